@@ -30,6 +30,7 @@ namespace htm_ext
 {
     void init_Connections(py::module&);
     void init_TemporalMemory(py::module&);
+    void init_ApicalTiebreakTemporalMemory(py::module&);
     void init_SDR_Classifier(py::module&);
     void init_Spatial_Pooler(py::module&);
 
@@ -42,6 +43,7 @@ PYBIND11_MODULE(algorithms, m) {
 
     init_Connections(m);
     init_TemporalMemory(m);
+    init_ApicalTiebreakTemporalMemory(m);
     init_SDR_Classifier(m);
     init_Spatial_Pooler(m);
 }
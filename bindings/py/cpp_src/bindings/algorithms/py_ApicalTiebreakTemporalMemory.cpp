@@ -0,0 +1,433 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * PyBind11 bindings for the ApicalTiebreakTemporalMemory classes
+ *
+ * Besides SDRs, compute accepts lists / numpy arrays of active indices, like
+ * py/htm/advanced/algorithms/apical_tiebreak_temporal_memory.py, so that the
+ * Python regions and frameworks can use either implementation.
+ */
+
+#include <bindings/suppress_register.hpp>  // include before pybind11.h
+#include <pybind11/pybind11.h>
+#include <pybind11/iostream.h>
+#include <pybind11/numpy.h>
+#include <pybind11/stl.h>
+
+#include <algorithm>
+#include <sstream>
+
+#include <htm/algorithms/ApicalTiebreakTemporalMemory.hpp>
+
+namespace py = pybind11;
+using namespace htm;
+
+namespace htm_ext
+{
+    // SDR of the given size from active indices in any order.
+    static SDR indicesToSDR(const UInt size, std::vector<UInt> indices)
+    {
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()), indices.end());
+        SDR sdr({ size });
+        sdr.setSparse(indices);
+        return sdr;
+    }
+
+    // Growth candidates default to the input (None).
+    static SDR growthCandidatesToSDR(const UInt size, const py::object &candidates, const SDR &input)
+    {
+        if (candidates.is_none())
+            return input;
+        return indicesToSDR(size, candidates.cast<std::vector<UInt>>());
+    }
+
+    template<typename T>
+    static py::array_t<UInt32> toArray(const std::vector<T> &values)
+    {
+        return py::array_t<UInt32>(values.size(), values.data());
+    }
+
+    template<typename TM_t, typename PyClass>
+    static void addPickle(PyClass &py_TM)
+    {
+        py_TM.def("saveToFile",
+            [](TM_t &self, const std::string& filename) { self.saveToFile(filename, SerializableFormat::BINARY); });
+
+        py_TM.def("loadFromFile",
+            [](TM_t &self, const std::string& filename) { self.loadFromFile(filename, SerializableFormat::BINARY); });
+
+        py_TM.def(py::pickle(
+            [](const TM_t& self)
+        {
+            std::ostringstream os;
+            self.save(os);
+            return py::bytes(os.str());
+        },
+            [](const py::bytes &str)
+        {
+            if (py::len(str) == 0)
+            {
+                throw std::runtime_error("Empty state");
+            }
+            std::stringstream is( str.cast<std::string>() );
+            std::unique_ptr<TM_t> tm(new TM_t());
+            tm->load(is);
+            return tm;
+        }
+        ));
+    }
+
+    void init_ApicalTiebreakTemporalMemory(py::module& m)
+    {
+        typedef ApicalTiebreakTemporalMemory ATTM_t;
+
+        py::class_<ATTM_t> py_ATTM(m, "ApicalTiebreakTemporalMemory",
+R"(A generalized Temporal Memory with apical dendrites that add a "tiebreak".
+
+Basal connections are used to implement traditional Temporal Memory.
+
+The apical connections are used for further disambiguation. If multiple cells
+in a minicolumn have active basal segments, each of those cells is predicted,
+unless one of them also has an active apical segment, in which case only the
+cells with active basal and apical segments are predicted.
+
+See ApicalTiebreakPairMemory and ApicalTiebreakSequenceMemory, which
+introduce the notion of a timestep.)");
+
+        py_ATTM.def(py::init<CellIdx, CellIdx, CellIdx, CellIdx, SynapseIdx, SynapseIdx,
+                             Permanence, Permanence, SynapseIdx, Int, Permanence, Permanence,
+                             Permanence, Permanence, Int, SegmentIdx, Int>(),
+R"(Argument columnCount
+    The number of minicolumns.
+
+Argument basalInputSize
+    The number of bits in the basal input.
+
+Argument apicalInputSize
+    The number of bits in the apical input.
+
+Argument cellsPerColumn
+    Number of cells per column.
+
+Argument activationThreshold
+    If the number of active connected synapses on a segment is at least this
+    threshold, the segment is said to be active.
+
+Argument reducedBasalThreshold
+    The activation threshold of basal (lateral) segments for cells that have
+    active apical segments. If equal to activationThreshold (default), this
+    parameter has no effect.
+
+Argument initialPermanence
+    Initial permanence of a new synapse.
+
+Argument connectedPermanence
+    If the permanence value for a synapse is greater than this value, it is
+    said to be connected.
+
+Argument minThreshold
+    If the number of potential synapses active on a segment is at least this
+    threshold, it is said to be "matching" and is eligible for learning.
+
+Argument sampleSize
+    How much of the active SDR to sample with synapses, -1 for all of it.
+
+Argument permanenceIncrement
+    Amount by which permanences of synapses are incremented during learning.
+
+Argument permanenceDecrement
+    Amount by which permanences of synapses are decremented during learning.
+
+Argument basalPredictedSegmentDecrement
+    Amount by which basal segments are punished for incorrect predictions.
+
+Argument apicalPredictedSegmentDecrement
+    Amount by which apical segments are punished for incorrect predictions.
+
+Argument maxSynapsesPerSegment
+    The maximum number of synapses per segment, -1 for no limit.
+
+Argument maxSegmentsPerCell
+    The maximum number of segments per cell.
+
+Argument seed
+    Seed for the random number generator.)"
+            , py::arg("columnCount") = 2048
+            , py::arg("basalInputSize") = 0
+            , py::arg("apicalInputSize") = 0
+            , py::arg("cellsPerColumn") = 32
+            , py::arg("activationThreshold") = 13
+            , py::arg("reducedBasalThreshold") = 13
+            , py::arg("initialPermanence") = 0.21
+            , py::arg("connectedPermanence") = 0.50
+            , py::arg("minThreshold") = 10
+            , py::arg("sampleSize") = 20
+            , py::arg("permanenceIncrement") = 0.1
+            , py::arg("permanenceDecrement") = 0.1
+            , py::arg("basalPredictedSegmentDecrement") = 0.0
+            , py::arg("apicalPredictedSegmentDecrement") = 0.0
+            , py::arg("maxSynapsesPerSegment") = -1
+            , py::arg("maxSegmentsPerCell") = 255
+            , py::arg("seed") = 42);
+
+        py_ATTM.def("reset", &ATTM_t::reset,
+R"(Clear all cell and segment activity.)");
+
+        py_ATTM.def("depolarizeCells", &ATTM_t::depolarizeCells,
+R"(Calculate predictions from the basal and apical input SDRs.)",
+            py::arg("basalInput"), py::arg("apicalInput"), py::arg("learn"));
+
+        py_ATTM.def("activateCells", &ATTM_t::activateCells,
+R"(Activate cells in the specified columns, using the result of the previous
+depolarizeCells as predictions. Then learn.)",
+            py::arg("activeColumns"),
+            py::arg("basalReinforceCandidates"),
+            py::arg("apicalReinforceCandidates"),
+            py::arg("basalGrowthCandidates"),
+            py::arg("apicalGrowthCandidates"),
+            py::arg("learn") = true);
+
+        py_ATTM.def("getActiveCells", [](const ATTM_t &self) { return toArray(self.getActiveCells()); });
+        py_ATTM.def("getPredictedActiveCells", [](const ATTM_t &self) { return toArray(self.getPredictedActiveCells()); });
+        py_ATTM.def("getWinnerCells", [](const ATTM_t &self) { return toArray(self.getWinnerCells()); });
+        py_ATTM.def("getActiveBasalSegments", [](const ATTM_t &self) { return toArray(self.getActiveBasalSegments()); });
+        py_ATTM.def("getActiveApicalSegments", [](const ATTM_t &self) { return toArray(self.getActiveApicalSegments()); });
+        py_ATTM.def("getMatchingBasalSegments", [](const ATTM_t &self) { return toArray(self.getMatchingBasalSegments()); });
+        py_ATTM.def("getMatchingApicalSegments", [](const ATTM_t &self) { return toArray(self.getMatchingApicalSegments()); });
+
+        py_ATTM.def("numberOfColumns", &ATTM_t::numberOfColumns);
+        py_ATTM.def("numberOfCells", &ATTM_t::numberOfCells);
+        py_ATTM.def("getCellsPerColumn", &ATTM_t::getCellsPerColumn);
+
+        py_ATTM.def("getActivationThreshold", &ATTM_t::getActivationThreshold);
+        py_ATTM.def("setActivationThreshold", &ATTM_t::setActivationThreshold);
+        py_ATTM.def("getReducedBasalThreshold", &ATTM_t::getReducedBasalThreshold);
+        py_ATTM.def("setReducedBasalThreshold", &ATTM_t::setReducedBasalThreshold);
+        py_ATTM.def("getInitialPermanence", &ATTM_t::getInitialPermanence);
+        py_ATTM.def("setInitialPermanence", &ATTM_t::setInitialPermanence);
+        py_ATTM.def("getConnectedPermanence", &ATTM_t::getConnectedPermanence);
+        py_ATTM.def("getMinThreshold", &ATTM_t::getMinThreshold);
+        py_ATTM.def("setMinThreshold", &ATTM_t::setMinThreshold);
+        py_ATTM.def("getSampleSize", &ATTM_t::getSampleSize);
+        py_ATTM.def("setSampleSize", &ATTM_t::setSampleSize);
+        py_ATTM.def("getPermanenceIncrement", &ATTM_t::getPermanenceIncrement);
+        py_ATTM.def("setPermanenceIncrement", &ATTM_t::setPermanenceIncrement);
+        py_ATTM.def("getPermanenceDecrement", &ATTM_t::getPermanenceDecrement);
+        py_ATTM.def("setPermanenceDecrement", &ATTM_t::setPermanenceDecrement);
+        py_ATTM.def("getBasalPredictedSegmentDecrement", &ATTM_t::getBasalPredictedSegmentDecrement);
+        py_ATTM.def("setBasalPredictedSegmentDecrement", &ATTM_t::setBasalPredictedSegmentDecrement);
+        py_ATTM.def("getApicalPredictedSegmentDecrement", &ATTM_t::getApicalPredictedSegmentDecrement);
+        py_ATTM.def("setApicalPredictedSegmentDecrement", &ATTM_t::setApicalPredictedSegmentDecrement);
+        py_ATTM.def("getMaxSynapsesPerSegment", &ATTM_t::getMaxSynapsesPerSegment);
+        py_ATTM.def("getMaxSegmentsPerCell", &ATTM_t::getMaxSegmentsPerCell);
+        py_ATTM.def("getUseApicalTiebreak", &ATTM_t::getUseApicalTiebreak);
+        py_ATTM.def("setUseApicalTiebreak", &ATTM_t::setUseApicalTiebreak);
+        py_ATTM.def("getUseApicalModulationBasalThreshold", &ATTM_t::getUseApicalModulationBasalThreshold);
+        py_ATTM.def("setUseApicalModulationBasalThreshold", &ATTM_t::setUseApicalModulationBasalThreshold);
+
+        py_ATTM.def_property_readonly("basalConnections", [](const ATTM_t &self)
+            { return self.basalConnections; },
+R"(Internal Connections object of the basal segments. Danger!)");
+
+        py_ATTM.def_property_readonly("apicalConnections", [](const ATTM_t &self)
+            { return self.apicalConnections; },
+R"(Internal Connections object of the apical segments. Danger!)");
+
+        py_ATTM.def("printParameters",
+            [](const ATTM_t& self)
+                { self.printParameters( std::cout ); },
+            py::call_guard<py::scoped_ostream_redirect,
+                           py::scoped_estream_redirect>());
+
+        py_ATTM.def("__eq__", [](const ATTM_t &self, const ATTM_t &other) { return self == other; }, py::is_operator());
+        addPickle<ATTM_t>(py_ATTM);
+
+
+        // ApicalTiebreakPairMemory
+        typedef ApicalTiebreakPairMemory Pair_t;
+        py::class_<Pair_t, ATTM_t> py_Pair(m, "ApicalTiebreakPairMemory",
+R"(Pair memory with apical tiebreak. Each compute predicts from the basal and
+apical input of this timestep, then activates the columns.)");
+
+        py_Pair.def(py::init<CellIdx, CellIdx, CellIdx, CellIdx, SynapseIdx, SynapseIdx,
+                             Permanence, Permanence, SynapseIdx, Int, Permanence, Permanence,
+                             Permanence, Permanence, Int, SegmentIdx, Int>(),
+R"(See ApicalTiebreakTemporalMemory.)"
+            , py::arg("columnCount") = 2048
+            , py::arg("basalInputSize") = 0
+            , py::arg("apicalInputSize") = 0
+            , py::arg("cellsPerColumn") = 32
+            , py::arg("activationThreshold") = 13
+            , py::arg("reducedBasalThreshold") = 13
+            , py::arg("initialPermanence") = 0.21
+            , py::arg("connectedPermanence") = 0.50
+            , py::arg("minThreshold") = 10
+            , py::arg("sampleSize") = 20
+            , py::arg("permanenceIncrement") = 0.1
+            , py::arg("permanenceDecrement") = 0.1
+            , py::arg("basalPredictedSegmentDecrement") = 0.0
+            , py::arg("apicalPredictedSegmentDecrement") = 0.0
+            , py::arg("maxSynapsesPerSegment") = -1
+            , py::arg("maxSegmentsPerCell") = 255
+            , py::arg("seed") = 42);
+
+        py_Pair.def("compute",
+            [](Pair_t &self, const SDR &activeColumns, const SDR &basalInput, const SDR &apicalInput,
+               const SDR &basalGrowthCandidates, const SDR &apicalGrowthCandidates, bool learn)
+            { self.compute(activeColumns, basalInput, apicalInput, basalGrowthCandidates, apicalGrowthCandidates, learn); },
+                py::arg("activeColumns"),
+                py::arg("basalInput"),
+                py::arg("apicalInput"),
+                py::arg("basalGrowthCandidates"),
+                py::arg("apicalGrowthCandidates"),
+                py::arg("learn") = true);
+
+        py_Pair.def("compute",
+            [](Pair_t &self, const std::vector<UInt> &activeColumns, const std::vector<UInt> &basalInput,
+               const std::vector<UInt> &apicalInput, const py::object &basalGrowthCandidates,
+               const py::object &apicalGrowthCandidates, bool learn)
+        {
+            const SDR columns = indicesToSDR(static_cast<UInt>(self.numberOfColumns()), activeColumns);
+            const SDR basal   = indicesToSDR(self.getBasalInputSize(), basalInput);
+            const SDR apical  = indicesToSDR(self.getApicalInputSize(), apicalInput);
+            self.compute(columns, basal, apical,
+                         growthCandidatesToSDR(self.getBasalInputSize(), basalGrowthCandidates, basal),
+                         growthCandidatesToSDR(self.getApicalInputSize(), apicalGrowthCandidates, apical),
+                         learn);
+        },
+R"(Perform one timestep. Use the basal and apical input to form a set of
+predictions, then activate the specified columns, then learn.
+
+Argument activeColumns
+    Active columns, SDR or list of indices.
+
+Argument basalInput
+    Active input bits for the basal dendrite segments.
+
+Argument apicalInput
+    Active input bits for the apical dendrite segments.
+
+Argument basalGrowthCandidates
+    Bits that the active cells may grow new basal synapses to. If None, the
+    basalInput is assumed to be growth candidates.
+
+Argument apicalGrowthCandidates
+    Bits that the active cells may grow new apical synapses to. If None, the
+    apicalInput is assumed to be growth candidates.
+
+Argument learn
+    Whether to grow / reinforce / punish synapses.)",
+                py::arg("activeColumns"),
+                py::arg("basalInput"),
+                py::arg("apicalInput") = std::vector<UInt>(),
+                py::arg("basalGrowthCandidates") = py::none(),
+                py::arg("apicalGrowthCandidates") = py::none(),
+                py::arg("learn") = true);
+
+        py_Pair.def("getPredictedCells", [](const Pair_t &self) { return toArray(self.getPredictedCells()); },
+R"(Cells that were predicted for this timestep.)");
+        py_Pair.def("getBasalPredictedCells", [](const Pair_t &self) { return toArray(self.getBasalPredictedCells()); },
+R"(Cells with active basal segments.)");
+        py_Pair.def("getApicalPredictedCells", [](const Pair_t &self) { return toArray(self.getApicalPredictedCells()); },
+R"(Cells with active apical segments.)");
+
+        addPickle<Pair_t>(py_Pair);
+
+
+        // ApicalTiebreakSequenceMemory
+        typedef ApicalTiebreakSequenceMemory Sequence_t;
+        py::class_<Sequence_t, ATTM_t> py_Sequence(m, "ApicalTiebreakSequenceMemory",
+R"(Sequence memory with apical tiebreak. The basal input are the active cells
+of the previous timestep, each compute activates the columns then predicts
+the next timestep.)");
+
+        py_Sequence.def(py::init<CellIdx, CellIdx, CellIdx, SynapseIdx, SynapseIdx,
+                                 Permanence, Permanence, SynapseIdx, Int, Permanence, Permanence,
+                                 Permanence, Permanence, Int, SegmentIdx, Int>(),
+R"(See ApicalTiebreakTemporalMemory, the basal input size is the number of cells.)"
+            , py::arg("columnCount") = 2048
+            , py::arg("apicalInputSize") = 0
+            , py::arg("cellsPerColumn") = 32
+            , py::arg("activationThreshold") = 13
+            , py::arg("reducedBasalThreshold") = 13
+            , py::arg("initialPermanence") = 0.21
+            , py::arg("connectedPermanence") = 0.50
+            , py::arg("minThreshold") = 10
+            , py::arg("sampleSize") = 20
+            , py::arg("permanenceIncrement") = 0.1
+            , py::arg("permanenceDecrement") = 0.1
+            , py::arg("basalPredictedSegmentDecrement") = 0.0
+            , py::arg("apicalPredictedSegmentDecrement") = 0.0
+            , py::arg("maxSynapsesPerSegment") = -1
+            , py::arg("maxSegmentsPerCell") = 255
+            , py::arg("seed") = 42);
+
+        py_Sequence.def("compute",
+            [](Sequence_t &self, const SDR &activeColumns, const SDR &apicalInput,
+               const SDR &apicalGrowthCandidates, bool learn)
+            { self.compute(activeColumns, apicalInput, apicalGrowthCandidates, learn); },
+                py::arg("activeColumns"),
+                py::arg("apicalInput"),
+                py::arg("apicalGrowthCandidates"),
+                py::arg("learn") = true);
+
+        py_Sequence.def("compute",
+            [](Sequence_t &self, const std::vector<UInt> &activeColumns, const std::vector<UInt> &apicalInput,
+               const py::object &apicalGrowthCandidates, bool learn)
+        {
+            const SDR columns = indicesToSDR(static_cast<UInt>(self.numberOfColumns()), activeColumns);
+            const SDR apical  = indicesToSDR(self.getApicalInputSize(), apicalInput);
+            self.compute(columns, apical,
+                         growthCandidatesToSDR(self.getApicalInputSize(), apicalGrowthCandidates, apical),
+                         learn);
+        },
+R"(Perform one timestep. Activate the specified columns, using the predictions
+from the previous timestep, then learn. Then form a new set of predictions
+using the new active cells and the apicalInput.
+
+Argument activeColumns
+    Active columns, SDR or list of indices.
+
+Argument apicalInput
+    Active input bits for the apical dendrite segments.
+
+Argument apicalGrowthCandidates
+    Bits that the active cells may grow new apical synapses to. If None, the
+    apicalInput is assumed to be growth candidates.
+
+Argument learn
+    Whether to grow / reinforce / punish synapses.)",
+                py::arg("activeColumns"),
+                py::arg("apicalInput") = std::vector<UInt>(),
+                py::arg("apicalGrowthCandidates") = py::none(),
+                py::arg("learn") = true);
+
+        py_Sequence.def("getPredictedCells", [](const Sequence_t &self) { return toArray(self.getPredictedCells()); },
+R"(The prediction from the previous timestep.)");
+        py_Sequence.def("getNextPredictedCells", [](const Sequence_t &self) { return toArray(self.getNextPredictedCells()); },
+R"(The prediction for the next timestep.)");
+        py_Sequence.def("getNextBasalPredictedCells", [](const Sequence_t &self) { return toArray(self.getNextBasalPredictedCells()); },
+R"(Cells with active basal segments.)");
+        py_Sequence.def("getNextApicalPredictedCells", [](const Sequence_t &self) { return toArray(self.getNextApicalPredictedCells()); },
+R"(Cells with active apical segments.)");
+
+        addPickle<Sequence_t>(py_Sequence);
+    }
+
+} // namespace htm_ext
@@ -37,13 +37,35 @@ namespace htm_ext
 {
   void init_Connections(py::module& m)
   {
+    py::enum_<PermanenceStorage>(m, "PermanenceStorage")
+      .value("REAL32", PermanenceStorage::REAL32)
+      .value("UINT16", PermanenceStorage::UINT16)
+      .value("UINT8",  PermanenceStorage::UINT8)
+      .export_values();
+
     py::class_<Connections> py_Connections(m, "Connections",
 R"(Compatibility Warning: This classes API is unstable and may change without warning.)");
 
-    py_Connections.def(py::init<UInt, Permanence, bool>(),
+    py_Connections.def(py::init<UInt, Permanence, bool, SynapseIdx, PermanenceStorage>(),
         py::arg("numCells"),
         py::arg("connectedThreshold"),
-        py::arg("timeseries") = false);
+        py::arg("timeseries") = false,
+        py::arg("synapseBlockSize") = 0,
+        py::arg("permanenceStorage") = PermanenceStorage::REAL32);
+
+    py_Connections.def_property_readonly("permanenceStorage",
+        [](const Connections &self) { return self.permanenceStorage(); });
+
+    py_Connections.def_property_readonly("synapseBlockSize",
+        [](const Connections &self) { return self.synapseBlockSize(); });
+
+    py_Connections.def_property("orderedSynapses",
+        [](const Connections &self) { return self.orderedSynapses(); },
+        [](Connections &self, bool ordered) { self.setOrderedSynapses(ordered); });
+
+    py_Connections.def_property("copyOnWrite",
+        [](const Connections &self) { return self.copyOnWrite(); },
+        [](Connections &self, bool enable) { self.setCopyOnWrite(enable); });
 
     py_Connections.def_property_readonly("connectedThreshold",
         [](const Connections &self) { return self.getConnectedThreshold(); });
@@ -62,6 +84,12 @@ R"(Compatibility Warning: This classes API is unstable and may change without wa
         py::arg("presynaticCell"),
         py::arg("permanence"));
 
+    py_Connections.def("createSynapses", &Connections::createSynapses,
+        py::arg("segment"),
+        py::arg("presynapticCells"),
+        py::arg("permanence"),
+        py::arg("maxNewSynapses") = std::numeric_limits<size_t>::max());
+
     py_Connections.def("destroySynapse", &Connections::destroySynapse);
 
     py_Connections.def("updateSynapsePermanence", &Connections::updateSynapsePermanence,
@@ -70,7 +98,10 @@ R"(Compatibility Warning: This classes API is unstable and may change without wa
 
     py_Connections.def("segmentsForCell", &Connections::segmentsForCell);
 
-    py_Connections.def("synapsesForSegment", &Connections::synapsesForSegment);
+    py_Connections.def("synapsesForSegment", [](const Connections &self, const Segment segment) {
+        return std::vector<Synapse>( self.synapsesForSegment(segment) ); });
+
+    py_Connections.def("orderedSynapsesForSegment", &Connections::orderedSynapsesForSegment);
 
     py_Connections.def("cellForSegment", &Connections::cellForSegment);
 
@@ -153,8 +184,8 @@ R"(Returns pair of:
         [](Connections &self, Segment seg) { return self.numSynapses(seg); });
 
     py_Connections.def("numConnectedSynapses",
-        [](Connections &self, Segment seg) {
-            auto &segData = self.dataForSegment( seg );
+        [](const Connections &self, Segment seg) {
+            const auto &segData = self.dataForSegment( seg );
             return segData.numConnected; });
 
     py_Connections.def("__str__",
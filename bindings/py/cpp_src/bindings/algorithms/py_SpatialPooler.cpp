@@ -216,6 +216,8 @@ Argument wrapAround boolean value that determines whether or not inputs
         py_SpatialPooler.def("setWrapAround", &SpatialPooler::setWrapAround);
         py_SpatialPooler.def("getUpdatePeriod", &SpatialPooler::getUpdatePeriod);
         py_SpatialPooler.def("setUpdatePeriod", &SpatialPooler::setUpdatePeriod);
+        py_SpatialPooler.def("getLazyDutyCycles", &SpatialPooler::getLazyDutyCycles);
+        py_SpatialPooler.def("setLazyDutyCycles", &SpatialPooler::setLazyDutyCycles);
         py_SpatialPooler.def("getSynPermActiveInc", &SpatialPooler::getSynPermActiveInc);
         py_SpatialPooler.def("setSynPermActiveInc", &SpatialPooler::setSynPermActiveInc);
         py_SpatialPooler.def("getSynPermInactiveDec", &SpatialPooler::getSynPermInactiveDec);
@@ -254,6 +256,14 @@ Argument wrapAround boolean value that determines whether or not inputs
             return os.str();
         });
 
+        py_SpatialPooler.def("freezeConnections", &SpatialPooler::freezeConnections,
+R"(Switch to the frozen mode, for inference only: take a read-only snapshot
+of the connections and release the connections. A frozen SP computes with
+learn False only, with the same results, and can not be saved.)");
+
+        py_SpatialPooler.def("isFrozen", &SpatialPooler::isFrozen,
+R"(True after freezeConnections.)");
+
         // compute
         py_SpatialPooler.def("compute", [](SpatialPooler& self, const SDR& input, const bool learn, SDR& output)
             { 
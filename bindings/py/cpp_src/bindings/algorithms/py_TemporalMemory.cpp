@@ -54,6 +54,12 @@ Example usage:
 	  .value("LOGLIKELIHOOD", TemporalMemory::ANMode::LOGLIKELIHOOD)
 	  .export_values();
 
+	py::enum_<SegmentEviction>(m, "SegmentEviction")
+	  .value("LRU",            SegmentEviction::LRU)
+	  .value("OLDEST",         SegmentEviction::OLDEST)
+	  .value("MIN_PERMANENCE", SegmentEviction::MIN_PERMANENCE)
+	  .export_values();
+
         py_HTM.def(py::init<>());
         py_HTM.def(py::init<std::vector<CellIdx>
                 , CellIdx
@@ -70,7 +76,8 @@ Example usage:
                 , SynapseIdx
                 , bool
                 , UInt
-		, TemporalMemory::ANMode>(),
+		, TemporalMemory::ANMode
+		, SegmentEviction>(),
 R"(Initialize the temporal memory (TM) using the given parameters.
 
 Argument columnDimensions
@@ -135,6 +142,10 @@ Argument externalPredictiveInputs
 Argument anomalyMode (optional, default ANMode::RAW) selects mode for `TM.anomaly`.
     Options are ANMode {DISABLED, RAW, LIKELIHOOD, LOGLIKELIHOOD}
 
+Argument segmentEviction (optional, default SegmentEviction.LRU) selects which
+    segment is destroyed to make room for a new one on a full cell.
+    Options are SegmentEviction {LRU, OLDEST, MIN_PERMANENCE}
+
 )"
                 , py::arg("columnDimensions")
                 , py::arg("cellsPerColumn") = 32
@@ -152,6 +163,7 @@ Argument anomalyMode (optional, default ANMode::RAW) selects mode for `TM.anomal
                 , py::arg("checkInputs") = true
                 , py::arg("externalPredictiveInputs") = 0u
 		, py::arg("anomalyMode") = TemporalMemory::ANMode::RAW 
+		, py::arg("segmentEviction") = SegmentEviction::LRU
 		);
 
         py_HTM.def("printParameters",
@@ -258,6 +270,26 @@ Argument externalPredictiveInputsWinners
                 py::arg("externalPredictiveInputsActive"),
                 py::arg("externalPredictiveInputsWinners"));
 
+        py_HTM.def("freezeConnections", &HTM_t::freezeConnections,
+R"(Switch to the frozen mode, for inference only: take a read-only snapshot
+of the connections and release the connections. A frozen TM can not compute
+or be saved, it infers with TemporalMemory::computeStreams in C++.)");
+
+        py_HTM.def("isFrozen", &HTM_t::isFrozen,
+R"(True after freezeConnections.)");
+
+        py_HTM.def("fork", &HTM_t::fork,
+R"(Returns a copy of this TM, for speculative (what-if) runs. With
+copyOnWrite the copies share the connections until either of them learns,
+then only the pages of synapses which it modifies are copied. The result
+is the same as a deep copy.)");
+
+        py_HTM.def_property("copyOnWrite",
+            [](const HTM_t &self) { return self.connections.copyOnWrite(); },
+            [](HTM_t &self, bool enable) { self.connections.setCopyOnWrite(enable); },
+R"(Keep the connections in pages shared by fork(), see
+Connections.copyOnWrite. Off by default, it slows compute slightly.)");
+
         py_HTM.def("reset", &HTM_t::reset,
 R"(Indicates the start of a new sequence.
 Resets sequence state of the TM.)");
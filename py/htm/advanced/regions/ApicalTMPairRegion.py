@@ -25,6 +25,7 @@ import numpy as np
 
 from htm.bindings.regions.PyRegion import PyRegion
 from htm.advanced.algorithms.apical_tiebreak_temporal_memory import ApicalTiebreakPairMemory
+from htm.bindings.algorithms import ApicalTiebreakPairMemory as ApicalTiebreakCPP
 
 
 class ApicalTMPairRegion(PyRegion):
@@ -345,7 +346,7 @@ class ApicalTMPairRegion(PyRegion):
              permanenceDecrement=0.10,
              basalPredictedSegmentDecrement=0.0,
              apicalPredictedSegmentDecrement=0.0,
-             learnOnOneCell=False, # ApicalTiebreakCPP only
+             learnOnOneCell=False, # unused
              maxSegmentsPerCell=255,
              maxSynapsesPerSegment=255, # ApicalTiebreakCPP only
              seed=42,
@@ -411,11 +412,11 @@ class ApicalTMPairRegion(PyRegion):
                 "seed": self.seed,
             }
 
-            if self.implementation == "ApicalTiebreakCPP": # TODO
-                params["learnOnOneCell"] = self.learnOnOneCell
+            if self.implementation == "ApicalTiebreakCPP":
+                params["reducedBasalThreshold"] = self.reducedBasalThreshold
                 params["maxSegmentsPerCell"] = self.maxSegmentsPerCell
 
-                cls = ApicalTiebreakPairMemory
+                cls = ApicalTiebreakCPP
 
             elif self.implementation == "ApicalTiebreak":
                 params["reducedBasalThreshold"] = self.reducedBasalThreshold
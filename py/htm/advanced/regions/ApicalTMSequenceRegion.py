@@ -25,6 +25,7 @@ import numpy as np
 
 from htm.bindings.regions.PyRegion import PyRegion
 from htm.advanced.algorithms.apical_tiebreak_temporal_memory import ApicalTiebreakSequenceMemory
+from htm.bindings.algorithms import ApicalTiebreakSequenceMemory as ApicalTiebreakCPP
 
 
 
@@ -296,7 +297,7 @@ class ApicalTMSequenceRegion(PyRegion):
              permanenceDecrement=0.10,
              basalPredictedSegmentDecrement=0.0,
              apicalPredictedSegmentDecrement=0.0,
-             learnOnOneCell=False, # ApicalTiebreakCPP only
+             learnOnOneCell=False, # unused
              maxSynapsesPerSegment=255,
              maxSegmentsPerCell=255, # ApicalTiebreakCPP only
              seed=42,
@@ -360,11 +361,11 @@ class ApicalTMSequenceRegion(PyRegion):
                 "seed": self.seed,
             }
 
-            if self.implementation == "ApicalTiebreakCPP": #TODO
-                params["learnOnOneCell"] = self.learnOnOneCell
+            if self.implementation == "ApicalTiebreakCPP":
+                params["reducedBasalThreshold"] = self.reducedBasalThreshold
                 params["maxSegmentsPerCell"] = self.maxSegmentsPerCell
 
-                cls = ApicalTiebreakSequenceMemory
+                cls = ApicalTiebreakCPP
 
             elif self.implementation == "ApicalTiebreak":
                 params["reducedBasalThreshold"] = self.reducedBasalThreshold
@@ -33,11 +33,19 @@ Real computeRawAnomalyScore(const SDR& active,
     return static_cast<Real>(0);
   }
 
-  // Calculate and return percent of active columns that were not predicted.
-  SDR both(active.dimensions);
-  both.intersection(active, predicted);
+  // Count the columns which are both active and predicted, by merging the
+  // sorted sparse indices (without allocating an SDR for the intersection).
+  const auto &predictedSparse = predicted.getSparse();
+  auto p = predictedSparse.cbegin();
+  UInt both = 0u;
+  for (const auto column : active.getSparse()) {
+    while (p != predictedSparse.cend() and *p < column) ++p;
+    if (p == predictedSparse.cend()) break;
+    both += (*p == column);
+  }
 
-  const Real score = (active.getSum() - both.getSum()) / static_cast<Real>(active.getSum());
+  // Calculate and return percent of active columns that were not predicted.
+  const Real score = (active.getSum() - both) / static_cast<Real>(active.getSum());
   NTA_ASSERT(score >= 0.0f and score <= 1.0f) << "Anomaly score out of bounds!";
   return score;
 }
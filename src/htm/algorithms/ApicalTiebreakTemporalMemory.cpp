@@ -0,0 +1,663 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of ApicalTiebreakTemporalMemory
+ *
+ * All lists of cells and columns are sorted, and all lists of segments are
+ * sorted by cell (Connections::compareSegments), so that the set operations
+ * of the Python version are merges and binary searches here.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include <htm/algorithms/ApicalTiebreakTemporalMemory.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace std;
+using namespace htm;
+
+
+namespace {
+  // The distinct cells of segments which are sorted by cell.
+  vector<CellIdx> cellsForSegments(const Connections &connections, const vector<Segment> &segments) {
+    vector<CellIdx> cells;
+    for (const auto segment : segments) {
+      const CellIdx cell = connections.cellForSegment(segment);
+      if (cells.empty() or cells.back() != cell) cells.push_back(cell);
+    }
+    return cells;
+  }
+
+  // The segments which are on one of the (sorted) cells.
+  vector<Segment> filterSegmentsByCell(const Connections &connections,
+                                       const vector<Segment> &segments,
+                                       const vector<CellIdx> &cells) {
+    vector<Segment> filtered;
+    for (const auto segment : segments) {
+      if (binary_search(cells.begin(), cells.end(), connections.cellForSegment(segment))) {
+        filtered.push_back(segment);
+      }
+    }
+    return filtered;
+  }
+
+  // The segments whose column is not one of the (sorted) active columns.
+  vector<Segment> segmentsNotInColumns(const Connections &connections,
+                                       const vector<Segment> &segments,
+                                       const vector<UInt> &activeColumns,
+                                       const CellIdx cellsPerColumn) {
+    vector<Segment> filtered;
+    for (const auto segment : segments) {
+      const UInt column = connections.cellForSegment(segment) / cellsPerColumn;
+      if (not binary_search(activeColumns.begin(), activeColumns.end(), column)) {
+        filtered.push_back(segment);
+      }
+    }
+    return filtered;
+  }
+
+  // For each group of `segments` with the same key (the groups are
+  // contiguous), the segment with the most active potential synapses. On a
+  // tie the first segment wins.
+  template<typename Key>
+  vector<Segment> chooseBestSegmentPerGroup(const vector<Segment> &segments,
+                                            const SegmentActivity &activity,
+                                            Key key) {
+    vector<Segment> best;
+    for (size_t i = 0; i < segments.size(); ) {
+      Segment winner = segments[i];
+      size_t j = i + 1u;
+      for (; j < segments.size() and key(segments[j]) == key(segments[i]); j++) {
+        if (activity.numActivePotential[segments[j]] > activity.numActivePotential[winner]) {
+          winner = segments[j];
+        }
+      }
+      best.push_back(winner);
+      i = j;
+    }
+    return best;
+  }
+}
+
+
+ApicalTiebreakTemporalMemory::ApicalTiebreakTemporalMemory(
+    CellIdx    columnCount,
+    CellIdx    basalInputSize,
+    CellIdx    apicalInputSize,
+    CellIdx    cellsPerColumn,
+    SynapseIdx activationThreshold,
+    SynapseIdx reducedBasalThreshold,
+    Permanence initialPermanence,
+    Permanence connectedPermanence,
+    SynapseIdx minThreshold,
+    Int        sampleSize,
+    Permanence permanenceIncrement,
+    Permanence permanenceDecrement,
+    Permanence basalPredictedSegmentDecrement,
+    Permanence apicalPredictedSegmentDecrement,
+    Int        maxSynapsesPerSegment,
+    SegmentIdx maxSegmentsPerCell,
+    Int        seed) {
+  initialize(columnCount, basalInputSize, apicalInputSize, cellsPerColumn,
+             activationThreshold, reducedBasalThreshold, initialPermanence,
+             connectedPermanence, minThreshold, sampleSize, permanenceIncrement,
+             permanenceDecrement, basalPredictedSegmentDecrement,
+             apicalPredictedSegmentDecrement, maxSynapsesPerSegment,
+             maxSegmentsPerCell, seed);
+}
+
+
+void ApicalTiebreakTemporalMemory::initialize(
+    CellIdx    columnCount,
+    CellIdx    basalInputSize,
+    CellIdx    apicalInputSize,
+    CellIdx    cellsPerColumn,
+    SynapseIdx activationThreshold,
+    SynapseIdx reducedBasalThreshold,
+    Permanence initialPermanence,
+    Permanence connectedPermanence,
+    SynapseIdx minThreshold,
+    Int        sampleSize,
+    Permanence permanenceIncrement,
+    Permanence permanenceDecrement,
+    Permanence basalPredictedSegmentDecrement,
+    Permanence apicalPredictedSegmentDecrement,
+    Int        maxSynapsesPerSegment,
+    SegmentIdx maxSegmentsPerCell,
+    Int        seed) {
+  NTA_CHECK(columnCount > 0) << "Number of columns must be greater than 0";
+  NTA_CHECK(cellsPerColumn > 0) << "Number of cells per column must be greater than 0";
+  NTA_CHECK(initialPermanence >= 0.0f and initialPermanence <= 1.0f);
+  NTA_CHECK(connectedPermanence >= 0.0f and connectedPermanence <= 1.0f);
+  NTA_CHECK(permanenceIncrement >= 0.0f and permanenceIncrement <= 1.0f);
+  NTA_CHECK(permanenceDecrement >= 0.0f and permanenceDecrement <= 1.0f);
+  NTA_CHECK(sampleSize == -1 or sampleSize > 0) << "sampleSize must be positive, or -1 for all";
+  NTA_CHECK(maxSynapsesPerSegment == -1 or maxSynapsesPerSegment > 0)
+    << "maxSynapsesPerSegment must be positive, or -1 for no limit";
+  NTA_CHECK(maxSegmentsPerCell > 0);
+
+  columnCount_ = columnCount;
+  basalInputSize_ = basalInputSize;
+  apicalInputSize_ = apicalInputSize;
+  cellsPerColumn_ = cellsPerColumn;
+  activationThreshold_ = activationThreshold;
+  reducedBasalThreshold_ = reducedBasalThreshold;
+  initialPermanence_ = initialPermanence;
+  connectedPermanence_ = connectedPermanence;
+  minThreshold_ = minThreshold;
+  sampleSize_ = sampleSize;
+  permanenceIncrement_ = permanenceIncrement;
+  permanenceDecrement_ = permanenceDecrement;
+  basalPredictedSegmentDecrement_ = basalPredictedSegmentDecrement;
+  apicalPredictedSegmentDecrement_ = apicalPredictedSegmentDecrement;
+  maxSynapsesPerSegment_ = maxSynapsesPerSegment;
+  maxSegmentsPerCell_ = maxSegmentsPerCell;
+  useApicalTiebreak_ = true;
+  useApicalModulationBasalThreshold_ = true;
+
+  const CellIdx numCells = static_cast<CellIdx>(numberOfCells());
+  basalConnections.initialize(numCells, connectedPermanence_);
+  apicalConnections.initialize(numCells, connectedPermanence_);
+  rng_ = Random(seed);
+
+  reset();
+}
+
+
+void ApicalTiebreakTemporalMemory::reset() {
+  activeCells_.clear();
+  winnerCells_.clear();
+  predictedCells_.clear();
+  predictedActiveCells_.clear();
+  activeBasalSegments_.clear();
+  matchingBasalSegments_.clear();
+  activeApicalSegments_.clear();
+  matchingApicalSegments_.clear();
+  basalActivity_.reset(basalConnections.segmentFlatListLength(), 0u, true);
+  apicalActivity_.reset(apicalConnections.segmentFlatListLength(), 0u, true);
+}
+
+
+void ApicalTiebreakTemporalMemory::findSegments_(const Connections &connections,
+                                                 const SegmentActivity &activity,
+                                                 const vector<SynapseIdx> &counts,
+                                                 const SynapseIdx threshold,
+                                                 vector<Segment> &segments) {
+  segments.clear();
+  if (threshold > 0) {
+    // Only the touched segments received input.
+    for (const auto segment : activity.touched) {
+      if (counts[segment] >= threshold) segments.push_back(segment);
+    }
+    sort(segments.begin(), segments.end(), [&](const Segment a, const Segment b) {
+      return connections.compareSegments(a, b); });
+  } else {
+    for (CellIdx cell = 0; cell < connections.numCells(); cell++) {
+      const auto &cellSegments = connections.segmentsForCell(cell);
+      segments.insert(segments.end(), cellSegments.begin(), cellSegments.end());
+    }
+  }
+}
+
+
+void ApicalTiebreakTemporalMemory::depolarizeCells(const SDR &basalInput,
+                                                   const SDR &apicalInput,
+                                                   const bool learn) {
+  NTA_CHECK(basalInput.size == basalInputSize_)
+    << "Basal input has size " << basalInput.size << ", expected " << basalInputSize_;
+  NTA_CHECK(apicalInput.size == apicalInputSize_)
+    << "Apical input has size " << apicalInput.size << ", expected " << apicalInputSize_;
+
+  // Apical segments.
+  apicalConnections.computeActivity(apicalActivity_, apicalInput.getSparse(), learn);
+  findSegments_(apicalConnections, apicalActivity_, apicalActivity_.numActiveConnected,
+                activationThreshold_, activeApicalSegments_);
+  findSegments_(apicalConnections, apicalActivity_, apicalActivity_.numActivePotential,
+                minThreshold_, matchingApicalSegments_);
+
+  // Basal segments. Active apical segments lower the activation threshold
+  // of the basal segments on their cell.
+  basalConnections.computeActivity(basalActivity_, basalInput.getSparse(), learn);
+  findSegments_(basalConnections, basalActivity_, basalActivity_.numActiveConnected,
+                activationThreshold_, activeBasalSegments_);
+  findSegments_(basalConnections, basalActivity_, basalActivity_.numActivePotential,
+                minThreshold_, matchingBasalSegments_);
+
+  if (not learn and useApicalModulationBasalThreshold_ and
+      reducedBasalThreshold_ < activationThreshold_ and not activeApicalSegments_.empty()) {
+    const auto reducedBasalThresholdCells = cellsForSegments(apicalConnections, activeApicalSegments_);
+    vector<Segment> conditionallyActive;
+    findSegments_(basalConnections, basalActivity_, basalActivity_.numActiveConnected,
+                  reducedBasalThreshold_, conditionallyActive);
+    vector<Segment> activeSegments;
+    for (const auto segment : conditionallyActive) {
+      if (basalActivity_.numActiveConnected[segment] >= activationThreshold_ or
+          binary_search(reducedBasalThresholdCells.begin(), reducedBasalThresholdCells.end(),
+                        basalConnections.cellForSegment(segment))) {
+        activeSegments.push_back(segment);
+      }
+    }
+    activeBasalSegments_.swap(activeSegments);
+  }
+
+  // Update segment bookkeeping, only the LRU eviction uses it.
+  if (learn) {
+    const auto markUsed = [](Connections &connections, const vector<Segment> &activeSegments) {
+      if (connections.segmentEviction() != SegmentEviction::LRU) return;
+      for (const auto segment : activeSegments) {
+        connections.dataForSegment(segment).lastUsed = connections.iteration();
+      }
+    };
+    markUsed(basalConnections, activeBasalSegments_);
+    markUsed(apicalConnections, activeApicalSegments_);
+  }
+
+  // Predicted cells: an active basal segment is enough to predict a cell, an
+  // active apical segment is not. When a cell has both types of segments
+  // active, other cells in its minicolumn must also have both types of
+  // segments to be considered predictive.
+  const auto basalCells = cellsForSegments(basalConnections, activeBasalSegments_);
+  predictedCells_.clear();
+  if (not useApicalTiebreak_) {
+    predictedCells_ = basalCells;
+    return;
+  }
+  const auto apicalCells = cellsForSegments(apicalConnections, activeApicalSegments_);
+  vector<bool> fullyDepolarized(basalCells.size());
+  vector<UInt> fullyDepolarizedColumns;
+  for (size_t i = 0; i < basalCells.size(); i++) {
+    fullyDepolarized[i] = binary_search(apicalCells.begin(), apicalCells.end(), basalCells[i]);
+    if (fullyDepolarized[i]) fullyDepolarizedColumns.push_back(basalCells[i] / cellsPerColumn_);
+  }
+  for (size_t i = 0; i < basalCells.size(); i++) {
+    if (fullyDepolarized[i] or not binary_search(fullyDepolarizedColumns.begin(),
+                                                 fullyDepolarizedColumns.end(),
+                                                 basalCells[i] / cellsPerColumn_)) {
+      predictedCells_.push_back(basalCells[i]);
+    }
+  }
+}
+
+
+void ApicalTiebreakTemporalMemory::activateCells(const SDR &activeColumns,
+                                                 const SDR &basalReinforceCandidates,
+                                                 const SDR &apicalReinforceCandidates,
+                                                 const SDR &basalGrowthCandidates,
+                                                 const SDR &apicalGrowthCandidates,
+                                                 const bool learn) {
+  NTA_CHECK(activeColumns.size == columnCount_)
+    << "Active columns have size " << activeColumns.size << ", expected " << columnCount_;
+  NTA_CHECK(basalReinforceCandidates.size == basalInputSize_ and basalGrowthCandidates.size == basalInputSize_);
+  NTA_CHECK(apicalReinforceCandidates.size == apicalInputSize_ and apicalGrowthCandidates.size == apicalInputSize_);
+  const auto &columns = activeColumns.getSparse();
+
+  // Calculate active cells: the correctly predicted cells, and all cells of
+  // the bursting columns.
+  vector<CellIdx> correctPredictedCells;
+  vector<UInt> burstingColumns;
+  {
+    auto predicted = predictedCells_.cbegin();
+    for (const auto column : columns) {
+      while (predicted != predictedCells_.cend() and *predicted / cellsPerColumn_ < column) predicted++;
+      const auto columnStart = predicted;
+      while (predicted != predictedCells_.cend() and *predicted / cellsPerColumn_ == column) predicted++;
+      if (columnStart == predicted) {
+        burstingColumns.push_back(column);
+      } else {
+        correctPredictedCells.insert(correctPredictedCells.end(), columnStart, predicted);
+      }
+    }
+  }
+  vector<CellIdx> newActiveCells = correctPredictedCells;
+  for (const auto column : burstingColumns) {
+    for (CellIdx cell = column * cellsPerColumn_; cell < (column + 1u) * cellsPerColumn_; cell++) {
+      newActiveCells.push_back(cell);
+    }
+  }
+  sort(newActiveCells.begin(), newActiveCells.end());
+
+  // Basal learning. Correctly predicted cells always have active basal
+  // segments, and we learn on these segments. In bursting columns, we either
+  // learn on an existing basal segment, or we grow a new one.
+  const auto learningActiveBasalSegments =
+      filterSegmentsByCell(basalConnections, activeBasalSegments_, correctPredictedCells);
+
+  vector<Segment> burstingMatchingBasalSegments;
+  vector<UInt> burstingColumnsWithNoMatch;
+  {
+    auto segment = matchingBasalSegments_.cbegin();
+    for (const auto column : burstingColumns) {
+      while (segment != matchingBasalSegments_.cend() and
+             basalConnections.cellForSegment(*segment) / cellsPerColumn_ < column) segment++;
+      const auto columnStart = segment;
+      while (segment != matchingBasalSegments_.cend() and
+             basalConnections.cellForSegment(*segment) / cellsPerColumn_ == column) segment++;
+      if (columnStart == segment) {
+        burstingColumnsWithNoMatch.push_back(column);
+      } else {
+        burstingMatchingBasalSegments.insert(burstingMatchingBasalSegments.end(), columnStart, segment);
+      }
+    }
+  }
+  const auto learningMatchingBasalSegments = chooseBestSegmentPerGroup(
+      burstingMatchingBasalSegments, basalActivity_,
+      [&](const Segment segment) { return basalConnections.cellForSegment(segment) / cellsPerColumn_; });
+
+  vector<CellIdx> newBasalSegmentCells;
+  getCellsWithFewestSegments_(burstingColumnsWithNoMatch, newBasalSegmentCells);
+
+  vector<CellIdx> learningCells = correctPredictedCells;
+  for (const auto segment : learningMatchingBasalSegments) {
+    learningCells.push_back(basalConnections.cellForSegment(segment));
+  }
+  learningCells.insert(learningCells.end(), newBasalSegmentCells.begin(), newBasalSegmentCells.end());
+  sort(learningCells.begin(), learningCells.end());
+
+  const auto basalSegmentsToPunish =
+      segmentsNotInColumns(basalConnections, matchingBasalSegments_, columns, cellsPerColumn_);
+
+  // Apical learning, on the same cells. Learn on any active segments on
+  // learning cells. For cells without active segments, learn on the best
+  // matching segment. For cells without a matching segment, grow a new
+  // segment.
+  const auto learningActiveApicalSegments =
+      filterSegmentsByCell(apicalConnections, activeApicalSegments_, learningCells);
+  const auto cellsWithActiveApical = cellsForSegments(apicalConnections, learningActiveApicalSegments);
+  vector<CellIdx> learningCellsWithoutActiveApical;
+  set_difference(learningCells.begin(), learningCells.end(),
+                 cellsWithActiveApical.begin(), cellsWithActiveApical.end(),
+                 back_inserter(learningCellsWithoutActiveApical));
+
+  const auto learningMatchingApicalSegments = chooseBestSegmentPerGroup(
+      filterSegmentsByCell(apicalConnections, matchingApicalSegments_, learningCellsWithoutActiveApical),
+      apicalActivity_,
+      [&](const Segment segment) { return apicalConnections.cellForSegment(segment); });
+  const auto cellsWithMatchingApical = cellsForSegments(apicalConnections, learningMatchingApicalSegments);
+  vector<CellIdx> newApicalSegmentCells;
+  set_difference(learningCellsWithoutActiveApical.begin(), learningCellsWithoutActiveApical.end(),
+                 cellsWithMatchingApical.begin(), cellsWithMatchingApical.end(),
+                 back_inserter(newApicalSegmentCells));
+
+  const auto apicalSegmentsToPunish =
+      segmentsNotInColumns(apicalConnections, matchingApicalSegments_, columns, cellsPerColumn_);
+
+  if (learn) {
+    // Learn on existing segments.
+    learn_(basalConnections, basalActivity_, learningActiveBasalSegments,
+           basalReinforceCandidates, basalGrowthCandidates);
+    learn_(basalConnections, basalActivity_, learningMatchingBasalSegments,
+           basalReinforceCandidates, basalGrowthCandidates);
+    learn_(apicalConnections, apicalActivity_, learningActiveApicalSegments,
+           apicalReinforceCandidates, apicalGrowthCandidates);
+    learn_(apicalConnections, apicalActivity_, learningMatchingApicalSegments,
+           apicalReinforceCandidates, apicalGrowthCandidates);
+
+    // Punish incorrect predictions.
+    if (basalPredictedSegmentDecrement_ != 0.0f) {
+      for (const auto segment : basalSegmentsToPunish) {
+        basalConnections.adaptSegment(segment, basalReinforceCandidates,
+                                      -basalPredictedSegmentDecrement_, 0.0f, false);
+      }
+    }
+    if (apicalPredictedSegmentDecrement_ != 0.0f) {
+      for (const auto segment : apicalSegmentsToPunish) {
+        apicalConnections.adaptSegment(segment, apicalReinforceCandidates,
+                                       -apicalPredictedSegmentDecrement_, 0.0f, false);
+      }
+    }
+
+    // Grow new segments. This can destroy segments (maxSegmentsPerCell), so
+    // it is done last.
+    learnOnNewSegments_(basalConnections, newBasalSegmentCells, basalGrowthCandidates);
+    learnOnNewSegments_(apicalConnections, newApicalSegmentCells, apicalGrowthCandidates);
+  }
+
+  activeCells_.swap(newActiveCells);
+  winnerCells_.swap(learningCells);
+  predictedActiveCells_.swap(correctPredictedCells);
+}
+
+
+void ApicalTiebreakTemporalMemory::getCellsWithFewestSegments_(const vector<CellIdx> &columns,
+                                                               vector<CellIdx> &cells) {
+  // The connections keep an index of the cells with the fewest segments in
+  // each mini-column, see Connections::indexLeastUsedCells.
+  if (basalConnections.leastUsedCellsGroupSize() != cellsPerColumn_) {
+    basalConnections.indexLeastUsedCells(cellsPerColumn_);
+  }
+  cells.clear();
+  for (const auto column : columns) {
+    const UInt32 numTiedCells = basalConnections.numLeastUsedCells(column);
+    cells.push_back(basalConnections.leastUsedCell(column, rng_.getUInt32(numTiedCells)));
+  }
+}
+
+
+void ApicalTiebreakTemporalMemory::learn_(Connections &connections,
+                                          const SegmentActivity &activity,
+                                          const vector<Segment> &learningSegments,
+                                          const SDR &reinforceCandidates,
+                                          const SDR &growthCandidates) {
+  for (const auto segment : learningSegments) {
+    connections.adaptSegment(segment, reinforceCandidates,
+                             permanenceIncrement_, permanenceDecrement_, false);
+
+    // Grow new synapses, up to sampleSize active potential synapses.
+    Int maxNew = sampleSize_ == -1
+      ? static_cast<Int>(growthCandidates.getSum())
+      : sampleSize_ - static_cast<Int>(activity.numActivePotential[segment]);
+    if (maxSynapsesPerSegment_ != -1) {
+      maxNew = std::min(maxNew, maxSynapsesPerSegment_ - static_cast<Int>(connections.numSynapses(segment)));
+    }
+    if (maxNew > 0) {
+      growSynapses_(connections, segment, growthCandidates, static_cast<size_t>(maxNew));
+    }
+  }
+}
+
+
+void ApicalTiebreakTemporalMemory::learnOnNewSegments_(Connections &connections,
+                                                       const vector<CellIdx> &newSegmentCells,
+                                                       const SDR &growthCandidates) {
+  size_t numNewSynapses = growthCandidates.getSum();
+  if (numNewSynapses == 0u) return;
+  if (sampleSize_ != -1) {
+    numNewSynapses = std::min(numNewSynapses, static_cast<size_t>(sampleSize_));
+  }
+  if (maxSynapsesPerSegment_ != -1) {
+    numNewSynapses = std::min(numNewSynapses, static_cast<size_t>(maxSynapsesPerSegment_));
+  }
+  for (const auto cell : newSegmentCells) {
+    const Segment segment = connections.createSegment(cell, maxSegmentsPerCell_);
+    growSynapses_(connections, segment, growthCandidates, numNewSynapses);
+  }
+}
+
+
+void ApicalTiebreakTemporalMemory::growSynapses_(Connections &connections,
+                                                 const Segment segment,
+                                                 const SDR &growthCandidates,
+                                                 const size_t maxNew) {
+  const auto &sparse = growthCandidates.getSparse();
+  growCandidates_.assign(sparse.begin(), sparse.end());
+  // Pick the candidates randomly. Grows synapses to the first candidates
+  // which are not on the segment yet.
+  rng_.shuffle(growCandidates_.begin(), growCandidates_.end());
+  connections.createSynapses(segment, growCandidates_, initialPermanence_, maxNew);
+}
+
+
+vector<CellIdx> ApicalTiebreakTemporalMemory::getBasalDepolarizedCells() const {
+  return cellsForSegments(basalConnections, activeBasalSegments_);
+}
+
+
+vector<CellIdx> ApicalTiebreakTemporalMemory::getApicalDepolarizedCells() const {
+  return cellsForSegments(apicalConnections, activeApicalSegments_);
+}
+
+
+bool ApicalTiebreakTemporalMemory::operator==(const ApicalTiebreakTemporalMemory &other) const {
+  return columnCount_ == other.columnCount_ and
+         basalInputSize_ == other.basalInputSize_ and
+         apicalInputSize_ == other.apicalInputSize_ and
+         cellsPerColumn_ == other.cellsPerColumn_ and
+         activationThreshold_ == other.activationThreshold_ and
+         reducedBasalThreshold_ == other.reducedBasalThreshold_ and
+         initialPermanence_ == other.initialPermanence_ and
+         connectedPermanence_ == other.connectedPermanence_ and
+         minThreshold_ == other.minThreshold_ and
+         sampleSize_ == other.sampleSize_ and
+         permanenceIncrement_ == other.permanenceIncrement_ and
+         permanenceDecrement_ == other.permanenceDecrement_ and
+         basalPredictedSegmentDecrement_ == other.basalPredictedSegmentDecrement_ and
+         apicalPredictedSegmentDecrement_ == other.apicalPredictedSegmentDecrement_ and
+         maxSynapsesPerSegment_ == other.maxSynapsesPerSegment_ and
+         maxSegmentsPerCell_ == other.maxSegmentsPerCell_ and
+         useApicalTiebreak_ == other.useApicalTiebreak_ and
+         useApicalModulationBasalThreshold_ == other.useApicalModulationBasalThreshold_ and
+         activeCells_ == other.activeCells_ and
+         winnerCells_ == other.winnerCells_ and
+         predictedCells_ == other.predictedCells_ and
+         predictedActiveCells_ == other.predictedActiveCells_ and
+         basalConnections == other.basalConnections and
+         apicalConnections == other.apicalConnections;
+}
+
+
+void ApicalTiebreakTemporalMemory::printParameters(std::ostream& out) const {
+  out << "Apical Tiebreak Temporal Memory Parameters\n";
+  out << "columnCount                     = " << columnCount_ << std::endl
+      << "basalInputSize                  = " << basalInputSize_ << std::endl
+      << "apicalInputSize                 = " << apicalInputSize_ << std::endl
+      << "cellsPerColumn                  = " << cellsPerColumn_ << std::endl
+      << "activationThreshold             = " << activationThreshold_ << std::endl
+      << "reducedBasalThreshold           = " << reducedBasalThreshold_ << std::endl
+      << "initialPermanence               = " << initialPermanence_ << std::endl
+      << "connectedPermanence             = " << connectedPermanence_ << std::endl
+      << "minThreshold                    = " << minThreshold_ << std::endl
+      << "sampleSize                      = " << sampleSize_ << std::endl
+      << "permanenceIncrement             = " << permanenceIncrement_ << std::endl
+      << "permanenceDecrement             = " << permanenceDecrement_ << std::endl
+      << "basalPredictedSegmentDecrement  = " << basalPredictedSegmentDecrement_ << std::endl
+      << "apicalPredictedSegmentDecrement = " << apicalPredictedSegmentDecrement_ << std::endl
+      << "maxSynapsesPerSegment           = " << maxSynapsesPerSegment_ << std::endl
+      << "maxSegmentsPerCell              = " << maxSegmentsPerCell_ << std::endl
+      << "useApicalTiebreak               = " << useApicalTiebreak_ << std::endl
+      << "useApicalModulationBasalThreshold = " << useApicalModulationBasalThreshold_ << std::endl;
+}
+
+
+// ==============================
+//  ApicalTiebreakPairMemory
+// ==============================
+
+void ApicalTiebreakPairMemory::compute(const SDR &activeColumns,
+                                       const SDR &basalInput,
+                                       const SDR &apicalInput,
+                                       const SDR &basalGrowthCandidates,
+                                       const SDR &apicalGrowthCandidates,
+                                       const bool learn) {
+  depolarizeCells(basalInput, apicalInput, learn);
+  activateCells(activeColumns, basalInput, apicalInput,
+                basalGrowthCandidates, apicalGrowthCandidates, learn);
+}
+
+
+// ==============================
+//  ApicalTiebreakSequenceMemory
+// ==============================
+
+ApicalTiebreakSequenceMemory::ApicalTiebreakSequenceMemory(
+    CellIdx    columnCount,
+    CellIdx    apicalInputSize,
+    CellIdx    cellsPerColumn,
+    SynapseIdx activationThreshold,
+    SynapseIdx reducedBasalThreshold,
+    Permanence initialPermanence,
+    Permanence connectedPermanence,
+    SynapseIdx minThreshold,
+    Int        sampleSize,
+    Permanence permanenceIncrement,
+    Permanence permanenceDecrement,
+    Permanence basalPredictedSegmentDecrement,
+    Permanence apicalPredictedSegmentDecrement,
+    Int        maxSynapsesPerSegment,
+    SegmentIdx maxSegmentsPerCell,
+    Int        seed)
+  : ApicalTiebreakTemporalMemory(columnCount, columnCount * cellsPerColumn, apicalInputSize,
+                                 cellsPerColumn, activationThreshold, reducedBasalThreshold,
+                                 initialPermanence, connectedPermanence, minThreshold,
+                                 sampleSize, permanenceIncrement, permanenceDecrement,
+                                 basalPredictedSegmentDecrement, apicalPredictedSegmentDecrement,
+                                 maxSynapsesPerSegment, maxSegmentsPerCell, seed) {
+  initializeBuffers_();
+}
+
+
+void ApicalTiebreakSequenceMemory::initializeBuffers_() {
+  basalInput_.initialize({basalInputSize_});
+  basalGrowthCandidates_.initialize({basalInputSize_});
+  apicalInput_.initialize({apicalInputSize_});
+  apicalGrowthCandidates_.initialize({apicalInputSize_});
+}
+
+
+void ApicalTiebreakSequenceMemory::reset() {
+  ApicalTiebreakTemporalMemory::reset();
+  prevApicalInput_.clear();
+  prevApicalGrowthCandidates_.clear();
+  prevPredictedCells_.clear();
+}
+
+
+void ApicalTiebreakSequenceMemory::compute(const SDR &activeColumns,
+                                           const SDR &apicalInput,
+                                           const SDR &apicalGrowthCandidates,
+                                           const bool learn) {
+  NTA_CHECK(apicalInput.size == apicalInputSize_ and apicalGrowthCandidates.size == apicalInputSize_);
+  prevPredictedCells_ = predictedCells_;
+
+  // Copies, setSparse(vector&) would take the vectors.
+  const auto copySparse = [](SDR &sdr, const vector<CellIdx> &sparse) { sdr.setSparse(sparse); };
+  copySparse(basalInput_, activeCells_);
+  copySparse(basalGrowthCandidates_, winnerCells_);
+  copySparse(apicalInput_, prevApicalInput_);
+  copySparse(apicalGrowthCandidates_, prevApicalGrowthCandidates_);
+  activateCells(activeColumns, basalInput_, apicalInput_,
+                basalGrowthCandidates_, apicalGrowthCandidates_, learn);
+
+  copySparse(basalInput_, activeCells_);
+  depolarizeCells(basalInput_, apicalInput, learn);
+
+  const auto &apicalSparse = apicalInput.getSparse();
+  prevApicalInput_.assign(apicalSparse.begin(), apicalSparse.end());
+  const auto &apicalGrowthSparse = apicalGrowthCandidates.getSparse();
+  prevApicalGrowthCandidates_.assign(apicalGrowthSparse.begin(), apicalGrowthSparse.end());
+}
+
+
+bool ApicalTiebreakSequenceMemory::operator==(const ApicalTiebreakTemporalMemory &other) const {
+  const auto *sequence = dynamic_cast<const ApicalTiebreakSequenceMemory*>(&other);
+  return sequence != nullptr and
+         ApicalTiebreakTemporalMemory::operator==(other) and
+         prevApicalInput_ == sequence->prevApicalInput_ and
+         prevApicalGrowthCandidates_ == sequence->prevApicalGrowthCandidates_ and
+         prevPredictedCells_ == sequence->prevPredictedCells_;
+}
@@ -0,0 +1,702 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the ApicalTiebreakTemporalMemory in C++
+ */
+
+#ifndef NTA_APICAL_TIEBREAK_TEMPORAL_MEMORY_HPP
+#define NTA_APICAL_TIEBREAK_TEMPORAL_MEMORY_HPP
+
+#include <iostream>
+#include <vector>
+
+#include <htm/algorithms/Connections.hpp>
+#include <htm/types/Types.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/types/Serializable.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace htm {
+
+/**
+ * A generalized Temporal Memory with apical dendrites that add a "tiebreak".
+ *
+ * C++ port of py/htm/advanced/algorithms/apical_tiebreak_temporal_memory.py,
+ * with the same parameters and results, up to the random choices.
+ *
+ * Basal connections are used to implement traditional Temporal Memory.
+ *
+ * The apical connections are used for further disambiguation. If multiple
+ * cells in a minicolumn have active basal segments, each of those cells is
+ * predicted, unless one of them also has an active apical segment, in which
+ * case only the cells with active basal and apical segments are predicted.
+ *
+ * In other words, the apical connections have no effect unless the basal
+ * input is a union of SDRs (e.g. from bursting minicolumns).
+ *
+ * This class is generalized in two ways:
+ *
+ * - This class does not specify when a 'timestep' begins and ends. It
+ *   exposes two main methods: 'depolarizeCells' and 'activateCells', and
+ *   callers or subclasses can introduce the notion of a timestep.
+ * - This class is unaware of whether its 'basalInput' or 'apicalInput' are
+ *   from internal or external cells. They are just cell numbers. The caller
+ *   knows what these cell numbers mean, but the TemporalMemory doesn't.
+ *
+ * The basal and apical segments are kept in two Connections, see
+ * basalConnections and apicalConnections.
+ */
+class ApicalTiebreakTemporalMemory : public Serializable
+{
+public:
+  ApicalTiebreakTemporalMemory() {}
+
+  /**
+   * @param columnCount
+   * The number of minicolumns.
+   *
+   * @param basalInputSize
+   * The number of bits in the basal input.
+   *
+   * @param apicalInputSize
+   * The number of bits in the apical input.
+   *
+   * @param cellsPerColumn
+   * Number of cells per column.
+   *
+   * @param activationThreshold
+   * If the number of active connected synapses on a segment is at least
+   * this threshold, the segment is said to be active.
+   *
+   * @param reducedBasalThreshold
+   * The activation threshold of basal (lateral) segments for cells that
+   * have active apical segments. If equal to activationThreshold (default),
+   * this parameter has no effect.
+   *
+   * @param initialPermanence
+   * Initial permanence of a new synapse.
+   *
+   * @param connectedPermanence
+   * If the permanence value for a synapse is greater than this value, it
+   * is said to be connected.
+   *
+   * @param minThreshold
+   * If the number of potential synapses active on a segment is at least
+   * this threshold, it is said to be "matching" and is eligible for
+   * learning.
+   *
+   * @param sampleSize
+   * How much of the active SDR to sample with synapses, -1 for all of it.
+   *
+   * @param permanenceIncrement
+   * Amount by which permanences of synapses are incremented during
+   * learning.
+   *
+   * @param permanenceDecrement
+   * Amount by which permanences of synapses are decremented during
+   * learning.
+   *
+   * @param basalPredictedSegmentDecrement
+   * Amount by which basal segments are punished for incorrect predictions.
+   *
+   * @param apicalPredictedSegmentDecrement
+   * Amount by which apical segments are punished for incorrect predictions.
+   *
+   * @param maxSynapsesPerSegment
+   * The maximum number of synapses per segment, -1 for no limit.
+   *
+   * @param maxSegmentsPerCell
+   * The maximum number of segments per cell, of each type.
+   *
+   * @param seed
+   * Seed for the random number generator.
+   */
+  ApicalTiebreakTemporalMemory(
+      CellIdx    columnCount,
+      CellIdx    basalInputSize,
+      CellIdx    apicalInputSize,
+      CellIdx    cellsPerColumn                  = 32,
+      SynapseIdx activationThreshold             = 13,
+      SynapseIdx reducedBasalThreshold           = 13,
+      Permanence initialPermanence               = 0.21f,
+      Permanence connectedPermanence             = 0.50f,
+      SynapseIdx minThreshold                    = 10,
+      Int        sampleSize                      = 20,
+      Permanence permanenceIncrement             = 0.10f,
+      Permanence permanenceDecrement             = 0.10f,
+      Permanence basalPredictedSegmentDecrement  = 0.0f,
+      Permanence apicalPredictedSegmentDecrement = 0.0f,
+      Int        maxSynapsesPerSegment           = -1,
+      SegmentIdx maxSegmentsPerCell              = 255,
+      Int        seed                            = 42);
+
+  virtual void initialize(
+      CellIdx    columnCount,
+      CellIdx    basalInputSize,
+      CellIdx    apicalInputSize,
+      CellIdx    cellsPerColumn                  = 32,
+      SynapseIdx activationThreshold             = 13,
+      SynapseIdx reducedBasalThreshold           = 13,
+      Permanence initialPermanence               = 0.21f,
+      Permanence connectedPermanence             = 0.50f,
+      SynapseIdx minThreshold                    = 10,
+      Int        sampleSize                      = 20,
+      Permanence permanenceIncrement             = 0.10f,
+      Permanence permanenceDecrement             = 0.10f,
+      Permanence basalPredictedSegmentDecrement  = 0.0f,
+      Permanence apicalPredictedSegmentDecrement = 0.0f,
+      Int        maxSynapsesPerSegment           = -1,
+      SegmentIdx maxSegmentsPerCell              = 255,
+      Int        seed                            = 42);
+
+  virtual ~ApicalTiebreakTemporalMemory() {}
+
+  /**
+   * Clear all cell and segment activity.
+   */
+  virtual void reset();
+
+  /**
+   * Calculate predictions.
+   *
+   * @param basalInput
+   * Active input bits for the basal dendrite segments.
+   *
+   * @param apicalInput
+   * Active input bits for the apical dendrite segments.
+   *
+   * @param learn
+   * Whether learning is enabled. Cells with active apical segments get the
+   * reducedBasalThreshold only without learning, and segment activity is
+   * recorded for the segment eviction only with learning.
+   */
+  void depolarizeCells(const SDR &basalInput,
+                       const SDR &apicalInput,
+                       const bool learn);
+
+  /**
+   * Activate cells in the specified columns, using the result of the
+   * previous 'depolarizeCells' as predictions. Then learn.
+   *
+   * @param activeColumns
+   * Active columns.
+   *
+   * @param basalReinforceCandidates
+   * Bits that the active cells may reinforce basal synapses to.
+   *
+   * @param apicalReinforceCandidates
+   * Bits that the active cells may reinforce apical synapses to.
+   *
+   * @param basalGrowthCandidates
+   * Bits that the active cells may grow new basal synapses to.
+   *
+   * @param apicalGrowthCandidates
+   * Bits that the active cells may grow new apical synapses to.
+   *
+   * @param learn
+   * Whether to grow / reinforce / punish synapses.
+   */
+  void activateCells(const SDR &activeColumns,
+                     const SDR &basalReinforceCandidates,
+                     const SDR &apicalReinforceCandidates,
+                     const SDR &basalGrowthCandidates,
+                     const SDR &apicalGrowthCandidates,
+                     const bool learn = true);
+
+  /**
+   * @returns Active cells, sorted.
+   */
+  const std::vector<CellIdx> &getActiveCells() const { return activeCells_; }
+
+  /**
+   * @returns Active cells that were correctly predicted, sorted.
+   */
+  const std::vector<CellIdx> &getPredictedActiveCells() const { return predictedActiveCells_; }
+
+  /**
+   * @returns Cells that were selected for learning, sorted.
+   */
+  const std::vector<CellIdx> &getWinnerCells() const { return winnerCells_; }
+
+  /**
+   * @returns Active basal / apical segments of the last depolarizeCells,
+   * sorted by cell.
+   */
+  const std::vector<Segment> &getActiveBasalSegments() const { return activeBasalSegments_; }
+  const std::vector<Segment> &getActiveApicalSegments() const { return activeApicalSegments_; }
+
+  /**
+   * @returns Matching basal / apical segments of the last depolarizeCells,
+   * sorted by cell.
+   */
+  const std::vector<Segment> &getMatchingBasalSegments() const { return matchingBasalSegments_; }
+  const std::vector<Segment> &getMatchingApicalSegments() const { return matchingApicalSegments_; }
+
+  /**
+   * @returns Cells with active basal / apical segments, sorted.
+   */
+  std::vector<CellIdx> getBasalDepolarizedCells() const;
+  std::vector<CellIdx> getApicalDepolarizedCells() const;
+
+  size_t numberOfColumns() const { return columnCount_; }
+  size_t numberOfCells() const { return static_cast<size_t>(columnCount_) * cellsPerColumn_; }
+  CellIdx getCellsPerColumn() const { return cellsPerColumn_; }
+  CellIdx getBasalInputSize() const { return basalInputSize_; }
+  CellIdx getApicalInputSize() const { return apicalInputSize_; }
+
+  SynapseIdx getActivationThreshold() const { return activationThreshold_; }
+  void setActivationThreshold(const SynapseIdx activationThreshold) { activationThreshold_ = activationThreshold; }
+
+  SynapseIdx getReducedBasalThreshold() const { return reducedBasalThreshold_; }
+  void setReducedBasalThreshold(const SynapseIdx reducedBasalThreshold) { reducedBasalThreshold_ = reducedBasalThreshold; }
+
+  Permanence getInitialPermanence() const { return initialPermanence_; }
+  void setInitialPermanence(const Permanence initialPermanence) { initialPermanence_ = initialPermanence; }
+
+  Permanence getConnectedPermanence() const { return connectedPermanence_; }
+
+  SynapseIdx getMinThreshold() const { return minThreshold_; }
+  void setMinThreshold(const SynapseIdx minThreshold) { minThreshold_ = minThreshold; }
+
+  Int getSampleSize() const { return sampleSize_; }
+  void setSampleSize(const Int sampleSize) { sampleSize_ = sampleSize; }
+
+  Permanence getPermanenceIncrement() const { return permanenceIncrement_; }
+  void setPermanenceIncrement(const Permanence permanenceIncrement) { permanenceIncrement_ = permanenceIncrement; }
+
+  Permanence getPermanenceDecrement() const { return permanenceDecrement_; }
+  void setPermanenceDecrement(const Permanence permanenceDecrement) { permanenceDecrement_ = permanenceDecrement; }
+
+  Permanence getBasalPredictedSegmentDecrement() const { return basalPredictedSegmentDecrement_; }
+  void setBasalPredictedSegmentDecrement(const Permanence decrement) { basalPredictedSegmentDecrement_ = decrement; }
+
+  Permanence getApicalPredictedSegmentDecrement() const { return apicalPredictedSegmentDecrement_; }
+  void setApicalPredictedSegmentDecrement(const Permanence decrement) { apicalPredictedSegmentDecrement_ = decrement; }
+
+  Int getMaxSynapsesPerSegment() const { return maxSynapsesPerSegment_; }
+  SegmentIdx getMaxSegmentsPerCell() const { return maxSegmentsPerCell_; }
+
+  /**
+   * Whether the apical segments break the ties between the basally
+   * predicted cells of a minicolumn (default true). Without it, all cells
+   * with an active basal segment are predicted.
+   */
+  bool getUseApicalTiebreak() const { return useApicalTiebreak_; }
+  void setUseApicalTiebreak(const bool useApicalTiebreak) { useApicalTiebreak_ = useApicalTiebreak; }
+
+  /**
+   * Whether the cells with active apical segments use the
+   * reducedBasalThreshold (default true).
+   */
+  bool getUseApicalModulationBasalThreshold() const { return useApicalModulationBasalThreshold_; }
+  void setUseApicalModulationBasalThreshold(const bool use) { useApicalModulationBasalThreshold_ = use; }
+
+  // a container to hold the data for one active or matching segment during
+  // serialization, the Segment handles are not kept by the Connections.
+  struct container_ar {
+    SegmentIdx idx;
+    CellIdx    cell;
+    SynapseIdx connected;
+    SynapseIdx potential;
+
+    template<class Archive>
+    void save_ar(Archive & ar) const {
+      ar(CEREAL_NVP(idx), CEREAL_NVP(cell), CEREAL_NVP(connected), CEREAL_NVP(potential));
+    }
+    template<class Archive>
+    void load_ar(Archive & ar) {
+      ar(CEREAL_NVP(idx), CEREAL_NVP(cell), CEREAL_NVP(connected), CEREAL_NVP(potential));
+    }
+  };
+
+  CerealAdapter;
+  template<class Archive>
+  void save_ar(Archive & ar) const {
+    const SegmentEviction segmentEviction = basalConnections.segmentEviction();
+    ar(CEREAL_NVP(columnCount_),
+       CEREAL_NVP(basalInputSize_),
+       CEREAL_NVP(apicalInputSize_),
+       CEREAL_NVP(cellsPerColumn_),
+       CEREAL_NVP(activationThreshold_),
+       CEREAL_NVP(reducedBasalThreshold_),
+       CEREAL_NVP(initialPermanence_),
+       CEREAL_NVP(connectedPermanence_),
+       CEREAL_NVP(minThreshold_),
+       CEREAL_NVP(sampleSize_),
+       CEREAL_NVP(permanenceIncrement_),
+       CEREAL_NVP(permanenceDecrement_),
+       CEREAL_NVP(basalPredictedSegmentDecrement_),
+       CEREAL_NVP(apicalPredictedSegmentDecrement_),
+       CEREAL_NVP(maxSynapsesPerSegment_),
+       CEREAL_NVP(maxSegmentsPerCell_),
+       CEREAL_NVP(useApicalTiebreak_),
+       CEREAL_NVP(useApicalModulationBasalThreshold_),
+       CEREAL_NVP(segmentEviction),
+       CEREAL_NVP(rng_),
+       CEREAL_NVP(activeCells_),
+       CEREAL_NVP(winnerCells_),
+       CEREAL_NVP(predictedCells_),
+       CEREAL_NVP(predictedActiveCells_),
+       CEREAL_NVP(basalConnections),
+       CEREAL_NVP(apicalConnections));
+    saveSegments_(ar, basalConnections, basalActivity_, activeBasalSegments_);
+    saveSegments_(ar, basalConnections, basalActivity_, matchingBasalSegments_);
+    saveSegments_(ar, apicalConnections, apicalActivity_, activeApicalSegments_);
+    saveSegments_(ar, apicalConnections, apicalActivity_, matchingApicalSegments_);
+  }
+  template<class Archive>
+  void load_ar(Archive & ar) {
+    SegmentEviction segmentEviction;
+    ar(CEREAL_NVP(columnCount_),
+       CEREAL_NVP(basalInputSize_),
+       CEREAL_NVP(apicalInputSize_),
+       CEREAL_NVP(cellsPerColumn_),
+       CEREAL_NVP(activationThreshold_),
+       CEREAL_NVP(reducedBasalThreshold_),
+       CEREAL_NVP(initialPermanence_),
+       CEREAL_NVP(connectedPermanence_),
+       CEREAL_NVP(minThreshold_),
+       CEREAL_NVP(sampleSize_),
+       CEREAL_NVP(permanenceIncrement_),
+       CEREAL_NVP(permanenceDecrement_),
+       CEREAL_NVP(basalPredictedSegmentDecrement_),
+       CEREAL_NVP(apicalPredictedSegmentDecrement_),
+       CEREAL_NVP(maxSynapsesPerSegment_),
+       CEREAL_NVP(maxSegmentsPerCell_),
+       CEREAL_NVP(useApicalTiebreak_),
+       CEREAL_NVP(useApicalModulationBasalThreshold_),
+       CEREAL_NVP(segmentEviction),
+       CEREAL_NVP(rng_),
+       CEREAL_NVP(activeCells_),
+       CEREAL_NVP(winnerCells_),
+       CEREAL_NVP(predictedCells_),
+       CEREAL_NVP(predictedActiveCells_),
+       CEREAL_NVP(basalConnections),
+       CEREAL_NVP(apicalConnections));
+    basalConnections.setSegmentEviction(segmentEviction);
+    apicalConnections.setSegmentEviction(segmentEviction);
+    basalActivity_.reset(basalConnections.segmentFlatListLength(), 0u, true);
+    apicalActivity_.reset(apicalConnections.segmentFlatListLength(), 0u, true);
+    loadSegments_(ar, basalConnections, basalActivity_, activeBasalSegments_);
+    loadSegments_(ar, basalConnections, basalActivity_, matchingBasalSegments_);
+    loadSegments_(ar, apicalConnections, apicalActivity_, activeApicalSegments_);
+    loadSegments_(ar, apicalConnections, apicalActivity_, matchingApicalSegments_);
+  }
+
+  virtual bool operator==(const ApicalTiebreakTemporalMemory &other) const;
+  inline bool operator!=(const ApicalTiebreakTemporalMemory &other) const { return not this->operator==(other); }
+
+  /**
+   * Print the main creation parameters
+   */
+  void printParameters(std::ostream& out=std::cout) const;
+
+private:
+  template<class Archive>
+  static void saveSegments_(Archive &ar, const Connections &connections,
+                            const SegmentActivity &activity, const std::vector<Segment> &segments) {
+    cereal::size_type numSegments = segments.size();
+    ar(cereal::make_size_tag(numSegments));
+    for (const Segment segment : segments) {
+      container_ar c;
+      c.cell      = connections.cellForSegment(segment);
+      c.idx       = connections.idxOnCellForSegment(segment);
+      c.connected = activity.numActiveConnected[segment];
+      c.potential = activity.numActivePotential[segment];
+      ar(c);
+    }
+  }
+  template<class Archive>
+  static void loadSegments_(Archive &ar, const Connections &connections,
+                            SegmentActivity &activity, std::vector<Segment> &segments) {
+    cereal::size_type numSegments;
+    ar(cereal::make_size_tag(numSegments));
+    segments.resize(static_cast<size_t>(numSegments));
+    for (size_t i = 0; i < segments.size(); i++) {
+      container_ar c;
+      ar(c);
+      const Segment segment = connections.getSegment(c.cell, c.idx);
+      segments[i] = segment;
+      if (activity.numActiveConnected[segment] == 0 and activity.numActivePotential[segment] == 0) {
+        activity.touched.push_back(segment);
+      }
+      activity.numActiveConnected[segment] = c.connected;
+      activity.numActivePotential[segment] = c.potential;
+    }
+  }
+
+  /**
+   * The segments of `activity` with at least `threshold` counts, sorted by
+   * cell.
+   */
+  static void findSegments_(const Connections &connections,
+                            const SegmentActivity &activity,
+                            const std::vector<SynapseIdx> &counts,
+                            const SynapseIdx threshold,
+                            std::vector<Segment> &segments);
+
+  /**
+   * For each column in `columns` the cell with the fewest basal segments,
+   * ties are broken randomly.
+   */
+  void getCellsWithFewestSegments_(const std::vector<CellIdx> &columns, std::vector<CellIdx> &cells);
+
+  /**
+   * Adapt the learning segments and grow synapses on them, up to
+   * sampleSize active potential synapses.
+   */
+  void learn_(Connections &connections,
+              const SegmentActivity &activity,
+              const std::vector<Segment> &learningSegments,
+              const SDR &reinforceCandidates,
+              const SDR &growthCandidates);
+
+  /**
+   * Grow a new segment on each of the cells, with synapses to a sample of
+   * the growth candidates.
+   */
+  void learnOnNewSegments_(Connections &connections,
+                           const std::vector<CellIdx> &newSegmentCells,
+                           const SDR &growthCandidates);
+
+  void growSynapses_(Connections &connections,
+                     const Segment segment,
+                     const SDR &growthCandidates,
+                     const size_t maxNew);
+
+protected:
+  CellIdx    columnCount_     = 0u;
+  CellIdx    basalInputSize_  = 0u;
+  CellIdx    apicalInputSize_ = 0u;
+  CellIdx    cellsPerColumn_  = 0u;
+  SynapseIdx activationThreshold_   = 0u;
+  SynapseIdx reducedBasalThreshold_ = 0u;
+  Permanence initialPermanence_   = 0.0f;
+  Permanence connectedPermanence_ = 0.0f;
+  SynapseIdx minThreshold_ = 0u;
+  Int        sampleSize_   = 0;
+  Permanence permanenceIncrement_ = 0.0f;
+  Permanence permanenceDecrement_ = 0.0f;
+  Permanence basalPredictedSegmentDecrement_  = 0.0f;
+  Permanence apicalPredictedSegmentDecrement_ = 0.0f;
+  Int        maxSynapsesPerSegment_ = -1;
+  SegmentIdx maxSegmentsPerCell_    = 0u;
+  bool useApicalTiebreak_                 = true;
+  bool useApicalModulationBasalThreshold_ = true;
+
+  std::vector<CellIdx> activeCells_;
+  std::vector<CellIdx> winnerCells_;
+  std::vector<CellIdx> predictedCells_;
+  std::vector<CellIdx> predictedActiveCells_;
+
+private:
+  std::vector<Segment> activeBasalSegments_;
+  std::vector<Segment> matchingBasalSegments_;
+  std::vector<Segment> activeApicalSegments_;
+  std::vector<Segment> matchingApicalSegments_;
+  SegmentActivity basalActivity_;  //of the last depolarizeCells, for learning
+  SegmentActivity apicalActivity_;
+  std::vector<CellIdx> growCandidates_; //scratch, see growSynapses_
+
+  Random rng_;
+
+public:
+  Connections basalConnections;
+  Connections apicalConnections;
+};
+
+
+/**
+ * Pair memory with apical tiebreak: each compute predicts from the basal and
+ * apical input of this timestep, then activates the columns.
+ */
+class ApicalTiebreakPairMemory : public ApicalTiebreakTemporalMemory
+{
+public:
+  using ApicalTiebreakTemporalMemory::ApicalTiebreakTemporalMemory;
+
+  /**
+   * Perform one timestep. Use the basal and apical input to form a set of
+   * predictions, then activate the specified columns, then learn.
+   *
+   * @param activeColumns
+   * Active columns.
+   *
+   * @param basalInput
+   * Active input bits for the basal dendrite segments.
+   *
+   * @param apicalInput
+   * Active input bits for the apical dendrite segments.
+   *
+   * @param basalGrowthCandidates
+   * Bits that the active cells may grow new basal synapses to.
+   *
+   * @param apicalGrowthCandidates
+   * Bits that the active cells may grow new apical synapses to.
+   *
+   * @param learn
+   * Whether to grow / reinforce / punish synapses.
+   */
+  void compute(const SDR &activeColumns,
+               const SDR &basalInput,
+               const SDR &apicalInput,
+               const SDR &basalGrowthCandidates,
+               const SDR &apicalGrowthCandidates,
+               const bool learn = true);
+
+  /**
+   * As above, the inputs are also the growth candidates.
+   */
+  void compute(const SDR &activeColumns,
+               const SDR &basalInput,
+               const SDR &apicalInput,
+               const bool learn = true) {
+    compute(activeColumns, basalInput, apicalInput, basalInput, apicalInput, learn);
+  }
+
+  /**
+   * @returns Cells that were predicted for this timestep, sorted.
+   */
+  const std::vector<CellIdx> &getPredictedCells() const { return predictedCells_; }
+
+  /**
+   * @returns Cells with active basal / apical segments, sorted.
+   */
+  std::vector<CellIdx> getBasalPredictedCells() const { return getBasalDepolarizedCells(); }
+  std::vector<CellIdx> getApicalPredictedCells() const { return getApicalDepolarizedCells(); }
+};
+
+
+/**
+ * Sequence memory with apical tiebreak: the basal input are the active cells
+ * of the previous timestep, each compute activates the columns then predicts
+ * the next timestep.
+ */
+class ApicalTiebreakSequenceMemory : public ApicalTiebreakTemporalMemory
+{
+public:
+  ApicalTiebreakSequenceMemory() {}
+
+  /**
+   * See ApicalTiebreakTemporalMemory, the basal input size is the number of
+   * cells.
+   */
+  ApicalTiebreakSequenceMemory(
+      CellIdx    columnCount,
+      CellIdx    apicalInputSize                 = 0,
+      CellIdx    cellsPerColumn                  = 32,
+      SynapseIdx activationThreshold             = 13,
+      SynapseIdx reducedBasalThreshold           = 13,
+      Permanence initialPermanence               = 0.21f,
+      Permanence connectedPermanence             = 0.50f,
+      SynapseIdx minThreshold                    = 10,
+      Int        sampleSize                      = 20,
+      Permanence permanenceIncrement             = 0.10f,
+      Permanence permanenceDecrement             = 0.10f,
+      Permanence basalPredictedSegmentDecrement  = 0.0f,
+      Permanence apicalPredictedSegmentDecrement = 0.0f,
+      Int        maxSynapsesPerSegment           = -1,
+      SegmentIdx maxSegmentsPerCell              = 255,
+      Int        seed                            = 42);
+
+  void reset() override;
+
+  /**
+   * Perform one timestep. Activate the specified columns, using the
+   * predictions from the previous timestep, then learn. Then form a new set
+   * of predictions using the new active cells and the apicalInput.
+   *
+   * @param activeColumns
+   * Active columns.
+   *
+   * @param apicalInput
+   * Active input bits for the apical dendrite segments.
+   *
+   * @param apicalGrowthCandidates
+   * Bits that the active cells may grow new apical synapses to.
+   *
+   * @param learn
+   * Whether to grow / reinforce / punish synapses.
+   */
+  void compute(const SDR &activeColumns,
+               const SDR &apicalInput,
+               const SDR &apicalGrowthCandidates,
+               const bool learn = true);
+
+  /**
+   * As above, the apical input is also the apical growth candidates.
+   */
+  void compute(const SDR &activeColumns,
+               const SDR &apicalInput,
+               const bool learn = true) {
+    compute(activeColumns, apicalInput, apicalInput, learn);
+  }
+
+  /**
+   * @returns The prediction from the previous timestep, sorted.
+   */
+  const std::vector<CellIdx> &getPredictedCells() const { return prevPredictedCells_; }
+
+  /**
+   * @returns The prediction for the next timestep, sorted.
+   */
+  const std::vector<CellIdx> &getNextPredictedCells() const { return predictedCells_; }
+
+  /**
+   * @returns Cells with active basal / apical segments for the next
+   * timestep, sorted.
+   */
+  std::vector<CellIdx> getNextBasalPredictedCells() const { return getBasalDepolarizedCells(); }
+  std::vector<CellIdx> getNextApicalPredictedCells() const { return getApicalDepolarizedCells(); }
+
+  CerealAdapter;
+  template<class Archive>
+  void save_ar(Archive & ar) const {
+    ApicalTiebreakTemporalMemory::save_ar(ar);
+    ar(CEREAL_NVP(prevApicalInput_),
+       CEREAL_NVP(prevApicalGrowthCandidates_),
+       CEREAL_NVP(prevPredictedCells_));
+  }
+  template<class Archive>
+  void load_ar(Archive & ar) {
+    ApicalTiebreakTemporalMemory::load_ar(ar);
+    ar(CEREAL_NVP(prevApicalInput_),
+       CEREAL_NVP(prevApicalGrowthCandidates_),
+       CEREAL_NVP(prevPredictedCells_));
+    initializeBuffers_();
+  }
+
+  bool operator==(const ApicalTiebreakTemporalMemory &other) const override;
+
+private:
+  void initializeBuffers_();
+
+  std::vector<CellIdx> prevApicalInput_;
+  std::vector<CellIdx> prevApicalGrowthCandidates_;
+  std::vector<CellIdx> prevPredictedCells_;
+
+  // Scratch, the inputs of activateCells and depolarizeCells.
+  SDR basalInput_;
+  SDR basalGrowthCandidates_;
+  SDR apicalInput_;
+  SDR apicalGrowthCandidates_;
+};
+
+} // namespace htm
+
+#endif // NTA_APICAL_TIEBREAK_TEMPORAL_MEMORY_HPP
@@ -0,0 +1,557 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of ColumnPooler
+ *
+ * All lists of cells and input bits are sorted, so that the set operations
+ * of the Python version are merges here.
+ */
+
+#include <algorithm>
+#include <iterator>
+
+#include <htm/algorithms/ColumnPooler.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace std;
+using namespace htm;
+
+
+ColumnPooler::ColumnPooler(const UInt inputWidth,
+                           const vector<UInt> &lateralInputWidths,
+                           const CellIdx cellCount,
+                           const UInt sdrSize,
+                           const bool onlineLearning,
+                           const UInt maxSdrSize,
+                           const UInt minSdrSize,
+                           const Permanence synPermProximalInc,
+                           const Permanence synPermProximalDec,
+                           const Permanence initialProximalPermanence,
+                           const Int sampleSizeProximal,
+                           const SynapseIdx minThresholdProximal,
+                           const Permanence connectedPermanenceProximal,
+                           const UInt predictedInhibitionThreshold,
+                           const Permanence synPermDistalInc,
+                           const Permanence synPermDistalDec,
+                           const Permanence initialDistalPermanence,
+                           const Int sampleSizeDistal,
+                           const SynapseIdx activationThresholdDistal,
+                           const Permanence connectedPermanenceDistal,
+                           const Real inertiaFactor,
+                           const Int seed) {
+  initialize(inputWidth, lateralInputWidths, cellCount, sdrSize, onlineLearning,
+             maxSdrSize, minSdrSize, synPermProximalInc, synPermProximalDec,
+             initialProximalPermanence, sampleSizeProximal, minThresholdProximal,
+             connectedPermanenceProximal, predictedInhibitionThreshold,
+             synPermDistalInc, synPermDistalDec, initialDistalPermanence,
+             sampleSizeDistal, activationThresholdDistal,
+             connectedPermanenceDistal, inertiaFactor, seed);
+}
+
+
+void ColumnPooler::initialize(const UInt inputWidth,
+                              const vector<UInt> &lateralInputWidths,
+                              const CellIdx cellCount,
+                              const UInt sdrSize,
+                              const bool onlineLearning,
+                              const UInt maxSdrSize,
+                              const UInt minSdrSize,
+                              const Permanence synPermProximalInc,
+                              const Permanence synPermProximalDec,
+                              const Permanence initialProximalPermanence,
+                              const Int sampleSizeProximal,
+                              const SynapseIdx minThresholdProximal,
+                              const Permanence connectedPermanenceProximal,
+                              const UInt predictedInhibitionThreshold,
+                              const Permanence synPermDistalInc,
+                              const Permanence synPermDistalDec,
+                              const Permanence initialDistalPermanence,
+                              const Int sampleSizeDistal,
+                              const SynapseIdx activationThresholdDistal,
+                              const Permanence connectedPermanenceDistal,
+                              const Real inertiaFactor,
+                              const Int seed) {
+  NTA_CHECK(inputWidth > 0) << "ColumnPooler needs a feedforward input.";
+  NTA_CHECK(cellCount > 0);
+  NTA_CHECK(sdrSize > 0 and sdrSize <= cellCount)
+    << "sdrSize " << sdrSize << " must be in [1, cellCount " << cellCount << "]";
+  NTA_CHECK(maxSdrSize == 0 or maxSdrSize >= sdrSize)
+    << "maxSdrSize " << maxSdrSize << " must be at least sdrSize " << sdrSize;
+  NTA_CHECK(minSdrSize <= sdrSize)
+    << "minSdrSize " << minSdrSize << " must be at most sdrSize " << sdrSize;
+  NTA_CHECK(sampleSizeProximal >= -1 and sampleSizeDistal >= -1);
+  NTA_CHECK(inertiaFactor >= 0.0f and inertiaFactor <= 1.0f);
+
+  inputWidth_         = inputWidth;
+  lateralInputWidths_ = lateralInputWidths;
+  cellCount_          = cellCount;
+  sdrSize_            = sdrSize;
+  onlineLearning_     = onlineLearning;
+  maxSdrSize_         = (maxSdrSize == 0) ? sdrSize : maxSdrSize;
+  minSdrSize_         = (minSdrSize == 0) ? sdrSize : minSdrSize;
+  synPermProximalInc_           = synPermProximalInc;
+  synPermProximalDec_           = synPermProximalDec;
+  initialProximalPermanence_    = initialProximalPermanence;
+  sampleSizeProximal_           = sampleSizeProximal;
+  minThresholdProximal_         = minThresholdProximal;
+  connectedPermanenceProximal_  = connectedPermanenceProximal;
+  predictedInhibitionThreshold_ = predictedInhibitionThreshold;
+  synPermDistalInc_             = synPermDistalInc;
+  synPermDistalDec_             = synPermDistalDec;
+  initialDistalPermanence_      = initialDistalPermanence;
+  sampleSizeDistal_             = sampleSizeDistal;
+  activationThresholdDistal_    = activationThresholdDistal;
+  connectedPermanenceDistal_    = connectedPermanenceDistal;
+  inertiaFactor_                = inertiaFactor;
+  useInertia_                   = true;
+
+  rng_ = Random(seed);
+  activeCells_.clear();
+
+  // Each cell potentially has 1 proximal segment and
+  // 1 + lateralInputWidths.size() distal segments.
+  proximalPermanences.initialize(cellCount_, connectedPermanenceProximal_);
+  internalDistalPermanences.initialize(cellCount_, connectedPermanenceDistal_);
+  distalPermanences.assign(lateralInputWidths_.size(), Connections(cellCount_, connectedPermanenceDistal_));
+}
+
+
+void ColumnPooler::compute(const SDR &feedforwardInput,
+                           const vector<SDR> &lateralInputs,
+                           const SDR &feedforwardGrowthCandidates,
+                           const bool learn,
+                           const SDR &predictedInput) {
+  NTA_CHECK(feedforwardInput.size == inputWidth_)
+    << "Feedforward input has size " << feedforwardInput.size << ", expected " << inputWidth_;
+  NTA_CHECK(feedforwardGrowthCandidates.size == inputWidth_)
+    << "Feedforward growth candidates have size " << feedforwardGrowthCandidates.size
+    << ", expected " << inputWidth_;
+  NTA_CHECK(lateralInputs.empty() or lateralInputs.size() == lateralInputWidths_.size())
+    << "Got " << lateralInputs.size() << " lateral inputs, expected "
+    << lateralInputWidths_.size();
+  for (size_t i = 0; i < lateralInputs.size(); i++) {
+    NTA_CHECK(lateralInputs[i].size == lateralInputWidths_[i])
+      << "Lateral input " << i << " has size " << lateralInputs[i].size
+      << ", expected " << lateralInputWidths_[i];
+  }
+
+  if (not learn) {
+    // inference step
+    computeInferenceMode_(feedforwardInput.getSparse(), lateralInputs);
+  }
+  else if (not onlineLearning_) {
+    // learning step
+    computeLearningMode_(feedforwardInput, lateralInputs, feedforwardGrowthCandidates);
+  }
+  // online learning step
+  else if (predictedInput.getSum() > predictedInhibitionThreshold_) {
+    const auto &ff        = feedforwardInput.getSparse();
+    const auto &predicted = predictedInput.getSparse();
+    SDR_sparse_t predictedActive;
+    set_intersection(ff.begin(), ff.end(), predicted.begin(), predicted.end(),
+                     back_inserter(predictedActive));
+    SDR predictedActiveInput({ inputWidth_ });
+    predictedActiveInput.setSparse(predictedActive);
+    computeInferenceMode_(predictedActiveInput.getSparse(), lateralInputs);
+    computeLearningMode_(predictedActiveInput, lateralInputs, feedforwardGrowthCandidates);
+  }
+  else if (not (minSdrSize_ <= activeCells_.size() and activeCells_.size() <= maxSdrSize_)) {
+    // If the pooler doesn't have a single representation, try to infer one,
+    // before actually attempting to learn.
+    computeInferenceMode_(feedforwardInput.getSparse(), lateralInputs);
+    computeLearningMode_(feedforwardInput, lateralInputs, feedforwardGrowthCandidates);
+  }
+  else {
+    // If there isn't predicted input and we have a single SDR, we are
+    // extending that representation and should just learn.
+    computeLearningMode_(feedforwardInput, lateralInputs, feedforwardGrowthCandidates);
+  }
+}
+
+
+void ColumnPooler::compute(const SDR &feedforwardInput,
+                           const vector<SDR> &lateralInputs,
+                           const bool learn) {
+  const SDR noPredictedInput({ 0u });
+  compute(feedforwardInput, lateralInputs, feedforwardInput, learn, noPredictedInput);
+}
+
+
+void ColumnPooler::computeLearningMode_(const SDR &feedforwardInput,
+                                        const vector<SDR> &lateralInputs,
+                                        const SDR &feedforwardGrowthCandidates) {
+  prevActiveCells_ = activeCells_;
+
+  // If there are not enough previously active cells, then we are no longer
+  // on a familiar object. Either our representation decayed due to the
+  // passage of time (i.e. we moved somewhere else) or we were mistaken.
+  // Either way, create a new SDR and learn on it.
+  // This case is the only way different object representations are created.
+  if (activeCells_.size() < minSdrSize_) {
+    vector<CellIdx> allCells(cellCount_);
+    for (CellIdx cell = 0; cell < cellCount_; cell++) allCells[cell] = cell;
+    activeCells_ = rng_.sample(allCells, sdrSize_);
+    sort(activeCells_.begin(), activeCells_.end());
+  }
+
+  // If we have a union of cells active, don't learn. This primarily affects
+  // online learning.
+  if (activeCells_.size() > maxSdrSize_) return;
+
+  // Finally, now that we have decided which cells we should be learning on,
+  // do the actual learning.
+  if (feedforwardInput.getSum() == 0) return;
+
+  learn_(proximalPermanences, feedforwardInput, feedforwardGrowthCandidates.getSparse(),
+         sampleSizeProximal_, initialProximalPermanence_,
+         synPermProximalInc_, synPermProximalDec_);
+
+  // External distal learning
+  for (size_t i = 0; i < lateralInputs.size(); i++) {
+    if (lateralInputs[i].getSum() == 0) continue;
+    learn_(distalPermanences[i], lateralInputs[i], lateralInputs[i].getSparse(),
+           sampleSizeDistal_, initialDistalPermanence_,
+           synPermDistalInc_, synPermDistalDec_);
+  }
+
+  // Internal distal learning
+  if (not prevActiveCells_.empty()) {
+    SDR prevActiveCells({ cellCount_ });
+    prevActiveCells.setSparse(static_cast<const vector<CellIdx>&>(prevActiveCells_));
+    learn_(internalDistalPermanences, prevActiveCells, prevActiveCells_,
+           sampleSizeDistal_, initialDistalPermanence_,
+           synPermDistalInc_, synPermDistalDec_);
+  }
+}
+
+
+void ColumnPooler::computeInferenceMode_(const vector<CellIdx> &feedforwardInput,
+                                         const vector<SDR> &lateralInputs) {
+  // Calculate the feedforward supported cells
+  activeSegmentCells_(proximalPermanences, feedforwardInput, minThresholdProximal_, supportedCells_);
+
+  // Calculate the number of active distal segments on each cell
+  numActiveSegmentsByCell_.assign(cellCount_, 0u);
+  activeSegmentCells_(internalDistalPermanences, activeCells_, activationThresholdDistal_, segmentCells_);
+  for (const auto cell : segmentCells_) numActiveSegmentsByCell_[cell]++;
+
+  for (size_t i = 0; i < lateralInputs.size(); i++) {
+    activeSegmentCells_(distalPermanences[i], lateralInputs[i].getSparse(),
+                        activationThresholdDistal_, segmentCells_);
+    for (const auto cell : segmentCells_) numActiveSegmentsByCell_[cell]++;
+  }
+
+  chosenCells_.clear();
+
+  // First, activate the FF-supported cells that have the highest number of
+  // lateral active segments (as long as it's not 0). This selects the cells
+  // in order of descending lateral activation, until we exceed the sdrSize
+  // quorum. The cells with at least ttop segments include the cells chosen
+  // with a higher ttop, so the union is the last selection.
+  UInt ttop = 0u;
+  for (const auto cell : supportedCells_) ttop = max(ttop, numActiveSegmentsByCell_[cell]);
+  for (; ttop > 0 and chosenCells_.size() < sdrSize_; ttop--) {
+    chosenCells_.clear();
+    for (const auto cell : supportedCells_) {
+      if (numActiveSegmentsByCell_[cell] >= ttop) chosenCells_.push_back(cell);
+    }
+  }
+
+  // If we haven't filled the sdrSize quorum, add in inertial cells.
+  if (chosenCells_.size() < sdrSize_ and useInertia_) {
+    prevCells_.clear();
+    set_difference(activeCells_.begin(), activeCells_.end(),
+                   chosenCells_.begin(), chosenCells_.end(), back_inserter(prevCells_));
+    const size_t inertialCap = static_cast<size_t>(prevCells_.size() * static_cast<Real64>(inertiaFactor_));
+    if (inertialCap > 0) {
+      // We sort the previously-active cells by number of active lateral
+      // segments (this really helps). We then activate them in order of
+      // descending lateral activation. Ties in reverse order, as numpy's
+      // argsort()[::-1].
+      stable_sort(prevCells_.begin(), prevCells_.end(), [&](const CellIdx a, const CellIdx b) {
+        return numActiveSegmentsByCell_[a] < numActiveSegmentsByCell_[b]; });
+      reverse(prevCells_.begin(), prevCells_.end());
+
+      // We use inertiaFactor to limit the number of previously-active cells
+      // which can become active, forcing decay even if we are below quota.
+      prevCells_.resize(inertialCap);
+
+      // Activate groups of previously active cells by order of their lateral
+      // support until we either meet quota or run out of cells.
+      size_t numPrevCells = 0u;
+      for (Int64 top = numActiveSegmentsByCell_[prevCells_[0]];
+           top >= 0 and chosenCells_.size() < sdrSize_; top--) {
+        const size_t begin = numPrevCells;
+        while (numPrevCells < prevCells_.size() and
+               static_cast<Int64>(numActiveSegmentsByCell_[prevCells_[numPrevCells]]) >= top) {
+          numPrevCells++;
+        }
+        segmentCells_.assign(prevCells_.begin() + begin, prevCells_.begin() + numPrevCells);
+        sort(segmentCells_.begin(), segmentCells_.end());
+        union_.clear();
+        set_union(chosenCells_.begin(), chosenCells_.end(),
+                  segmentCells_.begin(), segmentCells_.end(), back_inserter(union_));
+        chosenCells_.swap(union_);
+      }
+    }
+  }
+
+  // If we haven't filled the sdrSize quorum, add cells that have feedforward
+  // support and no lateral support.
+  if (chosenCells_.size() < sdrSize_) {
+    const size_t discrepancy = sdrSize_ - chosenCells_.size();
+    segmentCells_.clear();
+    set_difference(supportedCells_.begin(), supportedCells_.end(),
+                   chosenCells_.begin(), chosenCells_.end(), back_inserter(segmentCells_));
+    const auto &remainingFFcells = segmentCells_;
+
+    // Inhibit cells proportionally to the number of cells that have already
+    // been chosen. If ~0 have been chosen activate ~all of the feedforward
+    // supported cells. If ~sdrSize have been chosen, activate very few of
+    // the feedforward supported cells.
+
+    // Use the discrepancy:sdrSize ratio to determine the number of cells to
+    // activate.
+    size_t n = (remainingFFcells.size() * discrepancy) / sdrSize_;
+    // Activate at least 'discrepancy' cells.
+    n = max(n, discrepancy);
+    // If there aren't 'n' available, activate all of the available cells.
+    n = min(n, remainingFFcells.size());
+
+    if (remainingFFcells.size() > n) {
+      const auto selected = rng_.sample(remainingFFcells, static_cast<UInt>(n));
+      chosenCells_.insert(chosenCells_.end(), selected.begin(), selected.end());
+    }
+    else {
+      chosenCells_.insert(chosenCells_.end(), remainingFFcells.begin(), remainingFFcells.end());
+    }
+  }
+
+  sort(chosenCells_.begin(), chosenCells_.end());
+  activeCells_.swap(chosenCells_);
+}
+
+
+void ColumnPooler::activeSegmentCells_(Connections &connections,
+                                       const vector<CellIdx> &input,
+                                       const SynapseIdx threshold,
+                                       vector<CellIdx> &cells) {
+  cells.clear();
+  if (threshold > 0) {
+    // Only the touched segments received input.
+    connections.computeActivity(activity_, input, false, false);
+    for (const auto segment : activity_.touched) {
+      if (activity_.numActiveConnected[segment] >= threshold) {
+        cells.push_back(connections.cellForSegment(segment));
+      }
+    }
+    sort(cells.begin(), cells.end());
+  } else {
+    for (CellIdx cell = 0; cell < cellCount_; cell++) {
+      if (not connections.segmentsForCell(cell).empty()) cells.push_back(cell);
+    }
+  }
+}
+
+
+void ColumnPooler::learn_(Connections &connections,
+                          const SDR &activeInput,
+                          const vector<CellIdx> &growthCandidates,
+                          const Int sampleSize,
+                          const Permanence initialPermanence,
+                          const Permanence permanenceIncrement,
+                          const Permanence permanenceDecrement) {
+  const auto &activeBits = activeInput.getSparse();
+
+  for (const auto cell : activeCells_) {
+    // Should only have one segment per cell
+    const auto &segments = connections.segmentsForCell(cell);
+    const Segment segment = segments.empty() ? connections.createSegment(cell, 1)
+                                             : segments[0];
+
+    connections.adaptSegment(segment, activeInput, permanenceIncrement, permanenceDecrement, false);
+
+    presynapticCells_.clear();
+    for (const auto synapse : connections.synapsesForSegment(segment)) {
+      presynapticCells_.push_back(connections.dataForSynapse(synapse).presynapticCell);
+    }
+    sort(presynapticCells_.begin(), presynapticCells_.end());
+
+    size_t maxNew = growthCandidates.size();
+    if (sampleSize != -1) {
+      const auto existing = count_if(presynapticCells_.begin(), presynapticCells_.end(),
+          [&](const CellIdx c) { return binary_search(activeBits.begin(), activeBits.end(), c); });
+      const Int effectiveSampleSize = sampleSize - static_cast<Int>(existing);
+      if (effectiveSampleSize <= 0) continue;
+      maxNew = static_cast<size_t>(effectiveSampleSize);
+    }
+
+    newSynapseCells_.clear();
+    set_difference(growthCandidates.begin(), growthCandidates.end(),
+                   presynapticCells_.begin(), presynapticCells_.end(), back_inserter(newSynapseCells_));
+    if (maxNew < newSynapseCells_.size()) {
+      newSynapseCells_ = rng_.sample(newSynapseCells_, static_cast<UInt>(maxNew));
+    }
+    for (const auto presynapticCell : newSynapseCells_) {
+      connections.createSynapse(segment, presynapticCell, initialPermanence);
+    }
+  }
+}
+
+
+void ColumnPooler::reset() {
+  activeCells_.clear();
+}
+
+
+void ColumnPooler::getActiveCells(SDR &activeCells) const {
+  NTA_CHECK(activeCells.size == cellCount_)
+    << "SDR has size " << activeCells.size << ", expected " << cellCount_;
+  activeCells.setSparse(activeCells_);
+}
+
+
+namespace {
+  template<typename Count>
+  size_t countForCells(const Connections &connections, const vector<CellIdx> &cells,
+                       const CellIdx cellCount, Count count) {
+    size_t n = 0u;
+    const auto countCell = [&](const CellIdx cell) {
+      for (const auto segment : connections.segmentsForCell(cell)) n += count(segment);
+    };
+    if (cells.empty()) {
+      for (CellIdx cell = 0; cell < cellCount; cell++) countCell(cell);
+    } else {
+      for (const auto cell : cells) countCell(cell);
+    }
+    return n;
+  }
+}
+
+
+size_t ColumnPooler::numberOfProximalSynapses(const vector<CellIdx> &cells) const {
+  const auto &c = proximalPermanences;
+  return countForCells(c, cells, cellCount_, [&](const Segment s) { return c.numSynapses(s); });
+}
+
+
+size_t ColumnPooler::numberOfConnectedProximalSynapses(const vector<CellIdx> &cells) const {
+  const auto &c = proximalPermanences;
+  return countForCells(c, cells, cellCount_, [&](const Segment s) {
+    return static_cast<size_t>(c.dataForSegment(s).numConnected); });
+}
+
+
+size_t ColumnPooler::numberOfDistalSegments(const vector<CellIdx> &cells) const {
+  size_t n = 0u;
+  const auto countSegments = [&](const Connections &c) {
+    n += countForCells(c, cells, cellCount_, [&](const Segment s) {
+      return static_cast<size_t>(c.numSynapses(s) > 0); });
+  };
+  countSegments(internalDistalPermanences);
+  for (const auto &c : distalPermanences) countSegments(c);
+  return n;
+}
+
+
+size_t ColumnPooler::numberOfDistalSynapses(const vector<CellIdx> &cells) const {
+  size_t n = 0u;
+  const auto countSynapses = [&](const Connections &c) {
+    n += countForCells(c, cells, cellCount_, [&](const Segment s) { return c.numSynapses(s); });
+  };
+  countSynapses(internalDistalPermanences);
+  for (const auto &c : distalPermanences) countSynapses(c);
+  return n;
+}
+
+
+size_t ColumnPooler::numberOfConnectedDistalSynapses(const vector<CellIdx> &cells) const {
+  size_t n = 0u;
+  const auto countSynapses = [&](const Connections &c) {
+    n += countForCells(c, cells, cellCount_, [&](const Segment s) {
+      return static_cast<size_t>(c.dataForSegment(s).numConnected); });
+  };
+  countSynapses(internalDistalPermanences);
+  for (const auto &c : distalPermanences) countSynapses(c);
+  return n;
+}
+
+
+bool ColumnPooler::operator==(const ColumnPooler &other) const {
+  if (inputWidth_ != other.inputWidth_ or
+      lateralInputWidths_ != other.lateralInputWidths_ or
+      cellCount_ != other.cellCount_ or
+      sdrSize_ != other.sdrSize_ or
+      onlineLearning_ != other.onlineLearning_ or
+      maxSdrSize_ != other.maxSdrSize_ or
+      minSdrSize_ != other.minSdrSize_ or
+      synPermProximalInc_ != other.synPermProximalInc_ or
+      synPermProximalDec_ != other.synPermProximalDec_ or
+      initialProximalPermanence_ != other.initialProximalPermanence_ or
+      sampleSizeProximal_ != other.sampleSizeProximal_ or
+      minThresholdProximal_ != other.minThresholdProximal_ or
+      connectedPermanenceProximal_ != other.connectedPermanenceProximal_ or
+      predictedInhibitionThreshold_ != other.predictedInhibitionThreshold_ or
+      synPermDistalInc_ != other.synPermDistalInc_ or
+      synPermDistalDec_ != other.synPermDistalDec_ or
+      initialDistalPermanence_ != other.initialDistalPermanence_ or
+      sampleSizeDistal_ != other.sampleSizeDistal_ or
+      activationThresholdDistal_ != other.activationThresholdDistal_ or
+      connectedPermanenceDistal_ != other.connectedPermanenceDistal_ or
+      inertiaFactor_ != other.inertiaFactor_ or
+      useInertia_ != other.useInertia_ or
+      rng_ != other.rng_ or
+      activeCells_ != other.activeCells_) {
+    return false;
+  }
+  if (proximalPermanences != other.proximalPermanences or
+      internalDistalPermanences != other.internalDistalPermanences or
+      distalPermanences.size() != other.distalPermanences.size()) {
+    return false;
+  }
+  for (size_t i = 0; i < distalPermanences.size(); i++) {
+    if (distalPermanences[i] != other.distalPermanences[i]) return false;
+  }
+  return true;
+}
+
+
+void ColumnPooler::printParameters(std::ostream& out) const {
+  out << "Column Pooler Parameters\n";
+  out << "inputWidth                   = " << inputWidth_ << std::endl
+      << "lateralInputWidths           = " << lateralInputWidths_.size() << " inputs" << std::endl
+      << "cellCount                    = " << cellCount_ << std::endl
+      << "sdrSize                      = " << sdrSize_ << std::endl
+      << "onlineLearning               = " << onlineLearning_ << std::endl
+      << "maxSdrSize                   = " << maxSdrSize_ << std::endl
+      << "minSdrSize                   = " << minSdrSize_ << std::endl
+      << "synPermProximalInc           = " << synPermProximalInc_ << std::endl
+      << "synPermProximalDec           = " << synPermProximalDec_ << std::endl
+      << "initialProximalPermanence    = " << initialProximalPermanence_ << std::endl
+      << "sampleSizeProximal           = " << sampleSizeProximal_ << std::endl
+      << "minThresholdProximal         = " << minThresholdProximal_ << std::endl
+      << "connectedPermanenceProximal  = " << connectedPermanenceProximal_ << std::endl
+      << "predictedInhibitionThreshold = " << predictedInhibitionThreshold_ << std::endl
+      << "synPermDistalInc             = " << synPermDistalInc_ << std::endl
+      << "synPermDistalDec             = " << synPermDistalDec_ << std::endl
+      << "initialDistalPermanence      = " << initialDistalPermanence_ << std::endl
+      << "sampleSizeDistal             = " << sampleSizeDistal_ << std::endl
+      << "activationThresholdDistal    = " << activationThresholdDistal_ << std::endl
+      << "connectedPermanenceDistal    = " << connectedPermanenceDistal_ << std::endl
+      << "inertiaFactor                = " << inertiaFactor_ << std::endl;
+}
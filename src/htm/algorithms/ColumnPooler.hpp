@@ -0,0 +1,471 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the ColumnPooler in C++
+ */
+
+#ifndef NTA_COLUMN_POOLER_HPP
+#define NTA_COLUMN_POOLER_HPP
+
+#include <iostream>
+#include <vector>
+
+#include <htm/algorithms/Connections.hpp>
+#include <htm/types/Types.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/types/Serializable.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace htm {
+
+/**
+ * A cross-column pooler, the L2 layer of a cortical column which learns
+ * stable representations of objects.
+ *
+ * C++ port of py/htm/advanced/algorithms/column_pooler.py, with the same
+ * parameters and results, up to the random choices.
+ *
+ * Each cell has one proximal segment on the feedforward input, one distal
+ * segment on the previously active cells of this layer (internal distal)
+ * and one distal segment on each lateral input (the layers of the other
+ * cortical columns). The segments are kept in Connections, see
+ * proximalPermanences, internalDistalPermanences and distalPermanences.
+ *
+ * In learning mode the pooler keeps a set of sdrSize active cells, a new
+ * random one when the previous representation is gone, and learns the
+ * current input on it. In inference mode the cells with feedforward support
+ * compete by their lateral support, and the previously active cells stay
+ * active by inertia.
+ */
+class ColumnPooler : public Serializable
+{
+public:
+  ColumnPooler() {}
+
+  /**
+   * @param inputWidth
+   * The number of bits in the feedforward input.
+   *
+   * @param lateralInputWidths
+   * The number of bits in each lateral input.
+   *
+   * @param cellCount
+   * The number of cells in this layer.
+   *
+   * @param sdrSize
+   * The number of active cells in an object SDR.
+   *
+   * @param onlineLearning
+   * Whether or not the column pooler should learn in online mode.
+   *
+   * @param maxSdrSize
+   * The maximum SDR size for learning. If the column pooler has more than
+   * this many cells active, it will refuse to learn. This serves to stop the
+   * pooler from learning when it is uncertain of what object it is sensing.
+   * Default 0 means sdrSize.
+   *
+   * @param minSdrSize
+   * The minimum SDR size for learning. If the column pooler has fewer than
+   * this many active cells, it will create a new representation and learn
+   * that instead. This serves to create separate representations for
+   * different objects and sequences. Default 0 means sdrSize.
+   *
+   * If online learning is enabled, this parameter should be at least
+   * inertiaFactor*sdrSize. Otherwise, two different objects may be
+   * incorrectly inferred to be the same, as SDRs may still be active enough
+   * to learn even after inertial decay.
+   *
+   * @param synPermProximalInc
+   * Permanence increment for proximal synapses.
+   *
+   * @param synPermProximalDec
+   * Permanence decrement for proximal synapses.
+   *
+   * @param initialProximalPermanence
+   * Initial permanence value for proximal synapses.
+   *
+   * @param sampleSizeProximal
+   * Number of proximal synapses a cell should grow to each feedforward
+   * pattern, or -1 to connect to every active bit.
+   *
+   * @param minThresholdProximal
+   * Number of active synapses required for a cell to have feedforward
+   * support.
+   *
+   * @param connectedPermanenceProximal
+   * Permanence required for a proximal synapse to be connected.
+   *
+   * @param predictedInhibitionThreshold
+   * How much predicted input must be present for inhibitory behavior to be
+   * triggered. Only has effects if onlineLearning is true.
+   *
+   * @param synPermDistalInc
+   * Permanence increment for distal synapses.
+   *
+   * @param synPermDistalDec
+   * Permanence decrement for distal synapses.
+   *
+   * @param initialDistalPermanence
+   * Initial permanence value for distal synapses.
+   *
+   * @param sampleSizeDistal
+   * Number of distal synapses a cell should grow to each lateral pattern, or
+   * -1 to connect to every active bit.
+   *
+   * @param activationThresholdDistal
+   * Number of active synapses required to activate a distal segment.
+   *
+   * @param connectedPermanenceDistal
+   * Permanence required for a distal synapse to be connected.
+   *
+   * @param inertiaFactor
+   * The proportion of previously active cells that remain active in the
+   * next timestep due to inertia (in the absence of inhibition). If
+   * onlineLearning is enabled, should be at most 1 - learningTolerance, or
+   * representations may incorrectly become mixed.
+   *
+   * @param seed
+   * Random number generator seed.
+   */
+  ColumnPooler(const UInt inputWidth,
+               const std::vector<UInt> &lateralInputWidths = {},
+               const CellIdx cellCount = 4096,
+               const UInt sdrSize = 40,
+               const bool onlineLearning = false,
+               const UInt maxSdrSize = 0,
+               const UInt minSdrSize = 0,
+
+               // Proximal
+               const Permanence synPermProximalInc = 0.1f,
+               const Permanence synPermProximalDec = 0.001f,
+               const Permanence initialProximalPermanence = 0.6f,
+               const Int sampleSizeProximal = 20,
+               const SynapseIdx minThresholdProximal = 10,
+               const Permanence connectedPermanenceProximal = 0.5f,
+               const UInt predictedInhibitionThreshold = 20,
+
+               // Distal
+               const Permanence synPermDistalInc = 0.1f,
+               const Permanence synPermDistalDec = 0.001f,
+               const Permanence initialDistalPermanence = 0.6f,
+               const Int sampleSizeDistal = 20,
+               const SynapseIdx activationThresholdDistal = 13,
+               const Permanence connectedPermanenceDistal = 0.5f,
+               const Real inertiaFactor = 1.0f,
+
+               const Int seed = 42);
+
+  virtual void initialize(const UInt inputWidth,
+                          const std::vector<UInt> &lateralInputWidths = {},
+                          const CellIdx cellCount = 4096,
+                          const UInt sdrSize = 40,
+                          const bool onlineLearning = false,
+                          const UInt maxSdrSize = 0,
+                          const UInt minSdrSize = 0,
+                          const Permanence synPermProximalInc = 0.1f,
+                          const Permanence synPermProximalDec = 0.001f,
+                          const Permanence initialProximalPermanence = 0.6f,
+                          const Int sampleSizeProximal = 20,
+                          const SynapseIdx minThresholdProximal = 10,
+                          const Permanence connectedPermanenceProximal = 0.5f,
+                          const UInt predictedInhibitionThreshold = 20,
+                          const Permanence synPermDistalInc = 0.1f,
+                          const Permanence synPermDistalDec = 0.001f,
+                          const Permanence initialDistalPermanence = 0.6f,
+                          const Int sampleSizeDistal = 20,
+                          const SynapseIdx activationThresholdDistal = 13,
+                          const Permanence connectedPermanenceDistal = 0.5f,
+                          const Real inertiaFactor = 1.0f,
+                          const Int seed = 42);
+
+  virtual ~ColumnPooler() {}
+
+  /**
+   * Runs one time step of the column pooler algorithm.
+   *
+   * @param feedforwardInput
+   * Active feedforward input bits.
+   *
+   * @param lateralInputs
+   * For each lateral layer, the active lateral input bits. Either empty or
+   * one SDR per lateral input width.
+   *
+   * @param feedforwardGrowthCandidates
+   * Feedforward input bits that active cells may grow new synapses to.
+   *
+   * @param learn
+   * If true, we are learning a new object.
+   *
+   * @param predictedInput
+   * Predicted cells in the input layer. With online learning, more than
+   * predictedInhibitionThreshold of them restrict inference and learning to
+   * the predicted active input.
+   */
+  void compute(const SDR &feedforwardInput,
+               const std::vector<SDR> &lateralInputs,
+               const SDR &feedforwardGrowthCandidates,
+               const bool learn,
+               const SDR &predictedInput);
+
+  /**
+   * Same as above, the whole feedforwardInput are growth candidates and
+   * there is no predicted input.
+   */
+  void compute(const SDR &feedforwardInput,
+               const std::vector<SDR> &lateralInputs = {},
+               const bool learn = true);
+
+  /**
+   * Reset internal states. When learning this signifies we are to learn a
+   * unique new object.
+   */
+  virtual void reset();
+
+  /**
+   * Returns the indices of the active cells, sorted.
+   */
+  const std::vector<CellIdx> &getActiveCells() const { return activeCells_; }
+
+  /**
+   * Same as above, as an SDR of size numberOfCells().
+   */
+  void getActiveCells(SDR &activeCells) const;
+
+  UInt numberOfInputs() const { return inputWidth_; }
+  CellIdx numberOfCells() const { return cellCount_; }
+  const std::vector<UInt> &getLateralInputWidths() const { return lateralInputWidths_; }
+
+  /**
+   * The number of proximal synapses (all, or connected) on these cells, all
+   * cells if empty.
+   */
+  size_t numberOfProximalSynapses(const std::vector<CellIdx> &cells = {}) const;
+  size_t numberOfConnectedProximalSynapses(const std::vector<CellIdx> &cells = {}) const;
+
+  /**
+   * The number of distal segments with synapses, internal and lateral, on
+   * these cells, all cells if empty.
+   */
+  size_t numberOfDistalSegments(const std::vector<CellIdx> &cells = {}) const;
+
+  /**
+   * The number of distal synapses (all, or connected), internal and
+   * lateral, on these cells, all cells if empty.
+   */
+  size_t numberOfDistalSynapses(const std::vector<CellIdx> &cells = {}) const;
+  size_t numberOfConnectedDistalSynapses(const std::vector<CellIdx> &cells = {}) const;
+
+  /**
+   * Whether we actually use inertia (i.e. a fraction of the previously
+   * active cells remain active at the next time step unless inhibited by
+   * cells with both feedforward and lateral support).
+   */
+  bool getUseInertia() const { return useInertia_; }
+  void setUseInertia(const bool useInertia) { useInertia_ = useInertia; }
+
+  bool getOnlineLearning() const { return onlineLearning_; }
+  void setOnlineLearning(const bool onlineLearning) { onlineLearning_ = onlineLearning; }
+
+  UInt getSdrSize() const { return sdrSize_; }
+  UInt getMaxSdrSize() const { return maxSdrSize_; }
+  UInt getMinSdrSize() const { return minSdrSize_; }
+
+  Permanence getSynPermProximalInc() const { return synPermProximalInc_; }
+  void setSynPermProximalInc(const Permanence inc) { synPermProximalInc_ = inc; }
+  Permanence getSynPermProximalDec() const { return synPermProximalDec_; }
+  void setSynPermProximalDec(const Permanence dec) { synPermProximalDec_ = dec; }
+  Permanence getInitialProximalPermanence() const { return initialProximalPermanence_; }
+  Int getSampleSizeProximal() const { return sampleSizeProximal_; }
+  SynapseIdx getMinThresholdProximal() const { return minThresholdProximal_; }
+  void setMinThresholdProximal(const SynapseIdx threshold) { minThresholdProximal_ = threshold; }
+  Permanence getConnectedPermanenceProximal() const { return connectedPermanenceProximal_; }
+  UInt getPredictedInhibitionThreshold() const { return predictedInhibitionThreshold_; }
+
+  Permanence getSynPermDistalInc() const { return synPermDistalInc_; }
+  void setSynPermDistalInc(const Permanence inc) { synPermDistalInc_ = inc; }
+  Permanence getSynPermDistalDec() const { return synPermDistalDec_; }
+  void setSynPermDistalDec(const Permanence dec) { synPermDistalDec_ = dec; }
+  Permanence getInitialDistalPermanence() const { return initialDistalPermanence_; }
+  Int getSampleSizeDistal() const { return sampleSizeDistal_; }
+  SynapseIdx getActivationThresholdDistal() const { return activationThresholdDistal_; }
+  void setActivationThresholdDistal(const SynapseIdx threshold) { activationThresholdDistal_ = threshold; }
+  Permanence getConnectedPermanenceDistal() const { return connectedPermanenceDistal_; }
+  Real getInertiaFactor() const { return inertiaFactor_; }
+  void setInertiaFactor(const Real inertiaFactor) { inertiaFactor_ = inertiaFactor; }
+
+  CerealAdapter;
+  template<class Archive>
+  void save_ar(Archive & ar) const {
+    ar(CEREAL_NVP(inputWidth_),
+       CEREAL_NVP(lateralInputWidths_),
+       CEREAL_NVP(cellCount_),
+       CEREAL_NVP(sdrSize_),
+       CEREAL_NVP(onlineLearning_),
+       CEREAL_NVP(maxSdrSize_),
+       CEREAL_NVP(minSdrSize_),
+       CEREAL_NVP(synPermProximalInc_),
+       CEREAL_NVP(synPermProximalDec_),
+       CEREAL_NVP(initialProximalPermanence_),
+       CEREAL_NVP(sampleSizeProximal_),
+       CEREAL_NVP(minThresholdProximal_),
+       CEREAL_NVP(connectedPermanenceProximal_),
+       CEREAL_NVP(predictedInhibitionThreshold_),
+       CEREAL_NVP(synPermDistalInc_),
+       CEREAL_NVP(synPermDistalDec_),
+       CEREAL_NVP(initialDistalPermanence_),
+       CEREAL_NVP(sampleSizeDistal_),
+       CEREAL_NVP(activationThresholdDistal_),
+       CEREAL_NVP(connectedPermanenceDistal_),
+       CEREAL_NVP(inertiaFactor_),
+       CEREAL_NVP(useInertia_),
+       CEREAL_NVP(rng_),
+       CEREAL_NVP(activeCells_),
+       CEREAL_NVP(proximalPermanences),
+       CEREAL_NVP(internalDistalPermanences),
+       CEREAL_NVP(distalPermanences));
+  }
+  template<class Archive>
+  void load_ar(Archive & ar) {
+    ar(CEREAL_NVP(inputWidth_),
+       CEREAL_NVP(lateralInputWidths_),
+       CEREAL_NVP(cellCount_),
+       CEREAL_NVP(sdrSize_),
+       CEREAL_NVP(onlineLearning_),
+       CEREAL_NVP(maxSdrSize_),
+       CEREAL_NVP(minSdrSize_),
+       CEREAL_NVP(synPermProximalInc_),
+       CEREAL_NVP(synPermProximalDec_),
+       CEREAL_NVP(initialProximalPermanence_),
+       CEREAL_NVP(sampleSizeProximal_),
+       CEREAL_NVP(minThresholdProximal_),
+       CEREAL_NVP(connectedPermanenceProximal_),
+       CEREAL_NVP(predictedInhibitionThreshold_),
+       CEREAL_NVP(synPermDistalInc_),
+       CEREAL_NVP(synPermDistalDec_),
+       CEREAL_NVP(initialDistalPermanence_),
+       CEREAL_NVP(sampleSizeDistal_),
+       CEREAL_NVP(activationThresholdDistal_),
+       CEREAL_NVP(connectedPermanenceDistal_),
+       CEREAL_NVP(inertiaFactor_),
+       CEREAL_NVP(useInertia_),
+       CEREAL_NVP(rng_),
+       CEREAL_NVP(activeCells_),
+       CEREAL_NVP(proximalPermanences),
+       CEREAL_NVP(internalDistalPermanences),
+       CEREAL_NVP(distalPermanences));
+  }
+
+  virtual bool operator==(const ColumnPooler &other) const;
+  inline bool operator!=(const ColumnPooler &other) const { return not this->operator==(other); }
+
+  /**
+   * Print the main creation parameters
+   */
+  void printParameters(std::ostream& out=std::cout) const;
+
+private:
+  /**
+   * Inference mode: if there is some feedforward activity, perform spatial
+   * pooling on it to recognize previously known objects, then use lateral
+   * activity to activate a subset of the cells with feedforward support. If
+   * there is no feedforward activity, use lateral activity to activate a
+   * subset of the previous active cells.
+   */
+  void computeInferenceMode_(const std::vector<CellIdx> &feedforwardInput,
+                             const std::vector<SDR> &lateralInputs);
+
+  /**
+   * Learning mode: we are learning a new object in an online fashion. If
+   * there is no prior activity, we randomly activate 'sdrSize' cells and
+   * create connections to incoming input. If there was prior activity, we
+   * maintain it. If we have a union, we simply do not learn at all.
+   */
+  void computeLearningMode_(const SDR &feedforwardInput,
+                            const std::vector<SDR> &lateralInputs,
+                            const SDR &feedforwardGrowthCandidates);
+
+  /**
+   * The sorted cells which have a segment with at least `threshold` active
+   * connected synapses, with one segment per cell.
+   */
+  void activeSegmentCells_(Connections &connections,
+                           const std::vector<CellIdx> &input,
+                           const SynapseIdx threshold,
+                           std::vector<CellIdx> &cells);
+
+  /**
+   * For each active cell, reinforce active synapses, punish inactive
+   * synapses, and grow new synapses to a subset of the active input bits
+   * that the cell isn't already connected to.
+   */
+  void learn_(Connections &connections,
+              const SDR &activeInput,
+              const std::vector<CellIdx> &growthCandidates,
+              const Int sampleSize,
+              const Permanence initialPermanence,
+              const Permanence permanenceIncrement,
+              const Permanence permanenceDecrement);
+
+  UInt       inputWidth_ = 0u;
+  std::vector<UInt> lateralInputWidths_;
+  CellIdx    cellCount_  = 0u;
+  UInt       sdrSize_    = 0u;
+  bool       onlineLearning_ = false;
+  UInt       maxSdrSize_ = 0u;
+  UInt       minSdrSize_ = 0u;
+  Permanence synPermProximalInc_ = 0.0f;
+  Permanence synPermProximalDec_ = 0.0f;
+  Permanence initialProximalPermanence_ = 0.0f;
+  Int        sampleSizeProximal_ = 0;
+  SynapseIdx minThresholdProximal_ = 0u;
+  Permanence connectedPermanenceProximal_ = 0.0f;
+  UInt       predictedInhibitionThreshold_ = 0u;
+  Permanence synPermDistalInc_ = 0.0f;
+  Permanence synPermDistalDec_ = 0.0f;
+  Permanence initialDistalPermanence_ = 0.0f;
+  Int        sampleSizeDistal_ = 0;
+  SynapseIdx activationThresholdDistal_ = 0u;
+  Permanence connectedPermanenceDistal_ = 0.0f;
+  Real       inertiaFactor_ = 1.0f;
+  bool       useInertia_ = true;
+
+  std::vector<CellIdx> activeCells_;
+
+  // scratch, reused between the compute steps
+  SegmentActivity activity_;
+  std::vector<UInt> numActiveSegmentsByCell_;
+  std::vector<CellIdx> supportedCells_;
+  std::vector<CellIdx> segmentCells_;
+  std::vector<CellIdx> chosenCells_;
+  std::vector<CellIdx> prevActiveCells_;
+  std::vector<CellIdx> prevCells_;
+  std::vector<CellIdx> union_;
+  std::vector<CellIdx> presynapticCells_;
+  std::vector<CellIdx> newSynapseCells_;
+
+  Random rng_;
+
+public:
+  Connections proximalPermanences;
+  Connections internalDistalPermanences;
+  std::vector<Connections> distalPermanences;
+};
+
+} // namespace htm
+
+#endif // NTA_COLUMN_POOLER_HPP
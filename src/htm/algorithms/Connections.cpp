@@ -20,34 +20,102 @@
  */
 
 #include <algorithm> // nth_element
+#include <bitset>
 #include <climits>
+#include <cmath> // lround
+#include <functional> // greater
 #include <iomanip>
 #include <iostream>
 
 #include <htm/algorithms/Connections.hpp>
+#include <htm/algorithms/SegmentCounting.hpp>
 
 using std::endl;
 using std::string;
 using std::vector;
 using namespace htm;
+using htm::connections_::countSegments;
+
+const UInt16  Connections::VERSION;
+const UInt32  Connections::NO_BLOCK;
+const Synapse Connections::NO_SLOT;
+const Segment Connections::FREE_SLOT;
+
+namespace {
+  // computeActivity gives each thread at least this many active cells.
+  const size_t MIN_CELLS_PER_THREAD = 64u;
+
+  // computeActivity processes the counts of all segments sequentially, rather
+  // than only the touched ones, if more than 1/DENSE_FRACTION are touched.
+  const size_t DENSE_FRACTION = 16u;
+
+  // Marks a group of the least used cells index which must be recomputed.
+  const UInt32 INVALID_COUNT = std::numeric_limits<UInt32>::max();
+}
 
 Connections::Connections(const CellIdx numCells, 
 		         const Permanence connectedThreshold, 
-			 const bool timeseries) {
-  initialize(numCells, connectedThreshold, timeseries);
+			 const bool timeseries,
+			 const SynapseIdx synapseBlockSize,
+			 const PermanenceStorage permanenceStorage) {
+  initialize(numCells, connectedThreshold, timeseries, synapseBlockSize, permanenceStorage);
 }
 
-void Connections::initialize(CellIdx numCells, Permanence connectedThreshold, bool timeseries) {
-  cells_ = vector<CellData>(numCells);
+void Connections::initialize(CellIdx numCells, Permanence connectedThreshold, bool timeseries,
+		             SynapseIdx synapseBlockSize, PermanenceStorage permanenceStorage) {
+  cells_.clear();
+  cells_.resize(numCells);
   segments_.clear();
+  destroyedSegments_ = 0;
   synapses_.clear();
-  potentialSynapsesForPresynapticCell_.clear();
-  connectedSynapsesForPresynapticCell_.clear();
-  potentialSegmentsForPresynapticCell_.clear();
-  connectedSegmentsForPresynapticCell_.clear();
+  destroyedSynapses_ = 0;
+  nextSegmentOrdinal_ = 0;
+  nextSynapseOrdinal_ = 0;
+  freeSegments_.clear();
+  freeSynapses_.clear();
+  layout_++;
+  revision_++;
+  segmentBlocks_.clear();
+  nextBlock_.clear();
+  freeBlocks_.clear();
+  indexLeastUsedCells(0u);
+  NTA_CHECK(synapseBlockSize < std::numeric_limits<SynapseIdx>::max());
+  // A power of two which divides the page size of synapses_, so that the
+  // blocks do not straddle pages, and blocks of 32-byte SynapseData start on
+  // a cache line.
+  size_t blockSize = 0u;
+  if( synapseBlockSize > 0u ) {
+    blockSize = 2u;
+    while( blockSize < synapseBlockSize and blockSize < decltype(synapses_)::PAGE_SIZE ) {
+      blockSize *= 2u;
+    }
+  }
+  synapseBlockSize_ = static_cast<SynapseIdx>(blockSize);
+  presynapticLists_.clear();
+  presynapticSynapses_.clear();
+  presynapticSegments_.clear();
+  presynapticGaps_ = 0u;
+  threadActivity_.clear();
+  threadTouched_.clear();
   eventHandlers_.clear();
+  immediateHandlers_.clear();
+  batchHandlers_.clear();
+  eventQueue_.clear();
   NTA_CHECK(connectedThreshold >= minPermanence);
   NTA_CHECK(connectedThreshold <= maxPermanence);
+  permanenceStorage_ = permanenceStorage;
+  permanences16_.clear();
+  permanences8_.clear();
+  switch( permanenceStorage ) {
+    case PermanenceStorage::REAL32: permanenceSteps_ = 0.0f;     break;
+    case PermanenceStorage::UINT16: permanenceSteps_ = 65535.0f; break;
+    case PermanenceStorage::UINT8:  permanenceSteps_ = 255.0f;   break;
+    default: NTA_THROW << "Connections: unknown permanence storage " << static_cast<int>(permanenceStorage);
+  }
+  if( quantized_() ) {
+    connectedSteps_ = toSteps_( connectedThreshold );
+    connectedThreshold = fromSteps_( connectedSteps_ );
+  }
   connectedThreshold_ = connectedThreshold - htm::Epsilon;
   iteration_ = 0;
 
@@ -60,46 +128,131 @@ void Connections::initialize(CellIdx numCells, Permanence connectedThreshold, bo
 UInt32 Connections::subscribe(ConnectionsEventHandler *handler) {
   UInt32 token = nextEventToken_++;
   eventHandlers_[token] = handler;
+  if( handler->batchEvents() ) {
+    batchHandlers_.push_back(handler);
+  }
+  else {
+    immediateHandlers_.push_back(handler);
+  }
   return token;
 }
 
 void Connections::unsubscribe(UInt32 token) {
-  delete eventHandlers_.at(token);
+  ConnectionsEventHandler *handler = eventHandlers_.at(token);
+  const auto batched = std::find(batchHandlers_.begin(), batchHandlers_.end(), handler);
+  if( batched != batchHandlers_.end() ) {
+    if( not eventQueue_.empty() ) {
+      handler->onEvents(eventQueue_);
+    }
+    batchHandlers_.erase(batched);
+    if( batchHandlers_.empty() ) {
+      eventQueue_.clear();
+    }
+  }
+  else {
+    immediateHandlers_.erase(std::find(immediateHandlers_.begin(), immediateHandlers_.end(), handler));
+  }
+  delete handler;
   eventHandlers_.erase(token);
 }
 
+void Connections::flushEvents() {
+  if( eventQueue_.empty() ) return;
+  for( auto handler : batchHandlers_ ) {
+    handler->onEvents(eventQueue_);
+  }
+  eventQueue_.clear();
+}
+
+void Connections::dispatchEvent_(const ConnectionsEvent::Type type,
+                                 const UInt32 handle,
+                                 const Permanence permanence) {
+  for( auto handler : immediateHandlers_ ) {
+    switch( type ) {
+      case ConnectionsEvent::CREATE_SEGMENT:  handler->onCreateSegment(handle);  break;
+      case ConnectionsEvent::DESTROY_SEGMENT: handler->onDestroySegment(handle); break;
+      case ConnectionsEvent::CREATE_SYNAPSE:  handler->onCreateSynapse(handle);  break;
+      case ConnectionsEvent::DESTROY_SYNAPSE: handler->onDestroySynapse(handle); break;
+      case ConnectionsEvent::UPDATE_SYNAPSE_PERMANENCE:
+        handler->onUpdateSynapsePermanence(handle, permanence);
+        break;
+    }
+  }
+  if( not batchHandlers_.empty() ) {
+    ConnectionsEvent event;
+    event.type       = type;
+    event.handle     = handle;
+    event.permanence = permanence;
+    eventQueue_.push_back(event);
+  }
+}
+
+void Connections::evictSegments_(const CellIdx cell, const size_t numEvicted) {
+  auto &candidates = evictionCandidates_;
+  candidates.clear();
+  for (const Segment segment : segmentsForCell(cell)) {
+    const SegmentData &data = segments_[segment];
+    Real64 key = 0.0;
+    switch (segmentEviction_) {
+      case SegmentEviction::LRU:    key = data.lastUsed; break; //sort segments by access time
+      case SegmentEviction::OLDEST: key = 0.0;           break; //by ordinal only
+      case SegmentEviction::MIN_PERMANENCE:
+        for (const Synapse synapse : synapsesForSegment(segment)) {
+          key += synapses_[synapse].permanence;
+        }
+        break;
+    }
+    candidates.push_back({key, data.ordinal, segment});
+  }
+
+  // Destroy in the order of the policy, as if the minimum was destroyed one
+  // at a time.
+  const auto order = [](const EvictionCandidate_ &a, const EvictionCandidate_ &b) {
+    if (a.key == b.key) return a.ordinal < b.ordinal; //needed for deterministic sort
+    return a.key < b.key;
+  };
+  const auto last = candidates.begin() + static_cast<std::ptrdiff_t>(std::min(numEvicted, candidates.size()));
+  std::partial_sort(candidates.begin(), last, candidates.end(), order);
+  for (auto victim = candidates.begin(); victim != last; ++victim) {
+    destroySegment(victim->segment);
+  }
+}
+
 Segment Connections::createSegment(const CellIdx cell, 
 	                           const SegmentIdx maxSegmentsPerCell) {
 
-  //limit number of segmets per cell. If exceeded, remove the least recently used ones.
+  //limit number of segmets per cell. If exceeded, remove segments by the eviction policy.
   NTA_ASSERT(maxSegmentsPerCell > 0);
-  while (numSegments(cell) >= maxSegmentsPerCell) {
-    const auto& destroyCandidates = segmentsForCell(cell);
-    const auto compareSegmentsByLRU = [&](const Segment a, const Segment b) {
-	if(dataForSegment(a).lastUsed == dataForSegment(b).lastUsed) {
-	  return a < b; //needed for deterministic sort
-        } 
-	else return dataForSegment(a).lastUsed < dataForSegment(b).lastUsed; //sort segments by access time
-      };
-    const auto leastRecentlyUsedSegment = std::min_element(destroyCandidates.cbegin(), 
-        destroyCandidates.cend(), compareSegmentsByLRU);
-
-    destroySegment(*leastRecentlyUsedSegment);
+  if (numSegments(cell) >= maxSegmentsPerCell) {
+    evictSegments_(cell, numSegments(cell) - maxSegmentsPerCell + 1u);
   }
 
   //proceed to create a new segment
-  NTA_CHECK(segments_.size() < std::numeric_limits<Segment>::max()) << "Add segment failed: Range of Segment (data-type) insufficinet size."
+  const SegmentData& segmentData = SegmentData(cell, iteration_, nextSegmentOrdinal_, nextSegmentOrdinal_);
+  nextSegmentOrdinal_++;
+  Segment segment;
+  if( not freeSegments_.empty() ) { //reuse the slot of a destroyed segment
+    segment = freeSegments_.back();
+    freeSegments_.pop_back();
+    destroyedSegments_--;
+    segments_.edit(segment) = segmentData; //keeps the capacity of the synapses vector
+  }
+  else {
+    NTA_CHECK(segments_.size() < std::numeric_limits<Segment>::max()) << "Add segment failed: Range of Segment (data-type) insufficinet size."
 	    << (size_t)segments_.size() << " < " << (size_t)std::numeric_limits<Segment>::max();
-  const Segment segment = static_cast<Segment>(segments_.size());
-  const SegmentData& segmentData = SegmentData(cell, iteration_, nextSegmentOrdinal_++);
-  segments_.push_back(segmentData);
+    segment = static_cast<Segment>(segments_.size());
+    segments_.push_back(segmentData);
+    if(synapseBlockSize_ > 0) {
+      segmentBlocks_.push_back(SegmentBlocks_());
+    }
+  }
 
-  CellData &cellData = cells_[cell];
+  CellData &cellData = cells_.edit(cell);
   cellData.segments.push_back(segment); //assign the new segment to its mother-cell
+  segmentCountChanged_(cell, cellData.segments.size() - 1u, cellData.segments.size());
 
-  for (auto h : eventHandlers_) {
-    h.second->onCreateSegment(segment);
-  }
+  revision_++;
+  notify_(ConnectionsEvent::CREATE_SEGMENT, segment);
 
   return segment;
 }
@@ -126,39 +279,241 @@ Synapse Connections::createSynapse(Segment segment,
     }
   } //else: the new synapse is not duplicit, so keep creating it. 
 
+  return addSynapse_(segment, presynapticCell, permanence);
+}
+
+
+size_t Connections::createSynapses(const Segment segment,
+                                   const vector<CellIdx> &presynapticCells,
+                                   const Permanence permanence,
+                                   const size_t maxNewSynapses) {
+  return createSynapses_( segment, presynapticCells, nullptr, permanence, maxNewSynapses );
+}
+
+
+size_t Connections::createSynapses(const Segment segment,
+                                   const vector<CellIdx> &presynapticCells,
+                                   const vector<Permanence> &permanences) {
+  NTA_CHECK( permanences.size() == presynapticCells.size() )
+    << "createSynapses: " << permanences.size() << " permanences for "
+    << presynapticCells.size() << " cells";
+  return createSynapses_( segment, presynapticCells, permanences.data(), minPermanence,
+                          std::numeric_limits<size_t>::max() );
+}
+
+
+size_t Connections::createSynapses_(const Segment segment,
+                                    const vector<CellIdx> &presynapticCells,
+                                    const Permanence *permanences,
+                                    const Permanence permanence,
+                                    const size_t maxNewSynapses) {
+  if( presynapticCells.empty() or maxNewSynapses == 0u ) return 0u;
+
+  // Find the duplicates with a small hash table of the candidates: one pass
+  // over the candidates, to find the repeated cells (the first is kept), and
+  // one pass over the synapses of the segment.
+  const CellIdx EMPTY = std::numeric_limits<CellIdx>::max();
+  UInt bits = 5u;
+  while( (size_t(1u) << bits) < 4u * presynapticCells.size() ) bits++;
+  const size_t mask = (size_t(1u) << bits) - 1u;
+  auto &table = growTable_; //cell, and its position in presynapticCells
+  table.assign( mask + 1u, std::make_pair(EMPTY, 0u) );
+  const auto find = [&](const CellIdx cell) -> std::pair<CellIdx, UInt32>& {
+    size_t slot = (static_cast<UInt32>(cell) * 2654435761u) >> (32u - bits); //Fibonacci hashing
+    while( table[slot].first != cell and table[slot].first != EMPTY ) {
+      slot = (slot + 1u) & mask;
+    }
+    return table[slot];
+  };
+
+  auto &skip = growSkip_;
+  skip.assign( presynapticCells.size(), 0 );
+  size_t numNew = 0u;
+  for( size_t i = 0u; i < presynapticCells.size(); i++ ) {
+    const CellIdx cell = presynapticCells[i];
+    NTA_ASSERT(cell != EMPTY);
+    auto &entry = find( cell );
+    if( entry.first == EMPTY ) {
+      entry = std::make_pair(cell, static_cast<UInt32>(i));
+      numNew++;
+    }
+    else {
+      skip[i] = 1; //repeated
+    }
+  }
+  forEachSynapse_( segment, [&](const Synapse synapse) {
+    const auto &entry = find( synapses_[synapse].presynapticCell );
+    if( entry.first != EMPTY ) { //already on the segment
+      skip[entry.second] = 1;
+      numNew--;
+    }
+  });
+
+  // Create the synapses in the order of the input.
+  numNew = std::min( numNew, maxNewSynapses );
+  if( synapseBlockSize_ == 0 ) {
+    auto &synapses = segments_.edit(segment).synapses;
+    if( synapses.capacity() < synapses.size() + numNew ) { //grow geometrically, as push_back
+      synapses.reserve( std::max(synapses.size() + numNew, 2u * synapses.capacity()) );
+    }
+  }
+  size_t created = 0u;
+  for( size_t i = 0u; i < presynapticCells.size() and created < numNew; i++ ) {
+    if( skip[i] ) continue;
+    addSynapse_( segment, presynapticCells[i], permanences ? permanences[i] : permanence );
+    created++;
+  }
+  return created;
+}
+
 
+Synapse Connections::addSynapse_(const Segment segment,
+                                 const CellIdx presynapticCell,
+                                 Permanence permanence) {
+  permanence = clipPermanence_( permanence );
 
   // Get an index into the synapses_ list, for the new synapse to reside at.
-  NTA_ASSERT(synapses_.size() < std::numeric_limits<Synapse>::max()) << "Add synapse failed: Range of Synapse (data-type) insufficient size."
-	    << synapses_.size() << " < " << (size_t)std::numeric_limits<Synapse>::max();
-  const Synapse synapse = static_cast<Synapse>(synapses_.size()); //TODO work on cache locality. Have all Synapse, SynapseData on Segment in continuous mem block ?
-  synapses_.emplace_back(SynapseData());
+  const Synapse synapse = allocateSynapse_(segment);
+  if( timeseries_ and timeseriesUpdates_.size() < synapses_.size() ) {
+    timeseriesUpdates_.resize( synapses_.size(), TimeseriesUpdate_{minPermanence, minPermanence, 0u} );
+  }
+  if( permanenceStorage_ == PermanenceStorage::UINT16 and permanences16_.size() < synapses_.size() ) {
+    permanences16_.resize( synapses_.size(), 0u );
+  }
+  if( permanenceStorage_ == PermanenceStorage::UINT8 and permanences8_.size() < synapses_.size() ) {
+    permanences8_.resize( synapses_.size(), 0u );
+  }
 
   // Fill in the new synapse's data
-  SynapseData &synapseData    = synapses_[synapse];
+  SynapseData &synapseData    = synapses_.edit(synapse);
   synapseData.presynapticCell = presynapticCell;
   synapseData.segment         = segment;
   synapseData.id              = nextSynapseOrdinal_++; //TODO move these to SynData constructor
-  // Start in disconnected state.
-  synapseData.permanence           = connectedThreshold_ - 1.0f;
-  synapseData.presynapticMapIndex_ = 
-    (Synapse)potentialSynapsesForPresynapticCell_[presynapticCell].size();
-  potentialSynapsesForPresynapticCell_[presynapticCell].push_back(synapse);
-  potentialSegmentsForPresynapticCell_[presynapticCell].push_back(segment);
+  synapseData.permanence      = permanence;
+  if( quantized_() ) {
+    setSteps_( synapse, toSteps_(permanence) );
+    permanence = synapseData.permanence;
+  }
+  const bool connected = connected_(synapse);
+  addSynapseToPresynapticMap_(synapse, connected);
 
-  SegmentData &segmentData = segments_[segment];
-  segmentData.synapses.push_back(synapse);
+  SegmentData &segmentData = segments_.edit(segment);
+  if( synapseBlockSize_ > 0 ) {
+    synapseData.segmentIndex_ = 0u;
+    segmentBlocks_[segment].size++;
+  }
+  else {
+    synapseData.segmentIndex_ = static_cast<Synapse>(segmentData.synapses.size());
+    segmentData.synapses.push_back(synapse);
+  }
+  if( connected ) {
+    segmentData.numConnected++;
+  }
 
+  revision_++;
+  notify_(ConnectionsEvent::CREATE_SYNAPSE, synapse);
+  if( connected ) { //as if created disconnected and then updated
+    notify_(ConnectionsEvent::UPDATE_SYNAPSE_PERMANENCE, synapse, permanence);
+  }
 
-  for (auto h : eventHandlers_) {
-    h.second->onCreateSynapse(synapse);
+  return synapse;
+}
+
+Synapse Connections::allocateSynapse_(const Segment segment) {
+  if(synapseBlockSize_ == 0) {
+    if( not freeSynapses_.empty() ) { //reuse the slot of a destroyed synapse
+      const Synapse synapse = freeSynapses_.back();
+      freeSynapses_.pop_back();
+      destroyedSynapses_--;
+      resetSynapseUpdates_(synapse);
+      return synapse;
+    }
+    NTA_ASSERT(synapses_.size() < std::numeric_limits<Synapse>::max()) << "Add synapse failed: Range of Synapse (data-type) insufficient size."
+	    << synapses_.size() << " < " << (size_t)std::numeric_limits<Synapse>::max();
+    const Synapse synapse = static_cast<Synapse>(synapses_.size());
+    synapses_.push_back(SynapseData());
+    return synapse;
   }
 
-  updateSynapsePermanence(synapse, permanence);
+  // Take the first free slot of the segment, if all its blocks are full add
+  // a new block to the end of its chain.
+  SegmentBlocks_ &blocks = segmentBlocks_[segment];
+  if(blocks.freeSlot == NO_SLOT) {
+    UInt32 block;
+    if(not freeBlocks_.empty()) {
+      block = freeBlocks_.back();
+      freeBlocks_.pop_back();
+    }
+    else {
+      NTA_CHECK(synapses_.size() + synapseBlockSize_ < std::numeric_limits<Synapse>::max()) 
+	      << "Add synapse failed: Range of Synapse (data-type) insufficient size.";
+      block = static_cast<UInt32>(nextBlock_.size());
+      nextBlock_.push_back(NO_BLOCK);
+      SynapseData free;
+      free.presynapticCell      = 0;
+      free.permanence           = minPermanence;
+      free.segment              = FREE_SLOT;
+      free.presynapticMapIndex_ = 0;
+      free.id                   = 0;
+      free.segmentIndex_        = NO_SLOT;
+      synapses_.resize(synapses_.size() + synapseBlockSize_, free);
+      destroyedSynapses_ += synapseBlockSize_;
+    }
+    // Link the slots of the block into the free list of the segment.
+    const Synapse begin = block * synapseBlockSize_;
+    for(Synapse slot = begin; slot < begin + synapseBlockSize_; slot++) {
+      NTA_ASSERT(synapses_[slot].segment == FREE_SLOT);
+      synapses_.edit(slot).segmentIndex_ = slot + 1u < begin + synapseBlockSize_ ? slot + 1u : NO_SLOT;
+    }
+    nextBlock_[block] = NO_BLOCK;
+    if(blocks.last == NO_BLOCK) {
+      blocks.first = block;
+    }
+    else {
+      nextBlock_[blocks.last] = block;
+    }
+    blocks.last     = block;
+    blocks.freeSlot = begin;
+  }
 
+  const Synapse synapse = blocks.freeSlot;
+  NTA_ASSERT(synapses_[synapse].segment == FREE_SLOT);
+  blocks.freeSlot = synapses_[synapse].segmentIndex_;
+  destroyedSynapses_--;
+  resetSynapseUpdates_(synapse);
   return synapse;
 }
 
+
+void Connections::resetSynapseUpdates_(const Synapse synapse) {
+  if(synapse < timeseriesUpdates_.size()) timeseriesUpdates_.edit(synapse).step = 0u;
+}
+
+
+void Connections::advanceTimeseriesStep_(const UInt32 steps) {
+  if( timeseriesStep_ >= std::numeric_limits<UInt32>::max() - steps ) {
+    // Wrap around, keep only the entries of the current step as previous.
+    for( size_t synapse = 0u; synapse < timeseriesUpdates_.size(); synapse++ ) {
+      auto &entry = timeseriesUpdates_.edit(synapse);
+      entry.step = (steps == 1u and entry.step == timeseriesStep_) ? 1u : 0u;
+    }
+    timeseriesStep_ = 2u;
+  }
+  else {
+    timeseriesStep_ += steps;
+  }
+}
+
+
+void Connections::releaseSynapseBlocks_(const Segment segment) {
+  NTA_ASSERT(segmentBlocks_[segment].size == 0u);
+  for(UInt32 block = segmentBlocks_[segment].first; block != NO_BLOCK; block = nextBlock_[block]) {
+    freeBlocks_.push_back(block);
+  }
+  segmentBlocks_[segment] = SegmentBlocks_();
+}
+
+
 bool Connections::segmentExists_(const Segment segment) const {
   NTA_CHECK(segment < segments_.size());
   const SegmentData &segmentData = segments_[segment];
@@ -169,161 +524,371 @@ bool Connections::segmentExists_(const Segment segment) const {
 
 bool Connections::synapseExists_(const Synapse synapse) const {
   const SynapseData &synapseData = synapses_[synapse];
+  if(synapseBlockSize_ > 0) {
+    return synapseData.segment != FREE_SLOT; //a slot of the arena belongs to the segment of its block
+  }
   const vector<Synapse> &synapsesOnSegment =
       segments_[synapseData.segment].synapses;
   return (std::find(synapsesOnSegment.begin(), synapsesOnSegment.end(),
                     synapse) != synapsesOnSegment.end());
 }
 
-/**
- * Helper method to remove a synapse from a presynaptic map, by moving the
- * last synapse in the list over this synapse.
- */
-void Connections::removeSynapseFromPresynapticMap_(
-    const Synapse index,
-    vector<Synapse> &preSynapses,
-    vector<Segment> &preSegments)
+void Connections::addSynapseToPresynapticMap_(const Synapse synapse, const bool connected) {
+  SynapseData &synapseData = synapses_.edit(synapse);
+  const size_t idx = 2u * synapseData.presynapticCell + connected;
+  if( idx >= presynapticLists_.size() ) {
+    presynapticLists_.resize( idx + 1u );
+  }
+
+  PresynapticList &list = presynapticLists_.edit(idx);
+  if( list.size == list.capacity ) {
+    const Synapse capacity = std::max<Synapse>(4u, 2u * list.capacity);
+    if( list.capacity > 0u and list.offset + list.capacity == presynapticSynapses_.size() ) {
+      // The list is the last one in the packed arrays, grow it in place.
+      presynapticSynapses_.resize( list.offset + capacity );
+      presynapticSegments_.resize( list.offset + capacity );
+    }
+    else {
+      // Move the list to the end of the packed arrays.
+      const size_t offset = presynapticSynapses_.size();
+      presynapticSynapses_.resize( offset + capacity );
+      presynapticSegments_.resize( offset + capacity );
+      for( size_t i = 0u; i < list.size; i++ ) {
+        const Synapse moved = presynapticSynapses_[list.offset + i];
+        const Segment movedSegment = presynapticSegments_[list.offset + i];
+        presynapticSynapses_.edit(offset + i) = moved;
+        presynapticSegments_.edit(offset + i) = movedSegment;
+      }
+      presynapticGaps_ += list.capacity;
+      list.offset = offset;
+    }
+    list.capacity = capacity;
+  }
+
+  synapseData.presynapticMapIndex_ = list.size;
+  presynapticSynapses_.edit(list.offset + list.size) = synapse;
+  presynapticSegments_.edit(list.offset + list.size) = synapseData.segment;
+  list.size++;
+
+  if( presynapticGaps_ > presynapticSynapses_.size() / 2u ) {
+    compactPresynapticMap_();
+  }
+}
+
+
+void Connections::removeSynapseFromPresynapticMap_(const Synapse synapse, const bool connected)
 {
-  NTA_ASSERT( !preSynapses.empty() );
-  NTA_ASSERT( index < preSynapses.size() );
-  NTA_ASSERT( preSynapses.size() == preSegments.size() );
+  const SynapseData &synapseData = synapses_[synapse];
+  NTA_ASSERT( 2u * synapseData.presynapticCell + connected < presynapticLists_.size() );
+  PresynapticList &list = presynapticLists_.edit(2u * synapseData.presynapticCell + connected);
+  const Synapse index = synapseData.presynapticMapIndex_;
+  NTA_ASSERT( list.size > 0u );
+  NTA_ASSERT( index < list.size );
+  NTA_ASSERT( presynapticSynapses_[list.offset + index] == synapse );
+
+  const size_t last = list.offset + list.size - 1u;
+  const Synapse move = presynapticSynapses_[last];
+  const Segment moveSegment = presynapticSegments_[last];
+  synapses_.edit(move).presynapticMapIndex_ = index;
+  presynapticSynapses_.edit(list.offset + index) = move;
+  presynapticSegments_.edit(list.offset + index) = moveSegment;
+  list.size--;
+}
 
-  const auto move = preSynapses.back();
-  synapses_[move].presynapticMapIndex_ = index;
-  preSynapses[index] = move;
-  preSynapses.pop_back();
 
-  preSegments[index] = preSegments.back();
-  preSegments.pop_back();
+void Connections::compactPresynapticMap_() {
+  PagedVector<Synapse> synapses;
+  PagedVector<Segment> segments;
+  synapses.setPaged( copyOnWrite() );
+  segments.setPaged( copyOnWrite() );
+  for( size_t i = 0u; i < presynapticLists_.size(); i++ ) {
+    const PresynapticList &list = presynapticLists_[i];
+    const size_t offset = synapses.size();
+    presynapticSynapses_.forEachRun( list.offset, list.capacity, [&](const Synapse *run, const size_t n) {
+      for( size_t k = 0u; k < n; k++ ) synapses.push_back( run[k] );
+    });
+    presynapticSegments_.forEachRun( list.offset, list.capacity, [&](const Segment *run, const size_t n) {
+      for( size_t k = 0u; k < n; k++ ) segments.push_back( run[k] );
+    });
+    if( list.offset != offset ) {
+      presynapticLists_.edit(i).offset = offset;
+    }
+  }
+  presynapticSynapses_.swap( synapses );
+  presynapticSegments_.swap( segments );
+  presynapticGaps_ = 0u;
+}
+
+
+void Connections::indexLeastUsedCells(const CellIdx cellsPerGroup) {
+  cellGroupSize_ = cellsPerGroup;
+  leastUsedCount_.clear();
+  leastUsedBits_.clear();
+  if( cellsPerGroup == 0u ) {
+    wordsPerGroup_ = 0u;
+    return;
+  }
+  NTA_CHECK( cells_.size() % cellsPerGroup == 0u )
+    << "Number of cells " << cells_.size() << " is not a multiple of the group size " << cellsPerGroup;
+  wordsPerGroup_ = (cellsPerGroup + 63u) / 64u;
+  const size_t numGroups = cells_.size() / cellsPerGroup;
+  leastUsedCount_.assign( numGroups, INVALID_COUNT );
+  leastUsedBits_.assign( numGroups * wordsPerGroup_, 0u );
+}
+
+
+void Connections::updateLeastUsedCells_(const CellIdx group) {
+  const CellIdx start = group * cellGroupSize_;
+  UInt64 *bits = leastUsedBits_.data() + group * wordsPerGroup_;
+  UInt32 minCount = INVALID_COUNT;
+  for( CellIdx i = 0u; i < cellGroupSize_; i++ ) {
+    const UInt32 count = static_cast<UInt32>(cells_[start + i].segments.size());
+    if( count < minCount ) {
+      minCount = count;
+      std::fill( bits, bits + wordsPerGroup_, (UInt64)0u );
+    }
+    if( count == minCount ) {
+      bits[i / 64u] |= (UInt64)1u << (i % 64u);
+    }
+  }
+  leastUsedCount_[group] = minCount;
+}
+
+
+void Connections::segmentCountChanged_(const CellIdx cell, const size_t before, const size_t after) {
+  if( cellGroupSize_ == 0u ) return;
+  const CellIdx group = cell / cellGroupSize_;
+  const UInt32 minCount = leastUsedCount_[group];
+  if( minCount == INVALID_COUNT ) return; //recomputed when needed
+
+  const CellIdx i = cell % cellGroupSize_;
+  UInt64 *bits = leastUsedBits_.data() + group * wordsPerGroup_;
+  const UInt64 bit = (UInt64)1u << (i % 64u);
+  if( after < minCount ) { //the only least used cell
+    std::fill( bits, bits + wordsPerGroup_, (UInt64)0u );
+    bits[i / 64u] = bit;
+    leastUsedCount_[group] = static_cast<UInt32>(after);
+  }
+  else if( after == minCount ) {
+    bits[i / 64u] |= bit;
+  }
+  else if( before == minCount ) {
+    bits[i / 64u] &= ~bit;
+    if( std::all_of( bits, bits + wordsPerGroup_, [](const UInt64 word) { return word == 0u; }) ) {
+      leastUsedCount_[group] = INVALID_COUNT; //the minimum increased
+    }
+  }
+}
+
+
+UInt32 Connections::numLeastUsedCells(const CellIdx group) {
+  NTA_ASSERT( cellGroupSize_ > 0u ) << "Call indexLeastUsedCells first";
+  NTA_ASSERT( group < leastUsedCount_.size() );
+  if( leastUsedCount_[group] == INVALID_COUNT ) {
+    updateLeastUsedCells_(group);
+  }
+  const UInt64 *bits = leastUsedBits_.data() + group * wordsPerGroup_;
+  UInt32 count = 0u;
+  for( size_t w = 0u; w < wordsPerGroup_; w++ ) {
+    count += static_cast<UInt32>(std::bitset<64>(bits[w]).count());
+  }
+  return count;
+}
+
+
+CellIdx Connections::leastUsedCell(const CellIdx group, UInt32 index) {
+  NTA_ASSERT( cellGroupSize_ > 0u ) << "Call indexLeastUsedCells first";
+  if( leastUsedCount_[group] == INVALID_COUNT ) {
+    updateLeastUsedCells_(group);
+  }
+  const UInt64 *bits = leastUsedBits_.data() + group * wordsPerGroup_;
+  for( size_t w = 0u; w < wordsPerGroup_; w++ ) {
+    UInt64 word = bits[w];
+    const UInt32 count = static_cast<UInt32>(std::bitset<64>(word).count());
+    if( index >= count ) {
+      index -= count;
+      continue;
+    }
+    for( ; index > 0u; index-- ) {
+      word &= word - 1u; //clear the lowest bit
+    }
+    CellIdx i = static_cast<CellIdx>(w * 64u);
+    while( (word & 1u) == 0u ) {
+      word >>= 1u;
+      i++;
+    }
+    return group * cellGroupSize_ + i;
+  }
+  NTA_THROW << "leastUsedCell: index out of range";
 }
 
 
 void Connections::destroySegment(const Segment segment) {
   NTA_ASSERT(segmentExists_(segment));
-  for (auto h : eventHandlers_) {
-    h.second->onDestroySegment(segment);
-  }
+  revision_++;
+  notify_(ConnectionsEvent::DESTROY_SEGMENT, segment);
 
-  SegmentData &segmentData = segments_[segment];
+  SegmentData &segmentData = segments_.edit(segment);
 
-  // Destroy synapses from the end of the list, so that the index-shifting is
-  // easier to do.
-  while( !segmentData.synapses.empty() )
-    destroySynapse(segmentData.synapses.back());
+  if(synapseBlockSize_ > 0) {
+    // Destroying a synapse of the arena does not move the other synapses.
+    for(const auto synapse : synapsesForSegment(segment)) {
+      destroySynapse(synapse);
+    }
+    releaseSynapseBlocks_(segment);
+  }
+  else {
+    // Destroy synapses from the end of the list, so that the index-shifting is
+    // easier to do.
+    while( !segmentData.synapses.empty() )
+      destroySynapse(segmentData.synapses.back());
+  }
 
-  CellData &cellData = cells_[segmentData.cell];
+  CellData &cellData = cells_.edit(segmentData.cell);
 
   const auto segmentOnCell = std::find(cellData.segments.cbegin(), cellData.segments.cend(), segment);
   NTA_ASSERT(segmentOnCell != cellData.segments.cend()) << "Segment to be destroyed not found on the cell!";
   NTA_ASSERT(*segmentOnCell == segment);
 
   cellData.segments.erase(segmentOnCell);
+  segmentCountChanged_(segmentData.cell, cellData.segments.size() + 1u, cellData.segments.size());
   destroyedSegments_++;
+  freeSegments_.push_back(segment);
 }
 
 
 void Connections::destroySynapse(const Synapse synapse) {
   NTA_ASSERT(synapseExists_(synapse));
-  for (auto h : eventHandlers_) {
-    h.second->onDestroySynapse(synapse);
-  }
+  revision_++;
+  notify_(ConnectionsEvent::DESTROY_SYNAPSE, synapse);
 
-  const SynapseData &synapseData = synapses_[synapse];
-        SegmentData &segmentData = segments_[synapseData.segment];
-  const auto         presynCell  = synapseData.presynapticCell;
+  SynapseData &synapseData = synapses_.edit(synapse);
+  SegmentData &segmentData = segments_.edit(synapseData.segment);
 
-  if( synapseData.permanence >= connectedThreshold_ ) {
+  const bool connected = connected_(synapse);
+  if( connected ) {
     segmentData.numConnected--;
+  }
+  removeSynapseFromPresynapticMap_( synapse, connected );
+
+  if( synapseBlockSize_ > 0 ) {
+    // Push the slot onto the free list of the segment.
+    SegmentBlocks_ &blocks = segmentBlocks_[synapseData.segment];
+    NTA_ASSERT(blocks.size > 0u);
+    blocks.size--;
+    synapseData.segmentIndex_ = blocks.freeSlot;
+    blocks.freeSlot = synapse;
+  }
+  else if( orderedSynapses_ ) {
+    const auto synapseOnSegment =
+        std::lower_bound(segmentData.synapses.cbegin(), segmentData.synapses.cend(),
+                         synapse,
+                         [&](const Synapse a, const Synapse b) -> bool {
+                           return dataForSynapse(a).id < dataForSynapse(b).id;
+                         });
+
+    NTA_ASSERT(synapseOnSegment != segmentData.synapses.end());
+    NTA_ASSERT(*synapseOnSegment == synapse);
+
+    segmentData.synapses.erase(synapseOnSegment);
+  }
+  else {
+    // Move the last synapse into the position of the destroyed one.
+    const Synapse index = synapseData.segmentIndex_;
+    NTA_ASSERT(index < segmentData.synapses.size());
+    NTA_ASSERT(segmentData.synapses[index] == synapse);
+    const Synapse last = segmentData.synapses.back();
+    segmentData.synapses[index] = last;
+    synapses_.edit(last).segmentIndex_ = index;
+    segmentData.synapses.pop_back();
+  }
+  destroyedSynapses_++;
+  if(synapseBlockSize_ > 0) {
+    synapseData.segment = FREE_SLOT;
+  }
+  else {
+    freeSynapses_.push_back(synapse);
+  }
+}
 
-    removeSynapseFromPresynapticMap_(
-      synapseData.presynapticMapIndex_,
-      connectedSynapsesForPresynapticCell_.at( presynCell ),
-      connectedSegmentsForPresynapticCell_.at( presynCell ));
 
-    if( connectedSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      connectedSynapsesForPresynapticCell_.erase( presynCell );
-      connectedSegmentsForPresynapticCell_.erase( presynCell );
-    }
+vector<Synapse> Connections::orderedSynapsesForSegment(const Segment segment) const {
+  vector<Synapse> synapses = synapsesForSegment(segment);
+  if( not orderedSynapses() ) {
+    std::sort( synapses.begin(), synapses.end(), [&](const Synapse a, const Synapse b) {
+      return synapses_[a].id < synapses_[b].id; });
   }
-  else {
-    removeSynapseFromPresynapticMap_(
-      synapseData.presynapticMapIndex_,
-      potentialSynapsesForPresynapticCell_.at( presynCell ),
-      potentialSegmentsForPresynapticCell_.at( presynCell ));
+  return synapses;
+}
+
 
-    if( potentialSynapsesForPresynapticCell_.at( presynCell ).empty() ){
-      potentialSynapsesForPresynapticCell_.erase( presynCell );
-      potentialSegmentsForPresynapticCell_.erase( presynCell );
+void Connections::setOrderedSynapses(const bool ordered) {
+  if( ordered == orderedSynapses_ ) return;
+  orderedSynapses_ = ordered;
+  if( synapseBlockSize_ > 0 ) return; //unordered in the blocks, see synapsesForSegment
+  for( size_t segment = 0u; segment < segments_.size(); segment++ ) {
+    auto &synapses = segments_.edit(segment).synapses;
+    if( ordered ) {
+      std::sort( synapses.begin(), synapses.end(), [&](const Synapse a, const Synapse b) {
+        return synapses_[a].id < synapses_[b].id; });
+    }
+    for( size_t i = 0u; i < synapses.size(); i++ ) {
+      synapses_.edit(synapses[i]).segmentIndex_ = static_cast<Synapse>(i);
     }
   }
+}
 
-  const auto synapseOnSegment =
-      std::lower_bound(segmentData.synapses.cbegin(), segmentData.synapses.cend(),
-                       synapse, 
-		       [&](const Synapse a, const Synapse b) -> bool {
-			 return dataForSynapse(a).id < dataForSynapse(b).id;
-                       });
-
-  NTA_ASSERT(synapseOnSegment != segmentData.synapses.end());
-  NTA_ASSERT(*synapseOnSegment == synapse);
 
-  segmentData.synapses.erase(synapseOnSegment);
-  destroyedSynapses_++;
+void Connections::setCopyOnWrite(const bool enable) {
+  cells_.setPaged( enable );
+  segments_.setPaged( enable );
+  synapses_.setPaged( enable );
+  presynapticLists_.setPaged( enable );
+  presynapticSynapses_.setPaged( enable );
+  presynapticSegments_.setPaged( enable );
+  timeseriesUpdates_.setPaged( enable );
+  permanences16_.setPaged( enable );
+  permanences8_.setPaged( enable );
 }
 
 
 void Connections::updateSynapsePermanence(const Synapse synapse,
                                           Permanence permanence) {
-  permanence = std::min(permanence, maxPermanence );
-  permanence = std::max(permanence, minPermanence );
+  permanence = clipPermanence_( permanence );
 
-  auto &synData = synapses_[synapse];
+  auto &synData = synapses_.edit(synapse);
   
-  const bool before = synData.permanence >= connectedThreshold_;
-  const bool after  = permanence         >= connectedThreshold_;
-
-  // update the permanence
-  synData.permanence = permanence;
+  const bool before = connected_(synapse);
+  bool after;
+  if( quantized_() ) {
+    const UInt32 steps = toSteps_( permanence );
+    after = steps >= connectedSteps_;
+    setSteps_( synapse, steps );
+    permanence = synData.permanence;
+  }
+  else {
+    after = permanence >= connectedThreshold_;
+    // update the permanence
+    synData.permanence = permanence;
+  }
 
   if( before == after ) { //no change in dis/connected status
       return;
   }
-    const auto &presyn    = synData.presynapticCell;
-    auto &potentialPresyn = potentialSynapsesForPresynapticCell_[presyn];
-    auto &potentialPreseg = potentialSegmentsForPresynapticCell_[presyn];
-    auto &connectedPresyn = connectedSynapsesForPresynapticCell_[presyn];
-    auto &connectedPreseg = connectedSegmentsForPresynapticCell_[presyn];
-    const auto &segment   = synData.segment;
-    auto &segmentData     = segments_[segment];
+    auto &segmentData     = segments_.edit(synData.segment);
     
     if( after ) { //connect
       segmentData.numConnected++;
-
-      // Remove this synapse from presynaptic potential synapses.
-      removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
-                                        potentialPresyn, potentialPreseg );
-
-      // Add this synapse to the presynaptic connected synapses.
-      synData.presynapticMapIndex_ = (Synapse)connectedPresyn.size();
-      connectedPresyn.push_back( synapse );
-      connectedPreseg.push_back( segment );
     }
     else { //disconnected
       segmentData.numConnected--;
-
-      // Remove this synapse from presynaptic connected synapses.
-      removeSynapseFromPresynapticMap_( synData.presynapticMapIndex_,
-                                        connectedPresyn, connectedPreseg );
-
-      // Add this synapse to the presynaptic connected synapses.
-      synData.presynapticMapIndex_ = (Synapse)potentialPresyn.size();
-      potentialPresyn.push_back( synapse );
-      potentialPreseg.push_back( segment );
     }
+    // Move this synapse between the presynaptic potential and connected synapses.
+    removeSynapseFromPresynapticMap_( synapse, before );
+    addSynapseToPresynapticMap_( synapse, after );
 
-    for (auto h : eventHandlers_) { //TODO handle callbacks in performance-critical method only in Debug?
-      h.second->onUpdateSynapsePermanence(synapse, permanence);
-    }
+    revision_++;
+    notify_(ConnectionsEvent::UPDATE_SYNAPSE_PERMANENCE, synapse, permanence);
 }
 
 
@@ -339,9 +904,11 @@ bool Connections::compareSegments(const Segment a, const Segment b) const {
   const SegmentData &aData = segments_[a];
   const SegmentData &bData = segments_[b];
   // default sort by cell
-  if (aData.cell == bData.cell)
+  if (aData.cell == bData.cell) {
     //fallback to ordinals:
+    if (aData.id == bData.id) return aData.ordinal < bData.ordinal;
     return aData.id < bData.id;
+  }
   else return aData.cell < bData.cell;
 }
 
@@ -349,15 +916,12 @@ bool Connections::compareSegments(const Segment a, const Segment b) const {
 vector<Synapse> Connections::synapsesForPresynapticCell(const CellIdx presynapticCell) const {
   vector<Synapse> all;
 
-  if (potentialSynapsesForPresynapticCell_.count(presynapticCell)) {
-    const auto& potential = potentialSynapsesForPresynapticCell_.at(presynapticCell);
-    all.assign(potential.cbegin(), potential.cend());
-  }
+  const auto &potential = presynapticList_(presynapticCell, false);
+  const auto append = [&](const Synapse *run, const size_t n) { all.insert(all.end(), run, run + n); };
+  presynapticSynapses_.forEachRun(potential.offset, potential.size, append);
 
-  if (connectedSynapsesForPresynapticCell_.count(presynapticCell)) {
-    const auto& connected = connectedSynapsesForPresynapticCell_.at(presynapticCell);
-    all.insert( all.cend(), connected.cbegin(), connected.cend());
-  }
+  const auto &connected = presynapticList_(presynapticCell, true);
+  presynapticSynapses_.forEachRun(connected.offset, connected.size, append);
 
   return all;
 }
@@ -368,30 +932,31 @@ void Connections::reset()
   if( not timeseries_ ) {
     NTA_WARN << "Connections::reset() called with timeseries=false.";
   }
-  previousUpdates_.clear();
-  currentUpdates_.clear();
+  // Skip a step, so that no entry is current or previous.
+  advanceTimeseriesStep_(2u);
+  timeseriesUpdates_.resize( timeseries_ ? synapses_.size() : 0u,
+                             TimeseriesUpdate_{minPermanence, minPermanence, 0u} );
 }
 
-vector<SynapseIdx> Connections::computeActivity(const vector<CellIdx> &activePresynapticCells, const bool learn) {
-
-  vector<SynapseIdx> numActiveConnectedSynapsesForSegment(segments_.size(), 0);
+void Connections::startComputeStep(const bool learn) {
   if(learn) iteration_++;
+  flushEvents(); //of the previous compute step
 
   if( timeseries_ ) {
-    // Before each cycle of computation move the currentUpdates to the previous
-    // updates, and zero the currentUpdates in preparation for learning.
-    previousUpdates_.swap( currentUpdates_ );
-    currentUpdates_.clear();
+    // Before each cycle of computation the current updates become the
+    // previous updates, and the current updates are zero.
+    advanceTimeseriesStep_(1u);
   }
+}
+
+
+vector<SynapseIdx> Connections::computeActivity(const vector<CellIdx> &activePresynapticCells, const bool learn) {
+
+  vector<SynapseIdx> numActiveConnectedSynapsesForSegment(segments_.size(), 0);
+  startComputeStep(learn);
 
   // Iterate through all connected synapses.
-  for (const auto& cell : activePresynapticCells) {
-    if (connectedSegmentsForPresynapticCell_.count(cell)) {
-      for(const auto& segment : connectedSegmentsForPresynapticCell_.at(cell)) {
-        ++numActiveConnectedSynapsesForSegment[segment];
-      }
-    }
-  }
+  countActiveSynapses_( activePresynapticCells, true, numActiveConnectedSynapsesForSegment );
   return numActiveConnectedSynapsesForSegment;
 }
 
@@ -411,14 +976,126 @@ vector<SynapseIdx> Connections::computeActivity(
              numActiveConnectedSynapsesForSegment.end(),
              numActivePotentialSynapsesForSegment.begin());
 
-  for (const auto& cell : activePresynapticCells) {
-    if (potentialSegmentsForPresynapticCell_.count(cell)) {
-      for(const auto& segment : potentialSegmentsForPresynapticCell_.at(cell)) {
-        ++numActivePotentialSynapsesForSegment[segment];
+  countActiveSynapses_( activePresynapticCells, false, numActivePotentialSynapsesForSegment );
+  return numActiveConnectedSynapsesForSegment;
+}
+
+
+void Connections::computeActivity(SegmentActivity &activity,
+                                  const vector<CellIdx> &activePresynapticCells,
+                                  const bool learn,
+                                  const bool potential) {
+  startComputeStep(learn);
+
+  activity.reset( segments_.size(), layout_, potential );
+  auto &connectedCounts = activity.numActiveConnected;
+  auto &potentialCounts = activity.numActivePotential;
+
+  // Iterate through all connected synapses.
+  countActiveSynapses_( activePresynapticCells, true, connectedCounts, &activity.touched );
+
+  // Iterate through all potential synapses.
+  if( potential ) {
+    activity.copyConnectedToPotential();
+    countActiveSynapses_( activePresynapticCells, false, potentialCounts, &activity.touched );
+  }
+}
+
+
+void SegmentActivity::reset(const size_t numSegments, const UInt32 newLayout, const bool potential) {
+  // Reset only the counts which were set by the previous call. If most of
+  // them were set, a sequential fill is faster than the random access.
+  if( layout != newLayout or touched.size() * DENSE_FRACTION >= numActiveConnected.size() ) {
+    std::fill( numActiveConnected.begin(), numActiveConnected.end(), (SynapseIdx)0 );
+    std::fill( numActivePotential.begin(), numActivePotential.end(), (SynapseIdx)0 );
+  }
+  else {
+    for( const auto segment : touched ) {
+      if( segment < numActiveConnected.size() ) numActiveConnected[segment] = 0;
+      if( segment < numActivePotential.size() ) numActivePotential[segment] = 0;
+    }
+  }
+  touched.clear();
+  layout = newLayout;
+  numActiveConnected.resize( numSegments, 0 );
+  if( potential ) {
+    numActivePotential.resize( numSegments, 0 );
+  }
+  else {
+    numActivePotential.clear();
+  }
+}
+
+
+void SegmentActivity::copyConnectedToPotential() {
+  if( touched.size() * DENSE_FRACTION >= numActiveConnected.size() ) {
+    std::copy( numActiveConnected.begin(), numActiveConnected.end(), numActivePotential.begin() );
+  }
+  else {
+    for( const auto segment : touched ) {
+      numActivePotential[segment] = numActiveConnected[segment];
+    }
+  }
+}
+
+
+void Connections::countActiveSynapses_(const vector<CellIdx> &activePresynapticCells,
+                                       const bool connected,
+                                       vector<SynapseIdx> &numActiveSynapsesForSegment,
+                                       vector<Segment> *touched) {
+  const size_t numTasks = threadPool_ == nullptr ? 1u :
+      std::min<size_t>( threadPool_->size(), activePresynapticCells.size() / MIN_CELLS_PER_THREAD );
+
+  if( numTasks <= 1u ) {
+    SynapseIdx *counts = numActiveSynapsesForSegment.data();
+    for (const auto& cell : activePresynapticCells) {
+      const auto &list = presynapticList_(cell, connected);
+      if( touched == nullptr ) {
+        presynapticSegments_.forEachRun( list.offset, list.size, [&](const Segment *segments, const size_t n) {
+          countSegments<false>( segments, n, counts, nullptr ); });
+      }
+      else {
+        presynapticSegments_.forEachRun( list.offset, list.size, [&](const Segment *segments, const size_t n) {
+          countSegments<true>( segments, n, counts, touched ); });
       }
     }
+    return;
+  }
+
+  // Each task counts a chunk of the active cells into its own buffer, and
+  // lists the segments which it counted.
+  if( threadActivity_.size() < numTasks ) {
+    threadActivity_.resize( numTasks );
+    threadTouched_.resize( numTasks );
+  }
+  threadPool_->parallelFor( numTasks, [&](const size_t task, const UInt) {
+    auto &counts = threadActivity_[task];
+    auto &taskTouched = threadTouched_[task];
+    counts.resize( segments_.size(), 0 );
+    taskTouched.clear();
+    const auto range = ThreadPool::chunk( activePresynapticCells.size(), numTasks, task );
+    for( size_t c = range.first; c < range.second; c++ ) {
+      const auto &list = presynapticList_(activePresynapticCells[c], connected);
+      presynapticSegments_.forEachRun( list.offset, list.size, [&](const Segment *segments, const size_t n) {
+        countSegments<true>( segments, n, counts.data(), &taskTouched ); });
+    }
+  });
+
+  // Sum up the counts of the listed segments only, and reset them to zero
+  // for the next call. The tasks hold consecutive chunks of the cells, so
+  // their lists in task order give the touched segments in the order of the
+  // serial computation.
+  SynapseIdx *sums = numActiveSynapsesForSegment.data();
+  for( size_t task = 0u; task < numTasks; task++ ) {
+    SynapseIdx *counts = threadActivity_[task].data();
+    for( const auto segment : threadTouched_[task] ) {
+      if( touched != nullptr and sums[segment] == 0 ) {
+        touched->push_back( segment );
+      }
+      sums[segment] = static_cast<SynapseIdx>(sums[segment] + counts[segment]);
+      counts[segment] = 0;
+    }
   }
-  return numActiveConnectedSynapsesForSegment;
 }
 
 
@@ -428,48 +1105,159 @@ void Connections::adaptSegment(const Segment segment,
                                const Permanence decrement, 
 			       const bool pruneZeroSynapses)
 {
-  const auto &inputArray = inputs.getDense();
+  adaptUpdates_.clear();
+  adaptSegmentPermanences(segment, inputs, increment, decrement, pruneZeroSynapses, adaptUpdates_);
+  applySynapseUpdates(segment, adaptUpdates_, pruneZeroSynapses);
+}
 
-  if( timeseries_ ) {
-    previousUpdates_.resize( synapses_.size(), minPermanence );
-    currentUpdates_.resize(  synapses_.size(), minPermanence );
+
+void Connections::adaptSegmentPermanences(const Segment segment,
+                                          const SDR &inputs,
+                                          const Permanence increment,
+                                          const Permanence decrement,
+                                          const bool pruneZeroSynapses,
+                                          vector<SynapseUpdate> &deferred)
+{
+  switch( permanenceStorage_ ) {
+    case PermanenceStorage::UINT16:
+      adaptQuantizedPermanences_( permanences16_, segment, inputs, increment, decrement, pruneZeroSynapses, deferred );
+      return;
+    case PermanenceStorage::UINT8:
+      adaptQuantizedPermanences_( permanences8_, segment, inputs, increment, decrement, pruneZeroSynapses, deferred );
+      return;
+    default: break;
   }
+  const auto &inputArray = inputs.getDense();
+  NTA_ASSERT( not timeseries_ or timeseriesUpdates_.size() == synapses_.size() );
 
-  const auto& synapses = synapsesForSegment(segment);
-  for( size_t i = 0; i <  synapses.size(); i++) {
-      const auto synapse = synapses[i];
-      const SynapseData &synapseData = dataForSynapse(synapse);
+  forEachSynapse_( segment, [&](const Synapse synapse) {
+    const SynapseData &synapseData = synapses_[synapse];
 
-      Permanence update;
-      if( inputArray[synapseData.presynapticCell] ) {
-        update = increment;
-      } else {
-        update = -decrement;
-      }
+    Permanence update;
+    if( inputArray[synapseData.presynapticCell] ) {
+      update = increment;
+    } else {
+      update = -decrement;
+    }
 
     //prune permanences that reached zero
     if (pruneZeroSynapses and 
         synapseData.permanence + update < htm::minPermanence + htm::Epsilon) { //new value will disconnect the synapse
-      destroySynapse(synapse);
-      prunedSyns_++; //for statistics
-      i--; // do not advance `i`, as `destroySynapse` just modified inplace the synapses_, so now a `synapses_[i]`
-      // is the "next" synapse. 
-      continue;
+      deferred.push_back( SynapseUpdate{synapse, minPermanence, true} );
+      return;
     }
 
     //update synapse, but for TS only if changed
     if(timeseries_) {
-      if( update != previousUpdates_[synapse] ) {
-        updateSynapsePermanence(synapse, synapseData.permanence + update);
+      TimeseriesUpdate_ &entry = timeseriesUpdates_.edit(synapse);
+      if( entry.step != timeseriesStep_ ) { //first update in this step
+        entry.previous = (entry.step == timeseriesStep_ - 1u) ? entry.current : minPermanence;
+        entry.step     = timeseriesStep_;
       }
-      currentUpdates_[ synapse ] = update;
-    } else {
-      updateSynapsePermanence(synapse, synapseData.permanence + update);
+      entry.current = update;
+      if( update == entry.previous ) return;
+    }
+    const Permanence permanence = clipPermanence_( synapseData.permanence + update );
+    if( (permanence >= connectedThreshold_) == (synapseData.permanence >= connectedThreshold_) ) {
+      synapses_.edit(synapse).permanence = permanence; //same as updateSynapsePermanence
+    }
+    else { //changes the presynaptic map
+      deferred.push_back( SynapseUpdate{synapse, permanence, false} );
+    }
+  });
+}
+
+
+template<typename Steps>
+void Connections::adaptQuantizedPermanences_(PagedVector<Steps> &permanences,
+                                             const Segment segment,
+                                             const SDR &inputs,
+                                             const Permanence increment,
+                                             const Permanence decrement,
+                                             const bool pruneZeroSynapses,
+                                             vector<SynapseUpdate> &deferred)
+{
+  // As adaptSegmentPermanences, in whole steps.
+  const auto &inputArray = inputs.getDense();
+  NTA_ASSERT( not timeseries_ or timeseriesUpdates_.size() == synapses_.size() );
+  const Int32 incrementSteps = deltaSteps_( increment );
+  const Int32 decrementSteps = deltaSteps_( decrement );
+  const Int32 maxSteps       = static_cast<Int32>( permanenceSteps_ );
+  const Int32 connected      = static_cast<Int32>( connectedSteps_ );
+
+  forEachSynapse_( segment, [&](const Synapse synapse) {
+    const SynapseData &synapseData = synapses_[synapse];
+    const Int32 update = inputArray[synapseData.presynapticCell] ? incrementSteps : -decrementSteps;
+    const Int32 steps  = permanences[synapse];
+
+    //prune permanences that reached zero
+    if( pruneZeroSynapses and steps + update <= 0 ) {
+      deferred.push_back( SynapseUpdate{synapse, minPermanence, true} );
+      return;
+    }
+
+    //update synapse, but for TS only if changed
+    if(timeseries_) {
+      TimeseriesUpdate_ &entry = timeseriesUpdates_.edit(synapse);
+      if( entry.step != timeseriesStep_ ) { //first update in this step
+        entry.previous = (entry.step == timeseriesStep_ - 1u) ? entry.current : minPermanence;
+        entry.step     = timeseriesStep_;
+      }
+      entry.current = static_cast<Permanence>(update);
+      if( entry.current == entry.previous ) return;
+    }
+    const Int32 newSteps = std::max( std::min(steps + update, maxSteps), 0 );
+    if( (newSteps >= connected) == (steps >= connected) ) {
+      permanences.edit(synapse) = static_cast<Steps>(newSteps); //same as updateSynapsePermanence
+      synapses_.edit(synapse).permanence = fromSteps_( static_cast<UInt32>(newSteps) );
+    }
+    else { //changes the presynaptic map
+      deferred.push_back( SynapseUpdate{synapse, fromSteps_(static_cast<UInt32>(newSteps)), false} );
+    }
+  });
+}
+
+
+Int32 Connections::deltaSteps_(const Permanence delta) const {
+  // Float noise (eg. of connectedThreshold_ - permanence) is not a step.
+  if( std::fabs(delta) < htm::Epsilon ) return 0;
+  Int32 steps = static_cast<Int32>( std::lround(delta * permanenceSteps_) );
+  if( steps == 0 ) {
+    steps = delta > 0.0f ? 1 : -1;
+  }
+  return steps;
+}
+
+
+void Connections::setSteps_(const Synapse synapse, const UInt32 steps) {
+  NTA_ASSERT( steps <= static_cast<UInt32>(permanenceSteps_) );
+  if( permanenceStorage_ == PermanenceStorage::UINT8 ) {
+    permanences8_.edit(synapse) = static_cast<std::uint8_t>(steps);
+  }
+  else {
+    permanences16_.edit(synapse) = static_cast<UInt16>(steps);
+  }
+  synapses_.edit(synapse).permanence = fromSteps_( steps );
+}
+
+
+void Connections::applySynapseUpdates(const Segment segment,
+                                      const vector<SynapseUpdate> &deferred,
+                                      const bool pruneZeroSynapses)
+{
+  for( const auto &update : deferred ) {
+    NTA_ASSERT( synapses_[update.synapse].segment == segment );
+    if( update.destroy ) {
+      destroySynapse( update.synapse );
+      prunedSyns_++; //for statistics
+    }
+    else {
+      updateSynapsePermanence( update.synapse, update.permanence );
     }
   }
 
   //destroy segment if it has too few synapses left -> will never be able to connect again
-  if(pruneZeroSynapses and synapses.size() < connectedThreshold_) { //FIXME this is incorrect! connectedThreshold_ is if > then syn = connected. We need stimulusThreshold_ from TM.
+  if(pruneZeroSynapses and synapsesForSegment(segment).size() < connectedThreshold_) { //FIXME this is incorrect! connectedThreshold_ is if > then syn = connected. We need stimulusThreshold_ from TM.
     destroySegment(segment);
     prunedSegs_++; //statistics
   }
@@ -489,11 +1277,12 @@ void Connections::raisePermanencesToThreshold(
     return;
 
   NTA_ASSERT(segment < segments_.size()) << "Accessing segment out of bounds.";
-  auto &segData = segments_[segment];
-  if( segData.numConnected >= segmentThreshold )
+  if( segments_[segment].numConnected >= segmentThreshold )
     return;   // The segment already satisfies the requirement, done.
+  // Writable, so that updateSynapsePermanence does not copy its page.
+  segments_.edit(segment);
 
-  vector<Synapse> &synapses = segData.synapses;
+  const auto synapses = synapsesForSegment(segment);
   if( synapses.empty())
     return;   // No synapses to raise permanences to, no work to do.
 
@@ -515,15 +1304,19 @@ void Connections::raisePermanencesToThreshold(
   // permance by such that it becomes a connected synapse.  After that there
   // will be at least N synapses connected.
 
+  // The synapses of the segment stay in their order, the permanences are
+  // partially sorted in a copy.
+  vector<Permanence> permanences; permanences.reserve( synapses.size() );
+  forEachSynapse_( segment, [&](const Synapse syn) {
+    permanences.push_back( synapses_[syn].permanence ); });
+
   // Threshold is ensured to be >=1 by condition at very beginning if(thresh == 0)... 
-  auto minPermSynPtr = synapses.begin() + threshold - 1;
+  auto minPermPtr = permanences.begin() + threshold - 1;
 
-  const auto permanencesGreater = [&](const Synapse &A, const Synapse &B)
-    { return synapses_[A].permanence > synapses_[B].permanence; };
   // Do a partial sort, it's faster than a full sort.
-  std::nth_element(synapses.begin(), minPermSynPtr, synapses.end(), permanencesGreater);
+  std::nth_element(permanences.begin(), minPermPtr, permanences.end(), std::greater<Permanence>());
 
-  const Real increment = connectedThreshold_ - synapses_[ *minPermSynPtr ].permanence;
+  const Real increment = connectedThreshold_ - *minPermPtr;
   if( increment <= 0 ) // If minPermSynPtr is already connected then ...
     return;            // Enough synapses are already connected.
 
@@ -541,8 +1334,9 @@ void Connections::synapseCompetition(
   NTA_ASSERT( maximumSynapses > 0 );
 
   const auto &segData = dataForSegment( segment );
+  const auto synapses = synapsesForSegment( segment );
 
-  if( segData.synapses.empty())
+  if( synapses.empty())
     return;   // No synapses to work with, no work to do.
 
   // Sort the potential pool by permanence values, and look for the synapse with
@@ -561,7 +1355,7 @@ void Connections::synapseCompetition(
     return;  // The segment already satisfies the requirements, done.
   }
   // Can't connect more synapses than there are in the potential pool.
-  desiredConnected = std::min( (SynapseIdx) segData.synapses.size(), desiredConnected);
+  desiredConnected = std::min( (SynapseIdx) synapses.size(), desiredConnected);
   // The N'th synapse is at index N-1
   if( desiredConnected != 0 ) {
     desiredConnected--;
@@ -570,12 +1364,12 @@ void Connections::synapseCompetition(
   //   Corner case: there are no synapses on this segment.
   // }
 
-  vector<Permanence> permanences; permanences.reserve( segData.synapses.size() );
-  for( Synapse syn : segData.synapses )
+  vector<Permanence> permanences; permanences.reserve( synapses.size() );
+  for( Synapse syn : synapses )
     permanences.push_back( synapses_[syn].permanence );
 
   // Do a partial sort, it's faster than a full sort.
-  auto minPermPtr = permanences.begin() + (segData.synapses.size() - 1 - desiredConnected);
+  auto minPermPtr = permanences.begin() + (permanences.size() - 1 - desiredConnected);
   std::nth_element(permanences.begin(), minPermPtr, permanences.end());
 
   Permanence delta = (connectedThreshold_ + htm::Epsilon) - *minPermPtr;
@@ -586,11 +1380,19 @@ void Connections::synapseCompetition(
 
 
 void Connections::bumpSegment(const Segment segment, const Permanence delta) {
-  const vector<Synapse> &synapses = synapsesForSegment(segment);
+  if( quantized_() ) {
+    const Int32 maxSteps = static_cast<Int32>( permanenceSteps_ );
+    const Int32 update   = deltaSteps_( delta );
+    forEachSynapse_( segment, [&](const Synapse syn) {
+      const Int32 steps = std::max( std::min(static_cast<Int32>(steps_(syn)) + update, maxSteps), 0 );
+      updateSynapsePermanence(syn, fromSteps_(static_cast<UInt32>(steps)));
+    });
+    return;
+  }
   // TODO: vectorize?
-  for( const auto syn : synapses ) {
+  forEachSynapse_( segment, [&](const Synapse syn) {
     updateSynapsePermanence(syn, synapses_[syn].permanence + delta);
-  }
+  });
 }
 
 
@@ -614,7 +1416,7 @@ void Connections::destroyMinPermanenceSynapses(
     const Permanence A_perm = dataForSynapse(A).permanence;
     const Permanence B_perm = dataForSynapse(B).permanence;
     if( A_perm == B_perm ) {
-      return A < B;
+      return dataForSynapse(A).id < dataForSynapse(B).id; //order of creation, as the handles are recycled
     }
     else {
       return A_perm < B_perm;
@@ -629,6 +1431,173 @@ void Connections::destroyMinPermanenceSynapses(
 }
 
 
+void Connections::compact() {
+  const Segment INVALID_SEGMENT = std::numeric_limits<Segment>::max();
+  const Synapse INVALID_SYNAPSE = std::numeric_limits<Synapse>::max();
+
+  // New handles of the live segments, in the order of the old handles.
+  vector<bool> destroyed(segments_.size(), false);
+  for( const auto segment : freeSegments_ ) destroyed[segment] = true;
+  vector<Segment> segmentMap(segments_.size(), INVALID_SEGMENT);
+  vector<SegmentData> segments;
+  segments.reserve( segments_.size() - freeSegments_.size() );
+  for( Segment segment = 0; segment < segments_.size(); segment++ ) {
+    if( destroyed[segment] ) continue;
+    segmentMap[segment] = static_cast<Segment>(segments.size());
+    segments.push_back( segments_[segment] );
+    if( synapseBlockSize_ > 0 ) { //a temporary list, removed below
+      segments.back().synapses = synapsesForSegment(segment);
+    }
+  }
+
+  // Lay out the synapses segment by segment, so that the synapses of each
+  // segment are contiguous.
+  vector<Synapse> synapseMap(synapses_.size(), INVALID_SYNAPSE);
+  vector<SynapseData> synapses;
+  std::vector<SegmentBlocks_> segmentBlocks;
+  std::vector<UInt32> nextBlock;
+  Synapse numFreeSlots = 0u;
+  if( synapseBlockSize_ == 0 ) {
+    synapses.reserve( numSynapses() );
+  }
+  else {
+    segmentBlocks.resize( segments.size() );
+  }
+  for( Segment segment = 0; segment < segments.size(); segment++ ) {
+    auto &segmentSynapses = segments[segment].synapses;
+    if( synapseBlockSize_ > 0 and not segmentSynapses.empty() ) {
+      // Enough consecutive blocks for all synapses of the segment.
+      const size_t numBlocks = (segmentSynapses.size() + synapseBlockSize_ - 1u) / synapseBlockSize_;
+      SegmentBlocks_ &blocks = segmentBlocks[segment];
+      blocks.first = static_cast<UInt32>(nextBlock.size());
+      blocks.last  = static_cast<UInt32>(nextBlock.size() + numBlocks - 1u);
+      blocks.size  = static_cast<Synapse>(segmentSynapses.size());
+      for( size_t b = 0u; b < numBlocks; b++ ) {
+        nextBlock.push_back( b + 1u < numBlocks ? static_cast<UInt32>(nextBlock.size() + 1u) : NO_BLOCK );
+      }
+    }
+    const size_t begin = synapses.size();
+    for( auto &synapse : segmentSynapses ) {
+      const Synapse newSynapse = static_cast<Synapse>(synapses.size());
+      synapseMap[synapse] = newSynapse;
+      synapses.push_back( synapses_[synapse] );
+      synapses.back().segment = segment;
+      synapses.back().segmentIndex_ = static_cast<Synapse>(synapses.size() - 1u - begin);
+      synapse = newSynapse;
+    }
+    if( synapseBlockSize_ > 0 and synapses.size() > begin ) {
+      // Pad the last block with free slots, they are the free list of the segment.
+      SynapseData free;
+      free.presynapticCell      = 0;
+      free.permanence           = minPermanence;
+      free.segment              = FREE_SLOT;
+      free.presynapticMapIndex_ = 0;
+      free.id                   = 0;
+      const size_t end = nextBlock.size() * synapseBlockSize_;
+      if( synapses.size() < end ) {
+        segmentBlocks[segment].freeSlot = static_cast<Synapse>(synapses.size());
+      }
+      numFreeSlots += static_cast<Synapse>(end - synapses.size());
+      while( synapses.size() < end ) {
+        free.segmentIndex_ = synapses.size() + 1u < end ? static_cast<Synapse>(synapses.size() + 1u) : NO_SLOT;
+        synapses.push_back( free );
+      }
+    }
+    if( synapseBlockSize_ > 0 ) {
+      vector<Synapse>().swap( segmentSynapses );
+    }
+  }
+
+  // Remap the segment lists on the cells, and the timeseries updates.
+  for( size_t cell = 0u; cell < cells_.size(); cell++ ) {
+    if( cells_[cell].segments.empty() ) continue;
+    for( auto &segment : cells_.edit(cell).segments ) {
+      segment = segmentMap[segment];
+    }
+  }
+  if( timeseries_ ) {
+    vector<TimeseriesUpdate_> remapped(synapses.size(), TimeseriesUpdate_{minPermanence, minPermanence, 0u});
+    for( Synapse synapse = 0; synapse < timeseriesUpdates_.size() and synapse < synapseMap.size(); synapse++ ) {
+      if( synapseMap[synapse] != INVALID_SYNAPSE ) {
+        remapped[synapseMap[synapse]] = timeseriesUpdates_[synapse];
+      }
+    }
+    timeseriesUpdates_.assign( remapped.begin(), remapped.end() );
+  }
+  if( quantized_() ) {
+    vector<UInt16> remapped(synapses.size(), 0u);
+    for( Synapse synapse = 0; synapse < synapseMap.size(); synapse++ ) {
+      if( synapseMap[synapse] != INVALID_SYNAPSE ) {
+        remapped[synapseMap[synapse]] = static_cast<UInt16>( steps_(synapse) );
+      }
+    }
+    if( permanenceStorage_ == PermanenceStorage::UINT8 ) {
+      permanences8_.assign( remapped.begin(), remapped.end() );
+    }
+    else {
+      permanences16_.assign( remapped.begin(), remapped.end() );
+    }
+  }
+
+  segments_.assign( std::make_move_iterator(segments.begin()), std::make_move_iterator(segments.end()) );
+  synapses_.assign( synapses.begin(), synapses.end() );
+  segmentBlocks_.swap( segmentBlocks );
+  nextBlock_.swap( nextBlock );
+  freeBlocks_.clear();
+  freeSegments_.clear();
+  freeSynapses_.clear();
+  destroyedSegments_ = 0u;
+  destroyedSynapses_ = numFreeSlots;
+  for( auto &counts : threadActivity_ ) {
+    counts.assign( segments_.size(), 0 );
+  }
+  layout_++;
+  revision_++;
+
+  // Rebuild the presynaptic maps.
+  const size_t numLists = presynapticLists_.size();
+  presynapticLists_.clear();
+  presynapticLists_.resize( numLists );
+  presynapticSynapses_.clear();
+  presynapticSegments_.clear();
+  presynapticGaps_ = 0u;
+  for( Synapse synapse = 0; synapse < synapses_.size(); synapse++ ) {
+    if( synapses_[synapse].segment == FREE_SLOT ) continue;
+    addSynapseToPresynapticMap_( synapse, connected_(synapse) );
+  }
+}
+
+
+Connections Connections::fork() const {
+  Connections copy(*this);
+  // The handlers are owned by this instance.
+  copy.eventHandlers_.clear();
+  copy.immediateHandlers_.clear();
+  copy.batchHandlers_.clear();
+  copy.eventQueue_.clear();
+  copy.threadActivity_.clear();
+  copy.threadTouched_.clear();
+  return copy;
+}
+
+
+void Connections::unshareSegment(const Segment segment) {
+  if( not synapses_.mayBeShared() and not timeseriesUpdates_.mayBeShared()
+      and not permanences16_.mayBeShared() and not permanences8_.mayBeShared() ) return;
+  for( const auto synapse : synapsesForSegment(segment) ) {
+    synapses_.edit( synapse );
+    if( timeseries_ ) {
+      timeseriesUpdates_.edit( synapse );
+    }
+    if( permanenceStorage_ == PermanenceStorage::UINT16 ) {
+      permanences16_.edit( synapse );
+    }
+    else if( permanenceStorage_ == PermanenceStorage::UINT8 ) {
+      permanences8_.edit( synapse );
+    }
+  }
+}
+
 namespace htm {
 /**
  * print statistics in human readable form
@@ -636,7 +1605,12 @@ namespace htm {
 std::ostream& operator<< (std::ostream& stream, const Connections& self)
 {
   stream << "Connections:" << std::endl;
-  const auto numPresyns = self.potentialSynapsesForPresynapticCell_.size();
+  size_t numPresyns = 0u;
+  const size_t numLists = self.presynapticLists_.size(); //may be odd, see addSynapseToPresynapticMap_
+  for( size_t i = 0u; i < numLists; i += 2u ) {
+    const size_t connected = i + 1u < numLists ? self.presynapticLists_[i + 1u].size : 0u;
+    if( self.presynapticLists_[i].size + connected > 0u ) numPresyns++;
+  }
   stream << "    Inputs (" << numPresyns
          << ") ~> Outputs (" << self.cells_.size()
          << ") via Segments (" << self.numSegments() << ")" << std::endl;
@@ -652,8 +1626,9 @@ std::ostream& operator<< (std::ostream& stream, const Connections& self)
   SynapseIdx  connectedMax  = 0;
   UInt        synapsesDead      = 0;
   UInt        synapsesSaturated = 0;
-  for( const auto cellData : self.cells_ )
+  for( size_t cell = 0u; cell < self.cells_.size(); cell++ )
   {
+    const auto &cellData = self.cells_[cell];
     const UInt numSegments = (UInt) cellData.segments.size();
     segmentsMin   = std::min( segmentsMin, numSegments );
     segmentsMax   = std::max( segmentsMax, numSegments );
@@ -662,7 +1637,7 @@ std::ostream& operator<< (std::ostream& stream, const Connections& self)
     for( const auto seg : cellData.segments ) {
       const auto &segData = self.dataForSegment( seg );
 
-      const UInt numPotential = (UInt) segData.synapses.size();
+      const UInt numPotential = (UInt) self.numSynapses( seg );
       potentialMin   = std::min( potentialMin, numPotential );
       potentialMax   = std::max( potentialMax, numPotential );
       potentialMean += numPotential;
@@ -671,7 +1646,7 @@ std::ostream& operator<< (std::ostream& stream, const Connections& self)
       connectedMax   = std::max( connectedMax, segData.numConnected );
       connectedMean += segData.numConnected;
 
-      for( const auto syn : segData.synapses ) {
+      for( const auto syn : self.synapsesForSegment( seg ) ) {
         const auto &synData = self.dataForSynapse( syn );
         if( synData.permanence <= minPermanence + Epsilon )
           { synapsesDead++; }
@@ -707,6 +1682,8 @@ bool Connections::operator==(const Connections &other) const {
     return false;
 
   if(iteration_ != other.iteration_) return false;
+  if(segmentEviction_ != other.segmentEviction_) return false;
+  if(permanenceStorage_ != other.permanenceStorage_) return false;
 
   for (CellIdx i = 0; i < static_cast<CellIdx>(cells_.size()); i++) {
     const CellData &cellData = cells_[i];
@@ -722,15 +1699,17 @@ bool Connections::operator==(const Connections &other) const {
       const Segment otherSegment = otherCellData.segments[j];
       const SegmentData &otherSegmentData = other.segments_[otherSegment];
 
-      if (segmentData.synapses.size() != otherSegmentData.synapses.size() ||
+      if (numSynapses(segment) != other.numSynapses(otherSegment) ||
           segmentData.cell != otherSegmentData.cell) {
         return false;
       }
 
-      for (SynapseIdx k = 0; k < static_cast<SynapseIdx>(segmentData.synapses.size()); k++) {
-        const Synapse synapse = segmentData.synapses[k];
+      const vector<Synapse> synapses      = orderedSynapsesForSegment(segment);
+      const vector<Synapse> otherSynapses = other.orderedSynapsesForSegment(otherSegment);
+      for (SynapseIdx k = 0; k < static_cast<SynapseIdx>(synapses.size()); k++) {
+        const Synapse synapse = synapses[k];
         const SynapseData &synapseData = synapses_[synapse];
-        const Synapse otherSynapse = otherSegmentData.synapses[k];
+        const Synapse otherSynapse = otherSynapses[k];
         const SynapseData &otherSynapseData = other.synapses_[otherSynapse];
 
         if (synapseData.presynapticCell != otherSynapseData.presynapticCell ||
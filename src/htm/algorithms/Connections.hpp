@@ -22,8 +22,10 @@
 #ifndef NTA_CONNECTIONS_HPP
 #define NTA_CONNECTIONS_HPP
 
+#include <cstdint>
 #include <limits>
 #include <map>
+#include <memory>
 #include <unordered_map>
 #include <set>
 #include <utility>
@@ -33,6 +35,8 @@
 #include <htm/types/Types.hpp>
 #include <htm/types/Serializable.hpp>
 #include <htm/types/Sdr.hpp>
+#include <htm/utils/PagedVector.hpp>
+#include <htm/utils/ThreadPool.hpp>
 
 namespace htm {
 
@@ -66,8 +70,11 @@ struct SynapseData: public Serializable {
   Segment segment;
   Synapse presynapticMapIndex_;
   Synapse id;
+  Synapse segmentIndex_; //position in SegmentData.synapses with unordered synapses, next free slot of a free arena slot
 
-  SynapseData() {}
+  SynapseData()
+    : presynapticCell(0u), permanence(0.0f), segment(0u),
+      presynapticMapIndex_(0u), id(0u), segmentIndex_(0u) {}
 
   CerealAdapter;
   template<class Archive>
@@ -89,19 +96,22 @@ struct SynapseData: public Serializable {
  * The SegmentData contains the underlying data for a Segment.
  *
  * @param synapses
- * Synapses on this segment.
+ * Synapses on this segment. Not used with the synapse arena, which keeps
+ * them in the blocks of the segment, see Connections::synapsesForSegment.
  *
  * @param cell
  * The cell that this segment is on.
  */
 struct SegmentData {
-  SegmentData(const CellIdx cell, Segment id, UInt32 lastUsed = 0) : cell(cell), numConnected(0), lastUsed(lastUsed), id(id) {} //default constructor
+  SegmentData(const CellIdx cell, Segment id, UInt32 lastUsed = 0, Segment ordinal = 0) : cell(cell), numConnected(0), lastUsed(lastUsed), id(id), ordinal(ordinal) {} //default constructor
+  SegmentData() : SegmentData(0u, 0u) {} //placeholder, for unused slots of a PagedVector
 
   std::vector<Synapse> synapses;
   CellIdx cell; //mother cell that this segment originates from
   SynapseIdx numConnected; //number of permanences from `synapses` that are >= synPermConnected, ie connected synapses
   UInt32 lastUsed = 0; //last used time (iteration). Used for segment pruning by "least recently used" (LRU) in `createSegment`
   Segment id; 
+  Segment ordinal; //order of creation. Segment handles are recycled, use this to break ties deterministically.
 };
 
 /**
@@ -119,16 +129,153 @@ struct CellData {
   std::vector<Segment> segments;
 };
 
+/**
+ * SegmentActivity class used in Connections.
+ *
+ * @b Description
+ * Output of Connections::computeActivity: the number of active synapses on
+ * each segment. The caller keeps it between calls. computeActivity resets
+ * only the entries which it set in the previous call, so that once the
+ * buffers have grown to the number of segments a call does not allocate
+ * memory, and its cost is proportional to the number of active synapses.
+ * Do not modify the contents, or a later call can return wrong counts.
+ *
+ * @param numActiveConnected
+ * Number of active connected synapses, indexed by Segment.
+ *
+ * @param numActivePotential
+ * Number of active potential synapses (connected or not), indexed by Segment.
+ * Empty if not requested.
+ *
+ * @param touched
+ * The segments with any active (potential or connected) synapse, not sorted.
+ * All other segments have zero counts.
+ *
+ * @param layout
+ * Internal, detects that Connections::compact() renumbered the segments.
+ */
+struct SegmentActivity {
+  std::vector<SynapseIdx> numActiveConnected;
+  std::vector<SynapseIdx> numActivePotential;
+  std::vector<Segment>    touched;
+  UInt32                  layout = 0u;
+
+  /**
+   * Internal, used by computeActivity. Zero the counts set by the previous
+   * call and size the buffers for `numSegments` segments.
+   */
+  void reset(const size_t numSegments, const UInt32 newLayout, const bool potential);
+
+  /**
+   * Internal, used by computeActivity. Start the potential counts from the
+   * connected counts.
+   */
+  void copyConnectedToPotential();
+};
+
+/**
+ * SynapseUpdate class used in Connections.
+ *
+ * @b Description
+ * A change of a synapse which Connections::adaptSegmentPermanences leaves
+ * to Connections::applySynapseUpdates, because it changes the shared data
+ * of the Connections: the synapse becomes connected or disconnected, or it
+ * is destroyed.
+ */
+struct SynapseUpdate {
+  Synapse    synapse;
+  Permanence permanence; //new permanence, if not destroyed
+  bool       destroy;
+};
+
+/**
+ * SegmentEviction, used in Connections.
+ *
+ * @b Description
+ * Which segment Connections::createSegment destroys when the cell already
+ * has maxSegmentsPerCell segments, see Connections::setSegmentEviction.
+ * Ties are broken by the order of creation.
+ */
+enum class SegmentEviction {
+  LRU            = 0, //least recently used, by SegmentData::lastUsed (default)
+  OLDEST         = 1, //created first. Needs no lastUsed bookkeeping.
+  MIN_PERMANENCE = 2, //lowest sum of permanences, the weakest segment
+};
+
+/**
+ * PermanenceStorage, used in Connections.
+ *
+ * @b Description
+ * How Connections stores the permanences of the synapses, see the
+ * Connections constructor. The fixed point types hold the permanence as a
+ * whole number of steps between minPermanence and maxPermanence.
+ */
+enum class PermanenceStorage {
+  REAL32 = 0, //floating point (default)
+  UINT16 = 1, //16 bit fixed point, steps of 1/65535
+  UINT8  = 2, //8 bit fixed point, steps of 1/255
+};
+
+/**
+ * ConnectionsEvent class used in Connections.
+ *
+ * @b Description
+ * A change of the Connections, delivered to the event handlers which
+ * receive the events in batches, see ConnectionsEventHandler::batchEvents.
+ *
+ * @param type
+ * Which of the ConnectionsEventHandler callbacks this event stands for.
+ *
+ * @param handle
+ * The Segment or the Synapse.
+ *
+ * @param permanence
+ * The new permanence, for UPDATE_SYNAPSE_PERMANENCE.
+ */
+struct ConnectionsEvent {
+  enum Type : UInt32 {
+    CREATE_SEGMENT,
+    DESTROY_SEGMENT,
+    CREATE_SYNAPSE,
+    DESTROY_SYNAPSE,
+    UPDATE_SYNAPSE_PERMANENCE
+  };
+
+  Type       type;
+  UInt32     handle;
+  Permanence permanence;
+};
+
 /**
  * A base class for Connections event handlers.
  *
  * @b Description
  * This acts as a plug-in point for logging / visualizations.
+ *
+ * By default the callbacks are called as the changes happen. A handler can
+ * instead receive the events in batches, by returning true from
+ * batchEvents(). Connections then queues the events and calls onEvents()
+ * with all events since the previous batch, at the start of computeActivity
+ * (ie once per compute step of SP / TM), on Connections::flushEvents(), and
+ * before the handler is unsubscribed. The handles in a batch refer to the
+ * state at the time of the event, they can be reused by later events.
  */
 class ConnectionsEventHandler {
 public:
   virtual ~ConnectionsEventHandler() {}
 
+  /**
+   * Return true to receive the events with onEvents() instead of the other
+   * callbacks. Called once, when subscribing.
+   */
+  virtual bool batchEvents() const { return false; }
+
+  /**
+   * Called with the queued events, in the order they happened. Only for
+   * handlers which batch events.
+   */
+  virtual void onEvents(const std::vector<ConnectionsEvent> &events) {}
+
   /**
    * Called after a segment is created.
    */
@@ -183,11 +330,18 @@ public:
  * Create a vector of length `connections.segmentFlatListLength()`,
  * iterate over segments and update the vector at index `segment`.
  *
+ * The slots of destroyed segments and synapses are reused by new ones, so
+ * a handle (Segment, Synapse) of a destroyed item can later refer to a
+ * different item. The flat list only grows with the peak number of live
+ * segments. See also `compact()`.
+ *
  */
 class Connections : public Serializable
  {
+  friend class FrozenConnections;
+
 public:
-  static const UInt16 VERSION = 2;
+  static const UInt16 VERSION = 4;
 
   /**
    * Connections empty constructor.
@@ -209,13 +363,51 @@ public:
    * This change allows it to work with timeseries data which moves very slowly,
    * instead of the usual HTM inputs which reliably change every cycle.  See
    * also (Kropff & Treves, 2007. http://dx.doi.org/10.2976/1.2793335).
+   *
+   * @params synapseBlockSize - Optional, default 0 (disabled). If > 0, the
+   * synapses of each segment are stored together in blocks ("arena") of this
+   * many synapses, instead of in order of their creation. A segment has no
+   * list of its synapses, iterating them (synapsesForSegment, adaptSegment,
+   * raisePermanencesToThreshold, ...) scans the slots of the segment's blocks,
+   * a few contiguous, cache-line aligned runs of memory instead of memory
+   * scattered over the whole synapse list. The synapses are unordered, see
+   * setOrderedSynapses. Creating and destroying a synapse take constant
+   * time: slots of destroyed synapses are kept in a free list of the segment
+   * and reused by its new synapses, and the blocks of a destroyed segment
+   * are reused by other segments. Pick a value close to the typical
+   * number of synapses on a segment. The value is rounded up to a power of
+   * two, at least 2 and at most the 512 synapses of a storage page, so that
+   * blocks start on a cache line boundary and never straddle two pages.
+   * The layout is not part of the model, it is not serialized, and does not
+   * change the results of computations (except for tie-breaks which depend on
+   * the Synapse handle values).
+   *
+   * @params permanenceStorage - Optional, default REAL32. With UINT16 or
+   * UINT8 the permanences are stored as fixed point numbers, in an array of
+   * 2 or 1 bytes per synapse next to the synapses, and learning works on
+   * them in whole steps: adaptSegment and bumpSegment round the increments
+   * and decrements to steps (at least one step if not zero), and a synapse
+   * is connected if its steps reach the connected threshold rounded to
+   * steps. The results do not depend on floating point rounding. With UINT8
+   * increments smaller than ~0.004 are coarser than with REAL32, choose the
+   * learning rates accordingly. SynapseData::permanence holds the value of
+   * the fixed point permanence, for the readers of dataForSynapse. The
+   * storage is part of the model and is serialized.
    */
   Connections(const CellIdx numCells, 
 	      const Permanence connectedThreshold = 0.5f,
-              const bool timeseries = false);
+              const bool timeseries = false,
+              const SynapseIdx synapseBlockSize = 0,
+              const PermanenceStorage permanenceStorage = PermanenceStorage::REAL32);
 
   virtual ~Connections() {}
 
+  Connections(const Connections &) = default;
+  Connections &operator=(const Connections &) = default;
+  // Assigning a moved Connections releases the memory of the old one.
+  Connections(Connections &&) = default;
+  Connections &operator=(Connections &&) = default;
+
   /**
    * Initialize connections.
    *
@@ -223,10 +415,14 @@ public:
    * @param connectedThreshold Permanence threshold for synapses connecting or
    *                           disconnecting.
    * @param timeseries         See constructor.
+   * @param synapseBlockSize   See constructor.
+   * @param permanenceStorage  See constructor.
    */
   void initialize(const CellIdx numCells, 
 		  const Permanence connectedThreshold = 0.5f,
-                  const bool timeseries = false);
+                  const bool timeseries = false,
+                  const SynapseIdx synapseBlockSize = 0,
+                  const PermanenceStorage permanenceStorage = PermanenceStorage::REAL32);
 
   /**
    * Creates a segment on the specified cell.
@@ -234,9 +430,9 @@ public:
    * @param cell Cell to create segment on.
    *
    * @param maxSegmetsPerCell Optional. Enforce limit on maximum number of segments that can be
-   * created on a Cell. If the limit is exceeded, call `destroySegment` to remove least used segments 
-   * (ordered by LRU `SegmentData.lastUsed`). Default value is numeric_limits::max() of the data-type, 
-   * so effectively disabled. 
+   * created on a Cell. If the limit is exceeded, call `destroySegment` to remove segments, chosen
+   * by the segmentEviction() policy (default least recently used, by `SegmentData.lastUsed`).
+   * Default value is numeric_limits::max() of the data-type, so effectively disabled. 
    *
    * @retval Unique ID of the created segment `seg`. Use `dataForSegment(seg)` to obtain the segment's data. 
    * Use  `idxOfSegmentOnCell()` to get SegmentIdx of `seg` on this `cell`. 
@@ -275,6 +471,41 @@ public:
                         const CellIdx presynapticCell,
                         Permanence permanence);
 
+  /**
+   * Creates synapses on the specified segment, one for each of the given
+   * presynaptic cells, in this order. Like createSynapse(), this skips the
+   * cells which are already synapsed on by the segment, and repeated cells.
+   * The duplicates are found in a single pass over the segment, instead of a
+   * scan of the segment for each cell, so this is faster than calling
+   * createSynapse() in a loop when growing many synapses.
+   *
+   * @param segment          Segment to create synapses on.
+   * @param presynapticCells Cells to synapse on, in any order.
+   * @param permanence       Initial permanence of the new synapses.
+   * @param maxNewSynapses   Optional, stop after creating this many synapses.
+   *
+   * @return Number of created synapses. They are the last ones in
+   * synapsesForSegment(segment).
+   */
+  size_t createSynapses(const Segment segment,
+                        const std::vector<CellIdx> &presynapticCells,
+                        const Permanence permanence,
+                        const size_t maxNewSynapses = std::numeric_limits<size_t>::max());
+
+  /**
+   * Creates synapses on the specified segment, as above, with a permanence
+   * for each of the presynaptic cells.
+   *
+   * @param segment          Segment to create synapses on.
+   * @param presynapticCells Cells to synapse on, in any order.
+   * @param permanences      Initial permanences, one for each of the cells.
+   *
+   * @return Number of created synapses.
+   */
+  size_t createSynapses(const Segment segment,
+                        const std::vector<CellIdx> &presynapticCells,
+                        const std::vector<Permanence> &permanences);
+
   /**
    * Destroys segment.
    *
@@ -309,18 +540,145 @@ public:
     return cells_[cell].segments;
   }
 
+  /**
+   * The synapses of a segment, see synapsesForSegment. A view which iterates
+   * the synapse list of the segment or, with the synapse arena, the occupied
+   * slots of the segment's blocks, without copying them. It shows the
+   * current synapses of the segment, convert it to a std::vector for a copy
+   * which is not changed by creating and destroying synapses.
+   */
+  class SegmentSynapses {
+  public:
+    class const_iterator {
+    public:
+      using iterator_category = std::input_iterator_tag;
+      using value_type        = Synapse;
+      using difference_type   = std::ptrdiff_t;
+      using pointer           = const Synapse *;
+      using reference         = Synapse;
+
+      Synapse operator*() const { return arena_ == nullptr ? *list_ : slot_; }
+      const_iterator &operator++() {
+        remaining_--;
+        if( arena_ == nullptr ) {
+          list_++;
+        }
+        else if( remaining_ > 0u ) {
+          slot_++;
+          skipFreeSlots_();
+        }
+        return *this;
+      }
+      const_iterator operator++(int) { const_iterator it = *this; ++(*this); return it; }
+      bool operator==(const const_iterator &other) const { return remaining_ == other.remaining_; }
+      bool operator!=(const const_iterator &other) const { return remaining_ != other.remaining_; }
+
+    private:
+      friend class SegmentSynapses;
+      const_iterator(const Synapse *list, const size_t size)
+        : list_(list), arena_(nullptr), remaining_(size) {}
+      const_iterator(const Connections *arena, const UInt32 block, const size_t size)
+        : list_(nullptr), arena_(arena), remaining_(size), block_(block) {
+        if( remaining_ == 0u ) return;
+        slot_ = block_ * arena_->synapseBlockSize_;
+        end_  = slot_ + arena_->synapseBlockSize_;
+        skipFreeSlots_();
+      }
+      // Moves to the next occupied slot, following the chain of blocks.
+      void skipFreeSlots_() {
+        for( ;; ) {
+          if( slot_ == end_ ) {
+            block_ = arena_->nextBlock_[block_];
+            NTA_ASSERT( block_ != NO_BLOCK );
+            slot_ = block_ * arena_->synapseBlockSize_;
+            end_  = slot_ + arena_->synapseBlockSize_;
+          }
+          if( arena_->synapses_[slot_].segment != FREE_SLOT ) return;
+          slot_++;
+        }
+      }
+
+      const Synapse     *list_;
+      const Connections *arena_;
+      size_t  remaining_;
+      UInt32  block_ = NO_BLOCK;
+      Synapse slot_  = 0u;
+      Synapse end_   = 0u;
+    };
+    using iterator = const_iterator;
+
+    const_iterator begin() const {
+      if( connections_->synapseBlockSize_ == 0u ) {
+        const auto &list = connections_->segments_[segment_].synapses;
+        return const_iterator(list.data(), list.size());
+      }
+      const auto &blocks = connections_->segmentBlocks_[segment_];
+      return const_iterator(connections_, blocks.first, blocks.size);
+    }
+    const_iterator end() const { return const_iterator(nullptr, 0u); }
+    size_t size() const { return connections_->numSynapses(segment_); }
+    bool empty() const { return size() == 0u; }
+
+    /**
+     * Gets the synapse at position `index`. Constant time without the arena,
+     * with the arena it walks the blocks of the segment.
+     */
+    Synapse operator[](const size_t index) const {
+      NTA_ASSERT( index < size() );
+      if( connections_->synapseBlockSize_ == 0u ) {
+        return connections_->segments_[segment_].synapses[index];
+      }
+      auto it = begin();
+      for( size_t i = 0u; i < index; i++ ) ++it;
+      return *it;
+    }
+
+    operator std::vector<Synapse>() const {
+      std::vector<Synapse> copy;
+      copy.reserve( size() );
+      for( const auto synapse : *this ) copy.push_back( synapse );
+      return copy;
+    }
+
+    friend bool operator==(const SegmentSynapses &a, const std::vector<Synapse> &b) {
+      return a.size() == b.size() and std::equal( a.begin(), a.end(), b.begin() );
+    }
+    friend bool operator==(const std::vector<Synapse> &a, const SegmentSynapses &b) { return b == a; }
+    friend bool operator==(const SegmentSynapses &a, const SegmentSynapses &b) {
+      return a == static_cast<std::vector<Synapse>>(b);
+    }
+
+  private:
+    friend class Connections;
+    SegmentSynapses(const Connections *connections, const Segment segment)
+      : connections_(connections), segment_(segment) {}
+    const Connections *connections_;
+    Segment segment_;
+  };
+
   /**
    * Gets the synapses for a segment.
    *
    * @param segment Segment to get synapses for.
    *
-   * @retval Synapses on segment.
+   * @retval Synapses on segment, see SegmentSynapses.
    */
-  const std::vector<Synapse> &synapsesForSegment(const Segment segment) const {
+  SegmentSynapses synapsesForSegment(const Segment segment) const {
     NTA_ASSERT(segment < segments_.size()) << "Segment out of bounds! " << segment;
-    return segments_[segment].synapses;
+    return SegmentSynapses(this, segment);
   }
 
+  /**
+   * Gets the synapses for a segment, in the order of their creation.
+   * Same as synapsesForSegment, unless the synapses are unordered (see
+   * setOrderedSynapses), then this sorts a copy.
+   *
+   * @param segment Segment to get synapses for.
+   *
+   * @retval Synapses on segment.
+   */
+  std::vector<Synapse> orderedSynapsesForSegment(const Segment segment) const;
+
   /**
    * Gets the cell that this segment is on.
    *
@@ -364,7 +722,7 @@ public:
     return segments_[segment];
   }
   SegmentData& dataForSegment(const Segment segment) { //editable access, needed by SP 
-    return segments_[segment];
+    return segments_.edit(segment);
   }
 
   /**
@@ -451,6 +809,63 @@ public:
   std::vector<SynapseIdx> computeActivity(const std::vector<CellIdx> &activePresynapticCells, 
 		                          const bool learn = true);
 
+  /**
+   * Compute the segment excitations for a vector of active presynaptic
+   * cells, into caller owned buffers. Use this in a loop, it does not
+   * allocate memory in the steady state. See SegmentActivity.
+   *
+   * @param activity Output, reused between calls. It is resized to
+   * segmentFlatListLength().
+   *
+   * @param activePresynapticCells Active cells in the input.
+   *
+   * @param learn Enable learning updates (default true).
+   *
+   * @param potential Also count the potential synapses (default true).
+   */
+  void computeActivity(SegmentActivity &activity,
+                       const std::vector<CellIdx> &activePresynapticCells,
+                       const bool learn = true,
+                       const bool potential = true);
+
+  /**
+   * Bookkeeping which computeActivity does once per compute step: the
+   * iteration counter, the timeseries updates and the batched events. Call
+   * this when the segment activity of a step is computed by other means,
+   * eg with a FrozenConnections.
+   *
+   * @param learn Enable learning updates.
+   */
+  void startComputeStep(const bool learn);
+
+  /**
+   * Counter of the changes which can change the result of computeActivity:
+   * created and destroyed segments and synapses, and synapses which became
+   * connected or disconnected. It only increases, so a copy of the
+   * Connections (eg a FrozenConnections) is up to date if it was made at
+   * the same revision.
+   */
+  UInt64 revision() const noexcept { return revision_; }
+
+  /**
+   * Use a thread pool to compute the segment activity, see computeActivity.
+   *
+   * The active presynaptic cells are split between the threads, each counts
+   * the active synapses into its own buffer and lists the segments it
+   * counted, then the counts of the listed segments are summed up. The cost
+   * stays proportional to the active synapses, not to the number of
+   * segments. The counts are integers, so the result is identical to the
+   * serial computation for any number of threads.
+   * Small inputs are still computed serially, as the threads would only add
+   * overhead.
+   *
+   * The pool is not serialized, and is shared by copies of this instance.
+   *
+   * @param pool ThreadPool to use, or nullptr to compute serially (default).
+   */
+  void setThreadPool(const std::shared_ptr<ThreadPool> &pool) { threadPool_ = pool; }
+  const std::shared_ptr<ThreadPool> &getThreadPool() const { return threadPool_; }
+
   /**
    * The primary method in charge of learning.   Adapts the permanence values of
    * the synapses based on the input SDR.  Learning is applied to a single
@@ -473,6 +888,33 @@ public:
                     const Permanence decrement,
 		    const bool pruneZeroSynapses = false);
 
+  /**
+   * adaptSegment in two steps, so that many segments can be adapted in
+   * parallel. adaptSegment(...) is the same as
+   *    adaptSegmentPermanences(..., deferred);
+   *    applySynapseUpdates(segment, deferred, pruneZeroSynapses);
+   *
+   * adaptSegmentPermanences changes the permanences which do not change the
+   * connected status of their synapse, and appends the other changes to
+   * `deferred`. It writes only to the synapses of the segment, so it can be
+   * called concurrently for different segments, if nothing else modifies
+   * the Connections meanwhile. Call inputs.getDense() before, it is not
+   * thread-safe the first time.
+   *
+   * applySynapseUpdates applies the deferred changes in their order, and
+   * destroys the segment if pruning left it too few synapses.
+   */
+  void adaptSegmentPermanences(const Segment segment,
+                               const SDR &inputs,
+                               const Permanence increment,
+                               const Permanence decrement,
+                               const bool pruneZeroSynapses,
+                               std::vector<SynapseUpdate> &deferred);
+
+  void applySynapseUpdates(const Segment segment,
+                           const std::vector<SynapseUpdate> &deferred,
+                           const bool pruneZeroSynapses = false);
+
   /**
    * Ensures a minimum number of connected synapses.  This raises permance
    * values until the desired number of synapses have permanences above the
@@ -537,6 +979,47 @@ public:
   void destroyMinPermanenceSynapses(const Segment segment, Int nDestroy,
                                     const SDR_sparse_t &excludeCells = {});
 
+  /**
+   * Renumber the live segments and synapses, so that they are contiguous in
+   * memory and the flat lists have no unused slots. Rebuilds the presynaptic
+   * maps. Use after heavy pruning, to release memory and to make the per
+   * segment vectors (see segmentFlatListLength) shorter.
+   *
+   * This invalidates all Segment and Synapse handles held outside of this
+   * class (the relative order of the handles is kept), so call it between
+   * compute steps of the algorithm which owns this instance. Event handlers
+   * are not notified. The results of computations do not change.
+   */
+  void compact();
+
+  /**
+   * A copy of this instance, eg. to try out some inputs with learning
+   * without modifying this instance.
+   *
+   * With setCopyOnWrite(true) the fork shares the memory copy-on-write: the
+   * cells, segments, synapses and presynaptic maps are kept in pages (see
+   * PagedVector), the fork shares all pages with this instance, and each of
+   * them copies a page when it first modifies it. Forking takes time and
+   * memory proportional to the number of pages and to the synapse arena
+   * bookkeeping, not to the number of synapses. Afterwards the memory used
+   * by the fork grows with the segments and synapses which it modifies.
+   * Without it (default) the fork is a deep copy.
+   *
+   * The fork is independent of this instance, it computes exactly as a deep
+   * copy. Both can be used in different threads, and can be forked again.
+   * The fork has no event handlers (they stay subscribed to this instance),
+   * and it uses the same thread pool.
+   */
+  Connections fork() const;
+
+  /**
+   * Copy the pages holding the synapses of a segment which are shared with
+   * a fork, so that adaptSegmentPermanences can be called for distinct
+   * segments in parallel. Does nothing if this instance was never forked
+   * with copy-on-write, see setCopyOnWrite.
+   */
+  void unshareSegment(const Segment segment);
+
   /**
    * Print diagnostic info
    */
@@ -544,6 +1027,11 @@ public:
 
 
   // Serialization
+  // The archive starts with the VERSION, stored as a number larger than
+  // maxPermanence. Archives of version 2 have no version, they start with
+  // the connected threshold, and load with the default segment eviction.
+  // Archives before version 4 load with REAL32 permanences. The permanences
+  // are saved as Real32 in all storages, fixed point ones load exactly.
   CerealAdapter;
   template<class Archive>
   void save_ar(Archive & ar) const {
@@ -553,12 +1041,11 @@ public:
     std::deque<SynapseData> syndata;
     std::deque<size_t> sizes;
     sizes.push_back(cells_.size());
-    for (CellData cellData : cells_) {
-      const std::vector<Segment> &segments = cellData.segments;
+    for (size_t cell = 0; cell < cells_.size(); cell++) {
+      const std::vector<Segment> &segments = cells_[cell].segments;
       sizes.push_back(segments.size());
       for (Segment segment : segments) {
-        const SegmentData &segmentData = segments_[segment];
-        const std::vector<Synapse> &synapses = segmentData.synapses;
+        const std::vector<Synapse> synapses = orderedSynapsesForSegment(segment);
         sizes.push_back(synapses.size());
         for (Synapse synapse : synapses) {
           const SynapseData &synapseData = synapses_[synapse];
@@ -566,22 +1053,48 @@ public:
         }
       }
     }
+    const Real32 version = static_cast<Real32>(VERSION);
+    ar(CEREAL_NVP(version));
     ar(CEREAL_NVP(connectedThreshold_));
     ar(CEREAL_NVP(sizes));
     ar(CEREAL_NVP(syndata));
     ar(CEREAL_NVP(iteration_));
+    ar(CEREAL_NVP(segmentEviction_));
+    ar(CEREAL_NVP(permanenceStorage_));
   }
 
   template<class Archive>
   void load_ar(Archive & ar) {
     std::deque<size_t> sizes;
     std::deque<SynapseData> syndata;
-    ar(CEREAL_NVP(connectedThreshold_));
+    UInt32 iteration;
+    SegmentEviction segmentEviction = SegmentEviction::LRU;
+    PermanenceStorage permanenceStorage = PermanenceStorage::REAL32;
+    // Read the first item without a name, it is the version or the threshold.
+    Real32 first;
+    ar(first);
+    UInt16 version = 2;
+    if (first > maxPermanence) {
+      version = static_cast<UInt16>(first);
+      NTA_CHECK(version <= VERSION) << "Connections archive of version " << version
+                                    << ", this is version " << VERSION;
+      ar(CEREAL_NVP(connectedThreshold_));
+    }
+    else {
+      connectedThreshold_ = first;
+    }
     ar(CEREAL_NVP(sizes));
     ar(CEREAL_NVP(syndata));
+    ar(CEREAL_NVP(iteration));
+    if (version >= 3) {
+      ar(cereal::make_nvp("segmentEviction_", segmentEviction));
+    }
+    if (version >= 4) {
+      ar(cereal::make_nvp("permanenceStorage_", permanenceStorage));
+    }
 
     CellIdx numCells = static_cast<CellIdx>(sizes.front()); sizes.pop_front();
-    initialize(numCells, connectedThreshold_);
+    initialize(numCells, connectedThreshold_, false, synapseBlockSize_, permanenceStorage); //keeps the memory layout of this instance
     for (UInt cell = 0; cell < numCells; cell++) {
       size_t numSegments = sizes.front(); sizes.pop_front();
       for (SegmentIdx j = 0; j < static_cast<SegmentIdx>(numSegments); j++) {
@@ -594,7 +1107,8 @@ public:
         }
       }
     }
-    ar(CEREAL_NVP(iteration_));
+    iteration_       = iteration;
+    segmentEviction_ = segmentEviction;
   }
 
   /**
@@ -606,6 +1120,62 @@ public:
 
   constexpr Permanence getConnectedThreshold() const noexcept { return connectedThreshold_; }
 
+  /**
+   * Gets the number of synapses in a block of the synapse arena,
+   * 0 if the arena is not used. See constructor.
+   */
+  SynapseIdx synapseBlockSize() const noexcept { return synapseBlockSize_; }
+
+  /**
+   * Gets how the permanences are stored, see constructor.
+   */
+  PermanenceStorage permanenceStorage() const noexcept { return permanenceStorage_; }
+
+  /**
+   * By default the synapses of a segment are kept in the order of their
+   * creation, and destroySynapse shifts the synapses after the destroyed
+   * one. With unordered synapses destroySynapse moves the last synapse of
+   * the segment into the freed position instead, which takes constant time
+   * and helps with heavy pruning (adaptSegment with pruneZeroSynapses).
+   *
+   * The results of the algorithms do not depend on this order, ties are
+   * broken by the order of creation. Only synapsesForSegment returns the
+   * synapses in a different order, use orderedSynapsesForSegment where the
+   * order matters. Serialization and operator== are not affected.
+   *
+   * This option is not serialized, like the synapse arena. Switching back to
+   * ordered synapses sorts them. The synapse arena always keeps the synapses
+   * in the order of their slots, unordered, and ignores this option.
+   *
+   * @param ordered Keep the synapses in the order of creation (default).
+   */
+  void setOrderedSynapses(const bool ordered);
+  bool orderedSynapses() const noexcept { return orderedSynapses_ and synapseBlockSize_ == 0u; }
+
+  /**
+   * Keep the cells, segments, synapses and presynaptic maps in pages, which
+   * fork() shares copy-on-write. The pages cost an indirection on each
+   * access (a few percent of compute time), enable them only on instances
+   * which are forked. Forks keep this option.
+   *
+   * This option is not serialized, like the synapse arena. The contents and
+   * the results of computations do not change.
+   *
+   * @param enable Pages shared by forks, else contiguous storage (default).
+   */
+  void setCopyOnWrite(const bool enable);
+  bool copyOnWrite() const noexcept { return synapses_.paged(); }
+
+  /**
+   * Choose which segments createSegment destroys on a full cell, see
+   * SegmentEviction. The callers (eg TM) must update SegmentData::lastUsed
+   * for the LRU policy only.
+   *
+   * The policy is serialized, archives of version 2 load as LRU.
+   */
+  void setSegmentEviction(const SegmentEviction policy) noexcept { segmentEviction_ = policy; }
+  SegmentEviction segmentEviction() const noexcept { return segmentEviction_; }
+
   /**
    * Gets the number of segments.
    *
@@ -624,6 +1194,33 @@ public:
 	  return cells_[cell].segments.size(); 
   }
 
+  /**
+   * Keep an index of the cells with the fewest segments, per group of
+   * `cellsPerGroup` consecutive cells (eg the mini-columns of the TM). It is
+   * updated by createSegment / destroySegment, so that numLeastUsedCells and
+   * leastUsedCell do not scan the cells of the group.
+   *
+   * The index is not serialized, and initialize() removes it.
+   *
+   * @param cellsPerGroup Number of cells in a group, 0 removes the index.
+   */
+  void indexLeastUsedCells(const CellIdx cellsPerGroup);
+  CellIdx leastUsedCellsGroupSize() const noexcept { return cellGroupSize_; }
+
+  /**
+   * Gets the number of cells in the group with the fewest segments in the
+   * group. Requires indexLeastUsedCells.
+   */
+  UInt32 numLeastUsedCells(const CellIdx group);
+
+  /**
+   * Gets the cell number `index` (counted in the order of the cells) of the
+   * cells with the fewest segments in the group.
+   *
+   * @param index In range [0, numLeastUsedCells(group)).
+   */
+  CellIdx leastUsedCell(const CellIdx group, UInt32 index);
+
   /**
    * Gets the number of synapses.
    *
@@ -640,6 +1237,7 @@ public:
    * @retval Number of synapses.
    */
   size_t numSynapses(const Segment segment) const { 
+	  if( synapseBlockSize_ > 0u ) return segmentBlocks_[segment].size;
 	  return segments_[segment].synapses.size(); 
   }
 
@@ -673,6 +1271,12 @@ public:
    */
   void unsubscribe(UInt32 token);
 
+  /**
+   * Deliver the queued events to the handlers which batch events.
+   * See ConnectionsEventHandler.
+   */
+  void flushEvents();
+
 protected:
   /**
    * Check whether this segment still exists on its cell.
@@ -693,50 +1297,240 @@ protected:
   bool synapseExists_(const Synapse synapse) const;
 
   /**
-   * Remove a synapse from presynaptic maps.
+   * Add a synapse to the presynaptic map of its presynaptic cell.
+   * Sets SynapseData.presynapticMapIndex_ of the synapse.
    *
-   * @param Synapse Index of synapse in presynaptic vector.
+   * @param Synapse to add.
    *
-   * @param vector<Synapse> ynapsesForPresynapticCell must a vector from be
-   * either potentialSynapsesForPresynapticCell_ or
-   * connectedSynapsesForPresynapticCell_, depending on whether the synapse is
-   * connected or not.
+   * @param connected Add to the connected synapses of the presynaptic cell,
+   * else to the potential (not connected) synapses.
+   */
+  void addSynapseToPresynapticMap_(const Synapse synapse, const bool connected);
+
+  /**
+   * Remove a synapse from presynaptic map, by moving the last synapse in the
+   * list over this synapse.
    *
-   * @param vector<Synapse> segmentsForPresynapticCell must be a vector from
-   * either potentialSegmentsForPresynapticCell_ or
-   * connectedSegmentsForPresynapticCell_, depending on whether the synapse is
-   * connected or not.
+   * @param Synapse to remove.
+   *
+   * @param connected Must be true if the synapse is in the connected list
+   * of its presynaptic cell, false if it's in the potential list.
    */
-  void removeSynapseFromPresynapticMap_(const Synapse index,
-                              std::vector<Synapse> &synapsesForPresynapticCell,
-                              std::vector<Segment> &segmentsForPresynapticCell);
+  void removeSynapseFromPresynapticMap_(const Synapse synapse, const bool connected);
+
+  /**
+   * Rebuild the packed presynaptic lists without the gaps left behind by
+   * lists which were moved when they grew.
+   */
+  void compactPresynapticMap_();
+
+  /**
+   * Count the active synapses for each segment, for the connected or the
+   * potential (not connected) synapses, and add them to `numActiveSynapsesForSegment`.
+   * Segments whose count was zero are appended to `touched` (if not nullptr).
+   * Uses the thread pool, if any.
+   */
+  void countActiveSynapses_(const std::vector<CellIdx> &activePresynapticCells,
+                            const bool connected,
+                            std::vector<SynapseIdx> &numActiveSynapsesForSegment,
+                            std::vector<Segment> *touched = nullptr);
+
+  /**
+   * Creates a synapse, without checking for duplicates.
+   */
+  Synapse addSynapse_(const Segment segment, const CellIdx presynapticCell,
+                      Permanence permanence);
+
+  /**
+   * Get an index into the synapses_ list, for a new synapse on the segment
+   * to reside at. With the synapse arena this is a free slot in one of the
+   * segment's blocks, otherwise the slot of a destroyed synapse or a new
+   * element at the end of synapses_.
+   */
+  Synapse allocateSynapse_(const Segment segment);
+
+  /**
+   * Return the arena blocks of a (destroyed) segment to the pool of free blocks.
+   */
+  void releaseSynapseBlocks_(const Segment segment);
+
+  /**
+   * Call fn(synapse) for the synapses of the segment, in the order of
+   * synapsesForSegment. Same as iterating SegmentSynapses, but chooses
+   * between the list and the arena blocks once, for the hot loops.
+   */
+  template<typename Fn>
+  void forEachSynapse_(const Segment segment, Fn fn) const {
+    if( synapseBlockSize_ == 0u ) {
+      for( const auto synapse : segments_[segment].synapses ) fn( synapse );
+      return;
+    }
+    Synapse remaining = segmentBlocks_[segment].size;
+    for( UInt32 block = segmentBlocks_[segment].first; remaining > 0u; block = nextBlock_[block] ) {
+      const Synapse begin = block * synapseBlockSize_;
+      for( Synapse synapse = begin; synapse < begin + synapseBlockSize_ and remaining > 0u; synapse++ ) {
+        if( synapses_[synapse].segment == FREE_SLOT ) continue;
+        remaining--;
+        fn( synapse );
+      }
+    }
+  }
+
+  /**
+   * Clear the permanence updates of a recycled synapse slot, for timeseries.
+   */
+  void resetSynapseUpdates_(const Synapse synapse);
 
 private:
-  std::vector<CellData>    cells_;
-  std::vector<SegmentData> segments_;
+  PagedVector<CellData>    cells_;
+  PagedVector<SegmentData> segments_;
   Segment     destroyedSegments_ = 0;
-  std::vector<SynapseData> synapses_;
-  Synapse     destroyedSynapses_ = 0; //number of destroyed synapses
+  PagedVector<SynapseData> synapses_;
+  Synapse     destroyedSynapses_ = 0; //number of destroyed synapses (and free slots in the arena)
   Permanence               connectedThreshold_; //TODO make const
   UInt32 iteration_ = 0;
 
   // Extra bookkeeping for faster computing of segment activity.
  
-  struct identity { constexpr size_t operator()( const CellIdx t ) const noexcept { return t; };   };	//TODO in c++20 use std::identity 
+  // For each presynaptic cell the synapses which receive input from it
+  // (potential and connected separately), and the segments of those synapses.
+  // This is a flat index: the lists are packed in presynapticSynapses_ /
+  // presynapticSegments_, so computeActivity only scans contiguous memory.
+  // Each list has some slack to grow into. A full list is moved to the end
+  // of the packed arrays with double capacity. The gaps are removed by
+  // compactPresynapticMap_() when they take more space than the lists.
+  struct PresynapticList {
+    size_t  offset   = 0u; //of the list in presynapticSynapses_ / presynapticSegments_
+    Synapse size     = 0u;
+    Synapse capacity = 0u;
+  };
+  PagedVector<PresynapticList> presynapticLists_; //indexed by `2 * presynapticCell + connected`
+  PagedVector<Synapse> presynapticSynapses_;
+  PagedVector<Segment> presynapticSegments_;
+  size_t presynapticGaps_ = 0u; //unused capacity of moved lists
+
+  const PresynapticList &presynapticList_(const CellIdx cell, const bool connected) const {
+    static const PresynapticList empty;
+    const size_t idx = 2u * cell + connected;
+    return idx < presynapticLists_.size() ? presynapticLists_[idx] : empty;
+  }
 
-  std::unordered_map<CellIdx, std::vector<Synapse>, identity> potentialSynapsesForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Synapse>, identity> connectedSynapsesForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Segment>, identity> potentialSegmentsForPresynapticCell_;
-  std::unordered_map<CellIdx, std::vector<Segment>, identity> connectedSegmentsForPresynapticCell_;
+  // Slots of destroyed segments and synapses, reused by new ones.
+  std::vector<Segment> freeSegments_;
+  std::vector<Synapse> freeSynapses_; //not used with the synapse arena, it reuses slots in the blocks
+  UInt32 layout_ = 0u; //incremented by compact()
+  UInt64 revision_ = 0u; //see revision()
+
+  // Synapse arena, see constructor. Block `b` are the slots
+  // [b * synapseBlockSize_, (b+1) * synapseBlockSize_) of synapses_.
+  // A segment's synapses are the occupied slots of its chain of blocks, the
+  // free slots in the chain are linked through SynapseData::segmentIndex_.
+  static const UInt32  NO_BLOCK  = std::numeric_limits<UInt32>::max();
+  static const Synapse NO_SLOT   = std::numeric_limits<Synapse>::max();
+  static const Segment FREE_SLOT = std::numeric_limits<Segment>::max(); //SynapseData::segment of a free slot
+  struct SegmentBlocks_ {
+    UInt32  first    = NO_BLOCK;
+    UInt32  last     = NO_BLOCK;
+    Synapse freeSlot = NO_SLOT; //first free slot in the blocks
+    Synapse size     = 0u; //number of synapses
+  };
+  SynapseIdx synapseBlockSize_ = 0;
+  std::vector<SegmentBlocks_> segmentBlocks_; //indexed by Segment
+  std::vector<UInt32> nextBlock_; //next block of the same segment, indexed by block
+  std::vector<UInt32> freeBlocks_;
 
   Segment nextSegmentOrdinal_ = 0;
   Synapse nextSynapseOrdinal_ = 0;
 
-  // These three members should be used when working with highly correlated
-  // data. The vectors store the permanence changes made by adaptSegment.
-  bool timeseries_;
-  std::vector<Permanence> previousUpdates_;
-  std::vector<Permanence> currentUpdates_;
+  Permanence clipPermanence_(const Permanence permanence) const { //into [min, max]
+    return std::max( std::min(permanence, maxPermanence), minPermanence );
+  }
+
+  // Fixed point permanences, see PermanenceStorage. The arrays are indexed
+  // by Synapse, the one of the storage type is grown with synapses_ by
+  // addSynapse_. permanenceSteps_ is the number of steps between
+  // minPermanence and maxPermanence, 0 with REAL32.
+  PermanenceStorage   permanenceStorage_ = PermanenceStorage::REAL32;
+  Permanence          permanenceSteps_   = 0.0f;
+  UInt32              connectedSteps_    = 0u; //connected threshold in steps
+  PagedVector<UInt16> permanences16_;
+  PagedVector<std::uint8_t>  permanences8_;
+  bool quantized_() const noexcept { return permanenceStorage_ != PermanenceStorage::REAL32; }
+  UInt32 toSteps_(const Permanence permanence) const { //of a clipped permanence
+    return static_cast<UInt32>( permanence * permanenceSteps_ + 0.5f );
+  }
+  Permanence fromSteps_(const UInt32 steps) const {
+    return static_cast<Permanence>(steps) / permanenceSteps_;
+  }
+  Int32  deltaSteps_(const Permanence delta) const; //whole steps, at least one
+  UInt32 steps_(const Synapse synapse) const {
+    return permanenceStorage_ == PermanenceStorage::UINT8 ? permanences8_[synapse] : permanences16_[synapse];
+  }
+  void setSteps_(const Synapse synapse, const UInt32 steps); //and SynapseData::permanence
+  bool connected_(const Synapse synapse) const {
+    if( not quantized_() ) return synapses_[synapse].permanence >= connectedThreshold_;
+    return steps_(synapse) >= connectedSteps_;
+  }
+  template<typename Steps>
+  void adaptQuantizedPermanences_(PagedVector<Steps> &permanences,
+                                  const Segment segment,
+                                  const SDR &inputs,
+                                  const Permanence increment,
+                                  const Permanence decrement,
+                                  const bool pruneZeroSynapses,
+                                  std::vector<SynapseUpdate> &deferred);
+
+  // These members should be used when working with highly correlated data.
+  // They store the permanence changes made by adaptSegment in the current
+  // and in the previous compute step, for each synapse (kept the size of
+  // synapses_). An entry is only valid for the step in which it was written,
+  // so that a new step does not clear them: the cost is proportional to the
+  // adapted synapses.
+  bool timeseries_ = false;
+  bool orderedSynapses_ = true; //see setOrderedSynapses
+  struct TimeseriesUpdate_ {
+    Permanence current;  //update in the step `step`
+    Permanence previous; //update in the step before `step`
+    UInt32     step;
+  };
+  PagedVector<TimeseriesUpdate_> timeseriesUpdates_;
+  UInt32 timeseriesStep_ = 2u; //0 and step-1 of new entries are never valid
+  void advanceTimeseriesStep_(const UInt32 steps);
+
+  // Index of the least used cells, see indexLeastUsedCells. For each group
+  // the fewest segments on a cell, and a bit mask of the cells which have
+  // them. The minimum is INVALID_COUNT when it must be recomputed.
+  void segmentCountChanged_(const CellIdx cell, const size_t before, const size_t after);
+  void updateLeastUsedCells_(const CellIdx group);
+  CellIdx cellGroupSize_ = 0u;
+  size_t  wordsPerGroup_ = 0u;
+  std::vector<UInt32> leastUsedCount_;
+  std::vector<UInt64> leastUsedBits_;
+
+  std::vector<SynapseUpdate> adaptUpdates_; //scratch buffer of adaptSegment
+
+  SegmentEviction segmentEviction_ = SegmentEviction::LRU;
+  struct EvictionCandidate_ {
+    Real64  key; //smallest is evicted first
+    Segment ordinal;
+    Segment segment;
+  };
+  void evictSegments_(const CellIdx cell, const size_t numEvicted);
+  std::vector<EvictionCandidate_> evictionCandidates_; //scratch buffer of createSegment
+
+  size_t createSynapses_(const Segment segment,
+                         const std::vector<CellIdx> &presynapticCells,
+                         const Permanence *permanences, //or nullptr, then all have permanence
+                         const Permanence permanence,
+                         const size_t maxNewSynapses);
+  //scratch buffers of createSynapses
+  std::vector<std::pair<CellIdx, UInt32>> growTable_;
+  std::vector<Byte>   growSkip_;
+
+  //for multithreaded computeActivity
+  std::shared_ptr<ThreadPool> threadPool_;
+  std::vector<std::vector<SynapseIdx>> threadActivity_; //per task counts, all zero between calls
+  std::vector<std::vector<Segment>>    threadTouched_;  //per task segments with a nonzero count
 
   //for prune statistics
   Synapse prunedSyns_ = 0; //how many synapses have been removed?
@@ -745,6 +1539,18 @@ private:
   //for listeners
   UInt32 nextEventToken_;
   std::map<UInt32, ConnectionsEventHandler *> eventHandlers_;
+  std::vector<ConnectionsEventHandler *> immediateHandlers_; //in order of the tokens
+  std::vector<ConnectionsEventHandler *> batchHandlers_;
+  std::vector<ConnectionsEvent> eventQueue_;
+
+  // Dispatch an event. Without subscribers this is one well predicted branch.
+  void notify_(const ConnectionsEvent::Type type, const UInt32 handle,
+               const Permanence permanence = 0.0f) {
+    if( eventHandlers_.empty() ) return;
+    dispatchEvent_(type, handle, permanence);
+  }
+  void dispatchEvent_(const ConnectionsEvent::Type type, const UInt32 handle,
+                      const Permanence permanence);
 }; // end class Connections
 
 } // end namespace htm
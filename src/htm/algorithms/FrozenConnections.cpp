@@ -0,0 +1,107 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of FrozenConnections
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include <htm/algorithms/FrozenConnections.hpp>
+#include <htm/algorithms/SegmentCounting.hpp>
+#include <htm/utils/Log.hpp>
+
+using std::vector;
+using namespace htm;
+using htm::connections_::countSegments;
+
+
+FrozenConnections::FrozenConnections(const Connections &connections)
+  : numSegments_(connections.segmentFlatListLength()),
+    layout_(connections.layout_),
+    revision_(connections.revision()) {
+  // The presynaptic cells can be outside of the Connections' cells (eg the
+  // inputs of the SP), the presynaptic map grows as needed.
+  const size_t numCells = (connections.presynapticLists_.size() + 1u) / 2u;
+
+  size_t total = 0u;
+  for(CellIdx cell = 0; cell < numCells; cell++) {
+    total += connections.presynapticList_(cell, true).size;
+    total += connections.presynapticList_(cell, false).size;
+  }
+  NTA_CHECK(total < std::numeric_limits<UInt32>::max())
+    << "FrozenConnections: too many synapses " << total;
+
+  offsets_.reserve(2u * numCells + 1u);
+  segments_.reserve(total);
+  for(CellIdx cell = 0; cell < numCells; cell++) {
+    for(const bool connected : {true, false}) {
+      offsets_.push_back(static_cast<UInt32>(segments_.size()));
+      const auto &list = connections.presynapticList_(cell, connected);
+      connections.presynapticSegments_.forEachRun(list.offset, list.size,
+          [&](const Segment *run, const size_t n) { segments_.insert(segments_.end(), run, run + n); });
+    }
+  }
+  offsets_.push_back(static_cast<UInt32>(segments_.size()));
+
+  cellForSegment_.resize(numSegments_);
+  for(Segment segment = 0; segment < numSegments_; segment++) {
+    cellForSegment_[segment] = connections.segments_[segment].cell;
+  }
+  segmentsOnCell_.resize(connections.cells_.size());
+  vector<Segment> sorted;
+  for(CellIdx cell = 0; cell < segmentsOnCell_.size(); cell++) {
+    const auto &segments = connections.cells_[cell].segments;
+    segmentsOnCell_[cell] = static_cast<SegmentIdx>(segments.size());
+    sorted.insert(sorted.end(), segments.begin(), segments.end());
+  }
+  std::sort(sorted.begin(), sorted.end(), [&](const Segment a, const Segment b) {
+    return connections.compareSegments(a, b); });
+  segmentOrder_.resize(numSegments_);
+  for(Segment rank = 0; rank < sorted.size(); rank++) {
+    segmentOrder_[sorted[rank]] = rank;
+  }
+}
+
+
+void FrozenConnections::computeActivity(SegmentActivity &activity,
+                                        const vector<CellIdx> &activePresynapticCells,
+                                        const bool potential) const {
+  activity.reset( numSegments_, layout_, potential );
+  const size_t numCells = this->numCells();
+  const Segment *segments = segments_.data();
+
+  // Iterate through all connected synapses.
+  SynapseIdx *connectedCounts = activity.numActiveConnected.data();
+  for( const auto cell : activePresynapticCells ) {
+    if( cell >= numCells ) continue;
+    countSegments<true>( segments + offsets_[2u * cell], offsets_[2u * cell + 1u] - offsets_[2u * cell],
+                         connectedCounts, &activity.touched );
+  }
+
+  // Iterate through all potential synapses.
+  if( potential ) {
+    activity.copyConnectedToPotential();
+    SynapseIdx *potentialCounts = activity.numActivePotential.data();
+    for( const auto cell : activePresynapticCells ) {
+      if( cell >= numCells ) continue;
+      countSegments<true>( segments + offsets_[2u * cell + 1u], offsets_[2u * cell + 2u] - offsets_[2u * cell + 1u],
+                           potentialCounts, &activity.touched );
+    }
+  }
+}
@@ -0,0 +1,139 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Definitions for the FrozenConnections class in C++
+ */
+
+#ifndef NTA_FROZEN_CONNECTIONS_HPP
+#define NTA_FROZEN_CONNECTIONS_HPP
+
+#include <vector>
+
+#include <htm/algorithms/Connections.hpp>
+#include <htm/types/Types.hpp>
+
+namespace htm {
+
+/**
+ * FrozenConnections, a read-only snapshot of a Connections for inference.
+ *
+ * @b Description
+ * Holds only what computeActivity needs: for each presynaptic cell the
+ * segments of its connected synapses, followed by the segments of its
+ * potential (not connected) synapses, in one compressed sparse row (CSR)
+ * array with 32-bit offsets. This takes about 4 bytes per synapse, and
+ * computeActivity scans it sequentially. Besides it keeps the cell and the
+ * sort order of each segment and the number of segments on each cell (8
+ * bytes per segment and 2 bytes per cell), so that the TM can infer from the
+ * snapshot alone.
+ *
+ * The segments keep their handles from the Connections, and the results are
+ * identical to Connections::computeActivity on the Connections it was made
+ * from, as long as that is not changed (see revision()).
+ *
+ * The snapshot is immutable, computeActivity is const and writes only into
+ * the caller's SegmentActivity. One snapshot can be shared by any number of
+ * threads without locking, each with its own SegmentActivity.
+ *
+ * Example Usage:
+ *    FrozenConnections frozen(connections);
+ *    SegmentActivity activity;
+ *    frozen.computeActivity(activity, activeCells);
+ */
+class FrozenConnections {
+public:
+  FrozenConnections() {}
+
+  /**
+   * Take a snapshot of the connected and potential synapses.
+   */
+  explicit FrozenConnections(const Connections &connections);
+
+  /**
+   * Compute the segment excitations for a vector of active presynaptic
+   * cells, see Connections::computeActivity. Does not do the per step
+   * bookkeeping of the Connections (no learning), see
+   * Connections::startComputeStep.
+   *
+   * @param activity Output, reused between calls.
+   * @param activePresynapticCells Active cells in the input.
+   * @param potential Also count the potential synapses (default true).
+   */
+  void computeActivity(SegmentActivity &activity,
+                       const std::vector<CellIdx> &activePresynapticCells,
+                       const bool potential = true) const;
+
+  /**
+   * Connections::revision() of the Connections at the time of the snapshot.
+   * The snapshot is up to date while the Connections has the same revision.
+   */
+  UInt64 revision() const noexcept { return revision_; }
+
+  /**
+   * Number of presynaptic cells with synapses, the other cells are ignored
+   * by computeActivity.
+   */
+  size_t numCells() const noexcept { return offsets_.empty() ? 0u : (offsets_.size() - 1u) / 2u; }
+
+  size_t numSynapses() const noexcept { return segments_.size(); }
+
+  /**
+   * Length of the SegmentActivity buffers, the Connections::segmentFlatListLength.
+   */
+  size_t segmentFlatListLength() const noexcept { return numSegments_; }
+
+  /**
+   * See Connections::cellForSegment.
+   */
+  CellIdx cellForSegment(const Segment segment) const {
+    NTA_ASSERT(segment < cellForSegment_.size());
+    return cellForSegment_[segment];
+  }
+
+  /**
+   * See Connections::compareSegments.
+   */
+  bool compareSegments(const Segment a, const Segment b) const {
+    NTA_ASSERT(a < segmentOrder_.size() and b < segmentOrder_.size());
+    return segmentOrder_[a] < segmentOrder_[b];
+  }
+
+  /**
+   * See Connections::numSegments(cell).
+   */
+  size_t numSegments(const CellIdx cell) const {
+    NTA_ASSERT(cell < segmentsOnCell_.size());
+    return segmentsOnCell_[cell];
+  }
+
+private:
+  // Synapses of cell `c`: connected [offsets_[2c], offsets_[2c+1]), potential
+  // [offsets_[2c+1], offsets_[2c+2]).
+  std::vector<UInt32>  offsets_;
+  std::vector<Segment> segments_;
+  std::vector<CellIdx>    cellForSegment_; //of destroyed segments undefined
+  std::vector<Segment>    segmentOrder_;   //rank in the order of compareSegments
+  std::vector<SegmentIdx> segmentsOnCell_;
+  size_t numSegments_ = 0u;
+  UInt32 layout_      = 0u;
+  UInt64 revision_    = 0u;
+};
+
+} // end namespace htm
+
+#endif // NTA_FROZEN_CONNECTIONS_HPP
@@ -0,0 +1,61 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Internal, the inner loop of computeActivity shared by Connections and
+ * FrozenConnections.
+ */
+
+#ifndef NTA_SEGMENT_COUNTING_HPP
+#define NTA_SEGMENT_COUNTING_HPP
+
+#include <vector>
+
+#include <htm/algorithms/Connections.hpp>
+
+namespace htm {
+namespace connections_ {
+
+  /**
+   * Increment the counts of the segments, optionally remember the segments
+   * which had count zero. The touched list is appended without branching.
+   */
+  template<bool TRACK_TOUCHED>
+  inline void countSegments(const Segment *segments, const size_t numSegments,
+                            SynapseIdx *counts, std::vector<Segment> *touched) {
+    if(not TRACK_TOUCHED) {
+      for(size_t i = 0; i < numSegments; i++) {
+        ++counts[segments[i]];
+      }
+      return;
+    }
+    size_t numTouched = touched->size();
+    touched->resize(numTouched + numSegments);
+    Segment *out = touched->data();
+    for(size_t i = 0; i < numSegments; i++) {
+      const Segment segment = segments[i];
+      const SynapseIdx count = counts[segment];
+      out[numTouched] = segment;
+      numTouched += (count == 0);
+      counts[segment] = static_cast<SynapseIdx>(count + 1);
+    }
+    touched->resize(numTouched);
+  }
+
+} // end namespace connections_
+} // end namespace htm
+#endif // NTA_SEGMENT_COUNTING_HPP
@@ -23,6 +23,8 @@
 #include <algorithm>
 #include <iterator> //begin()
 #include <cmath> //fmod
+#include <cstring> //memcpy
+#include <numeric> //iota
 
 #include <htm/algorithms/SpatialPooler.hpp>
 #include <htm/utils/Topology.hpp>
@@ -129,6 +131,11 @@ void SpatialPooler::setPotentialPct(Real potentialPct) {
 bool SpatialPooler::getGlobalInhibition() const { return globalInhibition_; }
 
 void SpatialPooler::setGlobalInhibition(bool globalInhibition) {
+  if (boostFactorsStale_) {
+    boostFactors_ = currentBoostFactors_();
+    boostFactorsStale_ = false;
+  }
+  normalizeDutyCycles_();
   globalInhibition_ = globalInhibition;
 }
 
@@ -195,6 +202,17 @@ void SpatialPooler::setUpdatePeriod(UInt updatePeriod) {
   updatePeriod_ = updatePeriod;
 }
 
+bool SpatialPooler::getLazyDutyCycles() const { return lazyDutyCycles_; }
+
+void SpatialPooler::setLazyDutyCycles(bool lazyDutyCycles) {
+  if (boostFactorsStale_) {
+    boostFactors_ = currentBoostFactors_();
+    boostFactorsStale_ = false;
+  }
+  normalizeDutyCycles_();
+  lazyDutyCycles_ = lazyDutyCycles;
+}
+
 Real SpatialPooler::getSynPermActiveInc() const { return synPermActiveInc_; }
 
 void SpatialPooler::setSynPermActiveInc(Real synPermActiveInc) {
@@ -237,27 +255,33 @@ void SpatialPooler::setMinPctOverlapDutyCycles(Real minPctOverlapDutyCycles) {
 }
 
 void SpatialPooler::getBoostFactors(Real boostFactors[]) const { //TODO make vector
-  copy(boostFactors_.begin(), boostFactors_.end(), boostFactors);
+  const auto current = currentBoostFactors_();
+  copy(current.begin(), current.end(), boostFactors);
 }
 
 void SpatialPooler::setBoostFactors(Real boostFactors[]) {
+  boostFactorsStale_ = false;
   boostFactors_.assign(&boostFactors[0], &boostFactors[numColumns_]);
 }
 
 void SpatialPooler::getOverlapDutyCycles(Real overlapDutyCycles[]) const {
-  copy(overlapDutyCycles_.begin(), overlapDutyCycles_.end(), overlapDutyCycles);
+  const auto current = decayedDutyCycles_(overlapDutyCycles_);
+  copy(current.begin(), current.end(), overlapDutyCycles);
 }
 
 void SpatialPooler::setOverlapDutyCycles(const Real overlapDutyCycles[]) {
+  normalizeDutyCycles_();
   overlapDutyCycles_.assign(&overlapDutyCycles[0],
                             &overlapDutyCycles[numColumns_]);
 }
 
 void SpatialPooler::getActiveDutyCycles(Real activeDutyCycles[]) const {
-  copy(activeDutyCycles_.begin(), activeDutyCycles_.end(), activeDutyCycles);
+  const auto current = decayedDutyCycles_(activeDutyCycles_);
+  copy(current.begin(), current.end(), activeDutyCycles);
 }
 
 void SpatialPooler::setActiveDutyCycles(const Real activeDutyCycles[]) {
+  normalizeDutyCycles_();
   activeDutyCycles_.assign(&activeDutyCycles[0],
                            &activeDutyCycles[numColumns_]);
 }
@@ -273,6 +297,7 @@ void SpatialPooler::setMinOverlapDutyCycles(const Real minOverlapDutyCycles[]) {
 }
 
 void SpatialPooler::getPotential(UInt column, UInt potential[]) const {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   NTA_ASSERT(column < numColumns_);
   std::fill( potential, potential + numInputs_, 0 );
   const auto &synapses = connections_.synapsesForSegment( column );
@@ -283,6 +308,7 @@ void SpatialPooler::getPotential(UInt column, UInt potential[]) const {
 }
 
 void SpatialPooler::setPotential(UInt column, const UInt potential[]) {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   NTA_ASSERT(column < numColumns_);
 
   // Remove all existing synapses.
@@ -300,6 +326,7 @@ void SpatialPooler::setPotential(UInt column, const UInt potential[]) {
 }
 
 void SpatialPooler::getPermanence(UInt column, Real permanences[]) const {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   NTA_ASSERT(column < numColumns_);
   std::fill( permanences, permanences + numInputs_, 0.0f );
   const auto &synapses = connections_.synapsesForSegment( column );
@@ -310,6 +337,7 @@ void SpatialPooler::getPermanence(UInt column, Real permanences[]) const {
 }
 
 void SpatialPooler::setPermanence(UInt column, const Real permanences[]) {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   NTA_ASSERT(column < numColumns_);
 
 #ifndef NDEBUG // If DEBUG mode ...
@@ -340,6 +368,7 @@ void SpatialPooler::setPermanence(UInt column, const Real permanences[]) {
 
 void SpatialPooler::getConnectedSynapses(UInt column,
                                          UInt connectedSynapses[]) const {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   NTA_ASSERT(column < numColumns_);
   std::fill( connectedSynapses, connectedSynapses + numInputs_, 0 );
 
@@ -352,6 +381,7 @@ void SpatialPooler::getConnectedSynapses(UInt column,
 }
 
 void SpatialPooler::getConnectedCounts(UInt connectedCounts[]) const {
+  NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler has no synapses";
   for(UInt seg = 0; seg < numColumns_; seg++) { //in SP each column = 1 cell with 1 segment only.
     const auto &segment = connections_.dataForSegment( seg );
     connectedCounts[ seg ] = segment.numConnected; //TODO numConnected only used here, rm from SegmentData and compute for each segment.synapses?
@@ -363,6 +393,21 @@ const vector<Real> &SpatialPooler::getBoostedOverlaps() const {
   return boostedOverlaps_;
 }
 
+namespace {
+  /**
+   * Seed of the random generator of a column for the parallel initialize,
+   * from one seed drawn for all the columns. Mixed with splitmix64, so that
+   * the generators of neighboring columns are not correlated.
+   */
+  UInt64 columnSeed(const UInt32 seed, const UInt column) {
+    UInt64 z = (UInt64(seed) << 32u) + column + 0x9E3779B97F4A7C15ull;
+    z = (z ^ (z >> 30u)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27u)) * 0x94D049BB133111EBull;
+    z ^= z >> 31u;
+    return z == 0u ? 1u : z; //Random(0) would be seeded randomly
+  }
+}
+
 void SpatialPooler::initialize(
     const vector<UInt>& inputDimensions, 
     const vector<UInt>& columnDimensions,
@@ -429,23 +474,46 @@ void SpatialPooler::initialize(
   activeDutyCycles_.assign(numColumns_, 0);
   minOverlapDutyCycles_.assign(numColumns_, 0.0);
   boostFactors_.assign(numColumns_, 1.0); //1 is neutral value for boosting
+  boostFactorsStale_ = false;
+  dutyCycleDecay_ = 1.0;
   boostedOverlaps_.resize(numColumns_);
 
   inhibitionRadius_ = 0;
 
   connections_.initialize(numColumns_, synPermConnected_);
-  for (Size i = 0; i < numColumns_; ++i) {
-    connections_.createSegment( (CellIdx)i , 1 /* max segments per cell is fixed for SP to 1 */);
-
-    // Note: initMapPotential_ & initPermanence_ return dense arrays.
-    vector<UInt> potential = initMapPotential_((UInt)i, wrapAround_);
-    vector<Real> perm = initPermanence_(potential, initConnectedPct_);
-    for(UInt presyn = 0; presyn < numInputs_; presyn++) {
-      if( potential[presyn] )
-        connections_.createSynapse( (Segment)i, presyn, perm[presyn] );
+  connections_.setThreadPool(threadPool_);
+  frozenConnections_.reset();
+  const auto addColumn = [&](const UInt column, const vector<UInt> &pool, const vector<Real> &permanences) {
+    connections_.createSegment( (CellIdx)column , 1 /* max segments per cell is fixed for SP to 1 */);
+    connections_.createSynapses( (Segment)column, pool, permanences );
+    connections_.raisePermanencesToThreshold( (Segment)column, stimulusThreshold_ );
+  };
+  if (threadPool_ == nullptr) {
+    vector<UInt> pool;
+    vector<Real> permanences;
+    for (UInt i = 0; i < numColumns_; ++i) {
+      initColumnSynapses_(i, rng_, pool, permanences);
+      addColumn(i, pool, permanences);
+    }
+  }
+  else {
+    // The columns are chosen in parallel a block at a time, then added to the
+    // connections serially in their order.
+    const UInt32 blockSeed = rng_.getUInt32();
+    const UInt BLOCK = 1024u;
+    vector<vector<UInt>> pools(std::min(BLOCK, numColumns_));
+    vector<vector<Real>> permanences(pools.size());
+    for (UInt begin = 0; begin < numColumns_; begin += BLOCK) {
+      const UInt end = std::min(begin + BLOCK, numColumns_);
+      threadPool_->parallelFor(end - begin, [&](const size_t task, const UInt) {
+        const UInt column = begin + static_cast<UInt>(task);
+        Random rng(columnSeed(blockSeed, column));
+        initColumnSynapses_(column, rng, pools[task], permanences[task]);
+      });
+      for (UInt i = begin; i < end; i++) {
+        addColumn(i, pools[i - begin], permanences[i - begin]);
+      }
     }
-
-    connections_.raisePermanencesToThreshold( (Segment)i, stimulusThreshold_ );
   }
 
   updateInhibitionRadius_();
@@ -457,12 +525,32 @@ void SpatialPooler::initialize(
 }
 
 
-const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool learn, SDR &active) {
+void SpatialPooler::setThreadPool(const std::shared_ptr<ThreadPool> &pool) {
+  threadPool_ = pool;
+  connections_.setThreadPool(pool);
+}
+
+
+void SpatialPooler::freezeConnections() {
+  frozenConnections_ = std::make_shared<const FrozenConnections>(connections_);
+  connections_ = Connections(0u, synPermConnected_); //releases the memory
+  connections_.setThreadPool(threadPool_);
+}
+
+
+const vector<SynapseIdx> &SpatialPooler::compute(const SDR &input, const bool learn, SDR &active) {
   input.reshape(  inputDimensions_ );
   active.reshape( columnDimensions_ );
+  NTA_CHECK(not (learn and isFrozen())) << "SP: a frozen SpatialPooler can not learn";
   updateBookeepingVars_(learn);
 
-  const auto& overlaps = connections_.computeActivity(input.getSparse(), learn);
+  if( isFrozen() ) {
+    frozenConnections_->computeActivity(overlaps_, input.getSparse(), false);
+  }
+  else {
+    connections_.computeActivity(overlaps_, input.getSparse(), learn, false /* potential synapses not needed */);
+  }
+  const auto& overlaps = overlaps_.numActiveConnected;
 
   boostOverlaps_(overlaps, boostedOverlaps_);
 
@@ -478,7 +566,9 @@ const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool lea
     adaptSynapses_(input, active);
     updateDutyCycles_(overlaps, active);
     bumpUpWeakColumns_();
-    updateBoostFactors_();
+    if (not lazyDecay_()) { // lazy boost factors are computed in boostOverlaps_
+      updateBoostFactors_();
+    }
     if (isUpdateRound_()) {
       updateInhibitionRadius_();
       updateMinDutyCycles_();
@@ -489,12 +579,42 @@ const vector<SynapseIdx> SpatialPooler::compute(const SDR &input, const bool lea
 }
 
 
+const vector<SynapseIdx> &SpatialPooler::infer(const SDR &input, SDR &active, InferenceState &state) const {
+  NTA_CHECK(isFrozen()) << "SP: infer requires freezeConnections";
+  NTA_CHECK(input.size == numInputs_) << "SP: invalid input size " << input.size << " vs. " << numInputs_;
+  active.reshape( columnDimensions_ );
+
+  frozenConnections_->computeActivity(state.overlaps, input.getSparse(), false);
+  const auto &overlaps = state.overlaps.numActiveConnected;
+  state.boostedOverlaps.resize(numColumns_);
+  boostOverlaps_(overlaps, state.boostedOverlaps);
+
+  auto &activeVector = active.getSparse();
+  inhibitColumns_(state.boostedOverlaps, activeVector);
+  sort( activeVector.begin(), activeVector.end() );
+  active.setSparse( activeVector );
+  return overlaps;
+}
+
+
 void SpatialPooler::boostOverlaps_(const vector<SynapseIdx> &overlaps, //TODO use Eigen sparse vector here
                                    vector<Real> &boosted) const {
   if(boostStrength_ < htm::Epsilon) { //boost ~ 0.0, we can skip these computations, just copy the data
     boosted.assign(overlaps.begin(), overlaps.end());
     return;
   }
+  if (boostFactorsStale_) {
+    // Boost factors of the columns without overlap are not needed.
+    for (UInt i = 0; i < numColumns_; i++) {
+      if (overlaps[i] == 0) {
+        boosted[i] = 0.0f;
+        continue;
+      }
+      const Real activeDutyCycle = static_cast<Real>(activeDutyCycles_[i] * dutyCycleDecay_);
+      boosted[i] = overlaps[i] * exp((localAreaDensity_ - activeDutyCycle) * boostStrength_);
+    }
+    return;
+  }
   for (UInt i = 0; i < numColumns_; i++) {
     boosted[i] = overlaps[i] * boostFactors_[i];
   }
@@ -521,6 +641,11 @@ UInt SpatialPooler::initMapColumn_(UInt column) const {
 
 
 vector<UInt> SpatialPooler::initMapPotential_(UInt column, bool wrapAround) {
+  return VectorHelpers::sparseToBinary<UInt>(initPotentialPool_(column, wrapAround, rng_), numInputs_);
+}
+
+
+vector<UInt> SpatialPooler::initPotentialPool_(UInt column, bool wrapAround, Random &rng) const {
   NTA_ASSERT(column < numColumns_);
   const UInt centerInput = initMapColumn_(column);
 
@@ -537,9 +662,24 @@ vector<UInt> SpatialPooler::initMapPotential_(UInt column, bool wrapAround) {
   }
 
   const UInt numPotential = (UInt)round(columnInputs.size() * potentialPct_);
-  const auto selectedInputs = rng_.sample<UInt>(columnInputs, numPotential);
-  const vector<UInt> potential = VectorHelpers::sparseToBinary<UInt>(selectedInputs, numInputs_);
-  return potential;
+  auto selectedInputs = rng.sample<UInt>(columnInputs, numPotential);
+  sort(selectedInputs.begin(), selectedInputs.end());
+  return selectedInputs;
+}
+
+
+void SpatialPooler::initColumnSynapses_(UInt column, Random &rng,
+                                        vector<UInt> &pool, vector<Real> &permanences) const {
+  pool = initPotentialPool_(column, wrapAround_, rng);
+  // Same draws as initPermanence_, in the order of the inputs.
+  permanences.resize(pool.size());
+  for (Size i = 0; i < pool.size(); i++) {
+    if (rng.getReal64() <= initConnectedPct_) {
+      permanences[i] = rng.realRange(synPermConnected_, maxPermanence);
+    } else {
+      permanences[i] = rng.realRange(minPermanence, synPermConnected_);
+    }
+  }
 }
 
 
@@ -593,6 +733,7 @@ void SpatialPooler::updateInhibitionRadius_() {
 
 
 void SpatialPooler::updateMinDutyCycles_() {
+  normalizeDutyCycles_();
   if (globalInhibition_ ||
       inhibitionRadius_ >=
           *max_element(columnDimensions_.begin(), columnDimensions_.end())) {
@@ -612,23 +753,79 @@ void SpatialPooler::updateMinDutyCyclesGlobal_() {
 }
 
 
-void SpatialPooler::updateMinDutyCyclesLocal_() {
-  for (UInt i = 0; i < numColumns_; i++) {
-    Real maxActiveDuty = 0.0f;
-    Real maxOverlapDuty = 0.0f;
-    if (wrapAround_) {
-     for(auto column : WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-      maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-      maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
-     }
-    } else {
-     for(auto column: Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-      maxActiveDuty = max(maxActiveDuty, activeDutyCycles_[column]);
-      maxOverlapDuty = max(maxOverlapDuty, overlapDutyCycles_[column]);
+namespace {
+  /**
+   * Reduces the windows of `window` consecutive elements of `in` with the
+   * associative operation op: out[i] = op(in[i], ..., in[i + window - 1]).
+   * Linear time for any window size (van Herk / Gil-Werman): each window is
+   * the suffix of one block of `window` elements and the prefix of the next.
+   */
+  template<typename T, typename Op>
+  void slidingWindow(const vector<T> &in, const size_t window, vector<T> &out,
+                     vector<T> &prefix, vector<T> &suffix, Op op) {
+    const size_t n = in.size();
+    prefix.resize(n);
+    suffix.resize(n);
+    for(size_t i = 0u; i < n; i++) {
+      prefix[i] = (i % window == 0u) ? in[i] : op(prefix[i - 1u], in[i]);
+    }
+    for(size_t i = n; i-- > 0u; ) {
+      suffix[i] = (i + 1u == n or (i + 1u) % window == 0u) ? in[i] : op(in[i], suffix[i + 1u]);
+    }
+    out.resize(n - window + 1u);
+    for(size_t i = 0u; i < out.size(); i++) {
+      out[i] = (i % window == 0u) ? suffix[i] : op(suffix[i], prefix[i + window - 1u]);
+    }
+  }
+
+  /**
+   * Reduces the neighborhood of every column with op, in place. The
+   * neighborhoods are those of Neighborhood (the columns beyond the edges
+   * count as `identity`) or of WrappingNeighborhood. They are boxes, so the
+   * reduction is done one dimension after the other, with sliding windows,
+   * in O(columns * dimensions) for any radius.
+   */
+  template<typename T, typename Op>
+  void reduceNeighborhoods(vector<T> &data, const vector<UInt> &dimensions,
+                           const UInt radius, const bool wrap, const T identity, Op op) {
+    vector<T> line, out, prefix, suffix;
+    size_t stride = data.size();
+    for(const UInt dim : dimensions) {
+      stride /= dim;
+      const bool wholeLine = wrap and 2u * size_t(radius) + 1u >= dim;
+      const size_t r = std::min<size_t>(radius, dim - 1u);
+      for(size_t outer = 0u; outer < data.size(); outer += dim * stride) {
+        for(size_t base = outer; base < outer + stride; base++) {
+          if( wholeLine ) {
+            T all = data[base];
+            for(size_t i = 1u; i < dim; i++)
+              all = op(all, data[base + i * stride]);
+            for(size_t i = 0u; i < dim; i++)
+              data[base + i * stride] = all;
+            continue;
+          }
+          line.resize(dim + 2u * r);
+          for(size_t k = 0u; k < line.size(); k++) {
+            if( wrap )
+              line[k] = data[base + ((k + dim - r) % dim) * stride];
+            else
+              line[k] = (k >= r and k < r + dim) ? data[base + (k - r) * stride] : identity;
+          }
+          slidingWindow(line, 2u * r + 1u, out, prefix, suffix, op);
+          for(size_t i = 0u; i < dim; i++)
+            data[base + i * stride] = out[i];
+        }
       }
     }
+  }
+}
 
-    minOverlapDutyCycles_[i] = maxOverlapDuty * minPctOverlapDutyCycles_;
+void SpatialPooler::updateMinDutyCyclesLocal_() {
+  vector<Real> maxOverlapDuty(overlapDutyCycles_);
+  reduceNeighborhoods(maxOverlapDuty, columnDimensions_, inhibitionRadius_, wrapAround_, 0.0f,
+                      [](const Real a, const Real b) { return max(a, b); });
+  for (UInt i = 0; i < numColumns_; i++) {
+    minOverlapDutyCycles_[i] = maxOverlapDuty[i] * minPctOverlapDutyCycles_;
   }
 }
 
@@ -636,6 +833,26 @@ void SpatialPooler::updateMinDutyCyclesLocal_() {
 void SpatialPooler::updateDutyCycles_(const vector<SynapseIdx> &overlaps,
                                       SDR &active) {
 
+  const UInt period = std::min(dutyCyclePeriod_, iterationNum_);
+
+  if (lazyDecay_()) {
+    // Instead of decaying every duty cycle, decay their common factor and
+    // scale the increment up by it.
+    dutyCycleDecay_ *= (period - 1) / static_cast<Real64>(period);
+    if (dutyCycleDecay_ < 1.0e-6) { // keep the stored duty cycles in range
+      normalizeDutyCycles_();
+    }
+    const Real increment = static_cast<Real>(1.0 / (period * dutyCycleDecay_));
+    for (UInt i = 0; i < numColumns_; i++) {
+      if( overlaps[i] != 0 )
+        overlapDutyCycles_[i] += increment;
+    }
+    for(const auto idx : active.getSparse())
+      activeDutyCycles_[idx] += increment;
+    boostFactorsStale_ = true;
+    return;
+  }
+
   // Turn the overlaps array into an SDR. Convert directly to flat-sparse to
   // avoid copies and  type convertions.
   SDR newOverlap({ numColumns_ });
@@ -646,8 +863,6 @@ void SpatialPooler::updateDutyCycles_(const vector<SynapseIdx> &overlaps,
   }
   newOverlap.setSparse( overlapsSparseVec );
 
-  const UInt period = std::min(dutyCyclePeriod_, iterationNum_);
-
   updateDutyCyclesHelper_(overlapDutyCycles_, newOverlap, period);
   updateDutyCyclesHelper_(activeDutyCycles_, active, period);
 }
@@ -710,8 +925,9 @@ void SpatialPooler::adaptSynapses_(const SDR &input,
 
 
 void SpatialPooler::bumpUpWeakColumns_() {
+  const Real64 decay = dutyCycleDecay_;
   for (UInt i = 0; i < numColumns_; i++) {
-    if (overlapDutyCycles_[i] >= minOverlapDutyCycles_[i]) {
+    if (overlapDutyCycles_[i] * decay >= minOverlapDutyCycles_[i]) {
       continue;
     }
     connections_.bumpSegment( i, synPermBelowStimulusInc_ );
@@ -760,6 +976,37 @@ void applyBoosting_(const UInt i,
 }
 
 
+void SpatialPooler::normalizeDutyCycles_() {
+  if (dutyCycleDecay_ == 1.0) return;
+  overlapDutyCycles_ = decayedDutyCycles_(overlapDutyCycles_);
+  activeDutyCycles_  = decayedDutyCycles_(activeDutyCycles_);
+  dutyCycleDecay_ = 1.0;
+}
+
+
+vector<Real> SpatialPooler::decayedDutyCycles_(const vector<Real> &dutyCycles) const {
+  if (dutyCycleDecay_ == 1.0) return dutyCycles;
+  vector<Real> decayed(dutyCycles.size());
+  for (Size i = 0; i < dutyCycles.size(); i++) {
+    decayed[i] = static_cast<Real>(dutyCycles[i] * dutyCycleDecay_);
+  }
+  return decayed;
+}
+
+
+vector<Real> SpatialPooler::currentBoostFactors_() const {
+  if (not boostFactorsStale_ or boostStrength_ < htm::Epsilon) {
+    return boostFactors_;
+  }
+  const vector<Real> activeDutyCycles = decayedDutyCycles_(activeDutyCycles_);
+  vector<Real> boostFactors(numColumns_);
+  for (UInt i = 0; i < numColumns_; ++i) {
+    applyBoosting_(i, localAreaDensity_, activeDutyCycles, boostStrength_, boostFactors);
+  }
+  return boostFactors;
+}
+
+
 void SpatialPooler::updateBoostFactorsGlobal_() {
   const Real targetDensity = localAreaDensity_;
   
@@ -770,23 +1017,15 @@ void SpatialPooler::updateBoostFactorsGlobal_() {
 
 
 void SpatialPooler::updateBoostFactorsLocal_() {
-  for (UInt i = 0; i < numColumns_; ++i) {
-    UInt numNeighbors = 0u;
-    Real localActivityDensity = 0.0f;
-
-    if (wrapAround_) {
-      for(auto neighbor: WrappingNeighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
-    } else {
-      for(auto neighbor: Neighborhood(i, inhibitionRadius_, columnDimensions_)) {
-        localActivityDensity += activeDutyCycles_[neighbor];
-        numNeighbors += 1;
-      }
-    }
+  // Sum of the duty cycles and number of the columns in each neighborhood.
+  vector<Real64> localActivityDensity(activeDutyCycles_.begin(), activeDutyCycles_.end());
+  vector<Real64> numNeighbors(numColumns_, 1.0);
+  const auto sum = [](const Real64 a, const Real64 b) { return a + b; };
+  reduceNeighborhoods(localActivityDensity, columnDimensions_, inhibitionRadius_, wrapAround_, 0.0, sum);
+  reduceNeighborhoods(numNeighbors,         columnDimensions_, inhibitionRadius_, wrapAround_, 0.0, sum);
 
-    const Real targetDensity = localActivityDensity / numNeighbors;
+  for (UInt i = 0; i < numColumns_; ++i) {
+    const Real targetDensity = static_cast<Real>(localActivityDensity[i] / numNeighbors[i]);
     applyBoosting_(i, targetDensity, activeDutyCycles_, boostStrength_, boostFactors_);
   }
 }
@@ -824,28 +1063,54 @@ void SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
   const UInt numDesired = (UInt)(density * numColumns_);
   NTA_CHECK(numDesired > 0) << "Not enough columns (" << numColumns_ << ") "
                             << "for desired density (" << density << ").";
-  // Sort the columns by the amount of overlap.  First make a list of all of the
-  // column indexes.
-  activeColumns.reserve(numColumns_);
-  for(UInt i = 0; i < numColumns_; i++)
-    activeColumns.push_back(i);
   // Compare the column indexes by their overlap.
   auto compare = [&overlaps](const UInt &a, const UInt &b) -> bool
     {return (overlaps[a] == overlaps[b]) ? a > b : overlaps[a] > overlaps[b];};  //for determinism if overlaps match (tieBreaker does not solve that),
   //otherwise we'd return just `return overlaps[a] > overlaps[b]`. 
 
-  // Do a partial sort to divide the winners from the losers.  This sort is
-  // faster than a regular sort because it stops after it partitions the
-  // elements about the Nth element, with all elements on their correct side of
-  // the Nth element.
-  std::nth_element(
-    activeColumns.begin(),
-    activeColumns.begin() + numDesired,
-    activeColumns.end(),
-    compare);
-  // Remove the columns which lost the competition.
-  activeColumns.resize(numDesired);
-  // Finish sorting the winner columns by their overlap.
+  // Select the winners in linear time, with a counting select: Count the
+  // columns in buckets by the leading bits of their overlap (sign, exponent
+  // and 3 bits of the mantissa). The columns in the buckets above the one
+  // which contains the numDesired-th largest overlap win, the columns in that
+  // bucket are partially sorted to find the remaining winners. The bucket is
+  // a monotonic function of the overlap, so the winners are exactly those of
+  // sorting all of the columns with compare.
+  constexpr UInt BUCKET_SHIFT = 20u;
+  constexpr UInt NUM_BUCKETS  = 1u << (32u - BUCKET_SHIFT);
+  const auto bucketOf = [&overlaps](const UInt column) -> UInt {
+    // Float bits, reordered as unsigned integers. The conversion to Real32
+    // (if Real is Real64) keeps the order, adding 0.0f joins -0.0 with 0.0.
+    const Real32 overlap = static_cast<Real32>(overlaps[column]) + 0.0f;
+    UInt32 bits;
+    std::memcpy(&bits, &overlap, sizeof(bits));
+    bits ^= static_cast<UInt32>(static_cast<Int32>(bits) >> 31) | 0x80000000u;
+    return bits >> BUCKET_SHIFT;
+  };
+  UInt histogram[NUM_BUCKETS] = {};
+  for(UInt column = 0; column < numColumns_; column++)
+    histogram[bucketOf(column)]++;
+  UInt boundary = NUM_BUCKETS - 1u;
+  UInt numAbove = 0u;
+  while( numAbove + histogram[boundary] < numDesired ) {
+    numAbove += histogram[boundary--];
+  }
+
+  vector<UInt> candidates;
+  candidates.reserve(histogram[boundary]);
+  activeColumns.reserve(numDesired);
+  for(UInt column = 0; column < numColumns_; column++) {
+    const UInt bucket = bucketOf(column);
+    if( bucket > boundary )
+      activeColumns.push_back(column);
+    else if( bucket == boundary )
+      candidates.push_back(column);
+  }
+  const auto lastWinner = candidates.begin() + (numDesired - numAbove);
+  std::nth_element(candidates.begin(), lastWinner, candidates.end(), compare);
+  activeColumns.insert(activeColumns.end(), candidates.begin(), lastWinner);
+  NTA_ASSERT(activeColumns.size() == numDesired);
+
+  // Sort the winner columns by their overlap.
   std::sort(activeColumns.begin(), activeColumns.end(), compare);
   // Remove sub-threshold winners
   while( !activeColumns.empty() &&
@@ -857,6 +1122,18 @@ void SpatialPooler::inhibitColumnsGlobal_(const vector<Real> &overlaps,
 void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
                                          Real density,
                                          vector<UInt> &activeColumns) const {
+  // Counting the bigger neighbors in a Fenwick tree costs about as much as
+  // visiting a neighborhood of this many columns.
+  const UInt MIN_NEIGHBORHOOD_FOR_COUNTING = 16u;
+  if( columnDimensions_.size() <= 2u ) {
+    UInt neighborhood = 1u;
+    for(const auto dim : columnDimensions_)
+      neighborhood *= std::min(dim, 2u * inhibitionRadius_ + 1u);
+    if( neighborhood >= MIN_NEIGHBORHOOD_FOR_COUNTING ) {
+      inhibitColumnsLocalCounting_(overlaps, density, activeColumns);
+      return;
+    }
+  }
   activeColumns.clear();
 
   // Tie-breaking: when overlaps are equal, columns that have already been
@@ -908,6 +1185,148 @@ void SpatialPooler::inhibitColumnsLocal_(const vector<Real> &overlaps,
 }
 
 
+namespace {
+  /**
+   * Counts of points in a 2D grid, with sums over rectangles in
+   * O(log(height) * log(width)): a 2D Fenwick (binary indexed) tree.
+   */
+  class RectangleCounter {
+  public:
+    RectangleCounter(const UInt height, const UInt width)
+      : height_(height), width_(width), tree_(size_t(height) * width, 0u) {}
+
+    void add(const UInt y, const UInt x, const UInt delta) {
+      for(UInt i = y + 1u; i <= height_; i += i & (~i + 1u)) {
+        for(UInt j = x + 1u; j <= width_; j += j & (~j + 1u)) {
+          tree_[size_t(i - 1u) * width_ + j - 1u] += delta; //unsigned, so -1 is ~0u
+        }
+      }
+    }
+
+    // Sum over [y0, y1] x [x0, x1].
+    UInt count(const UInt y0, const UInt y1, const UInt x0, const UInt x1) const {
+      return prefix_(y1 + 1u, x1 + 1u) - prefix_(y0, x1 + 1u)
+           - prefix_(y1 + 1u, x0) + prefix_(y0, x0);
+    }
+
+  private:
+    // Sum over [0, y) x [0, x).
+    UInt prefix_(const UInt y, const UInt x) const {
+      UInt sum = 0u;
+      for(UInt i = y; i > 0u; i -= i & (~i + 1u)) {
+        for(UInt j = x; j > 0u; j -= j & (~j + 1u)) {
+          sum += tree_[size_t(i - 1u) * width_ + j - 1u];
+        }
+      }
+      return sum;
+    }
+
+    const UInt height_;
+    const UInt width_;
+    vector<UInt> tree_;
+  };
+
+  /**
+   * The coordinates of a neighborhood in one dimension, as visited by
+   * Neighborhood or WrappingNeighborhood: one or (wrapping) two ranges.
+   */
+  struct NeighborRanges {
+    UInt first[2];
+    UInt last[2];
+    UInt numRanges;
+    UInt size;
+
+    NeighborRanges(const UInt center, const UInt radius, const UInt dim, const bool wrap) {
+      if( not wrap ) {
+        first[0]  = center > radius ? center - radius : 0u;
+        last[0]   = std::min(dim - 1u, center + radius);
+        numRanges = 1u;
+        size      = last[0] - first[0] + 1u;
+        return;
+      }
+      size = std::min(2u * radius + 1u, dim);
+      Int start = (static_cast<Int>(center) - static_cast<Int>(radius)) % static_cast<Int>(dim);
+      if( start < 0 ) start += dim;
+      first[0] = static_cast<UInt>(start);
+      if( first[0] + size <= dim ) {
+        last[0]   = first[0] + size - 1u;
+        numRanges = 1u;
+      }
+      else {
+        last[0]   = dim - 1u;
+        first[1]  = 0u;
+        last[1]   = first[0] + size - dim - 1u;
+        numRanges = 2u;
+      }
+    }
+  };
+}
+
+void SpatialPooler::inhibitColumnsLocalCounting_(const vector<Real> &overlaps,
+                                                 Real density,
+                                                 vector<UInt> &activeColumns) const {
+  NTA_CHECK(columnDimensions_.size() <= 2u) << "Only for 1D and 2D columns.";
+  activeColumns.clear();
+  const UInt height = columnDimensions_.size() == 2u ? columnDimensions_[0] : 1u;
+  const UInt width  = columnDimensions_.back();
+
+  // Visit the columns from the largest overlap down. Equal overlaps are
+  // visited by their index, as inhibitColumnsLocal_ does, where a neighbor
+  // with an equal overlap is "bigger" if it has already been selected.
+  vector<UInt> order(numColumns_);
+  std::iota(order.begin(), order.end(), 0u);
+  std::sort(order.begin(), order.end(), [&overlaps](const UInt a, const UInt b) {
+    return (overlaps[a] == overlaps[b]) ? a < b : overlaps[a] > overlaps[b]; });
+
+  RectangleCounter bigger(height, width);      //columns with a larger overlap
+  RectangleCounter activeEqual(height, width); //selected columns with the current overlap
+  const auto countNeighbors = [&](const RectangleCounter &counter,
+                                  const NeighborRanges &rows, const NeighborRanges &cols) {
+    UInt count = 0u;
+    for(UInt r = 0u; r < rows.numRanges; r++) {
+      for(UInt c = 0u; c < cols.numRanges; c++) {
+        count += counter.count(rows.first[r], rows.last[r], cols.first[c], cols.last[c]);
+      }
+    }
+    return count;
+  };
+
+  for(size_t begin = 0u; begin < order.size(); ) {
+    const Real overlap = overlaps[order[begin]];
+    size_t end = begin + 1u;
+    while( end < order.size() and overlaps[order[end]] == overlap ) {
+      end++;
+    }
+    const size_t numSelectedBefore = activeColumns.size();
+    if( overlap >= stimulusThreshold_ ) {
+      for(size_t i = begin; i < end; i++) {
+        const UInt column = order[i];
+        const NeighborRanges rows(column / width, inhibitionRadius_, height, wrapAround_);
+        const NeighborRanges cols(column % width, inhibitionRadius_, width,  wrapAround_);
+        const UInt numNeighbors = rows.size * cols.size - 1u;
+        UInt numBigger = countNeighbors(bigger, rows, cols);
+        if( activeColumns.size() > numSelectedBefore ) {
+          numBigger += countNeighbors(activeEqual, rows, cols);
+        }
+        const UInt numActive = (UInt)(0.5f + (density * (numNeighbors + 1)));
+        if (numBigger < numActive) {
+          activeColumns.push_back(column);
+          activeEqual.add(column / width, column % width, 1u);
+        }
+      }
+      for(size_t i = numSelectedBefore; i < activeColumns.size(); i++) {
+        activeEqual.add(activeColumns[i] / width, activeColumns[i] % width, ~0u);
+      }
+    }
+    for(size_t i = begin; i < end; i++) {
+      bigger.add(order[i] / width, order[i] % width, 1u);
+    }
+    begin = end;
+  }
+  std::sort(activeColumns.begin(), activeColumns.end());
+}
+
+
 bool SpatialPooler::isUpdateRound_() const {
   return (iterationNum_ % updatePeriod_) == 0;
 }
@@ -947,6 +1366,7 @@ void SpatialPooler::printParameters(std::ostream& out) const {
       << "boostStrength               = " << getBoostStrength() << std::endl
       << "spVerbosity                 = " << getSpVerbosity() << std::endl
       << "wrapAround                  = " << getWrapAround() << std::endl
+      << "lazyDutyCycles              = " << getLazyDutyCycles() << std::endl
       << "version                     = " << version() << std::endl;
 }
 
@@ -1001,9 +1421,9 @@ bool SpatialPooler::operator==(const SpatialPooler& o) const{
   // compare vectors.
   if (inputDimensions_      != o.inputDimensions_) return false;
   if (columnDimensions_     != o.columnDimensions_) return false;
-  if (boostFactors_         != o.boostFactors_) return false;
-  if (overlapDutyCycles_    != o.overlapDutyCycles_) return false;
-  if (activeDutyCycles_     != o.activeDutyCycles_) return false;
+  if (currentBoostFactors_() != o.currentBoostFactors_()) return false;
+  if (decayedDutyCycles_(overlapDutyCycles_) != o.decayedDutyCycles_(o.overlapDutyCycles_)) return false;
+  if (decayedDutyCycles_(activeDutyCycles_)  != o.decayedDutyCycles_(o.activeDutyCycles_)) return false;
   if (minOverlapDutyCycles_ != o.minOverlapDutyCycles_) return false;
 
   // compare connections
@@ -23,12 +23,15 @@
 #define NTA_spatial_pooler_HPP
 
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <iomanip> // std::setprecision
 #include <htm/algorithms/Connections.hpp>
+#include <htm/algorithms/FrozenConnections.hpp>
 #include <htm/types/Types.hpp>
 #include <htm/types/Serializable.hpp>
 #include <htm/types/Sdr.hpp>
+#include <htm/utils/ThreadPool.hpp>
 
 
 namespace htm {
@@ -239,9 +242,69 @@ public:
         overlap score for a column is defined as the number of synapses in
         a "connected state" (connected synapses) that are connected to
         input bits which are turned on. 
+        The reference is valid until the next call to compute.
         Replaces: SP.calculateOverlaps_(), SP.getOverlaps()
    */
-  virtual const vector<SynapseIdx> compute(const SDR &input, const bool learn, SDR &active);
+  virtual const vector<SynapseIdx> &compute(const SDR &input, const bool learn, SDR &active);
+
+  /**
+   * Switch to the frozen mode, for inference only serving: take a read-only
+   * snapshot of the connections (see FrozenConnections) and release the
+   * connections, so that a frozen SP takes about 4 bytes per connected or
+   * potential synapse. The results of compute (with learn false) and infer
+   * are identical to the normal path.
+   *
+   * A frozen SP can not learn or be saved, and has no permanences or
+   * potential pools (the getters and setters throw). Copies of the SP share
+   * the snapshot. initialize or load leaves the frozen mode.
+   */
+  void freezeConnections();
+  bool isFrozen() const { return frozenConnections_ != nullptr; }
+
+  /**
+   * @returns The snapshot made by freezeConnections, or nullptr.
+   */
+  const std::shared_ptr<const FrozenConnections> &getFrozenConnections() const
+    { return frozenConnections_; }
+
+  /**
+   * Buffers of infer, owned by the caller and reused between calls.
+   */
+  struct InferenceState {
+    SegmentActivity overlaps;
+    vector<Real>    boostedOverlaps;
+  };
+
+  /**
+   * Inference of a frozen SP (see freezeConnections), the same as
+   * compute(input, false, active) but it does not change the SP: it writes
+   * only into `active` and the caller's `state`. Any number of threads can
+   * infer with one SP at once, each with its own state.
+   *
+   * @returns The overlaps, valid until the next call with this state.
+   */
+  const vector<SynapseIdx> &infer(const SDR &input, SDR &active, InferenceState &state) const;
+
+  /**
+   * Use a thread pool for initialize and compute.
+   *
+   * Set before initialize, the potential pools and the initial permanences of
+   * the columns are chosen in parallel. Each column then draws from its own
+   * random generator, seeded from the seed and the index of the column, so
+   * the connections do not depend on the number of threads. They differ from
+   * those of the serial initialization, without a thread pool, which is kept
+   * for compatibility.
+   *
+   * In compute, the pool is used for the overlaps, see
+   * Connections::setThreadPool. The results are identical to the serial
+   * computation.
+   *
+   * The pool is not serialized, and is shared by copies of this instance.
+   *
+   * @param pool ThreadPool to use, or nullptr to compute serially (default).
+   */
+  void setThreadPool(const std::shared_ptr<ThreadPool> &pool);
+  const std::shared_ptr<ThreadPool> &getThreadPool() const { return threadPool_; }
 
 
   /**
@@ -261,6 +324,7 @@ public:
   // FOR Cereal Serialization
   template<class Archive>
   void save_ar(Archive& ar) const {
+    NTA_CHECK(not isFrozen()) << "SP: a frozen SpatialPooler can not be saved";
     ar(CEREAL_NVP(inputDimensions_),
        CEREAL_NVP(columnDimensions_));
     ar(CEREAL_NVP(numInputs_),
@@ -284,9 +348,13 @@ public:
        CEREAL_NVP(synPermConnected_),
        CEREAL_NVP(minPctOverlapDutyCycles_),
        CEREAL_NVP(wrapAround_));
-    ar(CEREAL_NVP(boostFactors_));
-    ar(CEREAL_NVP(overlapDutyCycles_));
-    ar(CEREAL_NVP(activeDutyCycles_));
+    // Lazily decayed duty cycles are saved with the decay applied.
+    const vector<Real> boostFactors      = currentBoostFactors_();
+    const vector<Real> overlapDutyCycles = decayedDutyCycles_(overlapDutyCycles_);
+    const vector<Real> activeDutyCycles  = decayedDutyCycles_(activeDutyCycles_);
+    ar(cereal::make_nvp("boostFactors_", boostFactors));
+    ar(cereal::make_nvp("overlapDutyCycles_", overlapDutyCycles));
+    ar(cereal::make_nvp("activeDutyCycles_", activeDutyCycles));
     ar(CEREAL_NVP(minOverlapDutyCycles_));
     ar(CEREAL_NVP(connections_));
     ar(CEREAL_NVP(rng_));
@@ -325,7 +393,10 @@ public:
     ar(CEREAL_NVP(rng_));
 
     // initialize ephemeral members
+    dutyCycleDecay_ = 1.0;
+    boostFactorsStale_ = false;
     boostedOverlaps_.resize(numColumns_);
+    frozenConnections_.reset();
   }
 
   /**
@@ -538,6 +609,31 @@ public:
   */
   void setUpdatePeriod(UInt updatePeriod);
 
+  /**
+  Returns true if the duty cycles decay lazily, see setLazyDutyCycles.
+  */
+  bool getLazyDutyCycles() const;
+  /**
+  Sets lazy decay of the duty cycles, off by default.
+
+  Eager decay multiplies every duty cycle, and recomputes every boost factor,
+  on each learning step. Lazy decay keeps the duty cycles divided by a common
+  decay factor instead, so a learning step only updates the duty cycles of
+  the overlapping and the active columns. The boost factors are computed from
+  the active duty cycles when they are needed, only for the overlapping
+  columns. The duty cycles are renormalized once per update period.
+
+  This only applies with global inhibition, local inhibition always decays
+  eagerly. The results differ from eager decay by rounding.
+
+  The setting is not serialized, like the thread pool: save writes the duty
+  cycles and boost factors with the decay applied, as eager decay does, and
+  load keeps the setting of this instance. Archives are the same either way.
+
+  @param lazyDutyCycles boolean value
+  */
+  void setLazyDutyCycles(bool lazyDutyCycles);
+
   /**
   Returns the permanence increment amount for active synapses
   inputs.
@@ -811,6 +907,23 @@ public:
   */
   vector<UInt> initMapPotential_(UInt column, bool wrapAround);
 
+  /**
+  The potential pool of a column, as initMapPotential_, as sorted indices of
+  the inputs. Draws from rng.
+  */
+  vector<UInt> initPotentialPool_(UInt column, bool wrapAround, Random &rng) const;
+
+  /**
+  Chooses the potential pool of a column and the initial permanences of its
+  synapses, as initMapPotential_ and initPermanence_ do, without dense
+  vectors. Draws from rng.
+
+  @param pool        Output, sorted indices of the potential inputs.
+  @param permanences Output, the permanence for each input of the pool.
+  */
+  void initColumnSynapses_(UInt column, Random &rng,
+                           vector<UInt> &pool, vector<Real> &permanences) const;
+
   /**
   Returns a randomly generated permanence value for a synapses that is
   initialized in a connected state.
@@ -923,6 +1036,22 @@ public:
   void inhibitColumnsLocal_(const vector<Real> &overlaps, Real density,
                             vector<UInt> &activeColumns) const;
 
+  /**
+     Performs local inhibition of 1D and 2D column topologies, with the same
+     result as inhibitColumnsLocal_, in a time which does not depend on the
+     inhibition radius.
+
+     The columns are visited from the largest overlap down (equal overlaps
+     in the order of their index), and counted in a 2D Fenwick tree. The
+     number of bigger neighbors of a column is then a sum over the rectangle
+     of its neighborhood, in O(log(height) * log(width)).
+     inhibitColumnsLocal_ uses this for large neighborhoods.
+
+     Parameters as for inhibitColumnsLocal_.
+  */
+  void inhibitColumnsLocalCounting_(const vector<Real> &overlaps, Real density,
+                                    vector<UInt> &activeColumns) const;
+
   /**
       The primary method in charge of learning.
 
@@ -1053,6 +1182,28 @@ public:
   */
   void updateDutyCycles_(const vector<SynapseIdx> &overlaps, SDR &active);
 
+  /**
+  True if the duty cycles decay lazily in this configuration, see
+  setLazyDutyCycles.
+  */
+  bool lazyDecay_() const { return lazyDutyCycles_ and globalInhibition_; }
+
+  /**
+  Applies the pending lazy decay to the stored duty cycles.
+  */
+  void normalizeDutyCycles_();
+
+  /**
+  Returns the duty cycles with the pending lazy decay applied.
+  */
+  vector<Real> decayedDutyCycles_(const vector<Real> &dutyCycles) const;
+
+  /**
+  Returns the boost factors, computed from the active duty cycles if
+  boostFactors_ is stale.
+  */
+  vector<Real> currentBoostFactors_() const;
+
   /**
     Update the boost factors for all columns. The boost factors are used to
     increase the overlap of inactive columns to improve their chances of
@@ -1166,6 +1317,13 @@ protected:
   vector<Real> activeDutyCycles_;
   vector<Real> minOverlapDutyCycles_;
   vector<Real> minActiveDutyCycles_;
+  bool lazyDutyCycles_ = false;
+  // The true duty cycles are the stored ones times this decay, which is 1
+  // unless the duty cycles decay lazily.
+  Real64 dutyCycleDecay_ = 1.0;
+  // With lazy decay, the duty cycles have changed since boostFactors_ was
+  // last set, see currentBoostFactors_.
+  bool boostFactorsStale_ = false;
 
   Real minPctOverlapDutyCycles_;
 
@@ -1176,6 +1334,9 @@ protected:
    */
   Connections connections_;
 
+  SegmentActivity overlaps_; //reused by compute in each step
+  std::shared_ptr<const FrozenConnections> frozenConnections_; //see freezeConnections
+  std::shared_ptr<ThreadPool> threadPool_; //see setThreadPool
   vector<Real> boostedOverlaps_;
 
 
@@ -68,17 +68,54 @@ TemporalMemory::TemporalMemory(
     SynapseIdx maxSynapsesPerSegment, 
     bool checkInputs, 
     UInt externalPredictiveInputs,
-    ANMode anomalyMode) {
+    ANMode anomalyMode,
+    SegmentEviction segmentEviction) {
 
   initialize(columnDimensions, cellsPerColumn, activationThreshold,
              initialPermanence, connectedPermanence, minThreshold,
              maxNewSynapseCount, permanenceIncrement, permanenceDecrement,
              predictedSegmentDecrement, seed, maxSegmentsPerCell,
-             maxSynapsesPerSegment, checkInputs, externalPredictiveInputs, anomalyMode);
+             maxSynapsesPerSegment, checkInputs, externalPredictiveInputs, anomalyMode,
+             segmentEviction);
 }
 
 TemporalMemory::~TemporalMemory() {}
 
+TemporalMemory::TemporalMemory(const TemporalMemory &other)
+    : numColumns_(other.numColumns_),
+      columnDimensions_(other.columnDimensions_),
+      cellsPerColumn_(other.cellsPerColumn_),
+      activationThreshold_(other.activationThreshold_),
+      minThreshold_(other.minThreshold_),
+      maxNewSynapseCount_(other.maxNewSynapseCount_),
+      checkInputs_(other.checkInputs_),
+      initialPermanence_(other.initialPermanence_),
+      connectedPermanence_(other.connectedPermanence_),
+      permanenceIncrement_(other.permanenceIncrement_),
+      permanenceDecrement_(other.permanenceDecrement_),
+      predictedSegmentDecrement_(other.predictedSegmentDecrement_),
+      externalPredictiveInputs_(other.externalPredictiveInputs_),
+      maxSegmentsPerCell_(other.maxSegmentsPerCell_),
+      maxSynapsesPerSegment_(other.maxSynapsesPerSegment_),
+      activeCells_(other.activeCells_),
+      winnerCells_(other.winnerCells_),
+      segmentsValid_(other.segmentsValid_),
+      activeSegments_(other.activeSegments_),
+      matchingSegments_(other.matchingSegments_),
+      segmentActivity_(other.segmentActivity_),
+      frozenConnections_(other.frozenConnections_), //immutable, checked against connections.revision()
+      frozen_(other.frozen_),
+      threadPool_(other.threadPool_),
+      rng_(other.rng_),
+      connections(other.connections.fork()),
+      tmAnomaly_(other.tmAnomaly_) {
+  // The other members are scratch space, and the references to members.
+}
+
+TemporalMemory TemporalMemory::fork() const {
+  return TemporalMemory(*this);
+}
+
 void TemporalMemory::initialize(
     vector<CellIdx> columnDimensions, 
     CellIdx cellsPerColumn,
@@ -95,7 +132,8 @@ void TemporalMemory::initialize(
     SynapseIdx maxSynapsesPerSegment, 
     bool checkInputs, 
     UInt externalPredictiveInputs,
-    ANMode anomalyMode) {
+    ANMode anomalyMode,
+    SegmentEviction segmentEviction) {
 
   // Validate all input parameters
   NTA_CHECK(columnDimensions.size() > 0) << "Number of column dimensions must be greater than 0";
@@ -131,62 +169,42 @@ void TemporalMemory::initialize(
 
   // Initialize member variables
   connections = Connections(static_cast<CellIdx>(numberOfColumns() * cellsPerColumn_), connectedPermanence_);
+  frozenConnections_.reset();
+  frozen_ = false;
   rng_ = Random(seed);
 
   maxSegmentsPerCell_ = maxSegmentsPerCell;
   maxSynapsesPerSegment_ = maxSynapsesPerSegment;
 
   tmAnomaly_.mode_ = anomalyMode;
+  connections.setSegmentEviction(segmentEviction);
 
   reset();
 }
 
-///*
 static CellIdx getLeastUsedCell(Random &rng, 
 		                const UInt column, //TODO remove static methods, use private instead
-                                const Connections &connections,
+                                Connections &connections,
                                 const UInt cellsPerColumn) {
-  const CellIdx start = column * cellsPerColumn;
-  const CellIdx end = start + cellsPerColumn;
-
-  size_t minNumSegments = std::numeric_limits<CellIdx>::max();
-  UInt32 numTiedCells = 0u;
-  //for all cells in a mini-column
-  for (CellIdx cell = start; cell < end; cell++) {
-    const size_t numSegments = connections.numSegments(cell);
-    //..find a cell with least segments
-    if (numSegments < minNumSegments) {
-      minNumSegments = numSegments;
-      numTiedCells = 1u;
-    //..and how many of the cells have only these min segments? number of weakest
-    } else if (numSegments == minNumSegments) {
-      numTiedCells++;
-    }
+  // The connections keep an index of the cells with the fewest segments in
+  // each mini-column, see Connections::indexLeastUsedCells.
+  if( connections.leastUsedCellsGroupSize() != cellsPerColumn ) {
+    connections.indexLeastUsedCells( cellsPerColumn );
   }
 
   //randomly select one of the tie-d cells from the losers
+  const UInt32 numTiedCells = connections.numLeastUsedCells( column );
   const UInt32 tieWinnerIndex = rng.getUInt32(numTiedCells);
-  UInt32 tieIndex = 0;
-  for (CellIdx cell = start; cell < end; cell++) {
-    if (connections.numSegments(cell) == minNumSegments) {
-      if (tieIndex == tieWinnerIndex) {
-        return cell;
-      } else {
-        tieIndex++;
-      }
-    }
-  }
-
-  NTA_THROW << "getLeastUsedCell failed to find a cell";
+  return connections.leastUsedCell( column, tieWinnerIndex );
 }
-//*/
 
 void TemporalMemory::growSynapses_(
 			 const Segment& segment,
                          const SynapseIdx nDesiredNewSynapses,
                          const vector<CellIdx> &prevWinnerCells) {
   
-  vector<CellIdx> candidates(prevWinnerCells.begin(), prevWinnerCells.end());
+  vector<CellIdx> &candidates = buffers_.growCandidates;
+  candidates.assign(prevWinnerCells.begin(), prevWinnerCells.end());
   NTA_ASSERT(std::is_sorted(candidates.begin(), candidates.end()));
 
   //figure the number of new synapses to grow
@@ -201,12 +219,9 @@ void TemporalMemory::growSynapses_(
 
   // Pick nActual cells randomly.
   rng_.shuffle(candidates.begin(), candidates.end());
-  const size_t nDesired = connections.numSynapses(segment) + nActualWithMax; //num synapses on seg after this function (+-), see #COND
-  for (const auto syn : candidates) {
-    // #COND: this loop finishes two folds: a) we ran out of candidates (above), b) we grew the desired number of new synapses (below)
-    if(connections.numSynapses(segment) == nDesired) break;
-    connections.createSynapse(segment, syn, initialPermanence_); //TODO createSynapse consider creating a vector of new synapses at once?
-  }
+  // Grows synapses to the first candidates which are not on the segment yet,
+  // until we ran out of candidates or grew the desired number of new synapses.
+  connections.createSynapses(segment, candidates, initialPermanence_, nActualWithMax);
 }
 
 
@@ -226,12 +241,12 @@ void TemporalMemory::activatePredictedColumn_(
     // This cell might have multiple active segments.
     do {
       if (learn) { 
-        connections.adaptSegment(*activeSegment, prevActiveCells,
-                     permanenceIncrement_, permanenceDecrement_, true);
+        adaptSegment_(*activeSegment, prevActiveCells,
+                      permanenceIncrement_, permanenceDecrement_);
 
         const Int32 nGrowDesired =
             static_cast<Int32>(maxNewSynapseCount_) -
-            numActivePotentialSynapsesForSegment_[*activeSegment];
+            segmentActivity_.numActivePotential[*activeSegment];
         if (nGrowDesired > 0) {
           growSynapses_(*activeSegment, nGrowDesired, prevWinnerCells);
         }
@@ -259,14 +274,14 @@ void TemporalMemory::burstColumn_(
   const auto bestMatchingSegment =
       std::max_element(columnMatchingSegmentsBegin, columnMatchingSegmentsEnd,
                        [&](Segment a, Segment b) {
-                         return (numActivePotentialSynapsesForSegment_[a] <
-                                 numActivePotentialSynapsesForSegment_[b]);
+                         return (segmentActivity_.numActivePotential[a] <
+                                 segmentActivity_.numActivePotential[b]);
                        });
 
   const CellIdx winnerCell =
       (bestMatchingSegment != columnMatchingSegmentsEnd)
           ? connections.cellForSegment(*bestMatchingSegment)
-          : getLeastUsedCell(rng_, column, connections, cellsPerColumn_); //TODO replace (with random?) this is extremely costly, removing makes TM 6x faster!
+          : getLeastUsedCell(rng_, column, connections, cellsPerColumn_);
 
   winnerCells_.push_back(winnerCell);
 
@@ -274,10 +289,10 @@ void TemporalMemory::burstColumn_(
   if (learn) {
     if (bestMatchingSegment != columnMatchingSegmentsEnd) {
       // Learn on the best matching segment.
-      connections.adaptSegment(*bestMatchingSegment, prevActiveCells,
-                   permanenceIncrement_, permanenceDecrement_, true);
+      adaptSegment_(*bestMatchingSegment, prevActiveCells,
+                    permanenceIncrement_, permanenceDecrement_);
 
-      const Int32 nGrowDesired = maxNewSynapseCount_ - numActivePotentialSynapsesForSegment_[*bestMatchingSegment];
+      const Int32 nGrowDesired = maxNewSynapseCount_ - segmentActivity_.numActivePotential[*bestMatchingSegment];
       if (nGrowDesired > 0) {
         growSynapses_(*bestMatchingSegment, nGrowDesired, prevWinnerCells);
       }
@@ -307,15 +322,90 @@ void TemporalMemory::punishPredictedColumn_(
   if (predictedSegmentDecrement_ > 0.0) {
     for (auto matchingSegment = columnMatchingSegmentsBegin;
          matchingSegment != columnMatchingSegmentsEnd; matchingSegment++) {
-      connections.adaptSegment(*matchingSegment, prevActiveCells,
-                   -predictedSegmentDecrement_, 0.0, true);
+      adaptSegment_(*matchingSegment, prevActiveCells,
+                    -predictedSegmentDecrement_, 0.0f);
     }
   }
 }
 
+void TemporalMemory::adaptSegment_(const Segment segment, const SDR &prevActiveCells,
+                                   const Permanence increment, const Permanence decrement) {
+  if( adaptions_.empty() ) {
+    connections.adaptSegment(segment, prevActiveCells, increment, decrement, true);
+    return;
+  }
+  // The permanences are already adapted, commit the rest in the serial order.
+  NTA_ASSERT( nextAdaption_ < adaptions_.size() );
+  NTA_ASSERT( adaptions_[nextAdaption_].segment == segment );
+  connections.applySynapseUpdates(segment, adaptionUpdates_[nextAdaption_], true);
+  nextAdaption_++;
+}
+
+
+void TemporalMemory::adaptSegmentsInParallel_(const vector<UInt> &activeColumns,
+                                              const SDR &prevActiveCells) {
+  // Find the segments which activateCells will adapt, in the same order.
+  const auto toColumns = [&](const Segment segment) {
+    return connections.cellForSegment(segment) / cellsPerColumn_;
+  };
+  const auto identity = [](const ElemSparse a) {return a;};
+  for (auto &&columnData : groupBy(
+           activeColumns,     identity,
+           activeSegments_,   toColumns,
+           matchingSegments_, toColumns)) {
+    vector<UInt>::const_iterator activeColumnsBegin, activeColumnsEnd;
+    vector<Segment>::const_iterator activeBegin, activeEnd, matchingBegin, matchingEnd;
+    std::tie(std::ignore, activeColumnsBegin, activeColumnsEnd,
+             activeBegin, activeEnd, matchingBegin, matchingEnd) = columnData;
+
+    if (activeColumnsBegin != activeColumnsEnd) {
+      if (activeBegin != activeEnd) { // see activatePredictedColumn_
+        for (auto segment = activeBegin; segment != activeEnd; segment++) {
+          adaptions_.push_back({*segment, permanenceIncrement_, permanenceDecrement_});
+        }
+      } else { // see burstColumn_
+        const auto bestMatchingSegment =
+            std::max_element(matchingBegin, matchingEnd, [&](Segment a, Segment b) {
+              return (segmentActivity_.numActivePotential[a] <
+                      segmentActivity_.numActivePotential[b]);
+            });
+        if (bestMatchingSegment != matchingEnd) {
+          adaptions_.push_back({*bestMatchingSegment, permanenceIncrement_, permanenceDecrement_});
+        }
+      }
+    } else if (predictedSegmentDecrement_ > 0.0) { // see punishPredictedColumn_
+      for (auto segment = matchingBegin; segment != matchingEnd; segment++) {
+        adaptions_.push_back({*segment, -predictedSegmentDecrement_, 0.0f});
+      }
+    }
+  }
+  if (adaptionUpdates_.size() < adaptions_.size()) {
+    adaptionUpdates_.resize(adaptions_.size());
+  }
+
+  // The segments are distinct, adapt their permanences in parallel.
+  prevActiveCells.getDense();
+  for (const auto &adaption : adaptions_) {
+    connections.unshareSegment(adaption.segment); //see fork
+  }
+  const size_t numTasks = std::min<size_t>(threadPool_->size(), adaptions_.size());
+  threadPool_->parallelFor(numTasks, [&](const size_t task, const UInt) {
+    const auto range = ThreadPool::chunk(adaptions_.size(), numTasks, task);
+    for (size_t i = range.first; i < range.second; i++) {
+      const Adaption &adaption = adaptions_[i];
+      adaptionUpdates_[i].clear();
+      connections.adaptSegmentPermanences(adaption.segment, prevActiveCells,
+                                          adaption.increment, adaption.decrement,
+                                          true, adaptionUpdates_[i]);
+    }
+  });
+}
+
+
 void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
     NTA_CHECK(columnDimensions_.size() > 0) << "TM constructed using the default TM() constructor, which may only be used for serialization. "
 	    << "Use TM constructor where you provide at least column dimensions, eg: TM tm({32});";
+    NTA_CHECK(not frozen_) << "TM: a frozen TemporalMemory infers with computeStreams";
 
     NTA_CHECK( activeColumns.dimensions.size() == columnDimensions_.size() )  //this "hack" because columnDimensions_, and SDR.dimensions are vectors
 	    //of different type, so we cannot directly compare
@@ -325,11 +415,23 @@ void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
     }
     auto &sparse = activeColumns.getSparse();
 
-  SDR prevActiveCells({static_cast<CellIdx>(numberOfCells() + externalPredictiveInputs_)});
-  prevActiveCells.setSparse(activeCells_);
+  SDR &prevActiveCells = buffers_.prevActiveCells;
+  const UInt numInputs = static_cast<UInt>(numberOfCells() + externalPredictiveInputs_);
+  if (prevActiveCells.size != numInputs) {
+    prevActiveCells.initialize({numInputs});
+  }
+  prevActiveCells.setSparse(activeCells_); //swaps, activeCells_ keeps a buffer
   activeCells_.clear();
 
-  const vector<CellIdx> prevWinnerCells = std::move(winnerCells_);
+  vector<CellIdx> &prevWinnerCells = buffers_.prevWinnerCells;
+  prevWinnerCells.swap(winnerCells_);
+  winnerCells_.clear();
+
+  adaptions_.clear();
+  nextAdaption_ = 0u;
+  if (learn && threadPool_ != nullptr) {
+    adaptSegmentsInParallel_(sparse, prevActiveCells);
+  }
 
   //maps segment S to a new segment that is at start of a column where
   //S belongs. 
@@ -387,14 +489,57 @@ void TemporalMemory::activateCells(const SDR &activeColumns, const bool learn) {
       }
     } //else: not predicted & not active -> no activity -> does not show up at all
   }
+  NTA_ASSERT(nextAdaption_ == adaptions_.size());
+  adaptions_.clear();
   segmentsValid_ = false;
 }
 
 
+template<typename Cells>
+void TemporalMemory::selectSegments_(const SegmentActivity &activity,
+                                     const Cells &cells,
+                                     vector<Segment> &activeSegments,
+                                     vector<Segment> &matchingSegments) const {
+  // Only the touched segments received input, the others have zero counts
+  // and can be active or matching only with a zero threshold.
+  const auto findSegments = [&](const vector<SynapseIdx> &counts, const SynapseIdx threshold,
+                                vector<Segment> &segments) {
+    segments.clear();
+    if (threshold > 0) {
+      for (const auto segment : activity.touched) {
+        if (counts[segment] >= threshold) segments.push_back(segment);
+      }
+    } else {
+      for (Segment segment = 0; segment < counts.size(); segment++) segments.push_back(segment);
+    }
+    std::sort( segments.begin(), segments.end(), [&](const Segment a, const Segment b) {
+      return cells.compareSegments(a, b); }); //SDR requires sorted when constructed from activeSegments_
+  };
+
+  // Matching segments, potential synapses.
+  findSegments(activity.numActivePotential, minThreshold_, matchingSegments);
+
+  // Active segments, connected synapses.
+  if (minThreshold_ <= activationThreshold_) {
+    // The potential counts include the connected synapses, so the active
+    // segments are matching too: filter the sorted list, no second sort.
+    activeSegments.clear();
+    for (const auto segment : matchingSegments) {
+      if (activity.numActiveConnected[segment] >= activationThreshold_) { //TODO move to SegmentData.numConnected?
+        activeSegments.push_back(segment);
+      }
+    }
+  } else {
+    findSegments(activity.numActiveConnected, activationThreshold_, activeSegments);
+  }
+}
+
+
 void TemporalMemory::activateDendrites(const bool learn,
                                        const SDR &externalPredictiveInputsActive,
                                        const SDR &externalPredictiveInputsWinners)
 {
+    NTA_CHECK(not frozen_) << "TM: a frozen TemporalMemory infers with computeStreams";
     if( externalPredictiveInputs_ > 0 )
     {
         NTA_CHECK( externalPredictiveInputsActive.size  == externalPredictiveInputs_ );
@@ -425,39 +570,24 @@ void TemporalMemory::activateDendrites(const bool learn,
       winnerCells_.push_back( static_cast<CellIdx>(winner + numberOfCells()) );
   }
 
-  const size_t length = connections.segmentFlatListLength();
+  if( not learn and frozenConnections_ != nullptr and
+      frozenConnections_->revision() == connections.revision() ) {
+    connections.startComputeStep(learn);
+    frozenConnections_->computeActivity(segmentActivity_, activeCells_);
+  }
+  else {
+    connections.computeActivity(segmentActivity_, activeCells_, learn);
+  }
 
-  numActivePotentialSynapsesForSegment_.assign(length, 0);
-  numActiveConnectedSynapsesForSegment_ = connections.computeActivity(
-                              numActivePotentialSynapsesForSegment_,
-                              activeCells_,
-			      learn);
+  selectSegments_(segmentActivity_, connections, activeSegments_, matchingSegments_);
 
-  // Active segments, connected synapses.
-  activeSegments_.clear();
-  for (Segment segment = 0; segment < numActiveConnectedSynapsesForSegment_.size(); segment++) {
-    if (numActiveConnectedSynapsesForSegment_[segment] >= activationThreshold_) { //TODO move to SegmentData.numConnected?
-      activeSegments_.push_back(segment);
-    }
-  }
-  const auto compareSegments = [&](const Segment a, const Segment b) { return connections.compareSegments(a, b); };
-  std::sort( activeSegments_.begin(), activeSegments_.end(), compareSegments); //SDR requires sorted when constructed from activeSegments_
-  // Update segment bookkeeping.
-  if (learn) {
+  // Update segment bookkeeping, only the LRU eviction uses it.
+  if (learn and connections.segmentEviction() == SegmentEviction::LRU) {
     for (const auto segment : activeSegments_) {
       connections.dataForSegment(segment).lastUsed = connections.iteration(); //TODO the destroySegments based on LRU is expensive. Better random? or "energy" based on sum permanences?
     }
   }
 
-  // Matching segments, potential synapses.
-  matchingSegments_.clear();
-  for (Segment segment = 0; segment < numActivePotentialSynapsesForSegment_.size(); segment++) {
-    if (numActivePotentialSynapsesForSegment_[segment] >= minThreshold_) {
-      matchingSegments_.push_back(segment);
-    }
-  }
-  std::sort( matchingSegments_.begin(), matchingSegments_.end(), compareSegments);
-
   segmentsValid_ = true;
 }
 
@@ -474,49 +604,202 @@ void TemporalMemory::compute(const SDR &activeColumns,
   activateCells(activeColumns, learn);
 }
 
+void TemporalMemory::setThreadPool(const std::shared_ptr<ThreadPool> &pool) {
+  threadPool_ = pool;
+  connections.setThreadPool(pool);
+}
+
+// The anomaly score of the mode, from the raw anomaly score.
+static Real scoreAnomaly(const TemporalMemory::ANMode mode, const Real raw, AnomalyLikelihood &likelihood) {
+  switch(mode) {
+	case TemporalMemory::ANMode::DISABLED:
+	  return 0.5f;
+	case TemporalMemory::ANMode::RAW:
+	  return raw;
+	case TemporalMemory::ANMode::LIKELIHOOD:
+	  return likelihood.anomalyProbability(raw);
+	case TemporalMemory::ANMode::LOGLIKELIHOOD: {
+	  const Real like = likelihood.anomalyProbability(raw);
+	  return likelihood.computeLogLikelihood(like);
+	}
+  // TODO: Update mean & standard deviation of anomaly here.
+  };
+  return raw;
+}
+
+TemporalMemory::Stream TemporalMemory::createStream() const {
+  return Stream(rng_, tmAnomaly_.anomalyLikelihood_);
+}
+
+void TemporalMemory::prepareStreams() {
+  if (frozen_) return;
+  if (frozenConnections_ == nullptr or frozenConnections_->revision() != connections.revision()) {
+    frozenConnections_ = std::make_shared<const FrozenConnections>(connections);
+  }
+}
+
+void TemporalMemory::computeStreams(const vector<SDR> &activeColumns, vector<Stream> &streams) const {
+  NTA_CHECK(columnDimensions_.size() > 0) << "TM constructed using the default TM() constructor, which may only be used for serialization.";
+  NTA_CHECK(activeColumns.size() == streams.size())
+    << "TM computeStreams: " << activeColumns.size() << " inputs for " << streams.size() << " streams";
+  NTA_CHECK(externalPredictiveInputs_ == 0u) << "TM computeStreams does not support external predictive inputs";
+  NTA_CHECK(frozen_ or (frozenConnections_ != nullptr and frozenConnections_->revision() == connections.revision()))
+    << "TM computeStreams: call prepareStreams after the connections changed";
+  for (const auto &input : activeColumns) {
+    NTA_CHECK(input.size == numColumns_) << "TM invalid input size: " << input.size << " vs. " << numColumns_;
+    input.getSparse(); //not thread-safe the first time
+  }
+
+  // The streams are independent, each has its own random generator.
+  std::lock_guard<std::mutex> lock(streamMutex_);
+  const size_t numThreads = threadPool_ == nullptr ? 1u : threadPool_->size();
+  if (streamScratch_.size() < numThreads) {
+    streamScratch_.resize(numThreads);
+  }
+  if (threadPool_ == nullptr) {
+    for (size_t i = 0; i < streams.size(); i++) {
+      computeStream_(activeColumns[i], streams[i], streamScratch_[0]);
+    }
+  }
+  else {
+    threadPool_->parallelFor(streams.size(), [&](const size_t i, const UInt thread) {
+      computeStream_(activeColumns[i], streams[i], streamScratch_[thread]);
+    });
+  }
+}
+
+void TemporalMemory::computeStream_(const SDR &activeColumns, Stream &stream,
+                                    StreamScratch &scratch) const {
+  const FrozenConnections &frozen = *frozenConnections_;
+
+  // activateDendrites
+  frozen.computeActivity(scratch.activity, stream.activeCells);
+  selectSegments_(scratch.activity, frozen, scratch.activeSegments, scratch.matchingSegments);
+
+  // calculateAnomalyScore_
+  Real raw = 0.0f;
+  if (tmAnomaly_.mode_ != ANMode::DISABLED) {
+    raw = rawAnomalyScore_(activeColumns, scratch.activeSegments, frozen,
+                           scratch.predictedColumns, scratch.predictedColumnsSparse);
+  }
+  stream.anomaly = scoreAnomaly(tmAnomaly_.mode_, raw, stream.anomalyLikelihood);
+
+  // activateCells, without learning
+  stream.activeCells.clear();
+  stream.winnerCells.clear();
+  const auto toColumns = [&](const Segment segment) {
+    return frozen.cellForSegment(segment) / cellsPerColumn_;
+  };
+  const auto identity = [](const ElemSparse a) {return a;};
+  for (auto &&columnData : groupBy(
+           activeColumns.getSparse(), identity,
+           scratch.activeSegments,    toColumns,
+           scratch.matchingSegments,  toColumns)) {
+    UInt column;
+    vector<UInt>::const_iterator activeColumnsBegin, activeColumnsEnd;
+    vector<Segment>::const_iterator activeBegin, activeEnd, matchingBegin, matchingEnd;
+    std::tie(column, activeColumnsBegin, activeColumnsEnd,
+             activeBegin, activeEnd, matchingBegin, matchingEnd) = columnData;
+    if (activeColumnsBegin == activeColumnsEnd) continue;
+
+    if (activeBegin != activeEnd) { // see activatePredictedColumn_
+      for (auto segment = activeBegin; segment != activeEnd; segment++) {
+        const CellIdx cell = frozen.cellForSegment(*segment);
+        if (stream.activeCells.empty() or stream.activeCells.back() != cell) {
+          stream.activeCells.push_back(cell);
+          stream.winnerCells.push_back(cell);
+        }
+      }
+    } else { // see burstColumn_
+      for (CellIdx cell = column * cellsPerColumn_; cell < (column + 1) * cellsPerColumn_; cell++) {
+        stream.activeCells.push_back(cell);
+      }
+      const auto bestMatchingSegment =
+          std::max_element(matchingBegin, matchingEnd, [&](Segment a, Segment b) {
+            return (scratch.activity.numActivePotential[a] <
+                    scratch.activity.numActivePotential[b]);
+          });
+      if (bestMatchingSegment != matchingEnd) {
+        stream.winnerCells.push_back(frozen.cellForSegment(*bestMatchingSegment));
+      } else {
+        // The cells with the fewest segments, see Connections::leastUsedCell.
+        const CellIdx start = column * cellsPerColumn_;
+        const CellIdx end   = start + cellsPerColumn_;
+        size_t minSegments = std::numeric_limits<size_t>::max();
+        UInt32 numLeastUsed = 0u;
+        for (CellIdx cell = start; cell < end; cell++) {
+          const size_t numSegments = frozen.numSegments(cell);
+          if (numSegments < minSegments) {
+            minSegments  = numSegments;
+            numLeastUsed = 0u;
+          }
+          numLeastUsed += (numSegments == minSegments);
+        }
+        UInt32 tieWinnerIndex = stream.rng.getUInt32(numLeastUsed);
+        for (CellIdx cell = start; cell < end; cell++) {
+          if (frozen.numSegments(cell) != minSegments) continue;
+          if (tieWinnerIndex-- == 0u) {
+            stream.winnerCells.push_back(cell);
+            break;
+          }
+        }
+      }
+    }
+  }
+}
+
+void TemporalMemory::freezeConnections() {
+  if (frozen_) return;
+  prepareStreams();
+  reset();
+  connections = Connections(numberOfCells(), connectedPermanence_); //releases the memory
+  connections.setThreadPool(threadPool_);
+  frozen_ = true;
+}
+
+template<typename Cells>
+Real TemporalMemory::rawAnomalyScore_(const SDR &activeColumns,
+                                      const vector<Segment> &activeSegments,
+                                      const Cells &cells,
+                                      SDR &predicted,
+                                      vector<CellIdx> &predictedColumns) const {
+  if (predicted.dimensions != activeColumns.dimensions) {
+    predicted.initialize(activeColumns.dimensions);
+  }
+  predictedColumns.clear();
+  for (const auto segment : activeSegments) {
+    const CellIdx column = cells.cellForSegment(segment) / cellsPerColumn_;
+    if (predictedColumns.empty() or predictedColumns.back() != column) {
+      predictedColumns.push_back(column);
+    }
+  }
+  predicted.setSparse(predictedColumns); //swaps
+  return computeRawAnomalyScore(activeColumns, predicted);
+}
+
 void TemporalMemory::calculateAnomalyScore_(const SDR &activeColumns){
 
   // Update Anomaly Metric.  The anomaly is the percent of active columns that
   // were not predicted. 
   // Must be computed here, between `activateDendrites()` and `activateCells()`.
-  switch(tmAnomaly_.mode_) {
-
-	case ANMode::DISABLED: {
-	  tmAnomaly_.anomaly_ = 0.5f;
-			   } break;
-
-	case ANMode::RAW: {
-	  tmAnomaly_.anomaly_ = computeRawAnomalyScore(
-							 activeColumns,
-							 cellsToColumns( getPredictiveCells() ));
-			  } break;
-
-	case ANMode::LIKELIHOOD: {
-	  const Real raw = computeRawAnomalyScore(
-						 activeColumns,
-						 cellsToColumns( getPredictiveCells() ));
-	  tmAnomaly_.anomaly_ = tmAnomaly_.anomalyLikelihood_.anomalyProbability(raw);
-				 } break;
-
-	case ANMode::LOGLIKELIHOOD: {
-	  const Real raw = computeRawAnomalyScore(
-						 activeColumns,
-						 cellsToColumns( getPredictiveCells() ));
-	  const Real like = tmAnomaly_.anomalyLikelihood_.anomalyProbability(raw);
-	  const Real log  = tmAnomaly_.anomalyLikelihood_.computeLogLikelihood(like);
-	  tmAnomaly_.anomaly_ = log;
-				} break;
-  // TODO: Update mean & standard deviation of anomaly here.
-  };
+  // The predicted columns are cellsToColumns( getPredictiveCells() ), from
+  // the active segments which are sorted by cell.
+  Real raw = 0.0f;
+  if (tmAnomaly_.mode_ != ANMode::DISABLED) {
+    NTA_ASSERT(segmentsValid_);
+    raw = rawAnomalyScore_(activeColumns, activeSegments_, connections,
+                           buffers_.predictedColumns, buffers_.predictedColumnsSparse);
+  }
+  tmAnomaly_.anomaly_ = scoreAnomaly(tmAnomaly_.mode_, raw, tmAnomaly_.anomalyLikelihood_);
   NTA_ASSERT(tmAnomaly_.anomaly_ >= 0.0f and tmAnomaly_.anomaly_ <= 1.0f) << "TM.anomaly is out-of-bounds!";
-
-
 }
 
 void TemporalMemory::compute(const SDR &activeColumns, const bool learn) {
-  SDR externalPredictiveInputsActive({ externalPredictiveInputs_ });
-  SDR externalPredictiveInputsWinners({ externalPredictiveInputs_ });
-  compute( activeColumns, learn, externalPredictiveInputsActive, externalPredictiveInputsWinners );
+  SDR &noExternalInputs = buffers_.noExternalInputs;
+  if (noExternalInputs.dimensions.size() != 1u or noExternalInputs.dimensions[0] != externalPredictiveInputs_) {
+    noExternalInputs.initialize({ externalPredictiveInputs_ });
+  }
+  compute( activeColumns, learn, noExternalInputs, noExternalInputs );
 }
 
 void TemporalMemory::reset(void) {
@@ -733,6 +1016,7 @@ bool TemporalMemory::operator==(const TemporalMemory &other) const {
       winnerCells_ != other.winnerCells_ ||
       maxSegmentsPerCell_ != other.maxSegmentsPerCell_ ||
       maxSynapsesPerSegment_ != other.maxSynapsesPerSegment_ ||
+      getSegmentEviction() != other.getSegmentEviction() ||
       tmAnomaly_.anomaly_ != other.tmAnomaly_.anomaly_ ||
       tmAnomaly_.mode_ != other.tmAnomaly_.mode_ || 
       tmAnomaly_.anomalyLikelihood_ != other.tmAnomaly_.anomalyLikelihood_ ) {
@@ -784,5 +1068,7 @@ void TemporalMemory::printParameters(std::ostream& out) const {
       << std::endl
       << "maxSegmentsPerCell        = " << getMaxSegmentsPerCell() << std::endl
       << "maxSynapsesPerSegment     = " << getMaxSynapsesPerSegment()
+      << std::endl
+      << "segmentEviction           = " << static_cast<int>(getSegmentEviction())
       << std::endl;
 }
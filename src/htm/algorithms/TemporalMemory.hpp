@@ -23,12 +23,16 @@
 #define NTA_TEMPORAL_MEMORY_HPP
 
 #include <htm/algorithms/Connections.hpp>
+#include <htm/algorithms/FrozenConnections.hpp>
 #include <htm/types/Types.hpp>
 #include <htm/types/Sdr.hpp>
 #include <htm/types/Serializable.hpp>
 #include <htm/utils/Random.hpp>
+#include <htm/utils/ThreadPool.hpp>
 #include <htm/algorithms/AnomalyLikelihood.hpp>
 
+#include <memory>
+#include <mutex>
 #include <vector>
 
 
@@ -131,6 +135,13 @@ public:
    *
    * @param anomalyMode (optional, default `ANMode::RAW`)from enum ANMode, how is 
    * `TM.anomaly` computed. Options ANMode {DISABLED, RAW, LIKELIHOOD, LOGLIKELIHOOD}
+   *
+   * @param segmentEviction (optional, default `SegmentEviction::LRU`) which
+   * segment is destroyed to make room for a new one, on a cell which has
+   * maxSegmentsPerCell segments. Options SegmentEviction {LRU, OLDEST,
+   * MIN_PERMANENCE}, see Connections.hpp. LRU keeps the segments which
+   * predict, OLDEST needs no bookkeeping of the active segments, and
+   * MIN_PERMANENCE forgets the weakest segments first.
    * 
    */
   TemporalMemory(
@@ -149,7 +160,8 @@ public:
       SynapseIdx      maxSynapsesPerSegment       = 255,
       bool            checkInputs                 = true,
       UInt            externalPredictiveInputs    = 0,
-      ANMode	      anomalyMode 		  = ANMode::RAW
+      ANMode	      anomalyMode 		  = ANMode::RAW,
+      SegmentEviction segmentEviction             = SegmentEviction::LRU
       );
 
   virtual void
@@ -169,11 +181,32 @@ public:
     SynapseIdx    maxSynapsesPerSegment       = 255,
     bool          checkInputs                 = true,
     UInt          externalPredictiveInputs    = 0,
-    ANMode        anomalyMode                 = ANMode::RAW
+    ANMode        anomalyMode                 = ANMode::RAW,
+    SegmentEviction segmentEviction           = SegmentEviction::LRU
     );
 
   virtual ~TemporalMemory();
 
+  /**
+   * Copy of the TM, its connections are copied with Connections::fork.
+   */
+  TemporalMemory(const TemporalMemory &other);
+
+  /**
+   * A copy of this TM to compute speculatively, eg. "what if the next
+   * inputs are X" for multi-step or multi-hypothesis forecasting, without
+   * modifying the learned state of this TM.
+   *
+   * After connections.setCopyOnWrite(true) the fork shares the connections
+   * with this TM copy-on-write, see Connections::fork: it is cheap to
+   * create, and when it learns it copies only the pages of the segments and
+   * synapses which it modifies, else it is a deep copy of the connections.
+   * The fork and this TM are independent, the fork computes exactly as a deep copy
+   * (eg. made by serialization), and both can be used in different threads.
+   * The fork uses the same thread pool, see setThreadPool.
+   */
+  TemporalMemory fork() const;
+
   //----------------------------------------------------------------------
   //  Main functions
   //----------------------------------------------------------------------
@@ -270,6 +303,93 @@ public:
   virtual void compute(const SDR &activeColumns, 
                        const bool learn = true);
 
+  /**
+   * Switch to the frozen mode, for inference only serving: take a read-only
+   * snapshot of the connections (see FrozenConnections) and release the
+   * connections, so that a frozen TM takes about 4 bytes per synapse.
+   *
+   * A frozen TM keeps no activity of its own (it is reset) and can not
+   * compute, learn or be saved. It infers with computeStreams, where the
+   * caller owns the state of each stream, with the same results as compute
+   * with learn false. Do not change the (empty) connections of a frozen TM.
+   * Copies of the TM share the snapshot. initialize or load leaves the
+   * frozen mode.
+   */
+  void freezeConnections();
+  bool isFrozen() const { return frozen_; }
+
+  /**
+   * @returns The snapshot made by freezeConnections, or nullptr.
+   */
+  const std::shared_ptr<const FrozenConnections> &getFrozenConnections() const
+    { return frozenConnections_; }
+
+  /**
+   * Use a thread pool for compute: for the segment activity (see
+   * Connections::setThreadPool), and in activateCells for adapting the
+   * permanences of the learning segments, which is split between the threads.
+   *
+   * The changes which are not independent between the columns (connecting,
+   * disconnecting and pruning synapses, new segments and synapses, and the
+   * random numbers) are then committed serially in the order of the columns,
+   * so the results are identical to the serial computation, for any number
+   * of threads.
+   *
+   * The pool is not serialized, and is shared by copies of this instance.
+   *
+   * @param pool ThreadPool to use, or nullptr to compute serially (default).
+   */
+  void setThreadPool(const std::shared_ptr<ThreadPool> &pool);
+  const std::shared_ptr<ThreadPool> &getThreadPool() const { return threadPool_; }
+
+  /**
+   * State of one input stream for computeStreams: what the TM keeps between
+   * two compute steps, without the connections. Many streams can share one
+   * trained TM, instead of a copy of the TM (and all its synapses) each.
+   */
+  struct Stream {
+    Stream(const Random &rng, const AnomalyLikelihood &likelihood)
+      : rng(rng), anomalyLikelihood(likelihood) {}
+
+    vector<CellIdx>   activeCells;
+    vector<CellIdx>   winnerCells;
+    Real              anomaly = 0.5f;
+    Random            rng;
+    AnomalyLikelihood anomalyLikelihood;
+  };
+
+  /**
+   * @returns A new stream without activity, like a new TM. The random
+   * generator and the anomaly likelihood start as copies of this TM's.
+   */
+  Stream createStream() const;
+
+  /**
+   * Prepare computeStreams for the current connections: takes the snapshot
+   * of freezeConnections if it is missing or out of date, the connections are
+   * kept. Call it again after the connections changed (eg after learning),
+   * before computeStreams. Not needed for a frozen TM.
+   */
+  void prepareStreams();
+
+  /**
+   * Inference for many independent streams which share these connections.
+   * Each streams[i] advances like a TM with its state would in
+   * compute(activeColumns[i], false), the TM itself does not change.
+   *
+   * Uses the snapshot of prepareStreams or freezeConnections, which must be
+   * up to date. With a thread pool (see setThreadPool) the streams are
+   * computed in parallel, the results do not depend on the number of
+   * threads. It is safe to call from several threads at once, each with its
+   * own streams, but the calls on one TM take turns, as they use its scratch
+   * buffers: pass many streams in one call instead.
+   * External predictive inputs are not supported.
+   *
+   * @param activeColumns Input of each stream.
+   * @param streams       States, from createStream.
+   */
+  void computeStreams(const vector<SDR> &activeColumns, vector<Stream> &streams) const;
+
   // ==============================
   //  Helper functions
   // ==============================
@@ -428,6 +548,11 @@ public:
    */
   SegmentIdx getMaxSegmentsPerCell() const;
 
+  /**
+   * Returns the segmentEviction policy, see constructor.
+   */
+  SegmentEviction getSegmentEviction() const { return connections.segmentEviction(); }
+
   /**
    * Returns the maxSynapsesPerSegment.
    *
@@ -464,6 +589,7 @@ public:
   CerealAdapter;
   template<class Archive>
   void save_ar(Archive & ar) const {
+    NTA_CHECK(not frozen_) << "TM: a frozen TemporalMemory can not be saved";
     ar(CEREAL_NVP(numColumns_),
        CEREAL_NVP(cellsPerColumn_),
        CEREAL_NVP(activationThreshold_),
@@ -499,7 +625,7 @@ public:
                           segments.begin(), 
                           std::find(segments.begin(), 
                           segments.end(), segment));
-      c.syn = numActiveConnectedSynapsesForSegment_[segment];
+      c.syn = segmentActivity_.numActiveConnected[segment];
       ar(c); // to keep iteration counts correct, only serialize one item per iteration.
     }
 
@@ -514,7 +640,7 @@ public:
                           segments.begin(), 
                           std::find(segments.begin(), 
                           segments.end(), segment));
-      c.syn = numActivePotentialSynapsesForSegment_[segment];
+      c.syn = segmentActivity_.numActivePotential[segment];
       ar(c);
     }
 
@@ -545,7 +671,11 @@ public:
        CEREAL_NVP(tmAnomaly_.anomalyLikelihood_),
        CEREAL_NVP(connections));
 
-    numActiveConnectedSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
+    frozenConnections_.reset();
+    frozen_ = false;
+    segmentActivity_.numActiveConnected.assign(connections.segmentFlatListLength(), 0);
+    segmentActivity_.numActivePotential.assign(connections.segmentFlatListLength(), 0);
+    segmentActivity_.touched.clear();
     cereal::size_type numActiveSegments;
     ar(cereal::make_size_tag(numActiveSegments));
     activeSegments_.resize(static_cast<size_t>(numActiveSegments));
@@ -554,10 +684,10 @@ public:
       ar(c);  
       Segment segment = connections.getSegment(c.cell, c.idx);
       activeSegments_[i] = segment;
-      numActiveConnectedSynapsesForSegment_[segment] = c.syn;
+      segmentActivity_.numActiveConnected[segment] = c.syn;
+      segmentActivity_.touched.push_back(segment);
     }
 
-    numActivePotentialSynapsesForSegment_.assign(connections.segmentFlatListLength(), 0);
     cereal::size_type numMatchingSegments;
     ar(cereal::make_size_tag(numMatchingSegments));
     matchingSegments_.resize(static_cast<size_t>(numMatchingSegments));
@@ -566,7 +696,8 @@ public:
       ar(c);
       Segment segment = connections.getSegment(c.cell, c.idx);
       matchingSegments_[i] = segment;
-      numActivePotentialSynapsesForSegment_[segment] = c.syn;
+      segmentActivity_.numActivePotential[segment] = c.syn;
+      segmentActivity_.touched.push_back(segment);
     }
   }
 
@@ -639,6 +770,51 @@ private:
 		     const SynapseIdx nDesiredNewSynapses,
 		     const vector<CellIdx> &prevWinnerCells);
 
+  /**
+   * The active and matching segments for a segment activity, sorted by
+   * `cells`, the Connections or the FrozenConnections.
+   */
+  template<typename Cells>
+  void selectSegments_(const SegmentActivity &activity,
+                       const Cells &cells,
+                       vector<Segment> &activeSegments,
+                       vector<Segment> &matchingSegments) const;
+
+  // Scratch buffers of one thread in computeStreams.
+  struct StreamScratch {
+    SegmentActivity activity;
+    vector<Segment> activeSegments;
+    vector<Segment> matchingSegments;
+    SDR             predictedColumns;
+    vector<CellIdx> predictedColumnsSparse;
+  };
+  void computeStream_(const SDR &activeColumns, Stream &stream, StreamScratch &scratch) const;
+
+  /**
+   * The raw anomaly score, from the columns of the active segments (sorted by
+   * cell). `Cells` is the Connections or the FrozenConnections, the other two
+   * arguments are buffers.
+   */
+  template<typename Cells>
+  Real rawAnomalyScore_(const SDR &activeColumns,
+                        const vector<Segment> &activeSegments,
+                        const Cells &cells,
+                        SDR &predicted,
+                        vector<CellIdx> &predictedColumns) const;
+
+  /**
+   * connections.adaptSegment, or with a thread pool the commit of the
+   * permanences adapted by adaptSegmentsInParallel_.
+   */
+  void adaptSegment_(const Segment segment, const SDR &prevActiveCells,
+                     const Permanence increment, const Permanence decrement);
+
+  /**
+   * Adapt the permanences of all segments which learn in this step of
+   * activateCells, in parallel, see setThreadPool.
+   */
+  void adaptSegmentsInParallel_(const vector<UInt> &activeColumns, const SDR &prevActiveCells);
+
   void calculateAnomalyScore_(const SDR &activeColumns);
 
 protected:
@@ -665,8 +841,42 @@ private:
   bool segmentsValid_;
   vector<Segment> activeSegments_;
   vector<Segment> matchingSegments_;
-  vector<SynapseIdx> numActiveConnectedSynapsesForSegment_;
-  vector<SynapseIdx> numActivePotentialSynapsesForSegment_;
+  SegmentActivity segmentActivity_; //reused by activateDendrites in each step
+  std::shared_ptr<const FrozenConnections> frozenConnections_; //see freezeConnections, prepareStreams
+  bool frozen_ = false; //see freezeConnections
+
+  // For activateCells with a thread pool: the segments to adapt in this
+  // step, in the order of adaptSegment_ calls, and their deferred updates.
+  std::shared_ptr<ThreadPool> threadPool_;
+  struct Adaption {
+    Segment    segment;
+    Permanence increment;
+    Permanence decrement;
+  };
+  vector<Adaption> adaptions_;
+  vector<vector<SynapseUpdate>> adaptionUpdates_;
+  size_t nextAdaption_ = 0u;
+
+  // Buffers reused between compute steps, so that compute does not allocate
+  // memory once they have grown. They are scratch space, and are not copied.
+  struct ComputeBuffers {
+    ComputeBuffers() {}
+    ComputeBuffers(const ComputeBuffers &) {}
+    ComputeBuffers &operator=(const ComputeBuffers &) { return *this; }
+
+    SDR             noExternalInputs; //see compute(activeColumns, learn)
+    SDR             prevActiveCells;
+    vector<CellIdx> prevWinnerCells;
+    vector<CellIdx> growCandidates;
+    SDR             predictedColumns; //see calculateAnomalyScore_
+    vector<CellIdx> predictedColumnsSparse;
+  };
+  ComputeBuffers buffers_;
+
+  // Scratch buffers of computeStreams, one for each thread of the thread
+  // pool, indexed by the `thread` of parallelFor. Not copied.
+  mutable vector<StreamScratch> streamScratch_;
+  mutable std::mutex            streamMutex_; //held by computeStreams, which uses streamScratch_
 
   Random rng_;
 
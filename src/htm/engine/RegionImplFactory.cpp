@@ -37,6 +37,7 @@
 #include <htm/regions/VectorFileSensor.hpp>
 #include <htm/regions/SPRegion.hpp>
 #include <htm/regions/TMRegion.hpp>
+#include <htm/regions/ColumnPoolerRegion.hpp>
 
 
 #include <htm/utils/Log.hpp>
@@ -92,6 +93,7 @@ RegionImplFactory &RegionImplFactory::getInstance() {
     instance.addRegionType("VectorFileSensor",   new RegisteredRegionImplCpp<VectorFileSensor>());
     instance.addRegionType("SPRegion",           new RegisteredRegionImplCpp<SPRegion>());
     instance.addRegionType("TMRegion",            new RegisteredRegionImplCpp<TMRegion>());
+    instance.addRegionType("ColumnPoolerRegion", new RegisteredRegionImplCpp<ColumnPoolerRegion>());
   }
 
   return instance;
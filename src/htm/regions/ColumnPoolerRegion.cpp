@@ -0,0 +1,743 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <htm/regions/ColumnPoolerRegion.hpp>
+
+#include <htm/engine/Spec.hpp>
+#include <htm/ntypes/Array.hpp>
+#include <htm/utils/Log.hpp>
+
+using namespace htm;
+
+ColumnPoolerRegion::ColumnPoolerRegion(const ValueMap &params, Region *region)
+    : RegionImpl(region), computeCallback_(nullptr) {
+  // Note: the ValueMap gets destroyed on return so we need to get all of the
+  //       parameters out of the map and set aside so we can pass them to the
+  //       ColumnPooler algorithm when we create it during initialization().
+  memset((char *)&args_, 0, sizeof(args_));
+  args_.cellCount = params.getScalarT<UInt32>("cellCount", 4096);
+  args_.inputWidth = params.getScalarT<UInt32>("inputWidth", 0);  // normally not passed in.
+  args_.numOtherCorticalColumns = params.getScalarT<UInt32>("numOtherCorticalColumns", 0);
+  args_.sdrSize = params.getScalarT<UInt32>("sdrSize", 40);
+  args_.maxSdrSize = params.getScalarT<UInt32>("maxSdrSize", 0);
+  args_.minSdrSize = params.getScalarT<UInt32>("minSdrSize", 0);
+  args_.synPermProximalInc = params.getScalarT<Real32>("synPermProximalInc", 0.1f);
+  args_.synPermProximalDec = params.getScalarT<Real32>("synPermProximalDec", 0.001f);
+  args_.initialProximalPermanence = params.getScalarT<Real32>("initialProximalPermanence", 0.6f);
+  args_.sampleSizeProximal = params.getScalarT<Int32>("sampleSizeProximal", 20);
+  args_.minThresholdProximal = params.getScalarT<UInt32>("minThresholdProximal", 1);
+  args_.connectedPermanenceProximal = params.getScalarT<Real32>("connectedPermanenceProximal", 0.50f);
+  args_.predictedInhibitionThreshold = params.getScalarT<UInt32>("predictedInhibitionThreshold", 20);
+  args_.synPermDistalInc = params.getScalarT<Real32>("synPermDistalInc", 0.1f);
+  args_.synPermDistalDec = params.getScalarT<Real32>("synPermDistalDec", 0.1f);
+  args_.initialDistalPermanence = params.getScalarT<Real32>("initialDistalPermanence", 0.21f);
+  args_.sampleSizeDistal = params.getScalarT<Int32>("sampleSizeDistal", 20);
+  args_.activationThresholdDistal = params.getScalarT<UInt32>("activationThresholdDistal", 13);
+  args_.connectedPermanenceDistal = params.getScalarT<Real32>("connectedPermanenceDistal", 0.50f);
+  args_.inertiaFactor = params.getScalarT<Real32>("inertiaFactor", 1.0f);
+  args_.seed = params.getScalarT<Int32>("seed", 42);
+  args_.onlineLearning = params.getScalarT<bool>("onlineLearning", false);
+
+  // variables used by this class and not passed on
+  args_.learningMode = params.getScalarT<bool>("learningMode", true);
+  args_.iter = 0;
+  pooler_ = nullptr;
+}
+
+ColumnPoolerRegion::ColumnPoolerRegion(ArWrapper& wrapper, Region *region)
+    : RegionImpl(region), computeCallback_(nullptr) {
+  pooler_ = nullptr;
+  cereal_adapter_load(wrapper);
+}
+
+ColumnPoolerRegion::~ColumnPoolerRegion() {
+}
+
+
+// Note: - this is called during Region initialization, after configuration
+//         is set but prior to calling initialize on this class to create the
+//         pooler.
+//       - This is not called if output dimensions were explicitly set for this output.
+//       - This call determines the dimensions set on the Output buffers.
+Dimensions ColumnPoolerRegion::askImplForOutputDimensions(const std::string &name) {
+  if (name == "feedForwardOutput" || name == "activeCells") {
+    // It's size is cellCount, regardless of the input.
+    return Dimensions(args_.cellCount);
+  }
+  return RegionImpl::askImplForOutputDimensions(name);
+}
+
+
+void ColumnPoolerRegion::initialize() {
+
+  // All input links and buffers should have been initialized during
+  // Network.initialize() prior to calling this method.
+  std::shared_ptr<Input> in = region_->getInput("feedforwardInput");
+  if (!in || !in->hasIncomingLinks())
+      NTA_THROW << "ColumnPoolerRegion::initialize - No input was provided.\n";
+  NTA_ASSERT(in->getData().getType() == NTA_BasicType_SDR);
+
+  const UInt32 inputWidth = (UInt32)in->getDimensions().getCount();
+  if (args_.inputWidth == 0)
+    args_.inputWidth = inputWidth;
+  else
+    NTA_CHECK(args_.inputWidth == inputWidth)
+    << "The width of the feedforwardInput input buffer (" << inputWidth
+    << ") does not match the configured value for 'inputWidth' ("
+    << args_.inputWidth << ").";
+
+  // Every lateral input is of size 'cellCount'. If there are several links
+  // the input buffer is the concatenation of the other cortical columns.
+  in = region_->getInput("lateralInput");
+  if (in && in->hasIncomingLinks()) {
+    NTA_CHECK(in->getDimensions().getCount() == (size_t)args_.numOtherCorticalColumns * args_.cellCount)
+      << "The width of the lateralInput input buffer (" << in->getDimensions().getCount()
+      << ") should be numOtherCorticalColumns * cellCount ("
+      << args_.numOtherCorticalColumns << " * " << args_.cellCount << ").";
+  }
+  in = region_->getInput("feedforwardGrowthCandidates");
+  if (in && in->hasIncomingLinks()) {
+    NTA_CHECK(in->getDimensions().getCount() == args_.inputWidth)
+      << "The width of the feedforwardGrowthCandidates input buffer ("
+      << in->getDimensions().getCount() << ") does not match feedforwardInput ("
+      << args_.inputWidth << ").";
+  }
+
+  const std::vector<UInt> lateralInputWidths(args_.numOtherCorticalColumns, args_.cellCount);
+  ColumnPooler* pooler = new ColumnPooler(
+      args_.inputWidth, lateralInputWidths, args_.cellCount, args_.sdrSize,
+      args_.onlineLearning, args_.maxSdrSize, args_.minSdrSize,
+      args_.synPermProximalInc, args_.synPermProximalDec, args_.initialProximalPermanence,
+      args_.sampleSizeProximal, args_.minThresholdProximal,
+      args_.connectedPermanenceProximal, args_.predictedInhibitionThreshold,
+      args_.synPermDistalInc, args_.synPermDistalDec, args_.initialDistalPermanence,
+      args_.sampleSizeDistal, args_.activationThresholdDistal,
+      args_.connectedPermanenceDistal, args_.inertiaFactor, args_.seed);
+  pooler_.reset(pooler);
+  initializeLateralInputs_();
+
+  args_.iter = 0;
+}
+
+
+void ColumnPoolerRegion::initializeLateralInputs_() {
+  lateralInputs_.assign(args_.numOtherCorticalColumns, SDR({ args_.cellCount }));
+}
+
+
+void ColumnPoolerRegion::compute() {
+
+  NTA_ASSERT(pooler_) << "ColumnPooler not initialized";
+
+  if (computeCallback_ != nullptr)
+    computeCallback_(getName());
+  args_.iter++;
+
+  // Handle reset signal. The reset is sent with an empty signal, the outputs
+  // are empty.
+  if (getInput("resetIn")->hasIncomingLinks()) {
+    Array &reset = getInput("resetIn")->getData();
+    NTA_ASSERT(reset.getType() == NTA_BasicType_Real32);
+    if (reset.getCount() == 1 && ((Real32 *)(reset.getBuffer()))[0] != 0) {
+      pooler_->reset();
+      getOutput("feedForwardOutput")->getData().getSDR().zero();
+      getOutput("activeCells")->getData().getSDR().zero();
+      return;
+    }
+  }
+
+  std::shared_ptr<Input> in = getInput("feedforwardInput");
+  const SDR& feedforwardInput = in->getData().getSDR();
+
+  std::shared_ptr<Input> growth = getInput("feedforwardGrowthCandidates");
+  const SDR& feedforwardGrowthCandidates = growth->hasIncomingLinks()
+                                         ? growth->getData().getSDR() : feedforwardInput;
+
+  static const SDR nullSDR({0});
+  std::shared_ptr<Input> predicted = getInput("predictedInput");
+  const SDR& predictedInput = predicted->hasIncomingLinks()
+                            ? predicted->getData().getSDR() : nullSDR;
+
+  // Split the lateral input into one SDR per other cortical column.
+  std::shared_ptr<Input> lateral = getInput("lateralInput");
+  static const std::vector<SDR> noLateralInputs;
+  if (lateral->hasIncomingLinks()) {
+    std::vector<std::vector<UInt>> sparse(lateralInputs_.size());
+    for (const auto bit : lateral->getData().getSDR().getSparse()) {
+      sparse[bit / args_.cellCount].push_back(bit % args_.cellCount);
+    }
+    for (size_t i = 0; i < lateralInputs_.size(); i++) {
+      lateralInputs_[i].setSparse(sparse[i]);
+    }
+  }
+
+  // Trace facility
+  NTA_DEBUG << "compute " << *in << std::endl;
+
+  pooler_->compute(feedforwardInput,
+                   lateral->hasIncomingLinks() ? lateralInputs_ : noLateralInputs,
+                   feedforwardGrowthCandidates,
+                   args_.learningMode,
+                   predictedInput);
+
+  std::shared_ptr<Output> out = getOutput("activeCells");
+    pooler_->getActiveCells(out->getData().getSDR());
+    NTA_DEBUG << "compute " << *out << std::endl;
+
+  out = getOutput("feedForwardOutput");
+    pooler_->getActiveCells(out->getData().getSDR());
+    NTA_DEBUG << "compute " << *out << std::endl;
+}
+
+
+std::string ColumnPoolerRegion::executeCommand(const std::vector<std::string> &args, Int64 index) {
+  NTA_CHECK(!args.empty());
+  if (args[0] == "reset") {
+    if (pooler_)
+      pooler_->reset();
+    return "";
+  }
+  NTA_THROW << "ColumnPoolerRegion::executeCommand -- unknown command " << args[0];
+}
+
+
+/********************************************************************/
+
+Spec *ColumnPoolerRegion::createSpec() {
+  auto ns = new Spec;
+
+  ns->description =
+      "ColumnPoolerRegion. The ColumnPoolerRegion implements an L2 layer "
+      "within a single cortical column / cortical module. The layer supports "
+      "feed forward (proximal) and lateral inputs. C++ version of the Python "
+      "region py.ColumnPoolerRegion.";
+
+  ns->singleNodeOnly = true;
+
+  /* ---- parameters ------ */
+
+  /* constructor arguments */
+  ns->parameters.add(
+      "cellCount",
+      ParameterSpec("(int) Number of cells in this layer.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "4096",                        // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "inputWidth",
+      ParameterSpec("(int) Number of inputs to the layer. Normally this value "
+                    "is derived from the width of the feedforwardInput but if "
+                    "provided, this parameter must be the same size as the input.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0",                           // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "numOtherCorticalColumns",
+      ParameterSpec("(int) The number of lateral inputs that this L2 will "
+                    "receive. This region assumes that every lateral input is "
+                    "of size 'cellCount'.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0",                           // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "sdrSize",
+      ParameterSpec("(int) The number of active cells invoked per object.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "40",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "maxSdrSize",
+      ParameterSpec("(int) The largest number of active cells in an SDR "
+                    "tolerated during learning. Stops learning when unions "
+                    "are active. 0 means sdrSize.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0",                           // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "minSdrSize",
+      ParameterSpec("(int) The smallest number of active cells in an SDR "
+                    "tolerated during learning. Stops learning when possibly "
+                    "on a different object or sequence. 0 means sdrSize.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0",                           // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "synPermProximalInc",
+      ParameterSpec("(float) Amount by which permanences of proximal synapses "
+                    "are incremented during learning.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.1",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "synPermProximalDec",
+      ParameterSpec("(float) Amount by which permanences of proximal synapses "
+                    "are decremented during learning.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.001",                       // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "initialProximalPermanence",
+      ParameterSpec("(float) Initial permanence of a new proximal synapse.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.6",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "sampleSizeProximal",
+      ParameterSpec("(int) The desired number of active synapses for an "
+                    "active cell, -1 to connect to every active bit.",
+                    NTA_BasicType_Int32,           // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "20",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "minThresholdProximal",
+      ParameterSpec("(int) If the number of synapses active on a proximal "
+                    "segment is at least this threshold, it is considered as "
+                    "a candidate active cell.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "1",                           // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "connectedPermanenceProximal",
+      ParameterSpec("(float) If the permanence value for a proximal synapse "
+                    "is greater than this value, it is said to be connected.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.5",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "predictedInhibitionThreshold",
+      ParameterSpec("(int) How many predicted cells are required to cause "
+                    "inhibition in the pooler. Only has an effect if online "
+                    "learning is enabled.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "20",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "synPermDistalInc",
+      ParameterSpec("(float) Amount by which permanences of distal synapses "
+                    "are incremented during learning.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.1",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "synPermDistalDec",
+      ParameterSpec("(float) Amount by which permanences of distal synapses "
+                    "are decremented during learning.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.1",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "initialDistalPermanence",
+      ParameterSpec("(float) Initial permanence of a new distal synapse.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.21",                        // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "sampleSizeDistal",
+      ParameterSpec("(int) The desired number of active synapses for an "
+                    "active distal segment, -1 to connect to every active bit.",
+                    NTA_BasicType_Int32,           // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "20",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "activationThresholdDistal",
+      ParameterSpec("(int) If the number of synapses active on a distal "
+                    "segment is at least this threshold, the segment is "
+                    "considered active.",
+                    NTA_BasicType_UInt32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "13",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "connectedPermanenceDistal",
+      ParameterSpec("(float) If the permanence value for a distal synapse "
+                    "is greater than this value, it is said to be connected.",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "0.5",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "inertiaFactor",
+      ParameterSpec("(float) Controls the proportion of previously active "
+                    "cells that remain active through inertia in the next "
+                    "timestep (in the absence of inhibition).",
+                    NTA_BasicType_Real32,          // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "1.0",                         // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "seed",
+      ParameterSpec("(int) Seed for the random number generator.",
+                    NTA_BasicType_Int32,           // type
+                    1,                             // elementCount
+                    "",                            // constraints
+                    "42",                          // defaultValue
+                    ParameterSpec::CreateAccess)); // access
+
+  ns->parameters.add(
+      "onlineLearning",
+      ParameterSpec("Whether to use onlineLearning or not (default false).",
+                    NTA_BasicType_Bool,            // type
+                    1,                             // elementCount
+                    "bool",                        // constraints
+                    "false",                       // defaultValue
+                    ParameterSpec::ReadWriteAccess)); // access
+
+  ///////// Parameters not part of the calling arguments //////////
+  ns->parameters.add(
+      "learningMode",
+      ParameterSpec("Whether the node is learning (default true).",
+                    NTA_BasicType_Bool,            // type
+                    1,                             // elementCount
+                    "bool",                        // constraints
+                    "true",                        // defaultValue
+                    ParameterSpec::ReadWriteAccess)); // access
+
+
+  ///////////// Inputs and Outputs ////////////////
+  /* ----- inputs ------- */
+  ns->inputs.add(
+      "feedforwardInput",
+      InputSpec("The primary feed-forward input to the layer. Sets "
+                "inputWidth if not configured.",
+                NTA_BasicType_SDR,   // type
+                0,                   // count.
+                true,                // required?
+                true,                // isRegionLevel,
+                true                 // isDefaultInput
+                ));
+
+  ns->inputs.add(
+      "feedforwardGrowthCandidates",
+      InputSpec("The feedforward input that can be learned on new proximal "
+                "synapses. If this input isn't provided, the whole "
+                "feedforwardInput is used.",
+                NTA_BasicType_SDR,   // type
+                0,                   // count.
+                false,               // required?
+                false,               // isRegionLevel,
+                false                // isDefaultInput
+                ));
+
+  ns->inputs.add(
+      "predictedInput",
+      InputSpec("The input cells that are predicted to become active in the "
+                "next time step. If this input is not provided, some features "
+                "related to online learning may not function properly.",
+                NTA_BasicType_SDR,   // type
+                0,                   // count.
+                false,               // required?
+                false,               // isRegionLevel,
+                false                // isDefaultInput
+                ));
+
+  ns->inputs.add(
+      "lateralInput",
+      InputSpec("Lateral input into this column, presumably from other "
+                "neighboring columns. The width is numOtherCorticalColumns * "
+                "cellCount.",
+                NTA_BasicType_SDR,   // type
+                0,                   // count.
+                false,               // required?
+                false,               // isRegionLevel,
+                false                // isDefaultInput
+                ));
+
+  ns->inputs.add(
+      "resetIn",
+      InputSpec("A boolean flag that indicates whether or not the input "
+                "vector received in this compute cycle represents the first "
+                "presentation in a new temporal sequence.",
+                NTA_BasicType_Real32, // type
+                1,                    // count.
+                false,                // required?
+                false,                // isRegionLevel,
+                false                 // isDefaultInput
+                ));
+
+
+  /* ----- outputs ------ */
+  ns->outputs.add(
+      "feedForwardOutput",
+      OutputSpec("The default output of ColumnPoolerRegion, the active cells. "
+                 "The width is 'cellCount'.",
+                 NTA_BasicType_SDR,    // type
+                 0,                    // count 0 means is dynamic
+                 false,                // isRegionLevel
+                 true                  // isDefaultOutput
+                 ));
+
+  ns->outputs.add(
+      "activeCells",
+      OutputSpec("The cells that are currently active. "
+                 "The width is 'cellCount'.",
+                 NTA_BasicType_SDR,    // type
+                 0,                    // count 0 means is dynamic
+                 false,                // isRegionLevel
+                 false                 // isDefaultOutput
+                 ));
+
+
+  /* ----- commands ------ */
+  ns->commands.add("reset", CommandSpec("Explicitly reset the pooler states now."));
+
+  return ns;
+}
+
+////////////////////////////////////////////////////////////////////////
+//           Parameters
+//
+// Parameters are explicitly handled here until initialization.
+// After initialization they are read from the pooler_.
+//
+////////////////////////////////////////////////////////////////////////
+
+UInt32 ColumnPoolerRegion::getParameterUInt32(const std::string &name, Int64 index) {
+  if (name == "cellCount") {
+    if (pooler_)
+      return pooler_->numberOfCells();
+    return args_.cellCount;
+  }
+  if (name == "inputWidth") {
+    if (pooler_)
+      return pooler_->numberOfInputs();
+    return args_.inputWidth;
+  }
+  if (name == "numOtherCorticalColumns")
+    return args_.numOtherCorticalColumns;
+  if (name == "sdrSize") {
+    if (pooler_)
+      return pooler_->getSdrSize();
+    return args_.sdrSize;
+  }
+  if (name == "maxSdrSize") {
+    if (pooler_)
+      return pooler_->getMaxSdrSize();
+    return args_.maxSdrSize;
+  }
+  if (name == "minSdrSize") {
+    if (pooler_)
+      return pooler_->getMinSdrSize();
+    return args_.minSdrSize;
+  }
+  if (name == "minThresholdProximal") {
+    if (pooler_)
+      return pooler_->getMinThresholdProximal();
+    return args_.minThresholdProximal;
+  }
+  if (name == "predictedInhibitionThreshold") {
+    if (pooler_)
+      return pooler_->getPredictedInhibitionThreshold();
+    return args_.predictedInhibitionThreshold;
+  }
+  if (name == "activationThresholdDistal") {
+    if (pooler_)
+      return pooler_->getActivationThresholdDistal();
+    return args_.activationThresholdDistal;
+  }
+  return this->RegionImpl::getParameterUInt32(name, index); // default
+}
+
+
+Int32 ColumnPoolerRegion::getParameterInt32(const std::string &name, Int64 index) {
+  if (name == "sampleSizeProximal") {
+    if (pooler_)
+      return pooler_->getSampleSizeProximal();
+    return args_.sampleSizeProximal;
+  }
+  if (name == "sampleSizeDistal") {
+    if (pooler_)
+      return pooler_->getSampleSizeDistal();
+    return args_.sampleSizeDistal;
+  }
+  if (name == "seed") {
+    return args_.seed;
+  }
+  return this->RegionImpl::getParameterInt32(name, index); // default
+}
+
+
+Real32 ColumnPoolerRegion::getParameterReal32(const std::string &name, Int64 index) {
+  if (name == "synPermProximalInc") {
+    if (pooler_)
+      return pooler_->getSynPermProximalInc();
+    return args_.synPermProximalInc;
+  }
+  if (name == "synPermProximalDec") {
+    if (pooler_)
+      return pooler_->getSynPermProximalDec();
+    return args_.synPermProximalDec;
+  }
+  if (name == "initialProximalPermanence") {
+    if (pooler_)
+      return pooler_->getInitialProximalPermanence();
+    return args_.initialProximalPermanence;
+  }
+  if (name == "connectedPermanenceProximal") {
+    if (pooler_)
+      return pooler_->getConnectedPermanenceProximal();
+    return args_.connectedPermanenceProximal;
+  }
+  if (name == "synPermDistalInc") {
+    if (pooler_)
+      return pooler_->getSynPermDistalInc();
+    return args_.synPermDistalInc;
+  }
+  if (name == "synPermDistalDec") {
+    if (pooler_)
+      return pooler_->getSynPermDistalDec();
+    return args_.synPermDistalDec;
+  }
+  if (name == "initialDistalPermanence") {
+    if (pooler_)
+      return pooler_->getInitialDistalPermanence();
+    return args_.initialDistalPermanence;
+  }
+  if (name == "connectedPermanenceDistal") {
+    if (pooler_)
+      return pooler_->getConnectedPermanenceDistal();
+    return args_.connectedPermanenceDistal;
+  }
+  if (name == "inertiaFactor") {
+    if (pooler_)
+      return pooler_->getInertiaFactor();
+    return args_.inertiaFactor;
+  }
+  return this->RegionImpl::getParameterReal32(name, index); // default
+}
+
+
+bool ColumnPoolerRegion::getParameterBool(const std::string &name, Int64 index) {
+  if (name == "onlineLearning") {
+    if (pooler_)
+      return pooler_->getOnlineLearning();
+    return args_.onlineLearning;
+  }
+  if (name == "learningMode")
+    return args_.learningMode;
+
+  return this->RegionImpl::getParameterBool(name, index); // default
+}
+
+
+void ColumnPoolerRegion::setParameterBool(const std::string &name, Int64 index, bool value) {
+  if (name == "onlineLearning") {
+    if (pooler_)
+      pooler_->setOnlineLearning(value);
+    args_.onlineLearning = value;
+    return;
+  }
+  if (name == "learningMode") {
+    args_.learningMode = value;
+    return;
+  }
+  RegionImpl::setParameterBool(name, index, value);
+}
+
+
+bool ColumnPoolerRegion::operator==(const RegionImpl &o) const {
+  if (o.getType() != "ColumnPoolerRegion") return false;
+  ColumnPoolerRegion& other = (ColumnPoolerRegion&)o;
+  if (args_.cellCount != other.args_.cellCount) return false;
+  if (args_.inputWidth != other.args_.inputWidth) return false;
+  if (args_.numOtherCorticalColumns != other.args_.numOtherCorticalColumns) return false;
+  if (args_.sdrSize != other.args_.sdrSize) return false;
+  if (args_.maxSdrSize != other.args_.maxSdrSize) return false;
+  if (args_.minSdrSize != other.args_.minSdrSize) return false;
+  if (args_.synPermProximalInc != other.args_.synPermProximalInc) return false;
+  if (args_.synPermProximalDec != other.args_.synPermProximalDec) return false;
+  if (args_.initialProximalPermanence != other.args_.initialProximalPermanence) return false;
+  if (args_.sampleSizeProximal != other.args_.sampleSizeProximal) return false;
+  if (args_.minThresholdProximal != other.args_.minThresholdProximal) return false;
+  if (args_.connectedPermanenceProximal != other.args_.connectedPermanenceProximal) return false;
+  if (args_.predictedInhibitionThreshold != other.args_.predictedInhibitionThreshold) return false;
+  if (args_.synPermDistalInc != other.args_.synPermDistalInc) return false;
+  if (args_.synPermDistalDec != other.args_.synPermDistalDec) return false;
+  if (args_.initialDistalPermanence != other.args_.initialDistalPermanence) return false;
+  if (args_.sampleSizeDistal != other.args_.sampleSizeDistal) return false;
+  if (args_.activationThresholdDistal != other.args_.activationThresholdDistal) return false;
+  if (args_.connectedPermanenceDistal != other.args_.connectedPermanenceDistal) return false;
+  if (args_.inertiaFactor != other.args_.inertiaFactor) return false;
+  if (args_.seed != other.args_.seed) return false;
+  if (args_.onlineLearning != other.args_.onlineLearning) return false;
+  if (args_.learningMode != other.args_.learningMode) return false;
+  if (args_.iter != other.args_.iter) return false;
+  if (dim_ != other.dim_) return false;  // from RegionImpl
+  if ((pooler_ && !other.pooler_) || (other.pooler_ && !pooler_)) return false;
+  if (pooler_ && (*pooler_ != *other.pooler_)) return false;
+
+  return true;
+}
@@ -0,0 +1,204 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Declarations for ColumnPoolerRegion class
+ *
+ * C++ version of py/htm/advanced/regions/ColumnPoolerRegion.py, with the
+ * same parameters, inputs and outputs.
+ */
+
+//----------------------------------------------------------------------
+
+#ifndef NTA_COLUMNPOOLERREGION_HPP
+#define NTA_COLUMNPOOLERREGION_HPP
+
+#include <htm/engine/RegionImpl.hpp>
+#include <htm/algorithms/ColumnPooler.hpp>
+
+#include <htm/ntypes/Value.hpp>
+//----------------------------------------------------------------------
+
+namespace htm {
+class ColumnPoolerRegion : public RegionImpl, Serializable {
+  typedef void (*computeCallbackFunc)(const std::string &);
+  typedef std::map<std::string, Spec> SpecMap;
+
+public:
+  ColumnPoolerRegion() = delete;
+  ColumnPoolerRegion(const ColumnPoolerRegion &) = delete;
+  ColumnPoolerRegion(const ValueMap &params, Region *region);
+  ColumnPoolerRegion(ArWrapper& wrapper, Region *region);
+  virtual ~ColumnPoolerRegion();
+
+  /* -----------  Required RegionImpl Interface methods ------- */
+
+  // Used by RegionImplFactory to create and cache
+  // a nodespec. Ownership is transferred to the caller.
+  static Spec *createSpec();
+
+  std::string getNodeType() { return "ColumnPoolerRegion"; };
+
+  // Compute outputs from inputs and internal state
+  void compute() override;
+
+  /**
+   * Inputs/Outputs are made available in initialize()
+   * It is always called after the constructor (or load from serialized state)
+   */
+  void initialize() override;
+
+  CerealAdapter;  // see Serializable.hpp
+  // FOR Cereal Serialization
+  template<class Archive>
+  void save_ar(Archive& ar) const {
+    bool init = ((pooler_) ? true : false);
+    ar(cereal::make_nvp("cellCount", args_.cellCount));
+    ar(cereal::make_nvp("inputWidth", args_.inputWidth));
+    ar(cereal::make_nvp("numOtherCorticalColumns", args_.numOtherCorticalColumns));
+    ar(cereal::make_nvp("sdrSize", args_.sdrSize));
+    ar(cereal::make_nvp("maxSdrSize", args_.maxSdrSize));
+    ar(cereal::make_nvp("minSdrSize", args_.minSdrSize));
+    ar(cereal::make_nvp("synPermProximalInc", args_.synPermProximalInc));
+    ar(cereal::make_nvp("synPermProximalDec", args_.synPermProximalDec));
+    ar(cereal::make_nvp("initialProximalPermanence", args_.initialProximalPermanence));
+    ar(cereal::make_nvp("sampleSizeProximal", args_.sampleSizeProximal));
+    ar(cereal::make_nvp("minThresholdProximal", args_.minThresholdProximal));
+    ar(cereal::make_nvp("connectedPermanenceProximal", args_.connectedPermanenceProximal));
+    ar(cereal::make_nvp("predictedInhibitionThreshold", args_.predictedInhibitionThreshold));
+    ar(cereal::make_nvp("synPermDistalInc", args_.synPermDistalInc));
+    ar(cereal::make_nvp("synPermDistalDec", args_.synPermDistalDec));
+    ar(cereal::make_nvp("initialDistalPermanence", args_.initialDistalPermanence));
+    ar(cereal::make_nvp("sampleSizeDistal", args_.sampleSizeDistal));
+    ar(cereal::make_nvp("activationThresholdDistal", args_.activationThresholdDistal));
+    ar(cereal::make_nvp("connectedPermanenceDistal", args_.connectedPermanenceDistal));
+    ar(cereal::make_nvp("inertiaFactor", args_.inertiaFactor));
+    ar(cereal::make_nvp("seed", args_.seed));
+    ar(cereal::make_nvp("onlineLearning", args_.onlineLearning));
+    ar(cereal::make_nvp("learningMode", args_.learningMode));
+    ar(cereal::make_nvp("iter", args_.iter));
+    ar(cereal::make_nvp("init", init));
+    if (init) {
+      // Save the algorithm state
+      ar(cereal::make_nvp("ColumnPooler", pooler_));
+    }
+  }
+
+  // FOR Cereal Deserialization
+  template<class Archive>
+  void load_ar(Archive& ar) {
+    bool init = false;
+    ar(cereal::make_nvp("cellCount", args_.cellCount));
+    ar(cereal::make_nvp("inputWidth", args_.inputWidth));
+    ar(cereal::make_nvp("numOtherCorticalColumns", args_.numOtherCorticalColumns));
+    ar(cereal::make_nvp("sdrSize", args_.sdrSize));
+    ar(cereal::make_nvp("maxSdrSize", args_.maxSdrSize));
+    ar(cereal::make_nvp("minSdrSize", args_.minSdrSize));
+    ar(cereal::make_nvp("synPermProximalInc", args_.synPermProximalInc));
+    ar(cereal::make_nvp("synPermProximalDec", args_.synPermProximalDec));
+    ar(cereal::make_nvp("initialProximalPermanence", args_.initialProximalPermanence));
+    ar(cereal::make_nvp("sampleSizeProximal", args_.sampleSizeProximal));
+    ar(cereal::make_nvp("minThresholdProximal", args_.minThresholdProximal));
+    ar(cereal::make_nvp("connectedPermanenceProximal", args_.connectedPermanenceProximal));
+    ar(cereal::make_nvp("predictedInhibitionThreshold", args_.predictedInhibitionThreshold));
+    ar(cereal::make_nvp("synPermDistalInc", args_.synPermDistalInc));
+    ar(cereal::make_nvp("synPermDistalDec", args_.synPermDistalDec));
+    ar(cereal::make_nvp("initialDistalPermanence", args_.initialDistalPermanence));
+    ar(cereal::make_nvp("sampleSizeDistal", args_.sampleSizeDistal));
+    ar(cereal::make_nvp("activationThresholdDistal", args_.activationThresholdDistal));
+    ar(cereal::make_nvp("connectedPermanenceDistal", args_.connectedPermanenceDistal));
+    ar(cereal::make_nvp("inertiaFactor", args_.inertiaFactor));
+    ar(cereal::make_nvp("seed", args_.seed));
+    ar(cereal::make_nvp("onlineLearning", args_.onlineLearning));
+    ar(cereal::make_nvp("learningMode", args_.learningMode));
+    ar(cereal::make_nvp("iter", args_.iter));
+    ar(cereal::make_nvp("init", init));
+    if (init) {
+      // Restore algorithm state
+      ar(cereal::make_nvp("ColumnPooler", pooler_));
+      initializeLateralInputs_();
+    }
+  }
+
+  bool operator==(const RegionImpl &other) const override;
+  inline bool operator!=(const ColumnPoolerRegion &other) const {
+    return !operator==(other);
+  }
+
+  // Per-node size (in elements) of the given output.
+  // For per-region outputs, it is the total element count.
+  // This method is called only for outputs whose size is not
+  // specified in the spec.
+  Dimensions askImplForOutputDimensions(const std::string &name) override;
+
+
+  /* -----------  Optional RegionImpl Interface methods ------- */
+  UInt32 getParameterUInt32(const std::string &name, Int64 index) override;
+  Int32 getParameterInt32(const std::string &name, Int64 index) override;
+  Real32 getParameterReal32(const std::string &name, Int64 index) override;
+  bool getParameterBool(const std::string &name, Int64 index) override;
+
+  void setParameterBool(const std::string &name, Int64 index, bool value) override;
+
+  std::string executeCommand(const std::vector<std::string> &args, Int64 index) override;
+
+private:
+  // One SDR per other cortical column, split from the lateralInput.
+  void initializeLateralInputs_();
+
+  // Note: to avoid deserialization problems due to differences in
+  //       how compilers deal with structure padding, do not allow
+  //       any member to span an 64bit (8byte) boundary.
+  struct {
+    UInt32 cellCount;
+    UInt32 inputWidth;
+    UInt32 numOtherCorticalColumns;
+    UInt32 sdrSize;
+    UInt32 maxSdrSize;
+    UInt32 minSdrSize;
+    Real32 synPermProximalInc;
+    Real32 synPermProximalDec;
+    Real32 initialProximalPermanence;
+    Int32  sampleSizeProximal;
+    UInt32 minThresholdProximal;
+    Real32 connectedPermanenceProximal;
+    UInt32 predictedInhibitionThreshold;
+    Real32 synPermDistalInc;
+    Real32 synPermDistalDec;
+    Real32 initialDistalPermanence;
+    Int32  sampleSizeDistal;
+    UInt32 activationThresholdDistal;
+    Real32 connectedPermanenceDistal;
+    Real32 inertiaFactor;
+    Int32  seed;
+    bool   onlineLearning;
+
+    // parameters used by this class and not passed on
+    bool   learningMode;
+
+    // some local variables
+    Size iter;
+  } args_;
+
+  computeCallbackFunc computeCallback_;
+  std::unique_ptr<ColumnPooler> pooler_;
+  std::vector<SDR> lateralInputs_;
+};
+
+} // namespace htm
+
+#endif // NTA_COLUMNPOOLERREGION_HPP
@@ -283,8 +283,8 @@ namespace htm {
         NTA_ASSERT( dimensions == sdr.dimensions );
 
         UInt ovlp = 0u;
-        const auto a = this->getDense();
-        const auto b = sdr.getDense();
+        const auto &a = this->getDense();
+        const auto &b = sdr.getDense();
         for( UInt i = 0u; i < size; i++ )
             ovlp += a[i] && b[i];
         return ovlp;
@@ -0,0 +1,78 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Definition of AlignedAllocator, a std::allocator replacement which returns
+ * memory aligned to a (cache line) boundary.
+ */
+
+#ifndef NTA_UTILS_ALIGNED_ALLOCATOR_HPP
+#define NTA_UTILS_ALIGNED_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace htm {
+
+/** Size of a cache line on all platforms we build for. */
+constexpr const size_t CACHE_LINE_SIZE = 64u;
+
+/**
+ * Allocator for STL containers, aligns the start of the storage to `Alignment`
+ * bytes. Usage: `std::vector<T, AlignedAllocator<T>> v;`
+ *
+ * Works with C++11 (does not need aligned operator new from C++17), the
+ * original pointer is stored just in front of the aligned block.
+ */
+template<typename T, size_t Alignment = CACHE_LINE_SIZE>
+class AlignedAllocator {
+  static_assert((Alignment & (Alignment - 1)) == 0, "Alignment must be a power of 2");
+  static_assert(Alignment >= sizeof(void*), "Alignment must fit a pointer");
+
+public:
+  using value_type = T;
+  template<typename U> struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+  AlignedAllocator() noexcept {}
+  template<typename U>
+  AlignedAllocator(const AlignedAllocator<U, Alignment>&) noexcept {}
+
+  T* allocate(const size_t n) {
+    if(n == 0) return nullptr;
+    void *raw = std::malloc(n * sizeof(T) + Alignment + sizeof(void*));
+    if(raw == nullptr) throw std::bad_alloc();
+    const auto start   = reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*);
+    const auto aligned = (start + Alignment - 1) & ~(std::uintptr_t)(Alignment - 1);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<T*>(aligned);
+  }
+
+  void deallocate(T *p, const size_t) noexcept {
+    if(p == nullptr) return;
+    std::free(reinterpret_cast<void**>(p)[-1]);
+  }
+};
+
+template<typename T, typename U, size_t A>
+inline bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) noexcept { return true; }
+template<typename T, typename U, size_t A>
+inline bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) noexcept { return false; }
+
+} // end namespace htm
+#endif // NTA_UTILS_ALIGNED_ALLOCATOR_HPP
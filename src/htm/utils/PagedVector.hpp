@@ -0,0 +1,326 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Definition of PagedVector, a vector which can be stored in fixed size pages
+ * which are shared copy-on-write between copies.
+ */
+
+#ifndef NTA_UTILS_PAGED_VECTOR_HPP
+#define NTA_UTILS_PAGED_VECTOR_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <new>
+#include <utility>
+#include <vector>
+
+#include <htm/utils/AlignedAllocator.hpp>
+#include <htm/utils/Log.hpp>
+
+namespace htm {
+
+namespace paged_vector_ {
+  constexpr size_t log2Floor(const size_t n) { return n <= 1u ? 0u : 1u + log2Floor(n / 2u); }
+}
+
+/**
+ * A vector of elements, contiguous or kept in fixed size pages.
+ *
+ * By default the elements are contiguous, as in a std::vector, and a copy
+ * is a deep copy. After setPaged(true) they are kept in pages: copying a
+ * PagedVector then copies only its table of pages, the copies share the
+ * pages until one of them writes into a page, then it gets its own copy of
+ * that page. This makes a copy of a large container, of which only a small
+ * part is modified afterwards, cheap. See Connections::setCopyOnWrite.
+ * The pages cost an indirection on each access, use them only where copies
+ * are made.
+ *
+ * Elements are read with operator[] and written with edit(), which copies
+ * the page first if it is shared. There is no non-const operator[], so that
+ * reading an element never copies a page.
+ *
+ * Thread safety: as for std::vector, concurrent reads are safe, and so are
+ * concurrent copies of one container (eg forks of a model in several
+ * threads). Concurrent edit() of distinct elements is safe if their pages
+ * are not shared, edit() the elements once in a single thread beforehand to
+ * ensure that.
+ *
+ * @param T Element type, must be default constructible.
+ * @param PageBytes Size of a page, the number of elements in a page is the
+ *        largest power of 2 which fits.
+ */
+template<typename T, size_t PageBytes = 16384u>
+class PagedVector {
+public:
+  using value_type = T;
+
+  static constexpr size_t PAGE_BITS = paged_vector_::log2Floor(PageBytes / sizeof(T));
+  static constexpr size_t PAGE_SIZE = size_t(1u) << PAGE_BITS; //elements per page
+
+  PagedVector() noexcept {}
+
+  PagedVector(const PagedVector &other)
+    : flat_(other.flat_), pages_(other.pages_), size_(other.size_), paged_(other.paged_) {
+    if( not paged_ ) return;
+    for( const auto page : pages_ ) {
+      page->refs.fetch_add(1u, std::memory_order_relaxed);
+    }
+    // Copies of one container can be made concurrently, they all store true.
+    const bool shared = not pages_.empty();
+    shared_.store(shared, std::memory_order_relaxed);
+    other.shared_.store(shared, std::memory_order_relaxed);
+  }
+
+  PagedVector(PagedVector &&other) noexcept
+    : flat_(std::move(other.flat_)), pages_(std::move(other.pages_)), size_(other.size_),
+      paged_(other.paged_), shared_(other.shared_.load(std::memory_order_relaxed)) {
+    other.flat_.clear();
+    other.pages_.clear();
+    other.size_ = 0u;
+    other.shared_.store(false, std::memory_order_relaxed);
+  }
+
+  PagedVector &operator=(PagedVector other) noexcept {
+    swap(other);
+    return *this;
+  }
+
+  ~PagedVector() { clear(); }
+
+  size_t size()  const noexcept { return size_; }
+  bool   empty() const noexcept { return size_ == 0u; }
+
+  const T &operator[](const size_t i) const {
+    NTA_ASSERT(i < size_) << "PagedVector index out of range " << i << " >= " << size_;
+    if( not paged_ ) return flat_[i];
+    return pages_[i >> PAGE_BITS]->data[i & MASK];
+  }
+
+  const T &back() const { return (*this)[size_ - 1u]; }
+
+  /**
+   * Writable reference to an element, valid until the next modification of
+   * the size of this container.
+   */
+  T &edit(const size_t i) {
+    NTA_ASSERT(i < size_) << "PagedVector index out of range " << i << " >= " << size_;
+    if( not paged_ ) return flat_[i];
+    return writablePage_(i >> PAGE_BITS)->data[i & MASK];
+  }
+
+  void push_back(const T &value) {
+    if( not paged_ ) {
+      flat_.push_back( value );
+      size_++;
+      return;
+    }
+    if( (size_ & MASK) == 0u ) {
+      pages_.push_back( newPage_() );
+    }
+    size_++;
+    edit(size_ - 1u) = value;
+  }
+
+  void push_back(T &&value) {
+    if( not paged_ ) {
+      flat_.push_back( std::move(value) );
+      size_++;
+      return;
+    }
+    if( (size_ & MASK) == 0u ) {
+      pages_.push_back( newPage_() );
+    }
+    size_++;
+    edit(size_ - 1u) = std::move(value);
+  }
+
+  template<typename Iterator>
+  void assign(Iterator first, const Iterator last) {
+    clear();
+    for( ; first != last; ++first ) {
+      push_back( *first );
+    }
+  }
+
+  void resize(const size_t newSize, const T &value = T()) {
+    if( not paged_ ) {
+      flat_.resize( newSize, value );
+      size_ = newSize;
+      return;
+    }
+    const size_t numPages = (newSize + MASK) >> PAGE_BITS;
+    if( newSize < size_ ) {
+      for( size_t p = numPages; p < pages_.size(); p++ ) {
+        release_( pages_[p] );
+      }
+      pages_.resize( numPages );
+      // The remainder of the last page is reset, like destroyed elements.
+      const size_t end = std::min(size_, numPages << PAGE_BITS);
+      if( newSize < end ) {
+        Page *page = writablePage_(numPages - 1u);
+        std::fill(page->data + (newSize & MASK), page->data + ((end - 1u) & MASK) + 1u, T());
+      }
+      size_ = newSize;
+      return;
+    }
+    while( pages_.size() < numPages ) {
+      pages_.push_back( newPage_() );
+    }
+    for( size_t i = size_; i < newSize; ) {
+      Page *page = writablePage_(i >> PAGE_BITS);
+      const size_t n = std::min(newSize - i, PAGE_SIZE - (i & MASK));
+      std::fill(page->data + (i & MASK), page->data + (i & MASK) + n, value);
+      i += n;
+    }
+    size_ = newSize;
+  }
+
+  void clear() noexcept {
+    FlatVector().swap( flat_ ); //releases the memory, as the pages
+    for( const auto page : pages_ ) {
+      release_( page );
+    }
+    pages_.clear();
+    size_ = 0u;
+    shared_.store(false, std::memory_order_relaxed);
+  }
+
+  void swap(PagedVector &other) noexcept {
+    flat_.swap(other.flat_);
+    pages_.swap(other.pages_);
+    std::swap(size_, other.size_);
+    std::swap(paged_, other.paged_);
+    const bool shared = shared_.load(std::memory_order_relaxed);
+    shared_.store(other.shared_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    other.shared_.store(shared, std::memory_order_relaxed);
+  }
+
+  /**
+   * Calls function(const T *run, size_t length) for the contiguous runs of
+   * the elements [begin, begin + count).
+   */
+  template<typename Function>
+  void forEachRun(size_t begin, size_t count, Function function) const {
+    NTA_ASSERT(begin + count <= size_);
+    if( not paged_ ) {
+      if( count > 0u ) function( flat_.data() + begin, count );
+      return;
+    }
+    while( count > 0u ) {
+      const size_t offset = begin & MASK;
+      const size_t n = std::min(count, PAGE_SIZE - offset);
+      function( static_cast<const T*>(pages_[begin >> PAGE_BITS]->data + offset), n );
+      begin += n;
+      count -= n;
+    }
+  }
+
+  /**
+   * Number of pages which are shared with copies of this container.
+   */
+  size_t numSharedPages() const noexcept {
+    size_t shared = 0u;
+    for( const auto page : pages_ ) {
+      shared += page->refs.load(std::memory_order_relaxed) != 1u;
+    }
+    return shared;
+  }
+
+  size_t numPages() const noexcept { return pages_.size(); }
+
+  /**
+   * Switch between contiguous storage (default) and pages, keeps the
+   * elements. Copies keep the storage of their source.
+   */
+  void setPaged(const bool paged) {
+    if( paged == paged_ ) return;
+    PagedVector converted;
+    converted.paged_ = paged;
+    forEachRun(0u, size_, [&](const T *run, const size_t n) {
+      for( size_t i = 0u; i < n; i++ ) converted.push_back( run[i] );
+    });
+    swap( converted );
+  }
+  bool paged() const noexcept { return paged_; }
+
+  /**
+   * False if no page is shared: this container was not copied, nor made by
+   * copying, since it was created or cleared. A quick test before edit()
+   * of many elements to unshare them.
+   */
+  bool mayBeShared() const noexcept { return shared_.load(std::memory_order_relaxed); }
+
+private:
+  static constexpr size_t MASK = PAGE_SIZE - 1u;
+
+  struct Page {
+    T data[PAGE_SIZE];
+    std::atomic<size_t> refs;
+
+    Page() : refs(1u) {}
+    Page(const Page &other) : refs(1u) {
+      std::copy(other.data, other.data + PAGE_SIZE, data);
+    }
+  };
+
+  static Page *newPage_() {
+    AlignedAllocator<Page> allocator;
+    Page *page = allocator.allocate(1u);
+    try { new (page) Page(); }
+    catch(...) { allocator.deallocate(page, 1u); throw; }
+    return page;
+  }
+
+  static void release_(Page *page) noexcept {
+    if( page->refs.fetch_sub(1u, std::memory_order_acq_rel) == 1u ) {
+      page->~Page();
+      AlignedAllocator<Page>().deallocate(page, 1u);
+    }
+  }
+
+  Page *writablePage_(const size_t p) {
+    Page *&page = pages_[p];
+    if( page->refs.load(std::memory_order_acquire) != 1u ) {
+      AlignedAllocator<Page> allocator;
+      Page *copy = allocator.allocate(1u);
+      try { new (copy) Page(*page); }
+      catch(...) { allocator.deallocate(copy, 1u); throw; }
+      release_( page );
+      page = copy;
+    }
+    return page;
+  }
+
+  using FlatVector = std::vector<T, AlignedAllocator<T>>;
+  FlatVector flat_; //elements, if not paged_
+  std::vector<Page*> pages_;
+  size_t size_ = 0u;
+  bool paged_ = false;
+  mutable std::atomic<bool> shared_{false}; //see mayBeShared, set by copies of a const source
+};
+
+template<typename T, size_t PageBytes>
+constexpr size_t PagedVector<T, PageBytes>::PAGE_BITS;
+template<typename T, size_t PageBytes>
+constexpr size_t PagedVector<T, PageBytes>::PAGE_SIZE;
+template<typename T, size_t PageBytes>
+constexpr size_t PagedVector<T, PageBytes>::MASK;
+
+} // end namespace htm
+#endif // NTA_UTILS_PAGED_VECTOR_HPP
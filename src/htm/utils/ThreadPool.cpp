@@ -0,0 +1,130 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of ThreadPool
+ */
+
+#include <algorithm>
+
+#include <htm/utils/ThreadPool.hpp>
+
+using namespace htm;
+
+namespace {
+  // The pool whose tasks the current thread is running, and the thread
+  // number of those tasks. Detects the re-entry into parallelFor.
+  thread_local const ThreadPool *insidePool   = nullptr;
+  thread_local UInt              insideThread = 0u;
+}
+
+ThreadPool::ThreadPool(UInt numThreads) : nextTask_(0u) {
+  if( numThreads == 0u ) {
+    numThreads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for( UInt thread = 1u; thread < numThreads; thread++ ) {
+    workers_.emplace_back( &ThreadPool::workerLoop_, this, thread );
+  }
+}
+
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  wake_.notify_all();
+  for( auto &worker : workers_ ) {
+    worker.join();
+  }
+}
+
+
+void ThreadPool::parallelFor(const size_t numTasks,
+                             const std::function<void(size_t task, UInt thread)> &task) {
+  if( numTasks == 0u ) return;
+  const bool nested = insidePool == this;
+  if( workers_.empty() or numTasks == 1u or nested ) {
+    const UInt thread = nested ? insideThread : 0u;
+    for( size_t i = 0u; i < numTasks; i++ ) task(i, thread);
+    return;
+  }
+
+  std::lock_guard<std::mutex> call(callMutex_);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    task_     = &task;
+    numTasks_ = numTasks;
+    nextTask_.store(0u);
+    error_    = nullptr;
+    running_  = static_cast<UInt>(workers_.size());
+    generation_++;
+  }
+  wake_.notify_all();
+
+  runTasks_(0u);
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  done_.wait(lock, [&]() { return running_ == 0u; });
+  task_ = nullptr;
+  if( error_ ) {
+    std::exception_ptr error = error_;
+    error_ = nullptr;
+    std::rethrow_exception(error);
+  }
+}
+
+
+void ThreadPool::runTasks_(const UInt thread) {
+  const ThreadPool *outerPool   = insidePool;
+  const UInt        outerThread = insideThread;
+  insidePool   = this;
+  insideThread = thread;
+  while( true ) {
+    const size_t i = nextTask_.fetch_add(1u);
+    if( i >= numTasks_ ) break;
+    try {
+      (*task_)(i, thread);
+    }
+    catch(...) {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if( not error_ ) error_ = std::current_exception();
+      nextTask_.store(numTasks_); //skip the remaining tasks
+    }
+  }
+  insidePool   = outerPool;
+  insideThread = outerThread;
+}
+
+
+void ThreadPool::workerLoop_(const UInt thread) {
+  UInt64 seen = 0u;
+  while( true ) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      wake_.wait(lock, [&]() { return stop_ or generation_ != seen; });
+      if( stop_ ) return;
+      seen = generation_;
+    }
+    runTasks_(thread);
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      running_--;
+    }
+    done_.notify_one();
+  }
+}
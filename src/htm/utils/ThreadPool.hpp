@@ -0,0 +1,121 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Definition of ThreadPool, a minimal fork-join pool for data-parallel loops.
+ */
+
+#ifndef NTA_UTILS_THREAD_POOL_HPP
+#define NTA_UTILS_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <htm/types/Types.hpp>
+
+namespace htm {
+
+/**
+ * ThreadPool
+ *
+ * @b Description
+ * A fixed set of worker threads, used by the algorithms to split loops over
+ * independent items (cells, segments, columns) between cores.
+ *
+ * The pool only schedules work, it does not decide the results. Algorithms
+ * using it must make the output independent of the number of threads and of
+ * the order in which tasks run (ie. each task writes its own output, and the
+ * outputs are combined in a fixed order), so that results stay identical to
+ * the serial computation.
+ *
+ * Example Usage:
+ *    auto pool = std::make_shared<ThreadPool>(8);
+ *    pool->parallelFor(100, [&](size_t task, UInt thread) { out[task] = f(task); });
+ *
+ * One pool can be shared between several models. Calls to parallelFor from
+ * different threads are serialized. A task can call parallelFor of its own
+ * pool (eg. a model which uses the pool, run inside a task), the nested loop
+ * then runs serially on the thread of the task.
+ */
+class ThreadPool {
+public:
+  /**
+   * @param numThreads Total number of threads, including the calling thread
+   * which also runs tasks. 0 means std::thread::hardware_concurrency().
+   */
+  explicit ThreadPool(UInt numThreads = 0u);
+
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  /**
+   * Number of threads, including the calling thread.
+   */
+  UInt size() const { return static_cast<UInt>(workers_.size()) + 1u; }
+
+  /**
+   * Run task(i, thread) for all i in [0, numTasks) and wait until all are
+   * done. `thread` is in [0, size()) and is unique among the concurrently
+   * running tasks, use it to index per-thread scratch buffers.
+   * The first exception thrown by a task is re-thrown here.
+   *
+   * Called from a task of this pool, the tasks run serially on the calling
+   * thread and get its `thread` number, instead of waiting for the pool to
+   * finish the outer call (which would never happen). This is not detected
+   * when the pool is reached again through a task of another pool: that
+   * deadlocks.
+   */
+  void parallelFor(const size_t numTasks,
+                   const std::function<void(size_t task, UInt thread)> &task);
+
+  /**
+   * Split the range [0, size) into `parts` contiguous, nearly equal chunks.
+   * @returns [begin, end) of the chunk `part`.
+   */
+  static std::pair<size_t, size_t> chunk(const size_t size, const size_t parts, const size_t part) {
+    return std::make_pair(size * part / parts, size * (part + 1u) / parts);
+  }
+
+private:
+  void workerLoop_(const UInt thread);
+  void runTasks_(const UInt thread);
+
+  std::vector<std::thread> workers_;
+  std::mutex               callMutex_; //serializes parallelFor
+  std::mutex               mutex_;
+  std::condition_variable  wake_;
+  std::condition_variable  done_;
+
+  const std::function<void(size_t, UInt)> *task_ = nullptr;
+  size_t              numTasks_   = 0u;
+  std::atomic<size_t> nextTask_;
+  UInt64              generation_ = 0u;
+  UInt                running_    = 0u; //workers still busy with current generation
+  bool                stop_       = false;
+  std::exception_ptr  error_;
+};
+
+} // end namespace htm
+#endif // NTA_UTILS_THREAD_POOL_HPP
@@ -0,0 +1,283 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for ApicalTiebreakTemporalMemory
+ *
+ * The tiebreak tests are ported from
+ * py/tests/advanced/algorithms/apical_tiebreak_temporal_memory
+ */
+
+#include "gtest/gtest.h"
+
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include <htm/algorithms/ApicalTiebreakTemporalMemory.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace testing {
+
+using namespace htm;
+using std::set;
+using std::vector;
+
+static const UInt COLUMN_COUNT = 2048u;
+static const UInt INPUT_SIZE   = 1000u;
+static const UInt W            = 40u;
+
+static SDR randomPattern(const UInt size, Random &rng) {
+  vector<UInt> population(size);
+  for (UInt i = 0; i < size; i++) population[i] = i;
+  auto sparse = rng.sample(population, W);
+  std::sort(sparse.begin(), sparse.end());
+  SDR pattern({size});
+  pattern.setSparse(sparse);
+  return pattern;
+}
+
+static SDR unionOf(const SDR &a, const SDR &b) {
+  SDR both(a.dimensions);
+  both.set_union(a, b);
+  return both;
+}
+
+static set<CellIdx> asSet(const vector<CellIdx> &cells) {
+  return set<CellIdx>(cells.begin(), cells.end());
+}
+
+// The parameters of apical_tiebreak_test_base.py
+static ApicalTiebreakPairMemory makePairMemory() {
+  return ApicalTiebreakPairMemory(COLUMN_COUNT, INPUT_SIZE, INPUT_SIZE,
+                                  /*cellsPerColumn*/ 32,
+                                  /*activationThreshold*/ 25,
+                                  /*reducedBasalThreshold*/ 25,
+                                  /*initialPermanence*/ 0.5f,
+                                  /*connectedPermanence*/ 0.6f,
+                                  /*minThreshold*/ 25,
+                                  /*sampleSize*/ 30,
+                                  /*permanenceIncrement*/ 0.1f,
+                                  /*permanenceDecrement*/ 0.02f);
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, BasalInputRequiredForPredictions) {
+  Random rng(1);
+  auto tm = makePairMemory();
+  const SDR activeColumns = randomPattern(COLUMN_COUNT, rng);
+  const SDR basalInput    = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput   = randomPattern(INPUT_SIZE, rng);
+  for (int i = 0; i < 3; i++) {
+    tm.compute(activeColumns, basalInput, apicalInput, true);
+  }
+
+  const SDR noBasalInput({INPUT_SIZE});
+  tm.compute(activeColumns, noBasalInput, apicalInput, false);
+  ASSERT_TRUE(tm.getPredictedCells().empty());
+  ASSERT_EQ(tm.getActiveCells().size(), W * 32u) << "all columns burst";
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, BasalPredictionsWithoutApical) {
+  Random rng(2);
+  auto tm = makePairMemory();
+  const SDR activeColumns = randomPattern(COLUMN_COUNT, rng);
+  const SDR basalInput1   = randomPattern(INPUT_SIZE, rng);
+  const SDR basalInput2   = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput1  = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput2  = randomPattern(INPUT_SIZE, rng);
+  set<CellIdx> activeCells1, activeCells2;
+  for (int i = 0; i < 3; i++) {
+    tm.compute(activeColumns, basalInput1, apicalInput1, true);
+    activeCells1 = asSet(tm.getActiveCells());
+    tm.compute(activeColumns, basalInput2, apicalInput2, true);
+    activeCells2 = asSet(tm.getActiveCells());
+  }
+
+  ASSERT_EQ(activeCells1.size(), W) << "learned, one cell per column";
+
+  const SDR noApicalInput({INPUT_SIZE});
+  tm.compute(activeColumns, unionOf(basalInput1, basalInput2), noApicalInput, false);
+  activeCells1.insert(activeCells2.begin(), activeCells2.end());
+  ASSERT_EQ(asSet(tm.getActiveCells()), activeCells1);
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, ApicalNarrowsThePredictions) {
+  Random rng(3);
+  auto tm = makePairMemory();
+  const SDR activeColumns = randomPattern(COLUMN_COUNT, rng);
+  const SDR basalInput1   = randomPattern(INPUT_SIZE, rng);
+  const SDR basalInput2   = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput1  = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput2  = randomPattern(INPUT_SIZE, rng);
+  set<CellIdx> activeCells1;
+  for (int i = 0; i < 3; i++) {
+    tm.compute(activeColumns, basalInput1, apicalInput1, true);
+    activeCells1 = asSet(tm.getActiveCells());
+    tm.compute(activeColumns, basalInput2, apicalInput2, true);
+  }
+
+  ASSERT_EQ(activeCells1.size(), W) << "learned, one cell per column";
+
+  tm.compute(activeColumns, unionOf(basalInput1, basalInput2), apicalInput1, false);
+  ASSERT_EQ(asSet(tm.getActiveCells()), activeCells1);
+  ASSERT_EQ(tm.getActiveCells(), tm.getPredictedActiveCells());
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, UnionOfFeedback) {
+  Random rng(4);
+  auto tm = makePairMemory();
+  const SDR activeColumns = randomPattern(COLUMN_COUNT, rng);
+  const SDR basalInput1   = randomPattern(INPUT_SIZE, rng);
+  const SDR basalInput2   = randomPattern(INPUT_SIZE, rng);
+  const SDR basalInput3   = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput1  = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput2  = randomPattern(INPUT_SIZE, rng);
+  const SDR apicalInput3  = randomPattern(INPUT_SIZE, rng);
+  set<CellIdx> activeCells1, activeCells2;
+  for (int i = 0; i < 3; i++) {
+    tm.compute(activeColumns, basalInput1, apicalInput1, true);
+    activeCells1 = asSet(tm.getActiveCells());
+    tm.compute(activeColumns, basalInput2, apicalInput2, true);
+    activeCells2 = asSet(tm.getActiveCells());
+    tm.compute(activeColumns, basalInput3, apicalInput3, true);
+  }
+
+  ASSERT_EQ(activeCells1.size(), W) << "learned, one cell per column";
+
+  tm.compute(activeColumns, unionOf(unionOf(basalInput1, basalInput2), basalInput3),
+             unionOf(apicalInput1, apicalInput2), false);
+  activeCells1.insert(activeCells2.begin(), activeCells2.end());
+  ASSERT_EQ(asSet(tm.getActiveCells()), activeCells1);
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, TiebreakAndReducedBasalThreshold) {
+  // 2 columns of 4 cells, segments made by hand.
+  ApicalTiebreakTemporalMemory tm(2, 10, 10, 4,
+                                  /*activationThreshold*/ 3,
+                                  /*reducedBasalThreshold*/ 2,
+                                  /*initialPermanence*/ 0.21f,
+                                  /*connectedPermanence*/ 0.5f,
+                                  /*minThreshold*/ 2);
+  const auto grow = [](Connections &connections, CellIdx cell, vector<CellIdx> inputs) {
+    const Segment segment = connections.createSegment(cell);
+    for (const auto input : inputs) connections.createSynapse(segment, input, 0.6f);
+  };
+  grow(tm.basalConnections, 0, {0, 1, 2});
+  grow(tm.basalConnections, 1, {0, 1, 2});
+  grow(tm.apicalConnections, 1, {5, 6, 7});
+  grow(tm.basalConnections, 4, {0, 1, 2});
+  grow(tm.basalConnections, 5, {0, 1});     //below activationThreshold
+  grow(tm.apicalConnections, 5, {5, 6, 7});
+
+  SDR basalInput({10});
+  SDR apicalInput({10});
+  basalInput.setSparse(SDR_sparse_t{0, 1, 2});
+  apicalInput.setSparse(SDR_sparse_t{5, 6, 7});
+
+  // Cell 1 wins the tie in column 0. In column 1 cell 5 has the reduced
+  // threshold only without learning.
+  tm.depolarizeCells(basalInput, apicalInput, true);
+  ASSERT_EQ(tm.getBasalDepolarizedCells(), vector<CellIdx>({0, 1, 4}));
+  ASSERT_EQ(tm.getApicalDepolarizedCells(), vector<CellIdx>({1, 5}));
+  tm.activateCells(SDR({2}), basalInput, apicalInput, basalInput, apicalInput, false);
+
+  tm.depolarizeCells(basalInput, apicalInput, false);
+  ASSERT_EQ(tm.getBasalDepolarizedCells(), vector<CellIdx>({0, 1, 4, 5}));
+
+  SDR activeColumns({2});
+  activeColumns.setSparse(SDR_sparse_t{0, 1});
+  tm.activateCells(activeColumns, basalInput, apicalInput, basalInput, apicalInput, false);
+  ASSERT_EQ(tm.getPredictedActiveCells(), vector<CellIdx>({1, 5}));
+  ASSERT_EQ(tm.getActiveCells(), vector<CellIdx>({1, 5}));
+
+  // Without the tiebreak all basally depolarized cells are predicted.
+  tm.setUseApicalTiebreak(false);
+  tm.depolarizeCells(basalInput, apicalInput, false);
+  tm.activateCells(activeColumns, basalInput, apicalInput, basalInput, apicalInput, false);
+  ASSERT_EQ(tm.getActiveCells(), vector<CellIdx>({0, 1, 4, 5}));
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, SequenceMemoryLearnsSequence) {
+  Random rng(5);
+  ApicalTiebreakSequenceMemory tm(COLUMN_COUNT, INPUT_SIZE, 32,
+                                  /*activationThreshold*/ 15,
+                                  /*reducedBasalThreshold*/ 15,
+                                  /*initialPermanence*/ 0.55f,
+                                  /*connectedPermanence*/ 0.5f,
+                                  /*minThreshold*/ 15,
+                                  /*sampleSize*/ 30);
+  vector<SDR> sequence;
+  for (int i = 0; i < 4; i++) sequence.push_back(randomPattern(COLUMN_COUNT, rng));
+  const SDR noApicalInput({INPUT_SIZE});
+
+  for (int repeat = 0; repeat < 4; repeat++) {
+    for (const auto &columns : sequence) tm.compute(columns, noApicalInput, true);
+    tm.reset();
+  }
+
+  for (size_t i = 0; i < sequence.size(); i++) {
+    tm.compute(sequence[i], noApicalInput, false);
+    if (i > 0) {
+      ASSERT_EQ(tm.getPredictedActiveCells().size(), W) << "one predicted cell per column";
+      ASSERT_EQ(tm.getActiveCells(), tm.getPredictedActiveCells());
+    }
+    if (i + 1u < sequence.size()) {
+      set<UInt> predictedColumns;
+      for (const auto cell : tm.getNextPredictedCells()) predictedColumns.insert(cell / 32u);
+      const auto &expected = sequence[i + 1u].getSparse();
+      ASSERT_EQ(predictedColumns, set<UInt>(expected.begin(), expected.end()));
+    }
+  }
+}
+
+
+TEST(ApicalTiebreakTemporalMemoryTest, Serialization) {
+  Random rng(6);
+  ApicalTiebreakSequenceMemory tm1(COLUMN_COUNT, INPUT_SIZE, 32, 15, 15, 0.55f, 0.5f, 15, 30);
+  vector<SDR> sequence, apical;
+  for (int i = 0; i < 4; i++) {
+    sequence.push_back(randomPattern(COLUMN_COUNT, rng));
+    apical.push_back(randomPattern(INPUT_SIZE, rng));
+  }
+  for (int repeat = 0; repeat < 3; repeat++) {
+    for (size_t i = 0; i < sequence.size(); i++) tm1.compute(sequence[i], apical[i], true);
+  }
+
+  std::stringstream ss;
+  tm1.save(ss);
+  ApicalTiebreakSequenceMemory tm2;
+  tm2.load(ss);
+  ASSERT_TRUE(tm1 == tm2);
+
+  // Continue in the middle of the sequence, the saved depolarization is used.
+  for (size_t i = 0; i < sequence.size(); i++) {
+    tm1.compute(sequence[i], apical[i], true);
+    tm2.compute(sequence[i], apical[i], true);
+    ASSERT_EQ(tm1.getActiveCells(), tm2.getActiveCells());
+    ASSERT_EQ(tm1.getNextPredictedCells(), tm2.getNextPredictedCells());
+  }
+  ASSERT_TRUE(tm1 == tm2);
+}
+
+}
@@ -0,0 +1,259 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2017, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for ColumnPooler
+ *
+ * Ported from py/tests/advanced/algorithms/column_pooler_test.py
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <vector>
+
+#include <htm/algorithms/ColumnPooler.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace testing {
+
+using namespace htm;
+using std::vector;
+
+static const UInt INPUT_WIDTH  = 2048 * 8;
+static const UInt CELL_COUNT   = 4096;
+static const UInt SDR_SIZE     = 40;
+
+class ColumnPoolerTest : public ::testing::Test {
+protected:
+  Random rng{42};
+
+  // the parameters of the Python tests
+  ColumnPooler makePooler(const vector<UInt> &lateralInputWidths = {}) {
+    return ColumnPooler(INPUT_WIDTH, lateralInputWidths, CELL_COUNT, SDR_SIZE,
+      /*onlineLearning*/ false, /*maxSdrSize*/ 0, /*minSdrSize*/ 0,
+      /*synPermProximalInc*/ 0.1f, /*synPermProximalDec*/ 0.001f,
+      /*initialProximalPermanence*/ 0.6f, /*sampleSizeProximal*/ 20,
+      /*minThresholdProximal*/ 10, /*connectedPermanenceProximal*/ 0.6f,
+      /*predictedInhibitionThreshold*/ 20,
+      /*synPermDistalInc*/ 0.1f, /*synPermDistalDec*/ 0.001f,
+      /*initialDistalPermanence*/ 0.51f, /*sampleSizeDistal*/ 20,
+      /*activationThresholdDistal*/ 10, /*connectedPermanenceDistal*/ 0.6f);
+  }
+
+  SDR pattern(const UInt size = INPUT_WIDTH) {
+    SDR p({ size });
+    p.randomize(static_cast<Real>(SDR_SIZE) / size, rng);
+    return p;
+  }
+
+  vector<SDR> object(const size_t numPatterns) {
+    vector<SDR> patterns;
+    for (size_t i = 0; i < numPatterns; i++) patterns.push_back(pattern());
+    return patterns;
+  }
+
+  void learn(ColumnPooler &pooler, const vector<SDR> &patterns,
+             const vector<vector<SDR>> &lateral = {}, const UInt repetitions = 3) {
+    pooler.reset();
+    vector<size_t> order(patterns.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    for (UInt r = 0; r < repetitions; r++) {
+      rng.shuffle(order.begin(), order.end());
+      for (const auto i : order) {
+        pooler.compute(patterns[i], lateral.empty() ? vector<SDR>{} : lateral[i], true);
+      }
+    }
+  }
+
+  vector<CellIdx> infer(ColumnPooler &pooler, const SDR &input, const vector<SDR> &lateral = {}) {
+    pooler.reset();
+    pooler.compute(input, lateral, false);
+    return pooler.getActiveCells();
+  }
+
+  static vector<CellIdx> setUnion(const vector<CellIdx> &a, const vector<CellIdx> &b) {
+    vector<CellIdx> u;
+    std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(u));
+    return u;
+  }
+
+  static size_t overlap(const vector<CellIdx> &a, const vector<CellIdx> &b) {
+    vector<CellIdx> i;
+    std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(i));
+    return i.size();
+  }
+
+  static SDR unionSDR(const SDR &a, const SDR &b) {
+    SDR u({ a.size });
+    u.set_union(a, b);
+    return u;
+  }
+};
+
+
+TEST_F(ColumnPoolerTest, NewInputs) {
+  ColumnPooler pooler = makePooler();
+
+  // feed the first input, a random SDR should be generated
+  pooler.compute(pattern(), {}, true);
+  const auto representation = pooler.getActiveCells();
+  ASSERT_EQ(representation.size(), SDR_SIZE);
+  ASSERT_TRUE(std::is_sorted(representation.begin(), representation.end()));
+
+  // feed a new input for the same object, the previous SDR should persist
+  pooler.compute(pattern(), {}, true);
+  ASSERT_EQ(pooler.getActiveCells(), representation);
+
+  // without sensory input, the SDR should persist as well
+  pooler.compute(SDR({ INPUT_WIDTH }), {}, true);
+  ASSERT_EQ(pooler.getActiveCells(), representation);
+  ASSERT_EQ(pooler.numberOfProximalSynapses(), 2u * SDR_SIZE * 20u);
+  ASSERT_EQ(pooler.numberOfConnectedProximalSynapses(representation), SDR_SIZE * 20u)
+    << "the synapses to the 1st input were decremented below the connected permanence";
+  ASSERT_EQ(pooler.numberOfDistalSegments(), SDR_SIZE) << "internal distal, learned on the 2nd input";
+}
+
+
+TEST_F(ColumnPoolerTest, LearnTwoObjectsOneCommonPattern) {
+  ColumnPooler pooler = makePooler();
+
+  const auto objectA = object(5);
+  learn(pooler, objectA);
+  const auto representationA = pooler.getActiveCells();
+
+  auto objectB = object(5);
+  objectB[0] = objectA[0];
+  learn(pooler, objectB);
+  const auto representationB = pooler.getActiveCells();
+
+  ASSERT_NE(representationA, representationB);
+  ASSERT_LE(overlap(representationA, representationB), 3u) << "very small overlap";
+
+  // all patterns except the common one map to their object
+  for (size_t i = 1; i < 5; i++) {
+    ASSERT_EQ(infer(pooler, objectA[i]), representationA);
+    ASSERT_EQ(infer(pooler, objectB[i]), representationB);
+  }
+
+  // the shared pattern activates both
+  ASSERT_EQ(infer(pooler, objectA[0]), setUnion(representationA, representationB));
+
+  // union of patterns in object A
+  ASSERT_EQ(infer(pooler, unionSDR(objectA[1], objectA[2])), representationA);
+
+  // unions of patterns in objects A and B
+  ASSERT_EQ(infer(pooler, unionSDR(objectA[1], objectB[1])), setUnion(representationA, representationB));
+}
+
+
+TEST_F(ColumnPoolerTest, InferObjectOverTime) {
+  ColumnPooler pooler = makePooler();
+
+  // Infer an object after touching only ambiguous points.
+  const auto patterns = object(3);
+  learn(pooler, { patterns[0], patterns[1] });
+  const auto representationA = pooler.getActiveCells();
+  learn(pooler, { patterns[1], patterns[2] });
+  learn(pooler, { patterns[2], patterns[0] });
+  const auto representationC = pooler.getActiveCells();
+
+  pooler.reset();
+  pooler.compute(patterns[0], {}, false);
+  ASSERT_EQ(pooler.getActiveCells(), setUnion(representationA, representationC));
+  pooler.compute(patterns[1], {}, false);
+  ASSERT_EQ(pooler.getActiveCells(), representationA) << "internal distal support";
+}
+
+
+TEST_F(ColumnPoolerTest, LateralDisambiguation) {
+  ColumnPooler pooler = makePooler({ INPUT_WIDTH });
+
+  const auto objectA = object(5);
+  vector<vector<SDR>> lateralA = {{ SDR({ INPUT_WIDTH }) }};
+  for (size_t i = 1; i < 5; i++) lateralA.push_back({ pattern() });
+  learn(pooler, objectA, lateralA);
+  const auto representationA = pooler.getActiveCells();
+
+  auto objectB = object(5);
+  objectB[3] = objectA[3];
+  vector<vector<SDR>> lateralB = {{ SDR({ INPUT_WIDTH }) }};
+  for (size_t i = 1; i < 5; i++) lateralB.push_back({ pattern() });
+  learn(pooler, objectB, lateralB);
+  const auto representationB = pooler.getActiveCells();
+
+  ASSERT_NE(representationA, representationB);
+  ASSERT_LE(overlap(representationA, representationB), 3u);
+  ASSERT_GT(pooler.numberOfDistalSynapses(), 0u);
+  ASSERT_GT(pooler.numberOfConnectedDistalSynapses(), 0u);
+
+  // no ambiguity with lateral input, also for the shared pattern
+  for (size_t i = 0; i < 5; i++) {
+    ASSERT_EQ(infer(pooler, objectA[i], lateralA.back()), representationA);
+    ASSERT_EQ(infer(pooler, objectB[i], lateralB.back()), representationB);
+  }
+}
+
+
+TEST_F(ColumnPoolerTest, OnlineLearning) {
+  ColumnPooler pooler = makePooler();
+  pooler.setOnlineLearning(true);
+
+  const auto objectA = object(4);
+  learn(pooler, objectA);
+  const auto representationA = pooler.getActiveCells();
+  ASSERT_EQ(representationA.size(), SDR_SIZE);
+
+  // A known pattern is recognized by inference before learning, the
+  // representation is extended to the new pattern.
+  pooler.reset();
+  pooler.compute(objectA[2], {}, true);
+  ASSERT_EQ(pooler.getActiveCells(), representationA);
+  const SDR extension = pattern();
+  pooler.compute(extension, {}, true);
+  ASSERT_EQ(pooler.getActiveCells(), representationA);
+  ASSERT_EQ(infer(pooler, extension), representationA);
+}
+
+
+TEST_F(ColumnPoolerTest, Serialization) {
+  ColumnPooler pooler = makePooler({ INPUT_WIDTH });
+  const auto objectA = object(3);
+  vector<vector<SDR>> lateralA;
+  for (size_t i = 0; i < 3; i++) lateralA.push_back({ pattern() });
+  learn(pooler, objectA, lateralA);
+
+  std::stringstream ss;
+  pooler.save(ss);
+  ColumnPooler copy;
+  copy.load(ss);
+  ASSERT_EQ(pooler, copy);
+
+  // the copy continues identically
+  const auto objectB = object(3);
+  for (const auto &p : objectB) {
+    pooler.compute(p, {}, true);
+    copy.compute(p, {}, true);
+    ASSERT_EQ(pooler.getActiveCells(), copy.getActiveCells());
+  }
+  ASSERT_EQ(pooler, copy);
+}
+
+} // namespace testing
@@ -357,6 +357,65 @@ TEST(ConnectionsTest, testComputeActivity) {
   ASSERT_EQ(3ul, numActivePotentialSynapsesForSegment[segment2_1]);
 }
 
+/**
+ * Randomly creates, destroys, connects and disconnects synapses, so that
+ * the presynaptic lists grow, move and get compacted. The activity must
+ * always match the activity counted directly from the synapses.
+ */
+TEST(ConnectionsTest, testComputeActivityPresynapticIndex) {
+  Connections connections(200);
+  Random rng(7);
+  SDR input({ 100u });
+
+  for(int step = 0; step < 200; step++) {
+    const CellIdx cell = rng.getUInt32(200);
+    if(connections.numSegments(cell) > 0 and rng.getReal64() < 0.3) {
+      connections.destroySegment(connections.getSegment(cell, 0));
+    }
+    const Segment segment = connections.createSegment(cell);
+    const UInt numSynapses = rng.getUInt32(40);
+    for(UInt i = 0; i < numSynapses; i++) {
+      connections.createSynapse(segment, rng.getUInt32(100), (Permanence)rng.getReal64());
+    }
+    for(const auto syn : vector<Synapse>(connections.synapsesForSegment(segment))) {
+      const Real64 r = rng.getReal64();
+      if(r < 0.2) {
+        connections.destroySynapse(syn);
+      }
+      else if(r < 0.5) {
+        connections.updateSynapsePermanence(syn, (Permanence)rng.getReal64());
+      }
+    }
+
+    input.randomize(0.2f, rng);
+    vector<SynapseIdx> potential(connections.segmentFlatListLength(), 0);
+    const auto connected = connections.computeActivity(potential, input.getSparse());
+
+    const auto &dense = input.getDense();
+    for(CellIdx c = 0; c < 200; c++) {
+      for(const auto seg : connections.segmentsForCell(c)) {
+        SynapseIdx expectedConnected = 0;
+        SynapseIdx expectedPotential = 0;
+        for(const auto syn : connections.synapsesForSegment(seg)) {
+          const auto &synData = connections.dataForSynapse(syn);
+          if(dense[synData.presynapticCell]) {
+            expectedPotential++;
+            if(synData.permanence >= connections.getConnectedThreshold()) expectedConnected++;
+          }
+        }
+        ASSERT_EQ(expectedConnected, connected[seg]);
+        ASSERT_EQ(expectedPotential, potential[seg]);
+      }
+    }
+  }
+
+  for(CellIdx presyn = 0; presyn < 100; presyn++) {
+    for(const auto syn : connections.synapsesForPresynapticCell(presyn)) {
+      ASSERT_EQ(presyn, connections.dataForSynapse(syn).presynapticCell);
+    }
+  }
+}
+
 TEST(ConnectionsTest, testAdaptSynapses) {
   UInt numCells = 4;
   // NOTE: One segment per cell.
@@ -871,3 +930,860 @@ TEST(ConnectionsTest, testTimeseries) {
     ASSERT_TRUE( (synData.permanence == 0.0f) or (synData.permanence == 1.0f) );
   }
 }
+
+
+/**
+ * With timeseries the update of a synapse is skipped, when it is the same as
+ * in the previous compute step.
+ */
+TEST(ConnectionsTest, testTimeseriesPreviousStep) {
+  Connections C( 1, .5, true );
+  const auto seg = C.createSegment(0);
+  const auto syn = C.createSynapse(seg, 0, 0.5f);
+  SDR presyn({ 2u });
+  presyn.setSparse(SDR_sparse_t{ 0u });
+  const auto step = [&](const int numAdapt) {
+    C.computeActivity( presyn.getSparse() );
+    for( int i = 0; i < numAdapt; i++ ) {
+      C.adaptSegment( seg, presyn, 0.1f, 0.1f );
+    }
+    return C.dataForSynapse( syn ).permanence;
+  };
+  EXPECT_NEAR( step(1), 0.6f, 1e-6 );
+  EXPECT_NEAR( step(1), 0.6f, 1e-6 ) << "same update as in the previous step";
+  EXPECT_NEAR( step(0), 0.6f, 1e-6 );
+  EXPECT_NEAR( step(1), 0.7f, 1e-6 ) << "no update in the previous step";
+  EXPECT_NEAR( step(2), 0.7f, 1e-6 ) << "compares with the previous step, not the current";
+  C.reset();
+  EXPECT_NEAR( step(1), 0.8f, 1e-6 ) << "reset clears the updates";
+
+  // A new synapse in the slot of a destroyed one has no updates.
+  C.destroySynapse( syn );
+  const auto syn2 = C.createSynapse(seg, 0, 0.5f);
+  ASSERT_EQ( syn2, syn );
+  EXPECT_NEAR( step(1), 0.6f, 1e-6 );
+}
+
+/**
+ * The synapse arena stores the synapses of a segment together in its own
+ * blocks, reuses the slots of destroyed synapses and the blocks of destroyed
+ * segments.
+ */
+TEST(ConnectionsTest, testSynapseArena) {
+  Connections C(100, 0.5f, false, 3);
+  ASSERT_EQ(C.synapseBlockSize(), 4u) << "rounded up to a power of two";
+  ASSERT_EQ(Connections(1, 0.5f, false, 1).synapseBlockSize(), 2u);
+  ASSERT_EQ(Connections(1, 0.5f, false, 33).synapseBlockSize(), 64u);
+  ASSERT_EQ(Connections(1, 0.5f, false, 1000).synapseBlockSize(), 512u) << "at most a page";
+
+  const Segment seg1 = C.createSegment(0);
+  const Segment seg2 = C.createSegment(1);
+  for(CellIdx presyn = 0; presyn < 6; presyn++) {
+    C.createSynapse(seg1, presyn, 0.6f);
+    C.createSynapse(seg2, 50 + presyn, 0.4f);
+  }
+  ASSERT_EQ(C.numSynapses(), 12u);
+  ASSERT_EQ(C.numSynapses(seg1), 6u);
+
+  // Synapses of a segment are in the segment's own blocks.
+  const auto blockOf = [&](const Synapse syn) { return syn / C.synapseBlockSize(); };
+  const auto &syns1 = C.synapsesForSegment(seg1);
+  ASSERT_EQ(blockOf(syns1[0]), blockOf(syns1[3]));
+  ASSERT_EQ(blockOf(syns1[4]), blockOf(syns1[5]));
+  for(const auto syn : C.synapsesForSegment(seg2)) {
+    ASSERT_NE(blockOf(syn), blockOf(syns1[0]));
+    ASSERT_NE(blockOf(syn), blockOf(syns1[5]));
+    ASSERT_EQ(C.segmentForSynapse(syn), seg2);
+  }
+
+  // Slot of a destroyed synapse is reused by the same segment.
+  const Synapse destroyed = syns1[1];
+  C.destroySynapse(destroyed);
+  ASSERT_EQ(C.numSynapses(), 11u);
+  const Synapse reused = C.createSynapse(seg1, 99, 0.6f);
+  ASSERT_EQ(reused, destroyed);
+  ASSERT_EQ(C.dataForSynapse(reused).presynapticCell, 99u);
+  ASSERT_EQ(C.numSynapses(), 12u);
+  ASSERT_TRUE(C.dataForSegment(seg1).synapses.empty()) << "no separate list of the synapses";
+  ASSERT_FALSE(C.orderedSynapses());
+
+  // The free slots are a list, the last freed slot is reused first.
+  const vector<Synapse> before = C.synapsesForSegment(seg1);
+  C.destroySynapse(before[2]);
+  C.destroySynapse(before[5]);
+  ASSERT_EQ(C.numSynapses(seg1), 4u);
+  ASSERT_EQ(C.synapsesForSegment(seg1), vector<Synapse>({before[0], before[1], before[3], before[4]}));
+  ASSERT_EQ(C.createSynapse(seg1, 97, 0.6f), before[5]);
+  ASSERT_EQ(C.createSynapse(seg1, 98, 0.6f), before[2]);
+  ASSERT_EQ(C.synapsesForSegment(seg1)[2], before[2]);
+  ASSERT_EQ(C.synapsesForSegment(seg1), before);
+  const Synapse grown = C.createSynapse(seg1, 96, 0.6f);
+  ASSERT_EQ(blockOf(grown), blockOf(before[5])) << "fills the last block first";
+  C.destroySynapse(grown);
+
+  // Blocks and handle of a destroyed segment are reused by other segments.
+  const size_t flatLength = C.segmentFlatListLength();
+  C.destroySegment(seg1);
+  ASSERT_EQ(C.numSynapses(), 6u);
+  const Segment seg3 = C.createSegment(2);
+  for(CellIdx presyn = 0; presyn < 8; presyn++) {
+    C.createSynapse(seg3, presyn, 0.6f);
+  }
+  ASSERT_EQ(C.numSynapses(), 14u);
+  ASSERT_EQ(seg3, seg1);
+  ASSERT_EQ(C.segmentFlatListLength(), flatLength);
+  Synapse maxSynapse = 0;
+  for(const auto syn : C.synapsesForSegment(seg3)) maxSynapse = std::max(maxSynapse, syn);
+  ASSERT_LT(maxSynapse, 16u) << "no new memory was used";
+
+  const auto activity = C.computeActivity({0, 1, 2, 50, 51});
+  ASSERT_EQ(activity[seg3], 3u);
+  ASSERT_EQ(activity[seg2], 0u);
+}
+
+
+/**
+ * Connections with the synapse arena compute the same as without it, and
+ * the layout is kept over save/load.
+ */
+TEST(ConnectionsTest, testSynapseArenaSameResults) {
+  Connections plain(1024), arena(1024, 0.5f, false, 8);
+  setupSampleConnections(plain);
+  setupSampleConnections(arena);
+  ASSERT_EQ(plain, arena);
+
+  SDR input({1024});
+  Random rng(42);
+  for(int i = 0; i < 30; i++) {
+    input.randomize(0.1f, rng);
+    const auto a = plain.computeActivity(input.getSparse());
+    const auto b = arena.computeActivity(input.getSparse());
+    ASSERT_EQ(a.size(), b.size());
+    for(size_t seg = 0; seg < a.size(); seg++) {
+      ASSERT_EQ(a[seg], b[seg]);
+    }
+    const CellIdx cell = rng.getUInt32(60);
+    const auto segments = plain.segmentsForCell(cell); //copy, adapting can destroy a segment
+    for(const auto seg : segments) {
+      plain.adaptSegment(seg, input, 0.1f, 0.3f, true);
+      arena.adaptSegment(seg, input, 0.1f, 0.3f, true);
+    }
+    const Segment newPlain = plain.createSegment(cell);
+    const Segment newArena = arena.createSegment(cell);
+    ASSERT_EQ(newPlain, newArena);
+    for(const auto presyn : input.getSparse()) {
+      plain.createSynapse(newPlain, presyn, 0.51f);
+      arena.createSynapse(newArena, presyn, 0.51f);
+    }
+    ASSERT_EQ(plain, arena);
+    ASSERT_EQ(plain.numSynapses(), arena.numSynapses());
+  }
+
+  Connections loaded(1, 0.5f, false, 8);
+  stringstream ss;
+  arena.save(ss);
+  loaded.load(ss);
+  ASSERT_EQ(loaded.synapseBlockSize(), 8u);
+  ASSERT_EQ(loaded, arena);
+}
+
+
+/**
+ * computeActivity with a thread pool computes exactly the same as without.
+ */
+TEST(ConnectionsTest, testComputeActivityThreadPool) {
+  Connections serial(2048), parallel(2048);
+  parallel.setThreadPool(std::make_shared<ThreadPool>(4));
+
+  Random rng(11);
+  for(CellIdx cell = 0; cell < 2048; cell++) {
+    for(int s = 0; s < 3; s++) {
+      const Segment seg1 = serial.createSegment(cell);
+      const Segment seg2 = parallel.createSegment(cell);
+      for(int i = 0; i < 20; i++) {
+        const CellIdx presyn = rng.getUInt32(2048);
+        const Permanence perm = (Permanence)rng.getReal64();
+        serial.createSynapse(seg1, presyn, perm);
+        parallel.createSynapse(seg2, presyn, perm);
+      }
+    }
+  }
+
+  SDR input({2048});
+  SegmentActivity activity1, activity2; //reused, the buffers are reset from the touched lists
+  for(const Real sparsity : {0.01f, 0.2f, 0.9f, 0.05f}) {
+    input.randomize(sparsity, rng);
+    vector<SynapseIdx> potential1(serial.segmentFlatListLength(), 0);
+    vector<SynapseIdx> potential2(parallel.segmentFlatListLength(), 0);
+    const auto connected1 = serial.computeActivity(potential1, input.getSparse());
+    const auto connected2 = parallel.computeActivity(potential2, input.getSparse());
+    ASSERT_EQ(connected1, connected2);
+    ASSERT_EQ(potential1, potential2);
+
+    serial.computeActivity(activity1, input.getSparse());
+    parallel.computeActivity(activity2, input.getSparse());
+    ASSERT_EQ(activity1.numActiveConnected, activity2.numActiveConnected);
+    ASSERT_EQ(activity1.numActivePotential, activity2.numActivePotential);
+    ASSERT_EQ(activity1.touched, activity2.touched) << "in the same order";
+  }
+}
+
+
+/**
+ * computeActivity into reused SegmentActivity buffers gives the same counts
+ * as the allocating overloads, and does not reallocate the buffers.
+ */
+TEST(ConnectionsTest, testComputeActivityReusedBuffers) {
+  Connections connections(1024);
+  setupSampleConnections(connections);
+  SegmentActivity activity;
+  SDR input({1024});
+  Random rng(3);
+
+  for(int i = 0; i < 20; i++) {
+    if(i == 10) { // grow the segments, then keep their number constant
+      for(CellIdx cell = 100; cell < 200; cell++) {
+        const Segment seg = connections.createSegment(cell);
+        for(CellIdx presyn = 0; presyn < 1024; presyn += 7 + cell % 5) {
+          connections.createSynapse(seg, presyn, (Permanence)rng.getReal64());
+        }
+      }
+    }
+    input.randomize(0.05f, rng);
+    const auto before = activity.numActiveConnected.data();
+    connections.computeActivity(activity, input.getSparse(), false);
+
+    vector<SynapseIdx> potential(connections.segmentFlatListLength(), 0);
+    const auto connected = connections.computeActivity(potential, input.getSparse(), false);
+    ASSERT_EQ(activity.numActiveConnected, connected);
+    ASSERT_EQ(activity.numActivePotential, potential);
+    for(Segment seg = 0; seg < potential.size(); seg++) {
+      const bool isTouched = std::find(activity.touched.begin(), activity.touched.end(), seg) != activity.touched.end();
+      ASSERT_EQ(potential[seg] > 0, isTouched);
+    }
+    if(i > 11) {
+      ASSERT_EQ(before, activity.numActiveConnected.data()) << "buffer was reallocated";
+    }
+  }
+
+  // Without the potential synapses
+  connections.computeActivity(activity, input.getSparse(), false, false);
+  ASSERT_TRUE(activity.numActivePotential.empty());
+  ASSERT_EQ(activity.numActiveConnected, connections.computeActivity(input.getSparse(), false));
+}
+
+
+/**
+ * Handles of destroyed segments and synapses are recycled, so that the flat
+ * lists do not grow while the number of segments stays constant.
+ */
+TEST(ConnectionsTest, testRecycleDestroyedHandles) {
+  Connections C(100);
+  const Segment seg1 = C.createSegment(10);
+  const Segment seg2 = C.createSegment(20);
+  const Synapse syn1 = C.createSynapse(seg1, 1, 0.6f);
+  const Synapse syn2 = C.createSynapse(seg1, 2, 0.6f);
+  C.createSynapse(seg2, 3, 0.6f);
+
+  C.destroySynapse(syn1);
+  const Synapse syn3 = C.createSynapse(seg2, 4, 0.3f);
+  ASSERT_EQ(syn3, syn1);
+  ASSERT_EQ(C.segmentForSynapse(syn3), seg2);
+  ASSERT_EQ(C.dataForSynapse(syn3).presynapticCell, 4u);
+  ASSERT_EQ(C.synapsesForSegment(seg1), vector<Synapse>({syn2}));
+  ASSERT_EQ(C.synapsesForPresynapticCell(1).size(), 0u);
+
+  C.destroySegment(seg1);
+  const Segment seg3 = C.createSegment(30);
+  ASSERT_EQ(seg3, seg1);
+  ASSERT_EQ(C.cellForSegment(seg3), 30u);
+  ASSERT_EQ(C.numSynapses(seg3), 0u);
+  ASSERT_EQ(C.segmentsForCell(10).size(), 0u);
+  ASSERT_EQ(C.numSegments(), 2u);
+  ASSERT_EQ(C.segmentFlatListLength(), 2u);
+  ASSERT_EQ(C.numSynapses(), 2u);
+
+  // Churn: the number of segments is limited, the flat list is bounded.
+  Random rng(42);
+  for(int i = 0; i < 500; i++) {
+    const CellIdx cell = rng.getUInt32(100);
+    if(C.numSegments(cell) >= 2) {
+      C.destroySegment(C.segmentsForCell(cell)[0]);
+    }
+    const Segment seg = C.createSegment(cell);
+    for(int s = 0; s < 5; s++) {
+      C.createSynapse(seg, rng.getUInt32(100), (Permanence)rng.getReal64());
+    }
+  }
+  ASSERT_LE(C.segmentFlatListLength(), 200u + 2u);
+}
+
+
+/**
+ * compact() removes the holes left by destroyed segments and synapses, and
+ * does not change the results.
+ */
+TEST(ConnectionsTest, testCompact) {
+  for(const SynapseIdx blockSize : {0u, 4u}) {
+    Connections C(1024, 0.5f, false, blockSize);
+    setupSampleConnections(C);
+    Random rng(7);
+    for(CellIdx cell = 100; cell < 200; cell++) {
+      const Segment seg = C.createSegment(cell);
+      for(CellIdx presyn = 0; presyn < 1024; presyn += 7 + cell % 5) {
+        C.createSynapse(seg, presyn, (Permanence)rng.getReal64());
+      }
+    }
+    for(CellIdx cell = 100; cell < 200; cell += 3) {
+      C.destroySegment(C.segmentsForCell(cell)[0]);
+    }
+    for(CellIdx cell = 101; cell < 200; cell += 3) {
+      const Segment seg = C.segmentsForCell(cell)[0];
+      C.destroySynapse(C.synapsesForSegment(seg)[1]);
+    }
+
+    SDR input({1024});
+    input.randomize(0.1f, rng);
+    SegmentActivity activity;
+    C.computeActivity(activity, input.getSparse(), false);
+    // Results per cell, the handles change.
+    const auto perCell = [&](const Connections &conn, const vector<SynapseIdx> &counts) {
+      vector<SynapseIdx> out;
+      for(CellIdx cell = 0; cell < conn.numCells(); cell++) {
+        for(const auto seg : conn.segmentsForCell(cell)) out.push_back(counts[seg]);
+      }
+      return out;
+    };
+    const auto expectConnected = perCell(C, activity.numActiveConnected);
+    const auto expectPotential = perCell(C, activity.numActivePotential);
+    const size_t numSegments = C.numSegments();
+    const size_t numSynapses = C.numSynapses();
+    const size_t flatLength  = C.segmentFlatListLength();
+    Connections copy = C;
+
+    C.compact();
+    ASSERT_EQ(C, copy);
+    ASSERT_EQ(C.numSegments(), numSegments);
+    ASSERT_EQ(C.numSynapses(), numSynapses);
+    ASSERT_EQ(C.segmentFlatListLength(), numSegments);
+    ASSERT_LT(C.segmentFlatListLength(), flatLength);
+    for(Segment seg = 0; seg < C.segmentFlatListLength(); seg++) {
+      for(const auto syn : C.synapsesForSegment(seg)) {
+        ASSERT_EQ(C.segmentForSynapse(syn), seg);
+      }
+    }
+
+    // The same buffers can be used after compact().
+    C.computeActivity(activity, input.getSparse(), false);
+    ASSERT_EQ(perCell(C, activity.numActiveConnected), expectConnected);
+    ASSERT_EQ(perCell(C, activity.numActivePotential), expectPotential);
+
+    // Still works as usual.
+    const Segment seg = C.createSegment(5);
+    ASSERT_EQ(seg, numSegments);
+    C.createSynapse(seg, input.getSparse()[0], 0.9f);
+    C.computeActivity(activity, input.getSparse(), false);
+    ASSERT_EQ(activity.numActiveConnected[seg], 1u);
+  }
+}
+
+
+/**
+ * createSynapses skips the cells on the segment and the repeated cells, and
+ * creates the same synapses as createSynapse in a loop.
+ */
+TEST(ConnectionsTest, testCreateSynapses) {
+  Connections bulk(100), loop(100);
+  const Segment seg = bulk.createSegment(0);
+  loop.createSegment(0);
+  for(const CellIdx presyn : {5u, 20u, 30u}) {
+    bulk.createSynapse(seg, presyn, 0.2f);
+    loop.createSynapse(seg, presyn, 0.2f);
+  }
+
+  const vector<CellIdx> cells = {40, 20, 7, 40, 6, 5, 99, 8, 1};
+  ASSERT_EQ(bulk.createSynapses(seg, cells, 0.6f, 4u), 4u);
+  size_t created = 0u;
+  for(const auto presyn : cells) {
+    if(created == 4u) break;
+    const auto before = loop.numSynapses(seg);
+    loop.createSynapse(seg, presyn, 0.6f);
+    created += loop.numSynapses(seg) - before;
+  }
+  ASSERT_EQ(bulk, loop);
+  vector<CellIdx> presyns;
+  for(const auto syn : bulk.synapsesForSegment(seg)) {
+    presyns.push_back(bulk.dataForSynapse(syn).presynapticCell);
+  }
+  ASSERT_EQ(presyns, vector<CellIdx>({5, 20, 30, 40, 7, 6, 99}));
+  ASSERT_EQ(bulk.dataForSegment(seg).numConnected, 4u);
+  ASSERT_EQ(bulk.synapsesForPresynapticCell(99).size(), 1u);
+
+  // The rest of the cells, nothing to do the second time.
+  ASSERT_EQ(bulk.createSynapses(seg, cells, 0.3f), 2u);
+  ASSERT_EQ(bulk.numSynapses(seg), 9u);
+  ASSERT_EQ(bulk.createSynapses(seg, cells, 0.3f), 0u);
+  ASSERT_EQ(bulk.createSynapses(seg, {}, 0.3f), 0u);
+
+  // Event handlers are notified as with createSynapse.
+  TestConnectionsEventHandler *handler = new TestConnectionsEventHandler();
+  const auto token = bulk.subscribe(handler);
+  bulk.createSynapses(seg, {50, 51}, 0.1f);
+  EXPECT_TRUE(handler->didCreateSynapse);
+  EXPECT_FALSE(handler->didUpdateSynapsePermanence);
+  bulk.createSynapses(seg, {52}, 0.9f);
+  EXPECT_TRUE(handler->didUpdateSynapsePermanence);
+  bulk.unsubscribe(token);
+
+  // A permanence for each cell.
+  const Segment seg2 = bulk.createSegment(1);
+  ASSERT_EQ(bulk.createSynapses(seg2, {3, 9, 3, 4}, {0.1f, 0.5f, 0.9f, 0.3f}), 3u);
+  ASSERT_EQ(bulk.createSynapses(seg2, {4, 10}, {0.7f, 0.2f}), 1u);
+  vector<pair<CellIdx, Permanence>> synapses;
+  for(const auto syn : bulk.synapsesForSegment(seg2)) {
+    const auto &data = bulk.dataForSynapse(syn);
+    synapses.emplace_back(data.presynapticCell, data.permanence);
+  }
+  ASSERT_EQ(synapses, (vector<pair<CellIdx, Permanence>>({{3, 0.1f}, {9, 0.5f}, {4, 0.3f}, {10, 0.2f}})));
+  EXPECT_ANY_THROW(bulk.createSynapses(seg2, {11, 12}, vector<Permanence>({0.1f})));
+}
+
+
+
+class BatchEventHandler : public ConnectionsEventHandler {
+public:
+  BatchEventHandler(vector<vector<ConnectionsEvent>> &batches) : batches(batches) {}
+  bool batchEvents() const override { return true; }
+  void onEvents(const vector<ConnectionsEvent> &events) override {
+    batches.push_back(events);
+  }
+  void onCreateSynapse(Synapse synapse) override { calledImmediately = true; }
+
+  vector<vector<ConnectionsEvent>> &batches;
+  bool calledImmediately = false;
+};
+
+/**
+ * Handlers which batch events get them once per compute step, in order.
+ */
+TEST(ConnectionsTest, testBatchedEvents) {
+  Connections connections(1024, 0.5f);
+  vector<vector<ConnectionsEvent>> batches;
+  BatchEventHandler *batched = new BatchEventHandler(batches);
+  TestConnectionsEventHandler *immediate = new TestConnectionsEventHandler();
+  const auto batchToken = connections.subscribe(batched);
+  connections.subscribe(immediate);
+
+  const Segment segment = connections.createSegment(42);
+  const Synapse synapse = connections.createSynapse(segment, 41, 0.25f);
+  connections.updateSynapsePermanence(synapse, 0.60f);
+  EXPECT_TRUE(immediate->didCreateSynapse);
+  EXPECT_TRUE(immediate->didUpdateSynapsePermanence);
+  EXPECT_FALSE(batched->calledImmediately);
+  ASSERT_TRUE(batches.empty());
+
+  connections.computeActivity({41});
+  ASSERT_EQ(batches.size(), 1u);
+  ASSERT_EQ(batches[0].size(), 3u);
+  EXPECT_EQ(batches[0][0].type, ConnectionsEvent::CREATE_SEGMENT);
+  EXPECT_EQ(batches[0][0].handle, segment);
+  EXPECT_EQ(batches[0][1].type, ConnectionsEvent::CREATE_SYNAPSE);
+  EXPECT_EQ(batches[0][1].handle, synapse);
+  EXPECT_EQ(batches[0][2].type, ConnectionsEvent::UPDATE_SYNAPSE_PERMANENCE);
+  EXPECT_EQ(batches[0][2].permanence, 0.60f);
+
+  // No events, no call.
+  connections.computeActivity({41});
+  connections.flushEvents();
+  ASSERT_EQ(batches.size(), 1u);
+
+  connections.destroySynapse(synapse);
+  connections.destroySegment(segment);
+  connections.flushEvents();
+  ASSERT_EQ(batches.size(), 2u);
+  ASSERT_EQ(batches[1].size(), 2u);
+  EXPECT_EQ(batches[1][0].type, ConnectionsEvent::DESTROY_SYNAPSE);
+  EXPECT_EQ(batches[1][1].type, ConnectionsEvent::DESTROY_SEGMENT);
+
+  // Pending events are delivered before unsubscribing.
+  connections.createSegment(7);
+  connections.unsubscribe(batchToken);
+  ASSERT_EQ(batches.size(), 3u);
+  EXPECT_EQ(batches[2][0].type, ConnectionsEvent::CREATE_SEGMENT);
+  connections.createSegment(8);
+  connections.flushEvents();
+  ASSERT_EQ(batches.size(), 3u);
+  EXPECT_TRUE(immediate->didCreateSegment);
+}
+
+
+/**
+ * With unordered synapses destroySynapse swaps the last synapse into the
+ * freed position. The results, the serialized state and operator== are the
+ * same as with ordered synapses.
+ */
+TEST(ConnectionsTest, testUnorderedSynapses) {
+  Connections ordered(100, 0.5f);
+  Connections unordered(100, 0.5f);
+  unordered.setOrderedSynapses(false);
+  ASSERT_FALSE(unordered.orderedSynapses());
+
+  Random rng(5);
+  SDR input({100});
+  for(auto C : {&ordered, &unordered}) {
+    Random rngC(17);
+    for(CellIdx cell = 0; cell < 20; cell++) {
+      const Segment seg = C->createSegment(cell);
+      for(CellIdx presyn = 0; presyn < 100; presyn += 1 + cell % 4) {
+        C->createSynapse(seg, presyn, (Permanence)rngC.getReal64() * 0.3f);
+      }
+    }
+  }
+  const size_t numSynapses = ordered.numSynapses();
+  for(int i = 0; i < 10; i++) {
+    input.randomize(0.3f, rng);
+    for(auto C : {&ordered, &unordered}) {
+      for(CellIdx cell = 0; cell < 20; cell++) {
+        for(const auto seg : vector<Segment>(C->segmentsForCell(cell))) {
+          C->adaptSegment(seg, input, 0.02f, 0.05f, true);
+        }
+      }
+    }
+    ASSERT_EQ(ordered, unordered);
+    ASSERT_EQ(ordered.numSynapses(), unordered.numSynapses());
+    ASSERT_EQ(ordered.computeActivity(input.getSparse(), false),
+              unordered.computeActivity(input.getSparse(), false));
+  }
+  ASSERT_LT(ordered.numSynapses(), numSynapses) << "some synapses were pruned";
+
+  stringstream ss1, ss2;
+  ordered.save(ss1);
+  unordered.save(ss2);
+  ASSERT_EQ(ss1.str(), ss2.str());
+
+  // The order of creation is restored.
+  unordered.setOrderedSynapses(true);
+  for(CellIdx cell = 0; cell < 20; cell++) {
+    for(SegmentIdx idx = 0; idx < ordered.numSegments(cell); idx++) {
+      const auto seg1 = ordered.getSegment(cell, idx);
+      const auto seg2 = unordered.getSegment(cell, idx);
+      ASSERT_EQ(ordered.synapsesForSegment(seg1), unordered.synapsesForSegment(seg2));
+    }
+  }
+}
+
+
+TEST(ConnectionsTest, testDeferredSynapseUpdates) {
+  Connections direct(50, 0.5f);
+  Random rngC(3);
+  for(CellIdx cell = 0; cell < 10; cell++) {
+    const Segment seg = direct.createSegment(cell);
+    for(CellIdx presyn = 0; presyn < 50; presyn += 2) {
+      direct.createSynapse(seg, presyn, (Permanence)rngC.getReal64() * 0.6f);
+    }
+  }
+  Connections deferred = direct;
+
+  Random rng(9);
+  SDR input({50});
+  vector<vector<SynapseUpdate>> updates;
+  for(int i = 0; i < 20; i++) {
+    input.randomize(0.4f, rng);
+    const auto segments = direct.segmentsForCell(i % 10);
+    for(const auto seg : segments) {
+      direct.adaptSegment(seg, input, 0.1f, 0.1f, true);
+    }
+    // first all permanences, then the structural changes
+    updates.assign(segments.size(), {});
+    for(size_t s = 0; s < segments.size(); s++) {
+      deferred.adaptSegmentPermanences(segments[s], input, 0.1f, 0.1f, true, updates[s]);
+    }
+    for(size_t s = 0; s < segments.size(); s++) {
+      deferred.applySynapseUpdates(segments[s], updates[s], true);
+    }
+    ASSERT_EQ(direct, deferred);
+  }
+  ASSERT_LT(direct.numSynapses(), 250u) << "some synapses were pruned";
+}
+
+TEST(ConnectionsTest, testSegmentEviction) {
+  // 3 segments: the oldest, the least recently used, the weakest.
+  const auto prepare = [](Connections &C, vector<Segment> &segments) {
+    segments = {C.createSegment(0), C.createSegment(0), C.createSegment(0)};
+    for(CellIdx i = 0; i < 4; i++) {
+      C.createSynapse(segments[0], 10 + i, 0.4f);
+      C.createSynapse(segments[1], 10 + i, 0.3f);
+      C.createSynapse(segments[2], 10 + i, 0.1f);
+    }
+    C.dataForSegment(segments[0]).lastUsed = 100;
+    C.dataForSegment(segments[1]).lastUsed = 50;
+    C.dataForSegment(segments[2]).lastUsed = 100;
+  };
+  const vector<std::pair<SegmentEviction, size_t>> policies = {
+    {SegmentEviction::LRU, 1u},
+    {SegmentEviction::OLDEST, 0u},
+    {SegmentEviction::MIN_PERMANENCE, 2u}};
+  for(const auto &policy : policies) {
+    Connections C(20, 0.5f);
+    ASSERT_EQ(C.segmentEviction(), SegmentEviction::LRU);
+    C.setSegmentEviction(policy.first);
+    vector<Segment> segments;
+    prepare(C, segments);
+    const Segment evicted = segments[policy.second];
+    const Segment ordinal = C.dataForSegment(evicted).ordinal;
+
+    const Segment created = C.createSegment(0, 3);
+    ASSERT_EQ(C.numSegments(0), 3u);
+    for(const auto segment : C.segmentsForCell(0)) {
+      if(segment != created) {
+        ASSERT_NE(C.dataForSegment(segment).ordinal, ordinal) << static_cast<int>(policy.first);
+      }
+    }
+  }
+
+  // Several segments are evicted at once, when the limit is lowered.
+  Connections C(20, 0.5f);
+  C.setSegmentEviction(SegmentEviction::MIN_PERMANENCE);
+  vector<Segment> segments;
+  prepare(C, segments);
+  const Segment strongest = C.dataForSegment(segments[0]).ordinal;
+  C.createSegment(0, 2);
+  ASSERT_EQ(C.numSegments(0), 2u);
+  ASSERT_EQ(C.dataForSegment(C.segmentsForCell(0)[0]).ordinal, strongest);
+
+  // The policy is serialized.
+  std::stringstream ss;
+  C.save(ss);
+  Connections loaded;
+  loaded.load(ss);
+  ASSERT_EQ(loaded.segmentEviction(), SegmentEviction::MIN_PERMANENCE);
+  ASSERT_EQ(loaded, C);
+
+  // Archives of version 2 have no version and no policy, they load as LRU.
+  std::stringstream old;
+  {
+    cereal::BinaryOutputArchive ar(old);
+    const Permanence threshold = 0.5f;
+    const std::deque<size_t> sizes = {2u, 1u, 2u, 0u};
+    std::deque<SynapseData> syndata(2u);
+    syndata[0].presynapticCell = 3u; syndata[0].permanence = 0.6f;
+    syndata[1].presynapticCell = 5u; syndata[1].permanence = 0.2f;
+    const UInt32 iteration = 7u;
+    ar(threshold, sizes, syndata, iteration);
+  }
+  loaded.load(old);
+  ASSERT_EQ(loaded.segmentEviction(), SegmentEviction::LRU);
+  ASSERT_EQ(loaded.numCells(), 2u);
+  ASSERT_EQ(loaded.numSegments(0), 1u);
+  ASSERT_EQ(loaded.numSynapses(), 2u);
+  ASSERT_EQ(loaded.dataForSegment(loaded.getSegment(0, 0)).numConnected, 1u);
+  ASSERT_EQ(loaded.iteration(), 7u);
+}
+
+TEST(ConnectionsTest, testFork) {
+  for(const bool copyOnWrite : {false, true}) {
+    Connections C(100, 0.5f);
+    C.setCopyOnWrite(copyOnWrite);
+    for(CellIdx cell = 0; cell < 100; cell++) {
+      const Segment segment = C.createSegment(cell);
+      for(CellIdx i = 1; i <= 10; i++) {
+        C.createSynapse(segment, (cell + 7 * i) % 100, 0.05f * i);
+      }
+    }
+    const Connections copy(C);
+    Connections fork = C.fork();
+    ASSERT_EQ(fork, C);
+    ASSERT_EQ(fork.copyOnWrite(), copyOnWrite);
+
+    // Learning in the fork does not modify the original.
+    SDR input({100});
+    input.setSparse(SDR_sparse_t{1, 8, 15, 22, 29, 36});
+    const Segment segment = fork.segmentsForCell(3)[0];
+    fork.adaptSegment(segment, input, 0.1f, 0.1f);
+    fork.createSynapse(fork.createSegment(3), 50, 0.6f);
+    fork.destroySegment(fork.segmentsForCell(4)[0]);
+    ASSERT_EQ(C, copy);
+    ASSERT_NE(fork, C);
+
+    // The same changes to a deep copy give the same result.
+    Connections deep(copy);
+    deep.adaptSegment(deep.segmentsForCell(3)[0], input, 0.1f, 0.1f);
+    deep.createSynapse(deep.createSegment(3), 50, 0.6f);
+    deep.destroySegment(deep.segmentsForCell(4)[0]);
+    ASSERT_EQ(fork, deep);
+
+    // And the other way round.
+    C.adaptSegment(C.segmentsForCell(99)[0], input, 0.1f, 0.1f);
+    ASSERT_NE(C, copy);
+    ASSERT_EQ(fork, deep);
+  }
+}
+
+TEST(ConnectionsTest, testRaisePermanencesKeepsOrder) {
+  Connections C(10, 0.5f);
+  const Segment seg = C.createSegment(0);
+  C.createSynapse(seg, 1, 0.1f);
+  C.createSynapse(seg, 2, 0.4f);
+  C.createSynapse(seg, 3, 0.2f);
+  C.createSynapse(seg, 4, 0.3f);
+  const vector<Synapse> before = C.synapsesForSegment(seg);
+  C.raisePermanencesToThreshold(seg, 2u);
+  ASSERT_EQ(C.synapsesForSegment(seg), before);
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 2u);
+
+  C.destroySynapse(before[2]);
+  ASSERT_EQ(C.synapsesForSegment(seg), vector<Synapse>({before[0], before[1], before[3]}));
+}
+
+
+/**
+ * The index of the least used cells agrees with counting the segments of
+ * the cells, while segments are created and destroyed.
+ */
+TEST(ConnectionsTest, testLeastUsedCells) {
+  const CellIdx cellsPerGroup = 70u; //more than one word of the bit mask
+  Connections C(4u * cellsPerGroup);
+  C.indexLeastUsedCells(cellsPerGroup);
+  ASSERT_EQ(C.leastUsedCellsGroupSize(), cellsPerGroup);
+  Random rng(9);
+
+  for(int i = 0; i < 3000; i++) {
+    const CellIdx cell = rng.getUInt32((UInt32)C.numCells());
+    if(rng.getReal64() < 0.35 and C.numSegments(cell) > 0) {
+      C.destroySegment(C.segmentsForCell(cell)[0]);
+    }
+    else {
+      C.createSegment(cell, 5u); //also destroys the LRU segments
+    }
+    if(i % 10 != 0) continue;
+
+    for(CellIdx group = 0; group < 4u; group++) {
+      size_t minSegments = std::numeric_limits<size_t>::max();
+      vector<CellIdx> expected;
+      for(CellIdx c = group * cellsPerGroup; c < (group + 1u) * cellsPerGroup; c++) {
+        if(C.numSegments(c) < minSegments) {
+          minSegments = C.numSegments(c);
+          expected.clear();
+        }
+        if(C.numSegments(c) == minSegments) expected.push_back(c);
+      }
+      ASSERT_EQ(C.numLeastUsedCells(group), expected.size());
+      for(UInt32 k = 0; k < expected.size(); k++) {
+        ASSERT_EQ(C.leastUsedCell(group, k), expected[k]);
+      }
+    }
+  }
+
+  C.indexLeastUsedCells(0u);
+  ASSERT_EQ(C.leastUsedCellsGroupSize(), 0u);
+}
+
+
+/**
+ * Fixed point permanences: learning in whole steps, the threshold in steps,
+ * and the storage is kept by compact and save/load.
+ */
+TEST(ConnectionsTest, testQuantizedPermanence) {
+  Connections C(100, 0.5f, false, 0, PermanenceStorage::UINT8);
+  ASSERT_EQ(C.permanenceStorage(), PermanenceStorage::UINT8);
+  const auto steps = [](const UInt32 n) { return static_cast<Permanence>(n) / 255.0f; };
+  ASSERT_NEAR(C.getConnectedThreshold(), steps(128), htm::Epsilon * 2);
+
+  const Segment seg = C.createSegment(0);
+  const Synapse syn1 = C.createSynapse(seg, 1, 0.3f);
+  const Synapse syn2 = C.createSynapse(seg, 2, steps(127));
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(77));
+  ASSERT_EQ(C.dataForSynapse(syn2).permanence, steps(127));
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 0u);
+
+  // An increment smaller than a step still learns, one step at a time.
+  SDR input({100});
+  input.setSparse(SDR_sparse_t{2});
+  C.adaptSegment(seg, input, 0.001f, 0.0f);
+  ASSERT_EQ(C.dataForSynapse(syn2).permanence, steps(128));
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 1u);
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(77));
+  C.adaptSegment(seg, input, 0.0f, 0.02f); // 5.1 steps
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(72));
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 1u);
+
+  C.raisePermanencesToThreshold(seg, 2);
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 2u);
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(128));
+  ASSERT_EQ(C.dataForSynapse(syn2).permanence, steps(184));
+  C.synapseCompetition(seg, 1, 1);
+  ASSERT_EQ(C.dataForSegment(seg).numConnected, 1u);
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(72));
+  ASSERT_EQ(C.dataForSynapse(syn2).permanence, steps(128));
+
+  // A synapse one step above zero is pruned.
+  C.createSynapse(seg, 3, steps(1));
+  C.adaptSegment(seg, input, 0.0f, 0.001f, true);
+  ASSERT_EQ(C.synapsesForSegment(seg), vector<Synapse>({syn1, syn2}));
+  ASSERT_EQ(C.dataForSynapse(syn1).permanence, steps(71));
+
+  // Compact and save/load keep the steps.
+  C.destroySynapse(syn1);
+  C.createSynapse(C.createSegment(5), 4, 0.7f);
+  Connections compacted(C);
+  compacted.compact();
+  ASSERT_EQ(compacted, C);
+  stringstream ss;
+  compacted.save(ss);
+  Connections loaded;
+  loaded.load(ss);
+  ASSERT_EQ(loaded.permanenceStorage(), PermanenceStorage::UINT8);
+  ASSERT_EQ(loaded, C);
+  ASSERT_EQ(loaded.getConnectedThreshold(), C.getConnectedThreshold());
+  const Segment loadedSeg = loaded.getSegment(0, 0);
+  loaded.adaptSegment(loadedSeg, input, 0.001f, 0.0f);
+  ASSERT_EQ(loaded.dataForSynapse(loaded.synapsesForSegment(loadedSeg)[0]).permanence, steps(129));
+
+  // The storage is part of the model.
+  Connections real(100, 0.5f);
+  Connections fixed16(100, 0.5f, false, 0, PermanenceStorage::UINT16);
+  ASSERT_NE(real, fixed16);
+
+  // 16 bits learn as floating point, within a step.
+  Random rng(42);
+  for(CellIdx cell = 0; cell < 20; cell++) {
+    for(Connections *c : {&real, &fixed16}) {
+      const Segment segment = c->createSegment(cell);
+      for(CellIdx i = 0; i < 10; i++) {
+        c->createSynapse(segment, (cell + 9 * i) % 100, 0.1f * static_cast<Permanence>(i));
+      }
+    }
+  }
+  for(int step = 0; step < 20; step++) {
+    input.randomize(0.3f, rng);
+    for(CellIdx cell = 0; cell < 20; cell++) {
+      real.adaptSegment(real.getSegment(cell, 0), input, 0.05f, 0.02f);
+      fixed16.adaptSegment(fixed16.getSegment(cell, 0), input, 0.05f, 0.02f);
+    }
+  }
+  for(CellIdx cell = 0; cell < 20; cell++) {
+    const auto a = real.synapsesForSegment(real.getSegment(cell, 0));
+    const auto b = fixed16.synapsesForSegment(fixed16.getSegment(cell, 0));
+    ASSERT_EQ(a.size(), b.size());
+    for(size_t i = 0; i < a.size(); i++) {
+      ASSERT_NEAR(real.dataForSynapse(a[i]).permanence, fixed16.dataForSynapse(b[i]).permanence, 20.0f / 65535.0f);
+    }
+  }
+
+  // Archives of version 3 load with floating point permanences.
+  std::stringstream old;
+  {
+    cereal::BinaryOutputArchive ar(old);
+    const Real32 version = 3.0f;
+    const Permanence threshold = 0.5f;
+    const std::deque<size_t> sizes = {1u, 1u, 1u};
+    std::deque<SynapseData> syndata(1u);
+    syndata[0].presynapticCell = 0u; syndata[0].permanence = 0.6f;
+    const UInt32 iteration = 0u;
+    ar(version, threshold, sizes, syndata, iteration, SegmentEviction::OLDEST);
+  }
+  loaded.load(old);
+  ASSERT_EQ(loaded.permanenceStorage(), PermanenceStorage::REAL32);
+  ASSERT_EQ(loaded.segmentEviction(), SegmentEviction::OLDEST);
+  ASSERT_EQ(loaded.dataForSynapse(0).permanence, 0.6f);
+}
@@ -0,0 +1,125 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for FrozenConnections
+ */
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <vector>
+
+#include <htm/algorithms/FrozenConnections.hpp>
+#include <htm/types/Sdr.hpp>
+#include <htm/utils/Random.hpp>
+
+namespace testing {
+
+using namespace htm;
+using std::vector;
+
+static void randomConnections(Connections &connections, const CellIdx numInputs, Random &rng) {
+  for(CellIdx cell = 0; cell < connections.numCells(); cell++) {
+    for(UInt i = 0; i < 1 + cell % 3; i++) {
+      const Segment seg = connections.createSegment(cell);
+      for(UInt j = 0; j < 20; j++) {
+        connections.createSynapse(seg, rng.getUInt32(numInputs), (Permanence)rng.getReal64());
+      }
+    }
+  }
+}
+
+
+TEST(FrozenConnectionsTest, SameResults) {
+  Random rng(42);
+  Connections connections(200, 0.5f);
+  randomConnections(connections, 1000, rng);
+  // leave some holes in the flat lists
+  for(CellIdx cell = 0; cell < 200; cell += 7) {
+    connections.destroySegment(connections.segmentsForCell(cell)[0]);
+  }
+
+  const FrozenConnections frozen(connections);
+  ASSERT_EQ(frozen.segmentFlatListLength(), connections.segmentFlatListLength());
+  ASSERT_EQ(frozen.numSynapses(), connections.numSynapses());
+  ASSERT_EQ(frozen.revision(), connections.revision());
+  vector<Segment> segments;
+  for(CellIdx cell = 0; cell < 200; cell++) {
+    ASSERT_EQ(frozen.numSegments(cell), connections.numSegments(cell));
+    for(const auto segment : connections.segmentsForCell(cell)) {
+      ASSERT_EQ(frozen.cellForSegment(segment), cell);
+      segments.push_back(segment);
+    }
+  }
+  for(int i = 0; i < 500; i++) {
+    const Segment a = segments[rng.getUInt32(static_cast<UInt32>(segments.size()))];
+    const Segment b = segments[rng.getUInt32(static_cast<UInt32>(segments.size()))];
+    ASSERT_EQ(frozen.compareSegments(a, b), connections.compareSegments(a, b));
+  }
+
+  SDR input({1000});
+  SegmentActivity expected, actual;
+  for(int i = 0; i < 20; i++) {
+    input.randomize(i % 2 ? 0.02f : 0.3f, rng);
+    connections.computeActivity(expected, input.getSparse(), false);
+    frozen.computeActivity(actual, input.getSparse());
+    ASSERT_EQ(actual.numActiveConnected, expected.numActiveConnected);
+    ASSERT_EQ(actual.numActivePotential, expected.numActivePotential);
+    auto touched = actual.touched;
+    auto expectedTouched = expected.touched;
+    std::sort(touched.begin(), touched.end());
+    std::sort(expectedTouched.begin(), expectedTouched.end());
+    ASSERT_EQ(touched, expectedTouched);
+
+    frozen.computeActivity(actual, input.getSparse(), false);
+    ASSERT_EQ(actual.numActiveConnected, expected.numActiveConnected);
+    ASSERT_TRUE(actual.numActivePotential.empty());
+  }
+
+  // Cells without synapses are ignored.
+  frozen.computeActivity(actual, {5000u});
+  ASSERT_TRUE(actual.touched.empty());
+}
+
+
+TEST(FrozenConnectionsTest, Revision) {
+  Connections connections(10, 0.5f);
+  const Segment seg = connections.createSegment(1);
+  const Synapse syn = connections.createSynapse(seg, 3, 0.4f);
+
+  UInt64 revision = connections.revision();
+  connections.computeActivity({3}, true);
+  connections.updateSynapsePermanence(syn, 0.45f); // still disconnected
+  ASSERT_EQ(connections.revision(), revision) << "no change of computeActivity";
+
+  connections.updateSynapsePermanence(syn, 0.6f);
+  ASSERT_GT(connections.revision(), revision);
+  revision = connections.revision();
+  connections.createSynapse(seg, 4, 0.1f);
+  ASSERT_GT(connections.revision(), revision);
+  revision = connections.revision();
+  connections.destroySegment(seg);
+  ASSERT_GT(connections.revision(), revision);
+
+  const FrozenConnections frozen(connections);
+  ASSERT_EQ(frozen.revision(), connections.revision());
+  connections.createSegment(2);
+  ASSERT_NE(frozen.revision(), connections.revision());
+}
+
+}
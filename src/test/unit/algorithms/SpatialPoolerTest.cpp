@@ -30,6 +30,7 @@
 
 #include <htm/types/Types.hpp>
 #include <htm/utils/Log.hpp>
+#include <htm/utils/Topology.hpp>
 #include <htm/os/Timer.hpp>
 
 namespace testing {
@@ -1031,6 +1032,51 @@ TEST(SpatialPoolerTest, testUpdateBoostFactors) {
 }
 
 
+TEST(SpatialPoolerTest, testLocalNeighborhoodFilters) {
+  // The separable max and mean over the neighborhoods match the
+  // neighborhood loops, in 1D, 2D and 3D, with and without wrap around.
+  Random rng(3);
+  for(const auto &dims : vector<vector<UInt>>{{53}, {12, 9}, {4, 5, 6}}) {
+    SpatialPooler sp;
+    setup(sp, vector<UInt>(dims.size(), 4u), dims);
+    const UInt numColumns = sp.getNumColumns();
+    sp.setBoostStrength(3.0f);
+    sp.setMinPctOverlapDutyCycles(0.1f);
+    for(const bool wrap : {false, true}) {
+      sp.setWrapAround(wrap);
+      for(const UInt radius : {0u, 1u, 2u, 4u, 7u, 60u}) {
+        sp.setInhibitionRadius(radius);
+        vector<Real> overlapDuty(numColumns), activeDuty(numColumns);
+        for(auto &x : overlapDuty) x = static_cast<Real>(rng.getReal64());
+        for(auto &x : activeDuty)  x = static_cast<Real>(rng.getReal64() * 0.1);
+        sp.setOverlapDutyCycles(overlapDuty.data());
+        sp.setActiveDutyCycles(activeDuty.data());
+        sp.updateMinDutyCyclesLocal_();
+        sp.updateBoostFactorsLocal_();
+        vector<Real> minDuty(numColumns), boost(numColumns);
+        sp.getMinOverlapDutyCycles(minDuty.data());
+        sp.getBoostFactors(boost.data());
+
+        for(UInt column = 0; column < numColumns; column++) {
+          Real maxDuty = 0.0f, sum = 0.0f;
+          UInt count = 0u;
+          const auto visit = [&](UInt n) {
+            maxDuty = std::max(maxDuty, overlapDuty[n]);
+            sum += activeDuty[n];
+            count++;
+          };
+          if(wrap) { for(auto n : WrappingNeighborhood(column, radius, dims)) visit(n); }
+          else     { for(auto n : Neighborhood(column, radius, dims)) visit(n); }
+          ASSERT_EQ(minDuty[column], maxDuty * 0.1f) << column;
+          const Real expected = std::exp((sum / count - activeDuty[column]) * 3.0f);
+          ASSERT_NEAR(boost[column], expected, 1e-5f) << column;
+        }
+      }
+    }
+  }
+}
+
+
 TEST(SpatialPoolerTest, testUpdateBookeepingVars) {
   SpatialPooler sp;
   sp.setIterationNum(5);
@@ -1196,6 +1242,97 @@ TEST(SpatialPoolerTest, testInhibitColumnsGlobal) {
 }
 
 
+TEST(SpatialPoolerTest, testInhibitColumnsGlobalSameAsSort) {
+  // The radix select gives the same winners, in the same order, as sorting
+  // all columns by overlap (ties broken by the larger index).
+  SpatialPooler sp;
+  setup(sp, 10, 1000);
+  Random rng(5);
+  const auto reference = [&](const vector<Real> &overlaps, Real density) {
+    vector<UInt> sorted(overlaps.size());
+    std::iota(sorted.begin(), sorted.end(), 0u);
+    std::stable_sort(sorted.begin(), sorted.end(), [&](UInt a, UInt b) {
+      return (overlaps[a] == overlaps[b]) ? a > b : overlaps[a] > overlaps[b]; });
+    sorted.resize((UInt)(density * overlaps.size()));
+    while(!sorted.empty() && overlaps[sorted.back()] < sp.getStimulusThreshold())
+      sorted.pop_back();
+    return sorted;
+  };
+  vector<Real> overlaps(1000);
+  for(const Real density : {0.001f, 0.02f, 0.1f, 0.5f, 1.0f}) {
+    // Few distinct values (many ties), boosted values, and all equal.
+    for(auto &x : overlaps) x = static_cast<Real>(rng.getUInt32(8));
+    vector<UInt> active;
+    sp.inhibitColumnsGlobal_(overlaps, density, active);
+    ASSERT_EQ(active, reference(overlaps, density)) << density;
+
+    for(auto &x : overlaps) x = rng.getUInt32(40) * static_cast<Real>(rng.getReal64() + 0.5);
+    overlaps[7] = -0.0f;
+    sp.inhibitColumnsGlobal_(overlaps, density, active);
+    ASSERT_EQ(active, reference(overlaps, density)) << density;
+
+    std::fill(overlaps.begin(), overlaps.end(), 3.0f);
+    sp.inhibitColumnsGlobal_(overlaps, density, active);
+    ASSERT_EQ(active, reference(overlaps, density)) << density;
+  }
+}
+
+
+TEST(SpatialPoolerTest, testInhibitColumnsLocalCounting) {
+  // Same results as visiting the neighborhoods, for 1D and 2D topologies,
+  // with and without wrap around, with many equal overlaps.
+  const auto reference = [](const SpatialPooler &sp, const vector<Real> &overlaps, Real density) {
+    vector<UInt> dims = sp.getColumnDimensions();
+    vector<UInt> active;
+    vector<bool> activeDense(overlaps.size(), false);
+    for(UInt column = 0; column < overlaps.size(); column++) {
+      if(overlaps[column] < sp.getStimulusThreshold()) continue;
+      UInt numNeighbors = 0, numBigger = 0;
+      const auto visit = [&](UInt neighbor) {
+        if(neighbor == column) return;
+        numNeighbors++;
+        if(overlaps[neighbor] > overlaps[column] ||
+           (overlaps[neighbor] == overlaps[column] && activeDense[neighbor])) numBigger++;
+      };
+      if(sp.getWrapAround()) {
+        for(auto n : WrappingNeighborhood(column, sp.getInhibitionRadius(), dims)) visit(n);
+      } else {
+        for(auto n : Neighborhood(column, sp.getInhibitionRadius(), dims)) visit(n);
+      }
+      if(numBigger < (UInt)(0.5f + (density * (numNeighbors + 1)))) {
+        active.push_back(column);
+        activeDense[column] = true;
+      }
+    }
+    return active;
+  };
+
+  Random rng(17);
+  for(const auto &dims : vector<vector<UInt>>{{97}, {20, 30}, {7, 50}}) {
+    SpatialPooler sp;
+    setup(sp, vector<UInt>(dims.size(), 10u), dims);
+    vector<Real> overlaps(sp.getNumColumns());
+    for(const bool wrap : {false, true}) {
+      sp.setWrapAround(wrap);
+      for(const UInt radius : {0u, 1u, 3u, 8u, 30u, 100u}) {
+        sp.setInhibitionRadius(radius);
+        for(const UInt threshold : {0u, 2u}) {
+          sp.setStimulusThreshold(threshold);
+          for(auto &x : overlaps) x = static_cast<Real>(rng.getUInt32(6));
+          vector<UInt> active;
+          sp.inhibitColumnsLocalCounting_(overlaps, 0.1f, active);
+          ASSERT_EQ(active, reference(sp, overlaps, 0.1f))
+            << dims.size() << "D, wrap " << wrap << ", radius " << radius;
+          if(radius >= 3u) { ASSERT_FALSE(active.empty()); }
+          sp.inhibitColumnsLocal_(overlaps, 0.1f, active);
+          ASSERT_EQ(active, reference(sp, overlaps, 0.1f));
+        }
+      }
+    }
+  }
+}
+
+
 TEST(SpatialPoolerTest, testValidateGlobalInhibitionParameters) {
   // With 10 columns the minimum sparsity for global inhibition is 10%
   // Setting sparsity to 2% should throw an exception
@@ -2054,6 +2191,174 @@ TEST(SpatialPoolerTest, testConstructorVsInitialize) {
 }
 
 
+TEST(SpatialPoolerTest, testFreezeConnections) {
+  // not copies, SP::connections of a copy refers to the original
+  SpatialPooler sp({200}, {100});
+  SpatialPooler frozen({200}, {100});
+  SDR input({200});
+  SDR active1({100});
+  SDR active2({100});
+  SDR active3({100});
+  Random rng(11);
+  for(SpatialPooler *s : {&sp, &frozen}) {
+    s->setBoostStrength(2.0f);
+    Random inputs(11);
+    for(int i = 0; i < 50; i++) {
+      input.randomize(0.1f, inputs);
+      s->compute(input, true, active1);
+    }
+  }
+
+  frozen.freezeConnections();
+  ASSERT_TRUE(frozen.isFrozen());
+  ASSERT_FALSE(sp.isFrozen());
+  ASSERT_EQ(frozen.getFrozenConnections()->numSynapses(), sp.connections.numSynapses());
+  ASSERT_EQ(frozen.connections.numSynapses(), 0u) << "the connections are released";
+
+  SpatialPooler::InferenceState state;
+  for(int i = 0; i < 20; i++) {
+    input.randomize(0.1f, rng);
+    const auto overlaps = sp.compute(input, false, active1);
+    ASSERT_EQ(frozen.compute(input, false, active2), overlaps);
+    ASSERT_EQ(active1, active2);
+    const auto iterations = frozen.getIterationNum();
+    ASSERT_EQ(frozen.infer(input, active3, state), overlaps);
+    ASSERT_EQ(active1, active3);
+    ASSERT_EQ(frozen.getIterationNum(), iterations) << "infer does not change the SP";
+  }
+
+  EXPECT_ANY_THROW(frozen.compute(input, true, active2));
+  vector<Real> permanences(200);
+  EXPECT_ANY_THROW(frozen.getPermanence(0, permanences.data()));
+  std::stringstream ss;
+  EXPECT_ANY_THROW(frozen.save(ss));
+  EXPECT_ANY_THROW(sp.infer(input, active3, state)) << "not frozen";
+}
+
+
+TEST(SpatialPoolerTest, testLazyDutyCycles) {
+  SpatialPooler eager({400}, {1000});
+  eager.setGlobalInhibition(true);
+  eager.setLocalAreaDensity(0.02f);
+  eager.setBoostStrength(3.0f);
+  eager.setDutyCyclePeriod(100);
+  SpatialPooler lazy = eager;
+  lazy.setLazyDutyCycles(true);
+  ASSERT_TRUE(lazy.getLazyDutyCycles());
+
+  SDR input({400});
+  SDR active1({1000});
+  SDR active2({1000});
+  Random rng(42);
+  vector<Real> expected(1000), actual(1000);
+  int resyncs = 0;
+  for(int i = 0; i < 300; i++) {
+    input.randomize(0.05f, rng);
+    eager.compute(input, true, active1);
+    lazy.compute(input, true, active2);
+    const auto &boosted1 = eager.getBoostedOverlaps();
+    const auto &boosted2 = lazy.getBoostedOverlaps();
+    for(UInt c = 0; c < 1000; c++) {
+      ASSERT_NEAR(boosted1[c], boosted2[c], 1.0e-4f) << "step " << i;
+    }
+    if( active1 != active2 ) {
+      // Rounding broke a tie of boosted overlaps the other way.
+      resyncs++;
+      stringstream ss;
+      lazy.save(ss);
+      eager.load(ss);
+      ASSERT_FALSE(eager.getLazyDutyCycles()) << "load keeps the setting";
+      continue;
+    }
+    eager.getActiveDutyCycles(expected.data());
+    lazy.getActiveDutyCycles(actual.data());
+    for(UInt c = 0; c < 1000; c++) {
+      ASSERT_NEAR(expected[c], actual[c], 1.0e-5f) << "step " << i;
+    }
+    eager.getOverlapDutyCycles(expected.data());
+    lazy.getOverlapDutyCycles(actual.data());
+    for(UInt c = 0; c < 1000; c++) {
+      ASSERT_NEAR(expected[c], actual[c], 1.0e-5f) << "step " << i;
+    }
+    eager.getBoostFactors(expected.data());
+    lazy.getBoostFactors(actual.data());
+    for(UInt c = 0; c < 1000; c++) {
+      ASSERT_NEAR(expected[c], actual[c], 1.0e-4f) << "step " << i;
+    }
+  }
+  ASSERT_LT(resyncs, 30);
+
+  // Serialization keeps the decayed state, in the format of eager decay.
+  stringstream ss;
+  lazy.save(ss);
+  const string archive = ss.str();
+  SpatialPooler loaded;
+  loaded.setLazyDutyCycles(true);
+  loaded.load(ss);
+  ASSERT_TRUE(loaded.getLazyDutyCycles()) << "load keeps the setting";
+  ASSERT_EQ(lazy, loaded);
+
+  stringstream ssEager(archive);
+  SpatialPooler loadedEager;
+  loadedEager.load(ssEager);
+  ASSERT_FALSE(loadedEager.getLazyDutyCycles());
+  ASSERT_EQ(lazy, loadedEager);
+  for(int i = 0; i < 20; i++) {
+    input.randomize(0.05f, rng);
+    lazy.compute(input, true, active1);
+    loaded.compute(input, true, active2);
+    ASSERT_EQ(active1, active2);
+  }
+  ASSERT_EQ(lazy, loaded);
+
+  // Switching back to eager decay keeps the boost factors.
+  lazy.getBoostFactors(expected.data());
+  lazy.setLazyDutyCycles(false);
+  lazy.getBoostFactors(actual.data());
+  ASSERT_EQ(expected, actual);
+}
+
+
+TEST(SpatialPoolerTest, testParallelInitialize) {
+  const vector<UInt> inputDims  = {40, 50};
+  const vector<UInt> columnDims = {30, 30};
+  SpatialPooler serial(inputDims, columnDims, 5u);
+
+  vector<SpatialPooler> parallel(3);
+  const UInt numThreads[] = {1u, 3u, 8u};
+  for(UInt i = 0; i < 3u; i++) {
+    parallel[i].setThreadPool(std::make_shared<ThreadPool>(numThreads[i]));
+    parallel[i].initialize(inputDims, columnDims, 5u);
+  }
+  ASSERT_EQ(parallel[0], parallel[1]);
+  ASSERT_EQ(parallel[0], parallel[2]);
+
+  // Same sizes of the potential pools as the serial initialization, from
+  // different random draws.
+  const auto &conn = parallel[0].connections;
+  ASSERT_EQ(conn.numSynapses(), serial.connections.numSynapses());
+  ASSERT_NE(conn, serial.connections);
+  for(UInt column = 0; column < 900u; column++) {
+    ASSERT_EQ(conn.numSynapses(column), serial.connections.numSynapses(column));
+    ASSERT_GE(conn.dataForSegment(column).numConnected, serial.getStimulusThreshold());
+  }
+
+  // Compute uses the pool too, with the same results.
+  SpatialPooler copy(parallel[0]);
+  copy.setThreadPool(nullptr);
+  SDR input(inputDims);
+  SDR active1(columnDims);
+  SDR active2(columnDims);
+  Random rng(7);
+  for(int i = 0; i < 20; i++) {
+    input.randomize(0.1f, rng);
+    parallel[0].compute(input, true, active1);
+    copy.compute(input, true, active2);
+    ASSERT_EQ(active1, active2);
+  }
+}
+
+
 TEST(SpatialPoolerTest, ExactOutput) { 
   // Silver is an SDR that is loaded by direct initalization from a vector.
   SDR silver_sdr({ 200 });
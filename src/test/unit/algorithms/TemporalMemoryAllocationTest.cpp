@@ -0,0 +1,82 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * ---------------------------------------------------------------------- */
+
+/** @file
+ * Heap allocation tests for TemporalMemory.
+ *
+ * This file replaces the global operator new to count the allocations, so
+ * it is built into its own executable (allocation_tests), not unit_tests.
+ */
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include <htm/algorithms/TemporalMemory.hpp>
+
+// The replaced operators pair malloc with free, gcc 11 does not see that
+// through the inlined new and delete expressions of this file.
+#if defined(__GNUC__) && !defined(__clang__) && !defined(__INTEL_COMPILER) && (__GNUC__ >= 11)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+// Count the heap allocations of the whole program while countAllocations is
+// set.
+static std::atomic<bool>   countAllocations(false);
+static std::atomic<size_t> numAllocations(0u);
+
+void *operator new(std::size_t size) {
+  if( countAllocations ) numAllocations++;
+  void *ptr = std::malloc(size > 0u ? size : 1u);
+  if( ptr == nullptr ) throw std::bad_alloc();
+  return ptr;
+}
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+
+namespace testing {
+
+using namespace std;
+using namespace htm;
+
+
+TEST(TemporalMemoryAllocationTest, ComputeDoesNotAllocate) {
+  // 10 active columns, and segments grow up to 10 synapses.
+  TemporalMemory tm({200}, 8, 8, 0.21f, 0.5f, 6, 10, 0.1f, 0.1f, 0.0f, 42);
+  vector<SDR> sequence(10, SDR({200}));
+  Random rng(1);
+  for(auto &sdr : sequence) sdr.randomize(0.05f, rng);
+  for(int epoch = 0; epoch < 30; epoch++) {
+    for(const auto &x : sequence) tm.compute(x, true);
+  }
+  ASSERT_EQ(tm.anomaly, 0.0f) << "the sequence is learned";
+
+  // After warmup, the buffers have grown and the learning does not grow
+  // segments anymore.
+  for(const bool learn : {true, false}) {
+    numAllocations = 0u;
+    countAllocations = true;
+    for(const auto &x : sequence) tm.compute(x, learn);
+    countAllocations = false;
+    EXPECT_EQ(numAllocations.load(), 0u) << "learn " << learn;
+  }
+}
+
+} // namespace
@@ -21,12 +21,14 @@
 
 #include <cstring>
 #include <fstream>
+#include <memory>
 
 #include <htm/types/Types.hpp>
 #include <htm/types/Sdr.hpp>
 #include <htm/utils/Log.hpp>
 
 #include <cstdio>
+#include <thread>
 
 #include "gtest/gtest.h"
 #include <htm/algorithms/TemporalMemory.hpp>
@@ -1547,6 +1549,34 @@ TEST(TemporalMemoryTest, testSaveLoad) {
   serializationTestVerify(tm2);
 }
 
+TEST(TemporalMemoryTest, testSegmentEviction) {
+  // Few segments per cell, and sequences which need more.
+  vector<std::unique_ptr<TemporalMemory>> tms;
+  for(const auto policy : {SegmentEviction::LRU, SegmentEviction::OLDEST, SegmentEviction::MIN_PERMANENCE}) {
+    tms.emplace_back(new TemporalMemory({50}, 2, 3, 0.21f, 0.5f, 2, 5, 0.1f, 0.1f, 0.0f, 42, 2, 32,
+                                        true, 0u, TemporalMemory::ANMode::RAW, policy));
+    ASSERT_EQ(tms.back()->getSegmentEviction(), policy);
+  }
+  Random rng(4);
+  SDR x({50});
+  for(int step = 0; step < 200; step++) {
+    x.randomize(0.1f, rng);
+    for(auto &tm : tms) tm->compute(x, true);
+  }
+  for(auto &tm : tms) {
+    for(CellIdx cell = 0; cell < tm->numberOfCells(); cell++) {
+      ASSERT_LE(tm->connections.numSegments(cell), 2u);
+    }
+    // the policy is serialized
+    stringstream ss;
+    tm->save(ss);
+    TemporalMemory loaded;
+    loaded.load(ss);
+    ASSERT_EQ(loaded.getSegmentEviction(), tm->getSegmentEviction());
+    ASSERT_TRUE(loaded == *tm);
+  }
+}
+
 TEST(TemporalMemoryTest, testSaveArLoadAr) {
   TemporalMemory tm1(
       /*columnDimensions*/ {32},
@@ -1663,6 +1693,252 @@ TEST(TemporalMemoryTest, testEquals) {
   ASSERT_EQ(tm, tmCopy);
 }
 
+TEST(TemporalMemoryTest, testFreezeConnections) {
+  TemporalMemory tm({100}, 8, 5, 0.21f, 0.5f, 3, 12, 0.1f, 0.05f, 0.01f, 42);
+  vector<SDR> pattern(8, SDR({100}));
+  Random rng(7);
+  for(auto &sdr : pattern) sdr.randomize(0.08f, rng);
+  for(int trial = 0; trial < 10; trial++) {
+    for(const auto &x : pattern) tm.compute(x, true);
+  }
+  tm.reset();
+
+  // With an up to date snapshot, compute without learning uses it.
+  auto prepared = tm;
+  prepared.prepareStreams();
+  ASSERT_NE(prepared.getFrozenConnections(), nullptr);
+  ASSERT_EQ(tm.getFrozenConnections(), nullptr);
+  const auto checkSame = [&](const bool learn) {
+    for(const auto &x : pattern) {
+      tm.activateDendrites(learn);
+      prepared.activateDendrites(learn);
+      ASSERT_EQ(tm.getPredictiveCells(), prepared.getPredictiveCells());
+      ASSERT_EQ(tm.getActiveSegments(), prepared.getActiveSegments());
+      ASSERT_EQ(tm.getMatchingSegments(), prepared.getMatchingSegments());
+      tm.compute(x, learn);
+      prepared.compute(x, learn);
+      ASSERT_EQ(tm.getActiveCells(), prepared.getActiveCells());
+      ASSERT_EQ(tm.anomaly, prepared.anomaly);
+    }
+  };
+  checkSame(false);
+  ASSERT_EQ(tm, prepared);
+  ASSERT_EQ(prepared.getFrozenConnections()->revision(), prepared.connections.revision()) << "snapshot was used";
+  // Learning uses the connections, and makes the snapshot stale.
+  checkSame(true);
+  checkSame(false);
+  ASSERT_EQ(tm, prepared);
+  tm.reset();
+
+  // The frozen TM has only the snapshot, and infers with streams.
+  auto frozen = tm;
+  frozen.freezeConnections();
+  ASSERT_TRUE(frozen.isFrozen());
+  ASSERT_FALSE(tm.isFrozen());
+  ASSERT_EQ(frozen.getFrozenConnections()->numSynapses(), tm.connections.numSynapses());
+  ASSERT_EQ(frozen.connections.numSynapses(), 0u) << "the connections are released";
+  ASSERT_EQ(frozen.numberOfCells(), tm.numberOfCells());
+  vector<TemporalMemory::Stream> stream(1, frozen.createStream());
+  for(const auto &x : pattern) {
+    tm.compute(x, false);
+    frozen.computeStreams({x}, stream);
+    ASSERT_EQ(stream[0].activeCells, tm.getActiveCells());
+    ASSERT_EQ(stream[0].winnerCells, tm.getWinnerCells());
+    ASSERT_EQ(stream[0].anomaly, tm.anomaly);
+  }
+  EXPECT_ANY_THROW(frozen.compute(pattern[0], false));
+  std::stringstream ss;
+  EXPECT_ANY_THROW(frozen.save(ss));
+}
+
+TEST(TemporalMemoryTest, testThreadPoolSameResults) {
+  // predictedSegmentDecrement, few segments per cell and noisy inputs, so
+  // that columns are predicted, burst and punished, and segments are evicted.
+  // not copies, TM::anomaly of a copy refers to the original
+  TemporalMemory serial({200}, 6, 8, 0.3f, 0.5f, 5, 15, 0.1f, 0.08f, 0.02f, 42, 4, 32);
+  TemporalMemory one   ({200}, 6, 8, 0.3f, 0.5f, 5, 15, 0.1f, 0.08f, 0.02f, 42, 4, 32);
+  TemporalMemory four  ({200}, 6, 8, 0.3f, 0.5f, 5, 15, 0.1f, 0.08f, 0.02f, 42, 4, 32);
+  one.setThreadPool(std::make_shared<ThreadPool>(1));
+  four.setThreadPool(std::make_shared<ThreadPool>(4));
+  ASSERT_EQ(four.getThreadPool(), four.connections.getThreadPool());
+
+  vector<SDR> pattern(10, SDR({200}));
+  Random rng(11);
+  for(auto &sdr : pattern) sdr.randomize(0.05f, rng);
+  for(int step = 0; step < 300; step++) {
+    SDR input = pattern[step % pattern.size()];
+    input.addNoise(0.1f, rng);
+    const bool learn = step % 50 != 49;
+    for(TemporalMemory *tm : {&serial, &one, &four}) {
+      tm->compute(input, learn);
+    }
+    for(TemporalMemory *tm : {&one, &four}) {
+      ASSERT_EQ(tm->getActiveCells(), serial.getActiveCells()) << "step " << step;
+      ASSERT_EQ(tm->getWinnerCells(), serial.getWinnerCells()) << "step " << step;
+      ASSERT_EQ(tm->anomaly, serial.anomaly) << "step " << step;
+    }
+  }
+  ASSERT_GT(serial.connections.numSegments(), 0u);
+  ASSERT_EQ(one, serial);
+  ASSERT_EQ(four, serial);
+}
+
+TEST(TemporalMemoryTest, testFork) {
+  TemporalMemory tm({200}, 6, 8, 0.3f, 0.5f, 5, 15, 0.1f, 0.08f, 0.02f, 42, 4, 32);
+  vector<SDR> pattern(10, SDR({200}));
+  Random rng(3);
+  for(auto &sdr : pattern) sdr.randomize(0.05f, rng);
+  for(int trial = 0; trial < 20; trial++) {
+    for(const auto &x : pattern) tm.compute(x, true);
+  }
+  tm.connections.setCopyOnWrite(true);
+  const TemporalMemory saved(tm);
+  ASSERT_EQ(saved, tm);
+
+  // Both continue, with different inputs, as separate copies would.
+  TemporalMemory fork = tm.fork();
+  TemporalMemory copy; //a deep copy, with contiguous connections
+  std::stringstream ss;
+  saved.save(ss);
+  copy.load(ss);
+  ASSERT_EQ(fork, tm);
+  ASSERT_TRUE(fork.connections.copyOnWrite());
+  ASSERT_FALSE(copy.connections.copyOnWrite());
+  const auto run = [&](TemporalMemory &a, TemporalMemory &b, UInt seed) {
+    Random noise(seed);
+    for(int step = 0; step < 30; step++) {
+      SDR input = pattern[step % pattern.size()];
+      input.addNoise(0.2f, noise);
+      a.compute(input, true);
+      b.compute(input, true);
+      ASSERT_EQ(a.getActiveCells(), b.getActiveCells()) << "step " << step;
+      ASSERT_EQ(a.anomaly, b.anomaly) << "step " << step;
+    }
+    ASSERT_EQ(a, b);
+  };
+  run(fork, copy, 1u);
+  ASSERT_EQ(tm, saved) << "the original is not modified by its fork";
+  TemporalMemory other(saved);
+  run(tm, other, 2u);
+  ASSERT_EQ(fork, copy) << "the fork is not modified by the original";
+  ASSERT_NE(fork, tm);
+
+  // Forks learn in parallel, in different threads.
+  tm.setThreadPool(std::make_shared<ThreadPool>(4));
+  TemporalMemory fork1 = tm.fork(), fork2 = tm.fork();
+  TemporalMemory copy1(tm), copy2(tm);
+  ASSERT_EQ(fork1.getThreadPool(), tm.getThreadPool());
+  std::thread thread1([&]() { run(fork1, copy1, 3u); });
+  std::thread thread2([&]() { run(fork2, copy2, 4u); });
+  thread1.join();
+  thread2.join();
+  ASSERT_EQ(fork1, copy1);
+  ASSERT_EQ(fork2, copy2);
+  ASSERT_NE(fork1, fork2);
+}
+
+TEST(TemporalMemoryTest, testActiveAndMatchingSegmentsThresholds) {
+  TemporalMemory tm({50}, 4, 4, 0.3f, 0.5f, 2, 10, 0.1f, 0.05f, 0.0f, 42);
+  vector<SDR> pattern(6, SDR({50}));
+  Random rng(3);
+  for(auto &sdr : pattern) sdr.randomize(0.1f, rng);
+  for(int trial = 0; trial < 10; trial++) {
+    for(const auto &x : pattern) tm.compute(x, true);
+  }
+
+  // Compare with a scan of all segments, sorted by cell.
+  const auto expectSegments = [&](const SynapseIdx minThreshold, const SynapseIdx activationThreshold) {
+    tm.setMinThreshold(minThreshold);
+    tm.setActivationThreshold(activationThreshold);
+    for(const auto &x : pattern) {
+      tm.activateDendrites(false);
+      const auto activity = tm.connections.computeActivity(tm.getActiveCells(), false);
+      vector<Segment> active, matching;
+      for(CellIdx cell = 0; cell < tm.numberOfCells(); cell++) {
+        for(const auto segment : tm.connections.segmentsForCell(cell)) {
+          if(activity[segment] >= activationThreshold) active.push_back(segment);
+        }
+      }
+      ASSERT_EQ(tm.getActiveSegments(), active);
+      for(const auto segment : tm.getMatchingSegments()) {
+        ASSERT_GE(tm.connections.numSynapses(segment), minThreshold);
+      }
+      if(minThreshold == 0) {
+        ASSERT_EQ(tm.getMatchingSegments().size(), tm.connections.segmentFlatListLength());
+      }
+      tm.compute(x, false);
+    }
+  };
+  expectSegments(2, 4);
+  expectSegments(4, 2); // minThreshold above activationThreshold
+  expectSegments(0, 3);
+}
+
+TEST(TemporalMemoryTest, testComputeStreams) {
+  vector<SDR> pattern(8, SDR({100}));
+  Random rng(7);
+  for(auto &sdr : pattern) sdr.randomize(0.08f, rng);
+  const auto trainedTM = [&]() {
+    std::unique_ptr<TemporalMemory> tm(new TemporalMemory({100}, 6, 5, 0.21f, 0.5f, 3, 12, 0.1f, 0.05f, 0.01f, 42));
+    for(int trial = 0; trial < 10; trial++) {
+      for(const auto &x : pattern) tm->compute(x, true);
+    }
+    tm->reset();
+    return tm;
+  };
+  const auto tm     = trainedTM();
+  const auto shared = trainedTM();
+  shared->setThreadPool(std::make_shared<ThreadPool>(3));
+
+  // Each stream sees the pattern with its own noise. Compare with a TM per
+  // stream (not copies, TM::anomaly of a copy refers to the original).
+  const size_t numStreams = 5;
+  vector<std::unique_ptr<TemporalMemory>> expected;
+  vector<TemporalMemory::Stream> streams;
+  for(size_t i = 0; i < numStreams; i++) {
+    expected.push_back(trainedTM());
+    streams.push_back(tm->createStream());
+  }
+  vector<TemporalMemory::Stream> parallel(streams);
+  EXPECT_ANY_THROW(tm->computeStreams(vector<SDR>(numStreams, SDR({100})), streams)) << "not prepared";
+  tm->prepareStreams();
+  shared->prepareStreams();
+
+  vector<SDR> inputs(numStreams, SDR({100}));
+  for(int step = 0; step < 40; step++) {
+    for(size_t i = 0; i < numStreams; i++) {
+      inputs[i] = pattern[(step + i) % pattern.size()];
+      inputs[i].addNoise(0.05f * i, rng);
+      expected[i]->compute(inputs[i], false);
+    }
+    tm->computeStreams(inputs, streams);
+    shared->computeStreams(inputs, parallel);
+    for(size_t i = 0; i < numStreams; i++) {
+      ASSERT_EQ(streams[i].activeCells, expected[i]->getActiveCells()) << "step " << step;
+      ASSERT_EQ(streams[i].winnerCells, expected[i]->getWinnerCells()) << "step " << step;
+      ASSERT_EQ(streams[i].anomaly, expected[i]->anomaly) << "step " << step;
+      ASSERT_EQ(parallel[i].activeCells, streams[i].activeCells);
+      ASSERT_EQ(parallel[i].winnerCells, streams[i].winnerCells);
+      ASSERT_EQ(parallel[i].anomaly, streams[i].anomaly);
+    }
+  }
+  // Calls from several threads on one TM take turns with its scratch buffers.
+  vector<TemporalMemory::Stream> first(parallel), second(parallel);
+  std::thread other([&]() { shared->computeStreams(inputs, second); });
+  shared->computeStreams(inputs, first);
+  other.join();
+  for(size_t i = 0; i < numStreams; i++) {
+    ASSERT_EQ(first[i].activeCells, second[i].activeCells);
+    ASSERT_EQ(first[i].winnerCells, second[i].winnerCells);
+    ASSERT_EQ(first[i].anomaly, second[i].anomaly);
+  }
+  ASSERT_EQ(*tm, *trainedTM()) << "the shared TM does not change";
+  vector<TemporalMemory::Stream> one(1, tm->createStream());
+  EXPECT_ANY_THROW(tm->computeStreams(inputs, one)) << "one input per stream";
+  tm->createSegment(0);
+  EXPECT_ANY_THROW(tm->computeStreams(inputs, streams)) << "the snapshot is out of date";
+}
+
 TEST(TemporalMemoryTest, testIncorrectDefaultConstructor) {
   TemporalMemory tmFail; //default empty constructor is only used for deserialization
   SDR data1({0});
@@ -0,0 +1,185 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2018, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/*---------------------------------------------------------------------
+ * This is a test of the ColumnPoolerRegion module.  It does not check the
+ * ColumnPooler itself (see ColumnPoolerTest) but rather just the plug-in
+ * mechanism to call the ColumnPooler.
+ *---------------------------------------------------------------------
+ */
+
+#include <htm/engine/Input.hpp>
+#include <htm/engine/Network.hpp>
+#include <htm/engine/Output.hpp>
+#include <htm/engine/Region.hpp>
+#include <htm/engine/Spec.hpp>
+#include <htm/ntypes/Array.hpp>
+#include <htm/os/Directory.hpp>
+#include <htm/regions/ColumnPoolerRegion.hpp>
+
+#include <iostream>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "RegionTestUtilities.hpp"
+#include "gtest/gtest.h"
+
+#define VERBOSE if (verbose) std::cerr << "[          ] "
+static bool verbose = false; // turn this on to print extra stuff for debugging the test.
+
+#define EXPECTED_SPEC_COUNT 23 // The number of parameters expected in the ColumnPoolerRegion Spec
+
+using namespace htm;
+
+namespace testing {
+
+// Verify that all parameters are working.
+// Assumes that the default value in the Spec is the same as the default when
+// creating a region with default constructor.
+TEST(ColumnPoolerRegionTest, testSpecAndParameters) {
+  Network net;
+
+  std::set<std::string> excluded;
+  std::shared_ptr<Region> region1 = net.addRegion("region1", "ColumnPoolerRegion", "");
+  checkGetSetAgainstSpec(region1, EXPECTED_SPEC_COUNT, excluded, verbose);
+  checkInputOutputsAgainstSpec(region1, verbose);
+}
+
+TEST(ColumnPoolerRegionTest, initialization_with_parameters) {
+  Network net;
+
+  std::string nodeParams =
+      "{cellCount: 1024, sdrSize: 20, minSdrSize: 15, maxSdrSize: 30, "
+      "synPermProximalInc: 0.2, sampleSizeProximal: -1, "
+      "minThresholdProximal: 5, activationThresholdDistal: 8, "
+      "inertiaFactor: 0.5, seed: 43, onlineLearning: true, learningMode: false}";
+  std::shared_ptr<Region> region1 = net.addRegion("region1", "ColumnPoolerRegion", nodeParams);
+
+  EXPECT_EQ(region1->getParameterUInt32("cellCount"), 1024u);
+  EXPECT_EQ(region1->getParameterUInt32("sdrSize"), 20u);
+  EXPECT_EQ(region1->getParameterUInt32("minSdrSize"), 15u);
+  EXPECT_EQ(region1->getParameterUInt32("maxSdrSize"), 30u);
+  EXPECT_FLOAT_EQ(region1->getParameterReal32("synPermProximalInc"), 0.2f);
+  EXPECT_EQ(region1->getParameterInt32("sampleSizeProximal"), -1);
+  EXPECT_EQ(region1->getParameterUInt32("minThresholdProximal"), 5u);
+  EXPECT_EQ(region1->getParameterUInt32("activationThresholdDistal"), 8u);
+  EXPECT_FLOAT_EQ(region1->getParameterReal32("inertiaFactor"), 0.5f);
+  EXPECT_EQ(region1->getParameterInt32("seed"), 43);
+  EXPECT_TRUE(region1->getParameterBool("onlineLearning"));
+  EXPECT_FALSE(region1->getParameterBool("learningMode"));
+
+  // compute() should fail because network has not been initialized
+  EXPECT_THROW(net.run(1), std::exception);
+  EXPECT_THROW(region1->compute(), std::exception);
+}
+
+TEST(ColumnPoolerRegionTest, testLinking) {
+  // Feed a ScalarSensor into the pooler. While learning, the representation
+  // of the object persists across the sensations.
+  Network net;
+  std::shared_ptr<Region> sensor = net.addRegion("sensor", "ScalarSensor",
+                                       "{n: 400, w: 21, minValue: 0, maxValue: 100}");
+  std::shared_ptr<Region> pooler = net.addRegion("pooler", "ColumnPoolerRegion",
+                                       "{cellCount: 1024, sdrSize: 20, minThresholdProximal: 5}");
+  net.link("sensor", "pooler", "", "", "encoded", "feedforwardInput");
+  net.initialize();
+
+  ASSERT_EQ(pooler->getParameterUInt32("inputWidth"), 400u);
+  ASSERT_EQ(pooler->getOutputDimensions("feedForwardOutput").getCount(), 1024u);
+
+  sensor->setParameterReal64("sensedValue", 10.0);
+  net.run(1);
+  const SDR representation = pooler->getOutputData("feedForwardOutput").getSDR();
+  EXPECT_EQ(representation.getSum(), 20u);
+  EXPECT_EQ(pooler->getOutputData("activeCells").getSDR(), representation);
+
+  sensor->setParameterReal64("sensedValue", 90.0);
+  net.run(1);
+  EXPECT_EQ(pooler->getOutputData("feedForwardOutput").getSDR(), representation)
+      << "the object representation persists for a new sensation";
+
+  // After a reset the next object gets a new representation.
+  pooler->executeCommand({"reset"});
+  sensor->setParameterReal64("sensedValue", 50.0);
+  net.run(1);
+  EXPECT_EQ(pooler->getOutputData("feedForwardOutput").getSDR().getSum(), 20u);
+  EXPECT_NE(pooler->getOutputData("feedForwardOutput").getSDR(), representation);
+}
+
+TEST(ColumnPoolerRegionTest, testLateralInput) {
+  // Two cortical columns, each receiving the other's output.
+  Network net;
+  std::shared_ptr<Region> sensor = net.addRegion("sensor", "ScalarSensor",
+                                       "{n: 400, w: 21, minValue: 0, maxValue: 100}");
+  const std::string params = "{cellCount: 1024, sdrSize: 20, minThresholdProximal: 5, "
+                             "numOtherCorticalColumns: 1}";
+  std::shared_ptr<Region> column1 = net.addRegion("column1", "ColumnPoolerRegion", params);
+  std::shared_ptr<Region> column2 = net.addRegion("column2", "ColumnPoolerRegion", params);
+  net.link("sensor", "column1", "", "", "encoded", "feedforwardInput");
+  net.link("sensor", "column2", "", "", "encoded", "feedforwardInput");
+  net.link("column1", "column2", "", "", "feedForwardOutput", "lateralInput", 1);
+  net.link("column2", "column1", "", "", "feedForwardOutput", "lateralInput", 1);
+  net.initialize();
+
+  for (const Real64 value : { 10.0, 40.0, 70.0 }) {
+    sensor->setParameterReal64("sensedValue", value);
+    net.run(1);
+    EXPECT_EQ(column1->getOutputData("feedForwardOutput").getSDR().getSum(), 20u);
+    EXPECT_EQ(column2->getOutputData("feedForwardOutput").getSDR().getSum(), 20u);
+  }
+}
+
+TEST(ColumnPoolerRegionTest, testSerialization) {
+  Network net1;
+  std::shared_ptr<Region> n1region1 = net1.addRegion("region1", "ScalarSensor",
+                                          "{n: 400, w: 21, minValue: 0, maxValue: 100}");
+  std::shared_ptr<Region> n1region2 = net1.addRegion("region2", "ColumnPoolerRegion",
+                                          "{cellCount: 1024, sdrSize: 20, minThresholdProximal: 5}");
+  net1.link("region1", "region2", "", "", "encoded", "feedforwardInput");
+  n1region1->setParameterReal64("sensedValue", 5.0);
+  net1.run(1);
+
+  std::map<std::string, std::string> parameterMap;
+  EXPECT_TRUE(captureParameters(n1region2, parameterMap))
+      << "Capturing parameters before save.";
+
+  Directory::removeTree("TestOutputDir", true);
+  net1.saveToFile("TestOutputDir/columnPoolerRegionTest.stream");
+
+  Network net2;
+  net2.loadFromFile("TestOutputDir/columnPoolerRegionTest.stream");
+  std::shared_ptr<Region> n2region2 = net2.getRegion("region2");
+  ASSERT_EQ(n2region2->getType(), "ColumnPoolerRegion");
+  EXPECT_TRUE(compareParameters(n2region2, parameterMap))
+      << "Conflict when comparing ColumnPoolerRegion parameters after restore "
+         "with before save.";
+  EXPECT_TRUE(net1 == net2);
+
+  // can we continue with execution, identically?
+  net2.getRegion("region1")->setParameterReal64("sensedValue", 60.0);
+  n1region1->setParameterReal64("sensedValue", 60.0);
+  net1.run(1);
+  net2.run(1);
+  EXPECT_EQ(n1region2->getOutputData("feedForwardOutput").getSDR(),
+            n2region2->getOutputData("feedForwardOutput").getSDR());
+
+  Directory::removeTree("TestOutputDir", true);
+}
+
+} // namespace testing
@@ -0,0 +1,175 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+#include "gtest/gtest.h"
+
+#include <numeric>
+#include <thread>
+#include <vector>
+
+#include "htm/types/Types.hpp"
+#include "htm/utils/PagedVector.hpp"
+
+namespace testing {
+
+using namespace htm;
+
+// 64 bytes per page, 16 elements.
+typedef PagedVector<UInt32, 64u> SmallPages;
+
+static std::vector<UInt32> toVector(const SmallPages &v) {
+  std::vector<UInt32> out;
+  v.forEachRun(0u, v.size(), [&](const UInt32 *run, size_t n) {
+    out.insert(out.end(), run, run + n);
+  });
+  return out;
+}
+
+TEST(PagedVectorTest, PushBackAndRuns) {
+  ASSERT_EQ(SmallPages::PAGE_SIZE, 16u);
+  SmallPages v;
+  v.setPaged(true);
+  ASSERT_TRUE(v.empty());
+  for(UInt32 i = 0; i < 40u; i++) v.push_back(i);
+  ASSERT_EQ(v.size(), 40u);
+  ASSERT_EQ(v.numPages(), 3u);
+  ASSERT_EQ(v.back(), 39u);
+
+  std::vector<size_t> runs;
+  v.forEachRun(10u, 25u, [&](const UInt32 *run, size_t n) {
+    ASSERT_EQ(*run, 10u + std::accumulate(runs.begin(), runs.end(), size_t(0u)));
+    runs.push_back(n);
+  });
+  ASSERT_EQ(runs, std::vector<size_t>({6u, 16u, 3u}));
+
+  v.resize(20u);
+  ASSERT_EQ(v.numPages(), 2u);
+  v.resize(24u, 7u);
+  ASSERT_EQ(v[19], 19u);
+  ASSERT_EQ(v[20], 7u);
+  ASSERT_EQ(v[23], 7u);
+}
+
+TEST(PagedVectorTest, CopyOnWrite) {
+  SmallPages a;
+  a.setPaged(true);
+  for(UInt32 i = 0; i < 40u; i++) a.push_back(i);
+  ASSERT_FALSE(a.mayBeShared());
+  ASSERT_EQ(a.numSharedPages(), 0u);
+
+  SmallPages b(a);
+  ASSERT_TRUE(a.mayBeShared());
+  ASSERT_TRUE(b.mayBeShared());
+  ASSERT_EQ(a.numSharedPages(), 3u);
+  ASSERT_EQ(&a[0], &b[0]) << "pages are shared";
+
+  b.edit(17u) = 100u;
+  ASSERT_EQ(a[17], 17u) << "the original is not modified";
+  ASSERT_EQ(b[17], 100u);
+  ASSERT_EQ(a.numSharedPages(), 2u);
+  ASSERT_EQ(b.numSharedPages(), 2u);
+  ASSERT_EQ(&a[0], &b[0]);
+  ASSERT_NE(&a[16], &b[16]);
+
+  // Growing the copy does not modify the original either.
+  b.push_back(40u);
+  ASSERT_EQ(a.size(), 40u);
+  ASSERT_EQ(b.size(), 41u);
+
+  std::vector<UInt32> expected(40u);
+  std::iota(expected.begin(), expected.end(), 0u);
+  {
+    SmallPages c = b;
+    c.edit(0u) = 5u;
+  }
+  ASSERT_EQ(toVector(a), expected);
+  expected[17] = 100u;
+  expected.push_back(40u);
+  ASSERT_EQ(toVector(b), expected);
+
+  a.clear();
+  ASSERT_FALSE(a.mayBeShared());
+  ASSERT_EQ(b.numSharedPages(), 0u) << "pages are released";
+}
+
+TEST(PagedVectorTest, ConcurrentCopies) {
+  SmallPages source;
+  source.setPaged(true);
+  for(UInt32 i = 0; i < 100u; i++) source.push_back(i);
+  const SmallPages &constSource = source;
+
+  std::vector<SmallPages> copies(4);
+  std::vector<std::thread> threads;
+  for(UInt32 t = 0; t < copies.size(); t++) {
+    threads.emplace_back([&, t]() {
+      copies[t] = constSource;
+      copies[t].edit(0) = 1000u + t;
+    });
+  }
+  for(auto &thread : threads) thread.join();
+
+  ASSERT_TRUE(source.mayBeShared());
+  ASSERT_EQ(source[0], 0u);
+  for(UInt32 t = 0; t < copies.size(); t++) {
+    ASSERT_EQ(copies[t][0], 1000u + t);
+    ASSERT_EQ(copies[t][99], 99u);
+  }
+}
+
+TEST(PagedVectorTest, Contiguous) {
+  SmallPages a;
+  ASSERT_FALSE(a.paged());
+  for(UInt32 i = 0; i < 40u; i++) a.push_back(i);
+  ASSERT_EQ(a.numPages(), 0u);
+  size_t numRuns = 0u;
+  a.forEachRun(10u, 25u, [&](const UInt32 *run, size_t n) {
+    ASSERT_EQ(*run, 10u);
+    ASSERT_EQ(n, 25u);
+    numRuns++;
+  });
+  ASSERT_EQ(numRuns, 1u);
+
+  // Copies are deep.
+  SmallPages b(a);
+  ASSERT_FALSE(a.mayBeShared());
+  ASSERT_NE(&a[0], &b[0]);
+  b.edit(17u) = 100u;
+  ASSERT_EQ(a[17], 17u);
+
+  // Switching the storage keeps the elements.
+  std::vector<UInt32> expected = toVector(b);
+  b.setPaged(true);
+  ASSERT_TRUE(b.paged());
+  ASSERT_EQ(b.numPages(), 3u);
+  ASSERT_EQ(toVector(b), expected);
+  SmallPages c(b);
+  ASSERT_TRUE(c.paged());
+  ASSERT_EQ(b.numSharedPages(), 3u);
+  c.setPaged(false);
+  ASSERT_EQ(toVector(c), expected);
+  ASSERT_EQ(b.numSharedPages(), 0u);
+
+  a.resize(20u);
+  a.resize(24u, 7u);
+  ASSERT_EQ(a[19], 19u);
+  ASSERT_EQ(a[23], 7u);
+  a.clear();
+  ASSERT_TRUE(a.empty());
+  ASSERT_FALSE(a.paged());
+}
+
+} // namespace testing
@@ -0,0 +1,117 @@
+/* ---------------------------------------------------------------------
+ * HTM Community Edition of NuPIC
+ * Copyright (C) 2019, Numenta, Inc.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ * See the GNU Affero Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero Public License
+ * along with this program.  If not, see http://www.gnu.org/licenses.
+ * --------------------------------------------------------------------- */
+
+/** @file
+ * Implementation of unit tests for ThreadPool
+ */
+
+#include "gtest/gtest.h"
+
+#include <atomic>
+#include <stdexcept>
+#include <vector>
+
+#include <htm/utils/ThreadPool.hpp>
+
+namespace testing {
+
+using namespace htm;
+
+TEST(ThreadPoolTest, Size) {
+  ThreadPool one(1);
+  ASSERT_EQ(one.size(), 1u);
+  ThreadPool four(4);
+  ASSERT_EQ(four.size(), 4u);
+  ThreadPool automatic;
+  ASSERT_GE(automatic.size(), 1u);
+}
+
+TEST(ThreadPoolTest, RunsEachTaskOnce) {
+  ThreadPool pool(4);
+  for(size_t numTasks : {0u, 1u, 3u, 4u, 100u}) {
+    std::vector<int> runs(numTasks, 0);
+    std::vector<UInt> threads(numTasks, 99u);
+    pool.parallelFor(numTasks, [&](size_t task, UInt thread) {
+      runs[task]++;
+      threads[task] = thread;
+    });
+    for(size_t i = 0; i < numTasks; i++) {
+      ASSERT_EQ(runs[i], 1) << "task " << i << " of " << numTasks;
+      ASSERT_LT(threads[i], pool.size());
+    }
+  }
+}
+
+TEST(ThreadPoolTest, ReusedManyTimes) {
+  ThreadPool pool(3);
+  std::atomic<size_t> sum(0u);
+  for(int i = 0; i < 1000; i++) {
+    pool.parallelFor(7, [&](size_t task, UInt) { sum += task; });
+  }
+  ASSERT_EQ(sum.load(), 1000u * 21u);
+}
+
+TEST(ThreadPoolTest, Exception) {
+  ThreadPool pool(4);
+  EXPECT_THROW(pool.parallelFor(50, [](size_t task, UInt) {
+      if(task == 17) throw std::runtime_error("task failed");
+    }), std::runtime_error);
+
+  // the pool is still usable
+  std::atomic<int> count(0);
+  pool.parallelFor(10, [&](size_t, UInt) { count++; });
+  ASSERT_EQ(count.load(), 10);
+}
+
+TEST(ThreadPoolTest, NestedCallRunsSerially) {
+  ThreadPool pool(4);
+  std::vector<std::vector<int>> runs(20, std::vector<int>(10, 0));
+  std::vector<int> sameThread(20, 0);
+  pool.parallelFor(20, [&](size_t outer, UInt outerThread) {
+    pool.parallelFor(10, [&](size_t inner, UInt thread) {
+      runs[outer][inner]++;
+      sameThread[outer] += (thread == outerThread);
+    });
+  });
+  for(size_t i = 0; i < 20; i++) {
+    ASSERT_EQ(runs[i], std::vector<int>(10, 1)) << "outer task " << i;
+    ASSERT_EQ(sameThread[i], 10) << "nested tasks run on the thread of the outer task";
+  }
+
+  // Exceptions of the nested tasks reach the outer call.
+  EXPECT_THROW(pool.parallelFor(8, [&](size_t, UInt) {
+      pool.parallelFor(3, [](size_t task, UInt) {
+        if(task == 2) throw std::runtime_error("nested task failed");
+      });
+    }), std::runtime_error);
+  std::atomic<int> count(0);
+  pool.parallelFor(10, [&](size_t, UInt) { count++; });
+  ASSERT_EQ(count.load(), 10);
+}
+
+TEST(ThreadPoolTest, Chunk) {
+  size_t covered = 0u;
+  for(size_t part = 0; part < 3; part++) {
+    const auto range = ThreadPool::chunk(10, 3, part);
+    ASSERT_EQ(range.first, covered);
+    ASSERT_GE(range.second - range.first, 3u);
+    covered = range.second;
+  }
+  ASSERT_EQ(covered, 10u);
+}
+
+}